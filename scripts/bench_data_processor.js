@@ -0,0 +1,285 @@
+#!/usr/bin/env node
+// Replay the iRail /connections/ corpus through the parser and data processor
+//
+// Usage: node bench_data_processor.js [--iterations N] [--only NAME] [--update-golden]
+//        node bench_data_processor.js --record <response.json> --name NAME
+//
+// Every response in corpus/connections/v1/ goes through the same path as a
+// REQUEST_DATA and a detail request in PebbleKit JS: parseConnections from
+// 01-irail-parser.js (keeping MAX_DEPARTURES connections), processConnection
+// for each of them and processConnectionDetail for each of them. The output
+// is compared against <name>.golden.json next to the response. Then every
+// response is replayed --iterations times for parse and process time
+// (responses/s, MB/s, p50/p99), plus heap bytes allocated per response.
+// JSON.parse of the same text (what fetchConnections did before the
+// field-selective parser) is timed and measured alongside as a baseline.
+// The script exits non-zero on any golden mismatch.
+//
+// --update-golden rewrites the golden files from the current code, after a
+// deliberate change in output. --record adds a saved response (e.g. from
+// curl 'https://api.irail.be/connections/?from=...&to=...&format=json') to
+// the corpus, anonymised: all times are shifted so the first departure
+// falls on CORPUS_EPOCH, keeping the gaps between them, and the query
+// timestamp is dropped.
+//
+// Times are formatted in Europe/Brussels, like on a Belgian phone, so the
+// golden files don't depend on the machine's time zone.
+
+'use strict';
+
+process.env.TZ = 'Europe/Brussels';
+
+var fs = require('fs');
+var path = require('path');
+var v8 = require('v8');
+var vm = require('vm');
+
+var CORPUS_DIR = path.join(__dirname, 'corpus/connections/v1');
+
+// Monday 6 January 2025, 07:00 in Brussels
+var CORPUS_EPOCH = 1736143200;
+
+// Fields holding Unix times in iRail responses
+var TIME_FIELDS = ['time', 'scheduledArrivalTime', 'scheduledDepartureTime', 'startTime', 'endTime'];
+
+// The processor persists connection identifiers through Storage
+var storage = {};
+global.localStorage = {
+  getItem: function(key) { return storage.hasOwnProperty(key) ? storage[key] : null; },
+  setItem: function(key, value) { storage[key] = String(value); },
+  removeItem: function(key) { delete storage[key]; }
+};
+
+var Constants = require('../src/pkjs/00-constants.js');
+var Log = require('../src/pkjs/00-log.js');
+var IRailParser = require('../src/pkjs/01-irail-parser.js');
+var DataProcessor = require('../src/pkjs/03-data-processor.js');
+
+Log.setLevel('error');
+
+function parseArgs(argv) {
+  var options = { iterations: 200, only: null, updateGolden: false, record: null, name: null };
+  for (var i = 0; i < argv.length; i++) {
+    if (argv[i] === '--iterations') {
+      options.iterations = parseInt(argv[++i], 10);
+    } else if (argv[i] === '--only') {
+      options.only = argv[++i];
+    } else if (argv[i] === '--update-golden') {
+      options.updateGolden = true;
+    } else if (argv[i] === '--record') {
+      options.record = argv[++i];
+    } else if (argv[i] === '--name') {
+      options.name = argv[++i];
+    } else {
+      console.error('Usage: node bench_data_processor.js [--iterations N] [--only NAME] [--update-golden]');
+      console.error('       node bench_data_processor.js --record <response.json> --name NAME');
+      process.exit(1);
+    }
+  }
+  if (options.record && !options.name) {
+    console.error('--record needs --name');
+    process.exit(1);
+  }
+  return options;
+}
+
+function percentile(sorted, p) {
+  var rank = Math.ceil(p / 100 * sorted.length) - 1;
+  return sorted[Math.max(0, Math.min(sorted.length - 1, rank))];
+}
+
+function elapsedUs(start) {
+  var elapsed = process.hrtime(start);
+  return elapsed[0] * 1e6 + elapsed[1] / 1e3;
+}
+
+// Shift every time field by offset seconds, recursively
+function shiftTimes(value, offset) {
+  if (Array.isArray(value)) {
+    value.forEach(function(item) { shiftTimes(item, offset); });
+  } else if (value && typeof value === 'object') {
+    Object.keys(value).forEach(function(key) {
+      if (TIME_FIELDS.indexOf(key) !== -1 && /^\d+$/.test(value[key])) {
+        value[key] = String(parseInt(value[key], 10) + offset);
+      } else {
+        shiftTimes(value[key], offset);
+      }
+    });
+  }
+}
+
+function record(file, name) {
+  var response = JSON.parse(fs.readFileSync(file, 'utf8'));
+  if (!response.connection || response.connection.length === 0) {
+    console.error(file + ' has no connections');
+    process.exit(1);
+  }
+  shiftTimes(response, CORPUS_EPOCH - parseInt(response.connection[0].departure.time, 10));
+  response.timestamp = String(CORPUS_EPOCH);
+
+  var target = path.join(CORPUS_DIR, name + '.json');
+  fs.writeFileSync(target, JSON.stringify(response));
+  console.log('Recorded ' + target + ' (' + response.connection.length + ' connections, ' +
+              fs.statSync(target).size + ' B); run with --update-golden to add its golden file');
+}
+
+// What the watch would get for one response
+function replay(text) {
+  var response = IRailParser.parseConnections(text, Constants.CONFIG.MAX_DEPARTURES);
+  var connections = response.connection || [];
+  return {
+    departures: connections.map(function(conn, index) {
+      return DataProcessor.processConnection(conn, index);
+    }),
+    details: connections.map(function(conn) {
+      return DataProcessor.processConnectionDetail(conn);
+    })
+  };
+}
+
+function parseOnly(text) {
+  return IRailParser.parseConnections(text, Constants.CONFIG.MAX_DEPARTURES);
+}
+
+// First line where two outputs differ, or null
+function firstDifference(expected, actual) {
+  var a = JSON.stringify(expected, null, 2).split('\n');
+  var b = JSON.stringify(actual, null, 2).split('\n');
+  for (var i = 0; i < Math.max(a.length, b.length); i++) {
+    if (a[i] !== b[i]) {
+      return 'line ' + (i + 1) + ': expected ' + (a[i] || '(end)').trim() + ', got ' +
+             (b[i] || '(end)').trim();
+    }
+  }
+  return null;
+}
+
+function checkGolden(entry, output, update) {
+  var goldenFile = path.join(CORPUS_DIR, entry.name + '.golden.json');
+  if (update) {
+    fs.writeFileSync(goldenFile, JSON.stringify(output, null, 2) + '\n');
+    return 'updated';
+  }
+  if (!fs.existsSync(goldenFile)) {
+    return 'no golden file';
+  }
+  var difference = firstDifference(JSON.parse(fs.readFileSync(goldenFile, 'utf8')), output);
+  return difference ? 'MISMATCH at ' + difference : 'ok';
+}
+
+// Heap bytes allocated by fn(text) (median of several, each after a full
+// GC so a young-generation collection rarely lands inside the measurement)
+function allocatedBytes(fn, text, gc) {
+  var samples = [];
+  for (var i = 0; i < 15; i++) {
+    gc();
+    var before = process.memoryUsage().heapUsed;
+    fn(text);
+    samples.push(process.memoryUsage().heapUsed - before);
+  }
+  samples.sort(function(a, b) { return a - b; });
+  return percentile(samples, 50);
+}
+
+function bench(entry, iterations, gc) {
+  var parseTimes = [];
+  var processTimes = [];
+  var totalTimes = [];
+  var jsonTimes = [];
+
+  // Warm up so the JIT has settled before timing
+  for (var w = 0; w < 20; w++) {
+    replay(entry.text);
+    JSON.parse(entry.text);
+  }
+
+  for (var i = 0; i < iterations; i++) {
+    var jsonStart = process.hrtime();
+    JSON.parse(entry.text);
+    jsonTimes.push(elapsedUs(jsonStart));
+
+    var start = process.hrtime();
+    var response = IRailParser.parseConnections(entry.text, Constants.CONFIG.MAX_DEPARTURES);
+    var parsed = elapsedUs(start);
+    var connections = response.connection || [];
+    connections.forEach(function(conn, index) {
+      DataProcessor.processConnection(conn, index);
+      DataProcessor.processConnectionDetail(conn);
+    });
+    var total = elapsedUs(start);
+    parseTimes.push(parsed);
+    processTimes.push(total - parsed);
+    totalTimes.push(total);
+  }
+
+  [parseTimes, processTimes, totalTimes, jsonTimes].forEach(function(times) {
+    times.sort(function(a, b) { return a - b; });
+  });
+  var sum = totalTimes.reduce(function(acc, t) { return acc + t; }, 0);
+  return {
+    perSecond: iterations / (sum / 1e6),
+    mbPerSecond: entry.text.length * iterations / (sum / 1e6) / (1024 * 1024),
+    parse: parseTimes,
+    process: processTimes,
+    total: totalTimes,
+    json: jsonTimes,
+    allocated: allocatedBytes(replay, entry.text, gc),
+    parseAllocated: allocatedBytes(parseOnly, entry.text, gc),
+    jsonAllocated: allocatedBytes(JSON.parse, entry.text, gc)
+  };
+}
+
+function loadCorpus(only) {
+  return fs.readdirSync(CORPUS_DIR).filter(function(file) {
+    return /\.json$/.test(file) && !/\.golden\.json$/.test(file) &&
+           (!only || file === only + '.json');
+  }).sort().map(function(file) {
+    return { name: file.replace(/\.json$/, ''), text: fs.readFileSync(path.join(CORPUS_DIR, file), 'utf8') };
+  });
+}
+
+var options = parseArgs(process.argv.slice(2));
+if (options.record) {
+  record(options.record, options.name);
+  process.exit(0);
+}
+
+v8.setFlagsFromString('--expose-gc');
+var gc = vm.runInNewContext('gc');
+
+var corpus = loadCorpus(options.only);
+if (corpus.length === 0) {
+  console.error('No responses in ' + CORPUS_DIR + (options.only ? ' named ' + options.only : ''));
+  process.exit(1);
+}
+
+var failures = 0;
+console.log('Corpus: ' + corpus.length + ' responses in ' + path.relative(process.cwd(), CORPUS_DIR) +
+            ', ' + options.iterations + ' iterations each, TZ ' + process.env.TZ);
+corpus.forEach(function(entry) {
+  var output = replay(entry.text);
+  var status = checkGolden(entry, output, options.updateGolden);
+  if (status !== 'ok' && status !== 'updated') {
+    failures++;
+  }
+  var legs = output.details.reduce(function(sum, legList) { return sum + legList.length; }, 0);
+  console.log('\n' + entry.name + ': ' + (entry.text.length / 1024).toFixed(1) + ' KB, ' +
+              output.departures.length + ' departures, ' + legs + ' legs, golden ' + status);
+
+  var result = bench(entry, options.iterations, gc);
+  console.log('  ' + result.perSecond.toFixed(0) + ' responses/s, ' + result.mbPerSecond.toFixed(1) +
+              ' MB/s, ' + (result.allocated / 1024).toFixed(1) + ' KB allocated per response');
+  [['parse     ', result.parse], ['process   ', result.process], ['total     ', result.total],
+   ['JSON.parse', result.json]].forEach(function(row) {
+    console.log('  ' + row[0] + ' p50=' + percentile(row[1], 50).toFixed(1) + ' us p99=' +
+                percentile(row[1], 99).toFixed(1) + ' us');
+  });
+  console.log('  parse allocates ' + (result.parseAllocated / 1024).toFixed(1) + ' KB, JSON.parse ' +
+              (result.jsonAllocated / 1024).toFixed(1) + ' KB; parse p50 is ' +
+              (percentile(result.parse, 50) / percentile(result.json, 50)).toFixed(2) + 'x JSON.parse');
+});
+
+if (failures > 0) {
+  console.error('\n' + failures + ' response(s) differ from their golden output');
+  process.exit(1);
+}
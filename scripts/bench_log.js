@@ -0,0 +1,136 @@
+#!/usr/bin/env node
+// Cost of the per-departure debug logging, eager vs lazy
+//
+// Usage: node bench_log.js [--iterations N]
+//
+// Every response in corpus/connections/v1/ is processed once; then the
+// debug lines PebbleKit JS logs for each departure of the list (sending and
+// sent, details sent, platform change, its legs) are replayed --iterations
+// times, once as strings built at the call site (eager) and once as
+// functions Log only calls when debug is on (lazy). Both run at the default
+// level, where debug lines are dropped, and at debug with console.log
+// stubbed out, so what is timed is building the message, not printing it.
+// Prints ns per departure list, p50 over the iterations.
+
+'use strict';
+
+process.env.TZ = 'Europe/Brussels';
+
+var fs = require('fs');
+var path = require('path');
+
+var CORPUS_DIR = path.join(__dirname, 'corpus/connections/v1');
+
+var storage = {};
+global.localStorage = {
+  getItem: function(key) { return storage.hasOwnProperty(key) ? storage[key] : null; },
+  setItem: function(key, value) { storage[key] = String(value); },
+  removeItem: function(key) { delete storage[key]; }
+};
+
+var Constants = require('../src/pkjs/00-constants.js');
+var Log = require('../src/pkjs/00-log.js');
+var IRailParser = require('../src/pkjs/01-irail-parser.js');
+var DataProcessor = require('../src/pkjs/03-data-processor.js');
+
+function parseArgs(argv) {
+  var options = { iterations: 20000 };
+  for (var i = 0; i < argv.length; i++) {
+    if (argv[i] === '--iterations') {
+      options.iterations = parseInt(argv[++i], 10);
+    } else {
+      console.error('Usage: node bench_log.js [--iterations N]');
+      process.exit(1);
+    }
+  }
+  return options;
+}
+
+// Departures and legs of one response, as the message handler sees them
+function loadList(file) {
+  Log.setLevel('error');
+  var response = IRailParser.parseConnections(fs.readFileSync(file, 'utf8'),
+                                              Constants.CONFIG.MAX_DEPARTURES);
+  return (response.connection || []).map(function(conn, index) {
+    return {
+      departure: DataProcessor.processConnection(conn, index),
+      legs: DataProcessor.processConnectionDetail(conn)
+    };
+  });
+}
+
+// The debug lines of 04-message-handler.js and 03-data-processor.js for
+// one list, with messages built up front
+function logEager(list, requestId) {
+  list.forEach(function(item, index) {
+    Log.debug('Platform changed: ' + item.departure.platformChanged);
+    Log.debug('Sending departure ' + index + ': ' + item.departure.destination + ' [ID ' + requestId + ']');
+    Log.debug('Departure ' + index + ' sent successfully');
+    Log.debug('Built ' + item.legs.length + ' legs');
+    Log.debug('Departure details ' + index + ' sent');
+    item.legs.forEach(function(leg, legIndex) {
+      Log.debug('Sending leg ' + legIndex + ': ' + leg.departStation + ' → ' + leg.arriveStation +
+                ' [ID ' + requestId + ']');
+    });
+  });
+}
+
+// The same lines in the lazy form
+function logLazy(list, requestId) {
+  list.forEach(function(item, index) {
+    Log.debug(function() { return 'Platform changed: ' + item.departure.platformChanged; });
+    Log.debug(function() {
+      return 'Sending departure ' + index + ': ' + item.departure.destination + ' [ID ' + requestId + ']';
+    });
+    Log.debug(function() { return 'Departure ' + index + ' sent successfully'; });
+    Log.debug(function() { return 'Built ' + item.legs.length + ' legs'; });
+    Log.debug(function() { return 'Departure details ' + index + ' sent'; });
+    item.legs.forEach(function(leg, legIndex) {
+      Log.debug(function() {
+        return 'Sending leg ' + legIndex + ': ' + leg.departStation + ' → ' + leg.arriveStation +
+               ' [ID ' + requestId + ']';
+      });
+    });
+  });
+}
+
+// p50 ns of one fn(list, requestId), cycling through the lists
+function time(fn, lists, iterations) {
+  var samples = [];
+  for (var w = 0; w < 1000; w++) {
+    fn(lists[w % lists.length], w);
+  }
+  for (var i = 0; i < iterations; i++) {
+    var start = process.hrtime();
+    fn(lists[i % lists.length], i);
+    var elapsed = process.hrtime(start);
+    samples.push(elapsed[0] * 1e9 + elapsed[1]);
+  }
+  samples.sort(function(a, b) { return a - b; });
+  return samples[Math.floor(samples.length / 2)];
+}
+
+var options = parseArgs(process.argv.slice(2));
+var lists = fs.readdirSync(CORPUS_DIR).filter(function(file) {
+  return /\.json$/.test(file) && !/\.golden\.json$/.test(file);
+}).sort().map(function(file) {
+  return loadList(path.join(CORPUS_DIR, file));
+});
+var lines = lists.reduce(function(sum, list) {
+  return sum + list.reduce(function(acc, item) { return acc + 5 + item.legs.length; }, 0);
+}, 0) / lists.length;
+
+console.log('Corpus: ' + lists.length + ' lists, ' + lines.toFixed(1) + ' debug lines per list on average, ' +
+            options.iterations + ' iterations');
+var print = console.log;
+[Constants.CONFIG.DEFAULT_LOG_LEVEL, 'debug'].forEach(function(level) {
+  Log.setLevel(level);
+  if (level === 'debug') {
+    console.log = function() {};
+  }
+  var eager = time(logEager, lists, options.iterations);
+  var lazy = time(logLazy, lists, options.iterations);
+  console.log = print;
+  console.log('  level ' + level + ': eager ' + eager.toFixed(0) + ' ns/list, lazy ' + lazy.toFixed(0) +
+              ' ns/list');
+});
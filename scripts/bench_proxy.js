@@ -0,0 +1,195 @@
+#!/usr/bin/env node
+// Load generator for the iRail proxy (throughput, latency and hit rate)
+//
+// Usage: node bench_proxy.js [--clients N] [--duration S] [--routes N]
+//                            [--think MS] [--latency MS] [--direct] [--proxy URL]
+//
+// By default starts mock_irail.js and irail_proxy.js in-process, so it runs
+// offline. --clients simulated phones each request /connections/ for a
+// route drawn from --routes popular routes (Zipf-distributed, like a commute
+// peak), wait around --think ms and repeat for --duration seconds. --direct
+// sends the same load straight to the mock upstream for comparison; --proxy
+// benchmarks an already running proxy instead.
+
+'use strict';
+
+var http = require('http');
+var url = require('url');
+var MockIRail = require('./mock_irail.js');
+var IRailProxy = require('./irail_proxy.js');
+
+function parseArgs(argv) {
+  var options = { clients: 200, duration: 10, routes: 30, think: 1000, latency: 200,
+                  direct: false, proxy: null };
+  for (var i = 0; i < argv.length; i++) {
+    var name = argv[i].replace(/^--/, '');
+    if (name === 'direct') {
+      options.direct = true;
+    } else if (name === 'proxy') {
+      options.proxy = argv[++i];
+    } else if (options.hasOwnProperty(name)) {
+      options[name] = parseInt(argv[++i], 10);
+    } else {
+      console.error('Usage: node bench_proxy.js [--clients N] [--duration S] [--routes N] ' +
+                    '[--think MS] [--latency MS] [--direct] [--proxy URL]');
+      process.exit(1);
+    }
+  }
+  return options;
+}
+
+// Deterministic pseudo-random numbers so runs are comparable
+var seed = 12345;
+function random() {
+  seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF;
+  return seed / 0x7FFFFFFF;
+}
+
+// Cumulative Zipf weights: route k is requested about 1/(k+1) as often as route 0
+function zipfTable(count) {
+  var weights = [];
+  var total = 0;
+  for (var k = 0; k < count; k++) {
+    total += 1 / (k + 1);
+    weights.push(total);
+  }
+  return weights.map(function(w) { return w / total; });
+}
+
+function pickRoute(table) {
+  var r = random();
+  for (var k = 0; k < table.length; k++) {
+    if (r <= table[k]) {
+      return k;
+    }
+  }
+  return table.length - 1;
+}
+
+function percentile(sorted, p) {
+  var rank = Math.ceil(p / 100 * sorted.length) - 1;
+  return sorted[Math.max(0, Math.min(sorted.length - 1, rank))];
+}
+
+function getJson(agent, target, path, callback) {
+  var start = process.hrtime();
+  http.get({ hostname: target.hostname, port: target.port, path: path, agent: agent }, function(response) {
+    var length = 0;
+    response.on('data', function(chunk) { length += chunk.length; });
+    response.on('end', function() {
+      var elapsed = process.hrtime(start);
+      callback(response.statusCode, length, elapsed[0] * 1000 + elapsed[1] / 1e6);
+    });
+  }).on('error', function() {
+    callback(0, 0, 0);
+  });
+}
+
+function listen(server) {
+  return new Promise(function(resolve) {
+    server.listen(0, '127.0.0.1', function() {
+      resolve('http://127.0.0.1:' + server.address().port);
+    });
+  });
+}
+
+function run(options) {
+  var upstream = null;
+  var proxy = null;
+  var setup;
+
+  if (options.proxy) {
+    setup = Promise.resolve(options.proxy);
+  } else {
+    upstream = MockIRail.createMockUpstream({ latency: options.latency });
+    setup = listen(upstream).then(function(upstreamUrl) {
+      if (options.direct) {
+        return upstreamUrl;
+      }
+      proxy = IRailProxy.createProxy({ upstream: upstreamUrl });
+      return listen(proxy);
+    });
+  }
+
+  return setup.then(function(targetUrl) {
+    var target = url.parse(targetUrl);
+    var agent = new http.Agent({ keepAlive: true, maxSockets: options.clients });
+    var table = zipfTable(options.routes);
+    var latencies = [];
+    var bytes = 0;
+    var errors = 0;
+    var end = Date.now() + options.duration * 1000;
+
+    console.log('Target: ' + targetUrl + (options.direct ? ' (direct, no proxy)' : '') + ', ' +
+                options.clients + ' clients, ' + options.routes + ' routes, ' +
+                options.think + ' ms think time, ' + options.duration + ' s');
+
+    function client() {
+      return new Promise(function(resolve) {
+        function next() {
+          if (Date.now() >= end) {
+            resolve();
+            return;
+          }
+          var route = pickRoute(table);
+          var path = '/connections/?from=BE.NMBS.0088' + (10000 + route) +
+                     '&to=BE.NMBS.0088' + (20000 + route) + '&format=json&lang=en';
+          getJson(agent, target, path, function(status, length, ms) {
+            if (status === 200) {
+              latencies.push(ms);
+              bytes += length;
+            } else {
+              errors++;
+            }
+            setTimeout(next, random() * 2 * options.think);
+          });
+        }
+        // Spread the first requests over one think time
+        setTimeout(next, random() * options.think);
+      });
+    }
+
+    var clients = [];
+    for (var c = 0; c < options.clients; c++) {
+      clients.push(client());
+    }
+
+    return Promise.all(clients).then(function() {
+      agent.destroy();
+      latencies.sort(function(a, b) { return a - b; });
+      var count = latencies.length;
+      console.log('Requests: ' + count + ' ok, ' + errors + ' failed, ' +
+                  (count / options.duration).toFixed(1) + ' req/s');
+      if (count > 0) {
+        console.log('Latency: p50=' + percentile(latencies, 50).toFixed(1) + ' ms p90=' +
+                    percentile(latencies, 90).toFixed(1) + ' ms p99=' +
+                    percentile(latencies, 99).toFixed(1) + ' ms');
+        console.log('Payload: ' + Math.round(bytes / count) + ' B per response');
+      }
+      if (upstream) {
+        console.log('Upstream requests: ' + upstream.stats.requests + ' (' +
+                    (upstream.stats.requests / Math.max(1, count + errors) * 100).toFixed(1) +
+                    '% of client requests)');
+      }
+      if (proxy) {
+        var stats = proxy.stats;
+        console.log('Proxy: ' + stats.hits + ' cache hits, ' + stats.coalesced + ' coalesced, ' +
+                    'hit rate ' + ((stats.hits + stats.coalesced) / Math.max(1, stats.requests) * 100).toFixed(1) +
+                    '%, upstream ' + Math.round(stats.bytesIn / 1024) + ' KB in, ' +
+                    Math.round(stats.bytesOut / 1024) + ' KB out');
+      }
+    }).then(function() {
+      if (proxy) {
+        proxy.close();
+      }
+      if (upstream) {
+        upstream.close();
+      }
+    });
+  });
+}
+
+run(parseArgs(process.argv.slice(2))).catch(function(e) {
+  console.error('Error: ' + e.message);
+  process.exit(1);
+});
@@ -0,0 +1,159 @@
+#!/usr/bin/env node
+// Benchmark nearest-station lookups (grid index vs. linear scan)
+//
+// Usage: node bench_station_grid.js <stations.json> [--queries N] [--radius KM]
+//        node bench_station_grid.js --synthetic [--queries N] [--radius KM]
+//
+// Loads a saved iRail /stations/?format=json response (the full station set,
+// mapped the way fetchStations caches it), builds the grid from
+// 01-station-grid.js and answers lookups from random points around the
+// stations, checking every answer against a scan of all stations.
+// --synthetic scatters ~700 stations over Belgium and its neighbours
+// instead of loading a file.
+
+'use strict';
+
+var fs = require('fs');
+var StationGrid = require('../src/pkjs/01-station-grid.js');
+
+function parseArgs(argv) {
+  var options = { file: null, synthetic: false, queries: 100000, radius: 1 };
+  for (var i = 0; i < argv.length; i++) {
+    if (argv[i] === '--queries') {
+      options.queries = parseInt(argv[++i], 10);
+    } else if (argv[i] === '--radius') {
+      options.radius = parseFloat(argv[++i]);
+    } else if (argv[i] === '--synthetic') {
+      options.synthetic = true;
+    } else {
+      options.file = argv[i];
+    }
+  }
+  if (!options.file && !options.synthetic) {
+    console.error('Usage: node bench_station_grid.js <stations.json> [--queries N] [--radius KM]');
+    console.error('       node bench_station_grid.js --synthetic [--queries N] [--radius KM]');
+    process.exit(1);
+  }
+  return options;
+}
+
+// Deterministic pseudo-random numbers so runs are comparable
+var seed = 12345;
+function random() {
+  seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF;
+  return seed / 0x7FFFFFFF;
+}
+
+// Dense around a few cities like the real network, sparse elsewhere
+function syntheticStations() {
+  var cities = [[50.85, 4.35], [51.22, 4.40], [51.05, 3.72], [50.63, 5.57], [50.41, 4.44],
+                [50.88, 4.70], [51.21, 3.22], [50.47, 4.87], [50.93, 5.34], [50.83, 3.26]];
+  var stations = [];
+  for (var i = 0; i < 700; i++) {
+    var lat;
+    var lon;
+    if (i % 3 === 0) {
+      lat = 49.5 + random() * 2;
+      lon = 2.5 + random() * 3.8;
+    } else {
+      var city = cities[i % cities.length];
+      lat = city[0] + (random() - 0.5) * 0.4;
+      lon = city[1] + (random() - 0.5) * 0.6;
+    }
+    stations.push({ id: 'BE.NMBS.00' + (8800000 + i), name: 'Station ' + i, lat: lat, lon: lon });
+  }
+  return stations;
+}
+
+function loadStations(file) {
+  var response = JSON.parse(fs.readFileSync(file, 'utf8'));
+  return response.station.map(function(s) {
+    return { id: s.id, name: s.name, lat: parseFloat(s.locationY), lon: parseFloat(s.locationX) };
+  });
+}
+
+function linearNearest(stations, lat, lon, maxKm) {
+  var best = null;
+  stations.forEach(function(station) {
+    var km = StationGrid.distanceKm(lat, lon, station.lat, station.lon);
+    if (km <= maxKm && (!best || km < best.km)) {
+      best = { station: station, km: km };
+    }
+  });
+  return best;
+}
+
+function percentile(sorted, p) {
+  var rank = Math.ceil(p / 100 * sorted.length) - 1;
+  return sorted[Math.max(0, Math.min(sorted.length - 1, rank))];
+}
+
+function timeQueries(points, lookup) {
+  var times = [];
+  var results = [];
+  points.forEach(function(point) {
+    var start = process.hrtime();
+    results.push(lookup(point[0], point[1]));
+    var elapsed = process.hrtime(start);
+    times.push(elapsed[0] * 1e6 + elapsed[1] / 1e3);
+  });
+  times.sort(function(a, b) { return a - b; });
+  return { times: times, results: results };
+}
+
+function report(label, times) {
+  var total = times.reduce(function(sum, t) { return sum + t; }, 0);
+  console.log(label + ': mean=' + (total / times.length).toFixed(2) + ' us p50=' +
+              percentile(times, 50).toFixed(2) + ' us p99=' + percentile(times, 99).toFixed(2) +
+              ' us max=' + times[times.length - 1].toFixed(2) + ' us');
+}
+
+var options = parseArgs(process.argv.slice(2));
+var stations = options.synthetic ? syntheticStations() : loadStations(options.file);
+
+var t0 = process.hrtime();
+var grid = StationGrid.build(stations);
+var buildTime = process.hrtime(t0);
+var located = stations.filter(function(s) { return !isNaN(s.lat) && !isNaN(s.lon); });
+
+// Half the queries near a station (someone on a platform), half anywhere
+var points = [];
+for (var q = 0; q < options.queries; q++) {
+  var near = located[Math.floor(random() * located.length)];
+  if (q % 2 === 0) {
+    points.push([near.lat + (random() - 0.5) * 0.01, near.lon + (random() - 0.5) * 0.015]);
+  } else {
+    points.push([near.lat + (random() - 0.5) * 0.5, near.lon + (random() - 0.5) * 0.8]);
+  }
+}
+
+var gridRun = timeQueries(points, function(lat, lon) {
+  return StationGrid.nearest(grid, lat, lon, options.radius);
+});
+var linearRun = timeQueries(points, function(lat, lon) {
+  return linearNearest(located, lat, lon, options.radius);
+});
+
+var mismatches = 0;
+var found = 0;
+for (var i = 0; i < points.length; i++) {
+  var a = gridRun.results[i];
+  var b = linearRun.results[i];
+  if (b) {
+    found++;
+  }
+  if ((a && a.km) !== (b && b.km)) {
+    mismatches++;
+  }
+}
+
+console.log('Stations: ' + stations.length + ' (' + grid.size + ' with coordinates) in ' +
+            Object.keys(grid.cells).length + ' cells, built in ' +
+            (buildTime[0] * 1000 + buildTime[1] / 1e6).toFixed(2) + ' ms');
+console.log('Queries: ' + points.length + ' within ' + options.radius + ' km (' + found +
+            ' with a station), ' + mismatches + ' mismatches');
+report('  grid  ', gridRun.times);
+report('  linear', linearRun.times);
+if (mismatches > 0) {
+  process.exit(1);
+}
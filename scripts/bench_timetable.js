@@ -0,0 +1,171 @@
+#!/usr/bin/env node
+// Benchmark offline timetable queries (query time and memory)
+//
+// Usage: node bench_timetable.js <timetable.json> [--queries N] [--date YYYYMMDD]
+//        node bench_timetable.js --synthetic [--queries N]
+//
+// Loads a timetable written by build_timetable.js (use a full-network one to
+// get worst-case numbers), builds the dated connection list for one service
+// day and plans MAX_DEPARTURES journeys between random station pairs at
+// random times of day, the same way PebbleKit JS answers REQUEST_DATA.
+// --synthetic generates a network of roughly NMBS size instead of loading
+// a file.
+
+'use strict';
+
+var fs = require('fs');
+var ConnectionScan = require('../src/pkjs/01-connection-scan.js');
+var Constants = require('../src/pkjs/00-constants.js');
+
+function parseArgs(argv) {
+  var options = { file: null, synthetic: false, queries: 500, date: null };
+  for (var i = 0; i < argv.length; i++) {
+    if (argv[i] === '--queries') {
+      options.queries = parseInt(argv[++i], 10);
+    } else if (argv[i] === '--date') {
+      options.date = argv[++i];
+    } else if (argv[i] === '--synthetic') {
+      options.synthetic = true;
+    } else {
+      options.file = argv[i];
+    }
+  }
+  if (!options.file && !options.synthetic) {
+    console.error('Usage: node bench_timetable.js <timetable.json> [--queries N] [--date YYYYMMDD]');
+    console.error('       node bench_timetable.js --synthetic [--queries N]');
+    process.exit(1);
+  }
+  return options;
+}
+
+// Deterministic pseudo-random numbers so runs are comparable
+var seed = 12345;
+function random() {
+  seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF;
+  return seed / 0x7FFFFFFF;
+}
+
+function formatDate(date) {
+  return date.getFullYear() + ('0' + (date.getMonth() + 1)).slice(-2) +
+         ('0' + date.getDate()).slice(-2);
+}
+
+// ~600 stations on 40 lines, ~4000 trips per day with 15 stops each
+function syntheticTimetable() {
+  var stationCount = 600;
+  var stations = [];
+  for (var s = 0; s < stationCount; s++) {
+    stations.push(['BE.NMBS.00' + (8800000 + s), 'Station ' + s]);
+  }
+
+  var lines = [];
+  for (var l = 0; l < 40; l++) {
+    var stops = [];
+    for (var k = 0; k < 15; k++) {
+      // Lines share a few hub stations so transfers are possible
+      stops.push(k % 5 === 0 ? (l + k) % 20 : Math.floor(random() * stationCount));
+    }
+    lines.push(stops);
+  }
+
+  var trips = [];
+  var connections = [];
+  for (var t = 0; t < 4000; t++) {
+    var line = lines[t % lines.length];
+    var reverse = t % 2 === 1;
+    var time = 5 * 3600 + Math.floor(random() * 19 * 3600);
+    trips.push([0, 'IC', String(1000 + t), 'Station ' + line[reverse ? 0 : line.length - 1]]);
+    for (var i = 0; i + 1 < line.length; i++) {
+      var from = line[reverse ? line.length - 1 - i : i];
+      var to = line[reverse ? line.length - 2 - i : i + 1];
+      var run = 180 + Math.floor(random() * 420);
+      connections.push([from, to, time, time + run, t, 0, 0]);
+      time += run + 60;
+    }
+  }
+  connections.sort(function(a, b) { return a[2] - b[2]; });
+
+  var flat = [];
+  connections.forEach(function(c) {
+    for (var k = 0; k < c.length; k++) {
+      flat.push(c[k]);
+    }
+  });
+  return {
+    v: 1, start: formatDate(new Date()), days: 1,
+    stations: stations, services: ['1'], trips: trips, platforms: [''], connections: flat
+  };
+}
+
+function percentile(sorted, p) {
+  var rank = Math.ceil(p / 100 * sorted.length) - 1;
+  return sorted[Math.max(0, Math.min(sorted.length - 1, rank))];
+}
+
+// JS heap plus typed array storage, in MB (run with --expose-gc for stable numbers)
+function heapMb() {
+  if (global.gc) {
+    global.gc();
+  }
+  var usage = process.memoryUsage();
+  return (usage.heapUsed + (usage.arrayBuffers || 0)) / 1048576;
+}
+
+var options = parseArgs(process.argv.slice(2));
+var baseHeap = heapMb();
+
+var t0 = Date.now();
+var timetable;
+var size;
+if (options.synthetic) {
+  timetable = syntheticTimetable();
+  size = JSON.stringify(timetable).length;
+} else {
+  var text = fs.readFileSync(options.file, 'utf8');
+  size = text.length;
+  timetable = JSON.parse(text);
+  text = null;
+}
+var loadMs = Date.now() - t0;
+var loadedHeap = heapMb();
+
+var date = options.date ? ConnectionScan.parseServiceDate(options.date) :
+    ConnectionScan.parseServiceDate(timetable.start);
+t0 = Date.now();
+var day = ConnectionScan.buildDay(timetable, date);
+var buildMs = Date.now() - t0;
+if (!day) {
+  console.error('Date ' + formatDate(date) + ' is outside the timetable horizon');
+  process.exit(1);
+}
+var dayHeap = heapMb();
+
+var dayStart = Math.floor(date.getTime() / 1000) - 12 * 3600;
+var times = [];
+var found = 0;
+for (var q = 0; q < options.queries; q++) {
+  var from = timetable.stations[Math.floor(random() * timetable.stations.length)][0];
+  var to = timetable.stations[Math.floor(random() * timetable.stations.length)][0];
+  var when = dayStart + 5 * 3600 + Math.floor(random() * 17 * 3600);
+  var start = process.hrtime();
+  var result = ConnectionScan.plan(timetable, day, from, to, when,
+                                   Constants.CONFIG.MAX_DEPARTURES,
+                                   Constants.CONFIG.TIMETABLE_MIN_CHANGE);
+  var elapsed = process.hrtime(start);
+  times.push(elapsed[0] * 1000 + elapsed[1] / 1e6);
+  if (result && result.connection.length > 0) {
+    found++;
+  }
+}
+times.sort(function(a, b) { return a - b; });
+
+console.log('Timetable: ' + timetable.stations.length + ' stations, ' + timetable.trips.length +
+            ' trips, ' + (timetable.connections.length / ConnectionScan.STRIDE) +
+            ' connections, ' + Math.round(size / 1024) + ' KB JSON');
+console.log('Load: ' + loadMs + ' ms, heap +' + (loadedHeap - baseHeap).toFixed(1) + ' MB');
+console.log('Service day ' + formatDate(date) + ': ' + day.dep.length + ' dated connections, ' +
+            buildMs + ' ms, heap +' + (dayHeap - loadedHeap).toFixed(1) + ' MB');
+console.log('Queries: ' + options.queries + ' (' + found + ' with results), ' +
+            Constants.CONFIG.MAX_DEPARTURES + ' journeys each');
+console.log('  p50=' + percentile(times, 50).toFixed(2) + ' ms p90=' +
+            percentile(times, 90).toFixed(2) + ' ms max=' + times[times.length - 1].toFixed(2) + ' ms');
@@ -0,0 +1,278 @@
+#!/usr/bin/env node
+// Build the compact offline timetable from an NMBS GTFS export
+//
+// Usage: node build_timetable.js <gtfs_dir> <output.json> [options]
+//   --start YYYYMMDD     First service day (default: today)
+//   --days N             Number of service days to include (default: 7)
+//   --stations ID,ID     Only keep trips calling at these iRail station IDs
+//
+// The output format is documented in src/pkjs/01-connection-scan.js. Host the
+// full-network file and point CONFIG.TIMETABLE_URL at it; the phone keeps only
+// the trips serving the user's favorite stations.
+
+'use strict';
+
+var fs = require('fs');
+var path = require('path');
+var readline = require('readline');
+var ConnectionScan = require('../src/pkjs/01-connection-scan.js');
+
+var DAY_MS = 24 * 60 * 60 * 1000;
+
+function usage() {
+  console.error('Usage: node build_timetable.js <gtfs_dir> <output.json> ' +
+                '[--start YYYYMMDD] [--days N] [--stations ID,ID]');
+  process.exit(1);
+}
+
+function parseArgs(argv) {
+  var options = { start: null, days: 7, stations: null, positional: [] };
+  for (var i = 0; i < argv.length; i++) {
+    if (argv[i] === '--start') {
+      options.start = argv[++i];
+    } else if (argv[i] === '--days') {
+      options.days = parseInt(argv[++i], 10);
+    } else if (argv[i] === '--stations') {
+      options.stations = argv[++i].split(',');
+    } else {
+      options.positional.push(argv[i]);
+    }
+  }
+  if (options.positional.length !== 2 || !(options.days > 0)) {
+    usage();
+  }
+  return options;
+}
+
+function formatDate(date) {
+  return date.getFullYear() + ('0' + (date.getMonth() + 1)).slice(-2) +
+         ('0' + date.getDate()).slice(-2);
+}
+
+// Split one CSV line, honouring double-quoted fields
+function splitCsv(line) {
+  var fields = [];
+  var field = '';
+  var quoted = false;
+  for (var i = 0; i < line.length; i++) {
+    var c = line.charAt(i);
+    if (quoted) {
+      if (c === '"' && line.charAt(i + 1) === '"') {
+        field += '"';
+        i++;
+      } else if (c === '"') {
+        quoted = false;
+      } else {
+        field += c;
+      }
+    } else if (c === '"') {
+      quoted = true;
+    } else if (c === ',') {
+      fields.push(field);
+      field = '';
+    } else {
+      field += c;
+    }
+  }
+  fields.push(field);
+  return fields;
+}
+
+// Stream a GTFS table, calling onRow with an object per line.
+// Resolves without rows if the (optional) file does not exist.
+function readTable(dir, name, onRow) {
+  return new Promise(function(resolve, reject) {
+    var file = path.join(dir, name);
+    if (!fs.existsSync(file)) {
+      resolve();
+      return;
+    }
+    var header = null;
+    var input = fs.createReadStream(file, { encoding: 'utf8' });
+    input.on('error', reject);
+    var lines = readline.createInterface({ input: input, crlfDelay: Infinity });
+    lines.on('line', function(line) {
+      if (!line) {
+        return;
+      }
+      var fields = splitCsv(line);
+      if (!header) {
+        // Strip a UTF-8 BOM from the first column name
+        header = fields.map(function(f) { return f.replace(/^\uFEFF/, '').trim(); });
+        return;
+      }
+      var row = {};
+      for (var i = 0; i < header.length; i++) {
+        row[header[i]] = fields[i] || '';
+      }
+      onRow(row);
+    });
+    lines.on('close', resolve);
+  });
+}
+
+// GTFS HH:MM:SS (hours may exceed 23) to seconds
+function parseGtfsTime(value) {
+  var parts = value.split(':');
+  return parseInt(parts[0], 10) * 3600 + parseInt(parts[1], 10) * 60 + parseInt(parts[2], 10);
+}
+
+// NMBS stop IDs look like S8813003 (station) or 8813003_3 (platform);
+// iRail uses BE.NMBS.008813003
+function toIRailId(stopId) {
+  var code = stopId.replace(/^S/, '').replace(/_.*$/, '');
+  return /^\d{7}$/.test(code) ? 'BE.NMBS.00' + code : stopId;
+}
+
+function build(options) {
+  var dir = options.positional[0];
+  var start = ConnectionScan.parseServiceDate(options.start || formatDate(new Date()));
+  var dates = [];
+  for (var d = 0; d < options.days; d++) {
+    dates.push(new Date(start.getTime() + d * DAY_MS));
+  }
+
+  var stops = {};        // stop_id -> { station, platform }
+  var stations = [];     // [iRailId, name]
+  var stationIndex = {}; // iRailId -> index
+  var platforms = [''];
+  var platformIndex = { '': 0 };
+  var routes = {};
+  var calendar = {};     // service_id -> mask array
+  var trips = {};        // trip_id -> { service, type, number, headsign, stops: [] }
+
+  function intern(list, index, key, value) {
+    if (!index.hasOwnProperty(key)) {
+      index[key] = list.length;
+      list.push(value);
+    }
+    return index[key];
+  }
+
+  function serviceMask(serviceId) {
+    if (!calendar[serviceId]) {
+      calendar[serviceId] = dates.map(function() { return '0'; });
+    }
+    return calendar[serviceId];
+  }
+
+  var parents = {};
+  return readTable(dir, 'stops.txt', function(row) {
+    parents[row.stop_id] = row;
+  }).then(function() {
+    Object.keys(parents).forEach(function(stopId) {
+      var row = parents[stopId];
+      var station = (row.parent_station && parents[row.parent_station]) || row;
+      var id = toIRailId(station.stop_id);
+      stops[stopId] = {
+        station: intern(stations, stationIndex, id, [id, station.stop_name]),
+        platform: intern(platforms, platformIndex, row.platform_code || '', row.platform_code || '')
+      };
+    });
+    return readTable(dir, 'routes.txt', function(row) {
+      routes[row.route_id] = row.route_short_name || '';
+    });
+  }).then(function() {
+    var weekdays = ['sunday', 'monday', 'tuesday', 'wednesday', 'thursday', 'friday', 'saturday'];
+    return readTable(dir, 'calendar.txt', function(row) {
+      var mask = serviceMask(row.service_id);
+      dates.forEach(function(date, i) {
+        var day = formatDate(date);
+        if (day >= row.start_date && day <= row.end_date && row[weekdays[date.getDay()]] === '1') {
+          mask[i] = '1';
+        }
+      });
+    });
+  }).then(function() {
+    var dayIndex = {};
+    dates.forEach(function(date, i) { dayIndex[formatDate(date)] = i; });
+    return readTable(dir, 'calendar_dates.txt', function(row) {
+      if (dayIndex.hasOwnProperty(row.date)) {
+        serviceMask(row.service_id)[dayIndex[row.date]] = row.exception_type === '1' ? '1' : '0';
+      }
+    });
+  }).then(function() {
+    return readTable(dir, 'trips.txt', function(row) {
+      var mask = calendar[row.service_id];
+      if (!mask || mask.indexOf('1') === -1) {
+        return;  // Not running within the horizon
+      }
+      trips[row.trip_id] = {
+        service: row.service_id,
+        type: routes[row.route_id] || '',
+        number: row.trip_short_name || '',
+        headsign: row.trip_headsign || '',
+        stops: []
+      };
+    });
+  }).then(function() {
+    return readTable(dir, 'stop_times.txt', function(row) {
+      var trip = trips[row.trip_id];
+      var stop = stops[row.stop_id];
+      if (trip && stop) {
+        trip.stops.push([parseInt(row.stop_sequence, 10), parseGtfsTime(row.arrival_time),
+                         parseGtfsTime(row.departure_time), stop.station, stop.platform]);
+      }
+    });
+  }).then(function() {
+    var services = [];
+    var serviceIndex = {};
+    var tripList = [];
+    var connections = [];
+
+    Object.keys(trips).forEach(function(tripId) {
+      var trip = trips[tripId];
+      if (trip.stops.length < 2) {
+        return;
+      }
+      trip.stops.sort(function(a, b) { return a[0] - b[0]; });
+      var last = trip.stops[trip.stops.length - 1];
+      var tripIdx = tripList.length;
+      tripList.push([
+        intern(services, serviceIndex, trip.service, calendar[trip.service].join('')),
+        trip.type, trip.number, trip.headsign || stations[last[3]][1]
+      ]);
+      for (var i = 0; i + 1 < trip.stops.length; i++) {
+        var from = trip.stops[i];
+        var to = trip.stops[i + 1];
+        connections.push([from[3], to[3], from[2], to[1], tripIdx, from[4], to[4]]);
+      }
+    });
+
+    connections.sort(function(a, b) { return a[2] - b[2] || a[3] - b[3]; });
+    var flat = [];
+    connections.forEach(function(c) {
+      for (var k = 0; k < c.length; k++) {
+        flat.push(c[k]);
+      }
+    });
+
+    var timetable = {
+      v: 1,
+      start: formatDate(start),
+      days: options.days,
+      stations: stations,
+      services: services,
+      trips: tripList,
+      platforms: platforms,
+      connections: flat
+    };
+    if (options.stations) {
+      timetable = ConnectionScan.filterTimetable(timetable, options.stations);
+    }
+    return timetable;
+  });
+}
+
+var options = parseArgs(process.argv.slice(2));
+build(options).then(function(timetable) {
+  var json = JSON.stringify(timetable);
+  fs.writeFileSync(options.positional[1], json);
+  console.log('Wrote ' + options.positional[1] + ': ' + timetable.stations.length + ' stations, ' +
+              timetable.trips.length + ' trips, ' +
+              (timetable.connections.length / ConnectionScan.STRIDE) + ' connections, ' +
+              Math.round(json.length / 1024) + ' KB');
+}).catch(function(e) {
+  console.error('Error: ' + e.message);
+  process.exit(1);
+});
@@ -1,16 +1,25 @@
 #!/bin/bash
-# Generate icon variants for the NMBS Pebble app
+# Generate icon variants and the icon sprite sheet for the NMBS Pebble app
 # Requires ImageMagick (magick command)
 #
 # Usage: ./generate_icons.sh <input_icon.png>
+#        ./generate_icons.sh --sheet
 # Example: ./generate_icons.sh switch.png
+#
+# The app only ships icons_1bit.png: every *_1bit.png stacked top to bottom
+# in SHEET_ICONS order, which must match IconId in src/c/icons.h. Highlighted
+# (white) icons are drawn by swapping the sheet's palette at runtime.
 
 set -e  # Exit on error
 
+# Sheet order (16x16 each, top to bottom)
+SHEET_ICONS="switch airport start finish"
+
 # Check if input file is provided
 if [ $# -eq 0 ]; then
     echo "Error: No input file specified"
     echo "Usage: $0 <input_icon.png>"
+    echo "       $0 --sheet"
     echo "Example: $0 switch.png"
     exit 1
 fi
@@ -25,28 +34,48 @@ if ! command -v magick &> /dev/null; then
     exit 1
 fi
 
+cd "$RESOURCES_DIR"
+
+build_sheet() {
+    local files=""
+    for icon in $SHEET_ICONS; do
+        if [ ! -f "${icon}_1bit.png" ]; then
+            echo "Error: '${icon}_1bit.png' not found, run $0 ${icon}.png first"
+            exit 1
+        fi
+        files="$files ${icon}_1bit.png"
+    done
+
+    echo "  - Packing icons_1bit.png ($SHEET_ICONS)..."
+    magick $files -append -monochrome -depth 1 icons_1bit.png
+}
+
+if [ "$INPUT_FILE" = "--sheet" ]; then
+    echo "Generating icon sprite sheet..."
+    build_sheet
+    echo "✓ Sprite sheet generated successfully!"
+    exit 0
+fi
+
 # Check if input file exists
-if [ ! -f "$RESOURCES_DIR/$INPUT_FILE" ]; then
+if [ ! -f "$INPUT_FILE" ]; then
     echo "Error: Input file '$INPUT_FILE' not found in resources directory"
     exit 1
 fi
 
-cd "$RESOURCES_DIR"
-
 # Get filename without extension
 BASENAME="${INPUT_FILE%.*}"
 EXTENSION="${INPUT_FILE##*.}"
 
 echo "Generating icon variants for '$INPUT_FILE'..."
 
-echo "  - Generating ${BASENAME}_white.$EXTENSION (inverted colors with transparency)..."
-magick "$INPUT_FILE" -channel RGB -negate +channel "${BASENAME}_white.$EXTENSION"
-
 echo "  - Generating ${BASENAME}_1bit.$EXTENSION (monochrome with white background)..."
 magick "$INPUT_FILE" -background white -alpha remove -flatten -monochrome -depth 1 "${BASENAME}_1bit.$EXTENSION"
 
+build_sheet
+
 echo "✓ Icon variants generated successfully!"
 echo ""
 echo "Generated files:"
-echo "  - ${BASENAME}_white.$EXTENSION (white icon with transparency)"
 echo "  - ${BASENAME}_1bit.$EXTENSION (1-bit monochrome)"
+echo "  - icons_1bit.png (sprite sheet)"
@@ -0,0 +1,61 @@
+#!/usr/bin/env node
+// Generate the headers the Pebble SDK build would, for the host build
+//
+// Usage: node gen_headers.js path/to/package.json OUT_DIR
+//
+// Writes message_keys.auto.h (MESSAGE_KEY_* numbered from 10000 in
+// package.json order, like the SDK), resource_ids.auto.h, and
+// host_tables.auto.c with the key names (pebble_host.c speaks them on
+// stdin/stdout) and the resource files.
+
+'use strict';
+
+var fs = require('fs');
+var path = require('path');
+
+var FIRST_MESSAGE_KEY = 10000;
+
+if (process.argv.length !== 4) {
+  console.error('Usage: node gen_headers.js path/to/package.json OUT_DIR');
+  process.exit(1);
+}
+
+var pebble = JSON.parse(fs.readFileSync(process.argv[2], 'utf8')).pebble;
+var outDir = process.argv[3];
+
+var keys = [];
+pebble.messageKeys.forEach(function(entry) {
+  // "NAME[n]" reserves n consecutive keys
+  var match = /^(\w+)(?:\[(\d+)\])?$/.exec(entry);
+  var count = match[2] ? parseInt(match[2], 10) : 1;
+  for (var i = 0; i < count; i++) {
+    keys.push(i === 0 ? match[1] : null);
+  }
+});
+
+var header = ['#pragma once', ''];
+var tables = ['#include <stddef.h>', '', 'const char *const HOST_MESSAGE_KEY_NAMES[] = {'];
+keys.forEach(function(name, index) {
+  if (name) {
+    header.push('#define MESSAGE_KEY_' + name + ' ' + (FIRST_MESSAGE_KEY + index));
+  }
+  tables.push('  ' + (name ? '"' + name + '"' : 'NULL') + ',');
+});
+header.push('', '#define HOST_FIRST_MESSAGE_KEY ' + FIRST_MESSAGE_KEY,
+            '#define HOST_MESSAGE_KEY_COUNT ' + keys.length,
+            'extern const char *const HOST_MESSAGE_KEY_NAMES[];', '');
+tables.push('};', '', '// Resource files by ID (IDs start at 1)',
+            'const char *const HOST_RESOURCE_FILES[] = {', '  NULL,');
+
+var resources = ['#pragma once', ''];
+pebble.resources.media.forEach(function(resource, index) {
+  resources.push('#define RESOURCE_ID_' + resource.name + ' ' + (index + 1));
+  tables.push('  "' + resource.file + '",');
+});
+resources.push('', '#define HOST_RESOURCE_COUNT ' + pebble.resources.media.length,
+               'extern const char *const HOST_RESOURCE_FILES[];', '');
+tables.push('};', '');
+
+fs.writeFileSync(path.join(outDir, 'message_keys.auto.h'), header.join('\n'));
+fs.writeFileSync(path.join(outDir, 'host_tables.auto.c'), tables.join('\n'));
+fs.writeFileSync(path.join(outDir, 'resource_ids.auto.h'), resources.join('\n'));
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <pebble.h>
+
+// Glue between the Pebble API stand-in (pebble_host.c) and the app-specific
+// side of the host build (host_main.c).
+
+// Write one protocol line to stdout
+void host_emit(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// APP_LOG output on stderr (on by default)
+void host_set_log_verbose(bool verbose);
+
+// What launch_reason() returns
+void host_set_launch_reason(AppLaunchReason reason);
+
+// Implemented by host_main.c: the event loop started, a turn of it ended,
+// and a message from the phone is about to reach the app's inbox handler
+void host_app_started(void);
+void host_app_turn_end(void);
+void host_inbox_will_receive(DictionaryIterator *iter);
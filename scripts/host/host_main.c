@@ -0,0 +1,111 @@
+// Host build entry point: runs the watch app (nmbs.c's main, built as
+// app_main) and reports its data path state to simulate.js
+//
+// Usage: nmbs_host [--launch user|phone|wakeup|worker] [--quiet]
+//
+// Besides the lines pebble_host.c writes, after every event-loop turn in
+// which it changed:
+//   state load=N request=N departures=N filled=N full=N stations=N
+//         received=0|1 background=0|1 offline=0|1 failed=0|1 alerts=N
+//         detail=N detail_received=0|1
+// (load is the LoadState, filled counts rows with any data and full rows
+// with their destination), and before a data message for an older request
+// reaches the inbox handler:
+//   stale
+
+#include <pebble.h>
+
+#include "host.h"
+#include "types.h"
+#include "state.h"
+
+// Checkouts from before alerts and compact rows (--tree in simulate.js)
+#if __has_include("alerts.h")
+#include "alerts.h"
+#else
+static uint8_t alerts_get_count(void) { return 0; }
+#endif
+
+int app_main(void);
+
+void host_app_started(void) {
+}
+
+void host_app_turn_end(void) {
+  static char s_last[256];
+  char line[256];
+
+  uint8_t filled = 0;
+  uint8_t full = 0;
+  for (uint8_t i = 0; i < state_get_num_departures() && i < MAX_DEPARTURES; i++) {
+#ifdef MSG_DEPARTURE_DETAILS
+    uint8_t fill = state_get_departures()[i].fill;
+    if (fill != DEPARTURE_FILL_NONE) filled++;
+    if (fill == DEPARTURE_FILL_FULL) full++;
+#else
+    // Departures arrived whole
+    filled++;
+    full++;
+#endif
+  }
+
+  snprintf(line, sizeof(line),
+           "state load=%d request=%lu departures=%d filled=%d full=%d stations=%d received=%d "
+           "background=%d offline=%d failed=%d alerts=%d detail=%lu detail_received=%d",
+           state_get_load_state(), (unsigned long)state_get_last_data_request_id(),
+           state_get_num_departures(), filled, full, state_get_num_stations(),
+           state_are_stations_received(), state_is_background_update(),
+           state_is_data_offline(), state_is_data_failed(), alerts_get_count(),
+           (unsigned long)state_get_last_detail_request_id(), state_is_detail_received());
+  if (strcmp(line, s_last) != 0) {
+    strcpy(s_last, line);
+    host_emit("%s", line);
+  }
+}
+
+void host_inbox_will_receive(DictionaryIterator *iter) {
+  Tuple *type = dict_find(iter, MESSAGE_KEY_MESSAGE_TYPE);
+  Tuple *request_id = dict_find(iter, MESSAGE_KEY_REQUEST_ID);
+  if (!type || !request_id) return;
+  switch (type->value->uint8) {
+    case MSG_REQUEST_ACK:
+    case MSG_SEND_COUNT:
+    case MSG_SEND_DEPARTURE:
+#ifdef MSG_DEPARTURE_DETAILS
+    case MSG_DEPARTURE_DETAILS:
+#endif
+#ifdef MSG_THROTTLED
+    case MSG_THROTTLED:
+#endif
+      if (request_id->value->uint32 != state_get_last_data_request_id()) {
+        host_emit("stale");
+      }
+      break;
+  }
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--quiet") == 0) {
+      host_set_log_verbose(false);
+    } else if (strcmp(argv[i], "--launch") == 0 && i + 1 < argc) {
+      const char *reason = argv[++i];
+      host_set_launch_reason(strcmp(reason, "worker") == 0 ? APP_LAUNCH_WORKER :
+                             strcmp(reason, "phone") == 0 ? APP_LAUNCH_PHONE :
+                             strcmp(reason, "wakeup") == 0 ? APP_LAUNCH_WAKEUP :
+                             APP_LAUNCH_USER);
+    } else {
+      fprintf(stderr, "Usage: %s [--launch user|phone|wakeup|worker] [--quiet]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  // glibc sets up malloc and stdio on first use (about 1 KB it keeps);
+  // do that now, not inside the app's first heap_bytes_used() difference
+  FILE *warm_up = fopen("/dev/null", "rb");
+  if (warm_up) fclose(warm_up);
+
+  app_main();
+  host_emit("exit");
+  return 0;
+}
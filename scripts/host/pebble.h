@@ -0,0 +1,551 @@
+#pragma once
+
+// Host stand-in for the Pebble SDK's pebble.h: the subset of the API that
+// src/c uses, so the watch app builds and runs on Linux for simulate.js.
+//
+// Types and constants follow the SDK (diorite: rectangular, black & white,
+// with health). Drawing is a no-op; windows, layers, timers, persistent
+// storage and AppMessage behave like on the watch, with AppMessage carried
+// over stdin/stdout (see pebble_host.c).
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "message_keys.auto.h"
+#include "resource_ids.auto.h"
+
+#define PBL_PLATFORM_DIORITE 1
+#define PBL_BW 1
+#define PBL_RECT 1
+#define PBL_HEALTH 1
+
+#define PBL_IF_ROUND_ELSE(if_true, if_false) (if_false)
+#define PBL_IF_RECT_ELSE(if_true, if_false) (if_true)
+#define PBL_IF_COLOR_ELSE(if_true, if_false) (if_false)
+#define PBL_IF_BW_ELSE(if_true, if_false) (if_true)
+
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+
+// Logging
+
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200,
+  APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number,
+             const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+
+#define APP_LOG(level, fmt, args...) app_log(level, __FILE__, __LINE__, fmt, ## args)
+
+// Geometry and colors
+
+typedef struct { int16_t x, y; } GPoint;
+typedef struct { int16_t w, h; } GSize;
+typedef struct { GPoint origin; GSize size; } GRect;
+
+#define GPoint(x, y) ((GPoint){(x), (y)})
+#define GSize(w, h) ((GSize){(w), (h)})
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+#define GPointZero GPoint(0, 0)
+#define GSizeZero GSize(0, 0)
+#define GRectZero GRect(0, 0, 0, 0)
+
+typedef union GColor8 {
+  uint8_t argb;
+} GColor8;
+typedef GColor8 GColor;
+
+#define GColorClear ((GColor8){.argb = 0x00})
+#define GColorBlack ((GColor8){.argb = 0xC0})
+#define GColorDarkGray ((GColor8){.argb = 0xD5})
+#define GColorLightGray ((GColor8){.argb = 0xEA})
+#define GColorWhite ((GColor8){.argb = 0xFF})
+
+bool gcolor_equal(GColor8 x, GColor8 y);
+
+typedef enum {
+  GCompOpAssign,
+  GCompOpAssignInverted,
+  GCompOpOr,
+  GCompOpAnd,
+  GCompOpClear,
+  GCompOpSet,
+} GCompOp;
+
+typedef enum {
+  GCornerNone = 0,
+  GCornerTopLeft = 1 << 0,
+  GCornerTopRight = 1 << 1,
+  GCornerBottomLeft = 1 << 2,
+  GCornerBottomRight = 1 << 3,
+  GCornersAll = 0x0F,
+  GCornersTop = GCornerTopLeft | GCornerTopRight,
+  GCornersBottom = GCornerBottomLeft | GCornerBottomRight,
+} GCornerMask;
+
+typedef enum {
+  GTextAlignmentLeft,
+  GTextAlignmentCenter,
+  GTextAlignmentRight,
+} GTextAlignment;
+
+typedef enum {
+  GTextOverflowModeWordWrap,
+  GTextOverflowModeTrailingEllipsis,
+  GTextOverflowModeFill,
+} GTextOverflowMode;
+
+typedef struct GTextAttributes GTextAttributes;
+typedef struct FontInfo *GFont;
+
+#define FONT_KEY_GOTHIC_14 "RESOURCE_ID_GOTHIC_14"
+#define FONT_KEY_GOTHIC_14_BOLD "RESOURCE_ID_GOTHIC_14_BOLD"
+#define FONT_KEY_GOTHIC_18 "RESOURCE_ID_GOTHIC_18"
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_GOTHIC_24 "RESOURCE_ID_GOTHIC_24"
+#define FONT_KEY_GOTHIC_24_BOLD "RESOURCE_ID_GOTHIC_24_BOLD"
+#define FONT_KEY_GOTHIC_28_BOLD "RESOURCE_ID_GOTHIC_28_BOLD"
+
+GFont fonts_get_system_font(const char *font_key);
+
+// Bitmaps
+
+typedef enum {
+  GBitmapFormat1Bit,
+  GBitmapFormat8Bit,
+  GBitmapFormat1BitPalette,
+  GBitmapFormat2BitPalette,
+  GBitmapFormat4BitPalette,
+  GBitmapFormat8BitCircular,
+} GBitmapFormat;
+
+typedef struct GBitmap GBitmap;
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id);
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect);
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format);
+GBitmap *gbitmap_create_blank_with_palette(GSize size, GBitmapFormat format,
+                                           GColor *palette, bool free_on_destroy);
+void gbitmap_destroy(GBitmap *bitmap);
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap);
+uint8_t *gbitmap_get_data(const GBitmap *bitmap);
+GRect gbitmap_get_bounds(const GBitmap *bitmap);
+void gbitmap_set_bounds(GBitmap *bitmap, GRect bounds);
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap);
+GColor *gbitmap_get_palette(const GBitmap *bitmap);
+void gbitmap_set_palette(GBitmap *bitmap, GColor *palette, bool free_on_destroy);
+
+// Drawing (no-ops on the host)
+
+typedef struct GContext GContext;
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width);
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode);
+void graphics_context_set_antialiased(GContext *ctx, bool enable);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask);
+void graphics_draw_rect(GContext *ctx, GRect rect);
+void graphics_draw_round_rect(GContext *ctx, GRect rect, uint16_t radius);
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1);
+void graphics_draw_pixel(GContext *ctx, GPoint point);
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect);
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes *text_attributes);
+GSize graphics_text_layout_get_content_size(const char *text, GFont const font, const GRect box,
+                                            const GTextOverflowMode overflow_mode,
+                                            const GTextAlignment alignment);
+
+// Layers
+
+typedef struct Layer Layer;
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+void layer_mark_dirty(Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+GRect layer_get_frame(const Layer *layer);
+void layer_set_frame(Layer *layer, GRect frame);
+GRect layer_get_bounds(const Layer *layer);
+void layer_set_bounds(Layer *layer, GRect bounds);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_set_hidden(Layer *layer, bool hidden);
+
+typedef struct TextLayer TextLayer;
+
+TextLayer *text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer *text_layer);
+Layer *text_layer_get_layer(TextLayer *text_layer);
+void text_layer_set_text(TextLayer *text_layer, const char *text);
+void text_layer_set_font(TextLayer *text_layer, GFont font);
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment);
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode);
+void text_layer_set_background_color(TextLayer *text_layer, GColor color);
+void text_layer_set_text_color(TextLayer *text_layer, GColor color);
+GSize text_layer_get_content_size(TextLayer *text_layer);
+
+#define STATUS_BAR_LAYER_HEIGHT 16
+
+typedef struct StatusBarLayer StatusBarLayer;
+
+StatusBarLayer *status_bar_layer_create(void);
+void status_bar_layer_destroy(StatusBarLayer *status_bar_layer);
+Layer *status_bar_layer_get_layer(StatusBarLayer *status_bar_layer);
+void status_bar_layer_set_colors(StatusBarLayer *status_bar_layer, GColor background,
+                                 GColor foreground);
+
+// Windows and clicks
+
+typedef struct Window Window;
+
+typedef enum {
+  BUTTON_ID_BACK,
+  BUTTON_ID_UP,
+  BUTTON_ID_SELECT,
+  BUTTON_ID_DOWN,
+  NUM_BUTTONS,
+} ButtonId;
+
+typedef struct ClickRecognizer *ClickRecognizerRef;
+typedef void (*ClickHandler)(ClickRecognizerRef recognizer, void *context);
+typedef void (*ClickConfigProvider)(void *context);
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler);
+void window_single_repeating_click_subscribe(ButtonId button_id, uint16_t repeat_interval_ms,
+                                             ClickHandler handler);
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms,
+                                 ClickHandler down_handler, ClickHandler up_handler);
+
+typedef void (*WindowHandler)(Window *window);
+
+typedef struct {
+  WindowHandler load;
+  WindowHandler appear;
+  WindowHandler disappear;
+  WindowHandler unload;
+} WindowHandlers;
+
+Window *window_create(void);
+void window_destroy(Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider);
+void window_set_click_config_provider_with_context(Window *window,
+                                                   ClickConfigProvider click_config_provider,
+                                                   void *context);
+void window_set_background_color(Window *window, GColor background_color);
+Layer *window_get_root_layer(const Window *window);
+
+void window_stack_push(Window *window, bool animated);
+Window *window_stack_pop(bool animated);
+bool window_stack_contains_window(Window *window);
+Window *window_stack_get_top_window(void);
+
+// Scroll and menu layers
+
+typedef struct ScrollLayer ScrollLayer;
+typedef void (*ScrollLayerCallback)(ScrollLayer *scroll_layer, void *context);
+
+typedef struct {
+  ClickConfigProvider click_config_provider;
+  ScrollLayerCallback content_offset_changed_handler;
+} ScrollLayerCallbacks;
+
+ScrollLayer *scroll_layer_create(GRect frame);
+void scroll_layer_destroy(ScrollLayer *scroll_layer);
+Layer *scroll_layer_get_layer(const ScrollLayer *scroll_layer);
+void scroll_layer_add_child(ScrollLayer *scroll_layer, Layer *child);
+void scroll_layer_set_click_config_onto_window(ScrollLayer *scroll_layer, Window *window);
+void scroll_layer_set_callbacks(ScrollLayer *scroll_layer, ScrollLayerCallbacks callbacks);
+void scroll_layer_set_context(ScrollLayer *scroll_layer, void *context);
+void scroll_layer_set_content_size(ScrollLayer *scroll_layer, GSize size);
+GSize scroll_layer_get_content_size(const ScrollLayer *scroll_layer);
+void scroll_layer_set_content_offset(ScrollLayer *scroll_layer, GPoint offset, bool animated);
+GPoint scroll_layer_get_content_offset(ScrollLayer *scroll_layer);
+
+#define MENU_CELL_BASIC_HEADER_HEIGHT 16
+#define MENU_CELL_ROUND_FOCUSED_SHORT_CELL_HEIGHT 68
+#define MENU_CELL_ROUND_UNFOCUSED_TALL_CELL_HEIGHT 24
+
+typedef struct MenuLayer MenuLayer;
+
+typedef struct MenuIndex {
+  uint16_t section;
+  uint16_t row;
+} MenuIndex;
+
+#define MenuIndex(section, row) ((MenuIndex){(section), (row)})
+
+typedef enum {
+  MenuRowAlignNone,
+  MenuRowAlignCenter,
+  MenuRowAlignTop,
+  MenuRowAlignBottom,
+} MenuRowAlign;
+
+typedef uint16_t (*MenuLayerGetNumberOfSectionsCallback)(MenuLayer *menu_layer, void *callback_context);
+typedef uint16_t (*MenuLayerGetNumberOfRowsInSectionsCallback)(MenuLayer *menu_layer,
+                                                               uint16_t section_index,
+                                                               void *callback_context);
+typedef int16_t (*MenuLayerGetCellHeightCallback)(MenuLayer *menu_layer, MenuIndex *cell_index,
+                                                  void *callback_context);
+typedef int16_t (*MenuLayerGetHeaderHeightCallback)(MenuLayer *menu_layer, uint16_t section_index,
+                                                    void *callback_context);
+typedef void (*MenuLayerDrawRowCallback)(GContext *ctx, const Layer *cell_layer,
+                                         MenuIndex *cell_index, void *callback_context);
+typedef void (*MenuLayerDrawHeaderCallback)(GContext *ctx, const Layer *cell_layer,
+                                            uint16_t section_index, void *callback_context);
+typedef void (*MenuLayerSelectCallback)(MenuLayer *menu_layer, MenuIndex *cell_index,
+                                        void *callback_context);
+typedef void (*MenuLayerSelectionChangedCallback)(MenuLayer *menu_layer, MenuIndex new_index,
+                                                  MenuIndex old_index, void *callback_context);
+
+typedef struct {
+  MenuLayerGetNumberOfSectionsCallback get_num_sections;
+  MenuLayerGetNumberOfRowsInSectionsCallback get_num_rows;
+  MenuLayerGetCellHeightCallback get_cell_height;
+  MenuLayerGetHeaderHeightCallback get_header_height;
+  MenuLayerDrawRowCallback draw_row;
+  MenuLayerDrawHeaderCallback draw_header;
+  MenuLayerSelectCallback select_click;
+  MenuLayerSelectCallback select_long_click;
+  MenuLayerSelectionChangedCallback selection_changed;
+} MenuLayerCallbacks;
+
+MenuLayer *menu_layer_create(GRect frame);
+void menu_layer_destroy(MenuLayer *menu_layer);
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer);
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context,
+                              MenuLayerCallbacks callbacks);
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, Window *window);
+void menu_layer_reload_data(MenuLayer *menu_layer);
+void menu_layer_set_selected_index(MenuLayer *menu_layer, MenuIndex index,
+                                   MenuRowAlign scroll_align, bool animated);
+void menu_layer_set_selected_next(MenuLayer *menu_layer, bool up, MenuRowAlign scroll_align,
+                                  bool animated);
+MenuIndex menu_layer_get_selected_index(const MenuLayer *menu_layer);
+bool menu_layer_is_index_selected(const MenuLayer *menu_layer, MenuIndex *index);
+void menu_layer_set_normal_colors(MenuLayer *menu_layer, GColor background, GColor foreground);
+void menu_layer_set_highlight_colors(MenuLayer *menu_layer, GColor background, GColor foreground);
+bool menu_cell_layer_is_highlighted(const Layer *cell_layer);
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title,
+                          const char *subtitle, GBitmap *icon);
+
+// Timers and time
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer_handle);
+
+typedef enum {
+  SECOND_UNIT = 1 << 0,
+  MINUTE_UNIT = 1 << 1,
+  HOUR_UNIT = 1 << 2,
+  DAY_UNIT = 1 << 3,
+  MONTH_UNIT = 1 << 4,
+  YEAR_UNIT = 1 << 5,
+} TimeUnits;
+
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms);
+
+// System
+
+typedef enum {
+  APP_LAUNCH_SYSTEM,
+  APP_LAUNCH_USER,
+  APP_LAUNCH_PHONE,
+  APP_LAUNCH_WAKEUP,
+  APP_LAUNCH_WORKER,
+  APP_LAUNCH_QUICK_LAUNCH,
+  APP_LAUNCH_TIMELINE_ACTION,
+  APP_LAUNCH_SMARTSTRAP,
+} AppLaunchReason;
+
+AppLaunchReason launch_reason(void);
+
+size_t heap_bytes_free(void);
+size_t heap_bytes_used(void);
+
+void app_event_loop(void);
+
+typedef void (*ConnectionHandler)(bool connected);
+
+typedef struct {
+  ConnectionHandler pebble_app_connection_handler;
+  ConnectionHandler pebblekit_connection_handler;
+} ConnectionHandlers;
+
+void connection_service_subscribe(ConnectionHandlers conn_handlers);
+void connection_service_unsubscribe(void);
+bool connection_service_peek_pebble_app_connection(void);
+
+// Persistent storage
+
+#define PERSIST_DATA_MAX_LENGTH 256
+#define PERSIST_STRING_MAX_LENGTH PERSIST_DATA_MAX_LENGTH
+
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+bool persist_read_bool(const uint32_t key);
+int32_t persist_read_int(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+int persist_read_string(const uint32_t key, char *buffer, const size_t buffer_size);
+int persist_write_bool(const uint32_t key, const bool value);
+int persist_write_int(const uint32_t key, const int32_t value);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+int persist_write_string(const uint32_t key, const char *cstring);
+int persist_delete(const uint32_t key);
+
+// Dictionaries and AppMessage
+
+typedef enum {
+  TUPLE_BYTE_ARRAY = 0,
+  TUPLE_CSTRING = 1,
+  TUPLE_UINT = 2,
+  TUPLE_INT = 3,
+} TupleType;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t key;
+  TupleType type:8;
+  uint16_t length;
+  union {
+    uint8_t data[0];
+    char cstring[0];
+    uint8_t uint8;
+    uint16_t uint16;
+    uint32_t uint32;
+    int8_t int8;
+    int16_t int16;
+    int32_t int32;
+  } value[];
+} Tuple;
+
+typedef struct __attribute__((__packed__)) {
+  uint8_t count;
+  Tuple head[];
+} Dictionary;
+
+typedef struct {
+  Dictionary *dictionary;
+  const void *end;
+  Tuple *cursor;
+} DictionaryIterator;
+
+typedef enum {
+  DICT_OK = 0,
+  DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+  DICT_INVALID_ARGS = 1 << 2,
+  DICT_INTERNAL_INCONSISTENCY = 1 << 3,
+  DICT_MALLOC_FAILED = 1 << 4,
+} DictionaryResult;
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+uint32_t dict_size(DictionaryIterator *iter);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key,
+                                 const uint8_t *data, const uint16_t size);
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key,
+                                    const char *cstring);
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key,
+                                const void *integer, const uint8_t width_bytes,
+                                const bool is_signed);
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value);
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value);
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value);
+DictionaryResult dict_write_int8(DictionaryIterator *iter, const uint32_t key, const int8_t value);
+DictionaryResult dict_write_int16(DictionaryIterator *iter, const uint32_t key, const int16_t value);
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value);
+
+typedef enum {
+  APP_MSG_OK = 0,
+  APP_MSG_SEND_TIMEOUT = 1 << 1,
+  APP_MSG_SEND_REJECTED = 1 << 2,
+  APP_MSG_NOT_CONNECTED = 1 << 3,
+  APP_MSG_APP_NOT_RUNNING = 1 << 4,
+  APP_MSG_INVALID_ARGS = 1 << 5,
+  APP_MSG_BUSY = 1 << 6,
+  APP_MSG_BUFFER_OVERFLOW = 1 << 7,
+  APP_MSG_ALREADY_RELEASED = 1 << 9,
+  APP_MSG_CALLBACK_ALREADY_REGISTERED = 1 << 10,
+  APP_MSG_CALLBACK_NOT_REGISTERED = 1 << 11,
+  APP_MSG_OUT_OF_MEMORY = 1 << 12,
+  APP_MSG_CLOSED = 1 << 13,
+  APP_MSG_INTERNAL_ERROR = 1 << 14,
+} AppMessageResult;
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageInboxDropped)(AppMessageResult reason, void *context);
+typedef void (*AppMessageOutboxSent)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator *iterator, AppMessageResult reason,
+                                       void *context);
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback);
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback);
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback);
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback);
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+uint32_t app_message_inbox_size_maximum(void);
+uint32_t app_message_outbox_size_maximum(void);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+
+// Background worker messages
+
+typedef struct {
+  uint16_t data0;
+  uint16_t data1;
+  uint16_t data2;
+} AppWorkerMessage;
+
+typedef void (*AppWorkerMessageHandler)(uint16_t type, AppWorkerMessage *data);
+
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler);
+bool app_worker_message_unsubscribe(void);
+void app_worker_send_message(uint8_t type, AppWorkerMessage *data);
+
+// App glances
+
+typedef struct AppGlanceReloadSession AppGlanceReloadSession;
+
+typedef enum {
+  APP_GLANCE_RESULT_SUCCESS = 0,
+  APP_GLANCE_RESULT_INVALID_SESSION = 1 << 0,
+} AppGlanceResult;
+
+#define APP_GLANCE_SLICE_DEFAULT_ICON 0
+#define APP_GLANCE_SLICE_NO_EXPIRATION ((time_t)0)
+
+typedef struct {
+  struct {
+    uint32_t icon;
+    const char *subtitle_template_string;
+  } layout;
+  time_t expiration_time;
+} AppGlanceSlice;
+
+typedef void (*AppGlanceReloadCallback)(AppGlanceReloadSession *session, size_t limit,
+                                        void *context);
+
+AppGlanceResult app_glance_add_slice(AppGlanceReloadSession *session, AppGlanceSlice slice);
+void app_glance_reload(AppGlanceReloadCallback callback, void *context);
@@ -0,0 +1,1592 @@
+// Host implementation of the Pebble API in pebble.h
+//
+// One process is one watch app run. app_event_loop() waits on stdin and on
+// the next due timer; every line read and every timer fired is one turn of
+// the event loop, after which dirty layers of the top window are "drawn"
+// (their draw callbacks run against a no-op graphics context).
+//
+// Lines read from stdin (tuples are NAME=TYPE:VALUE, see below):
+//   in TUPLE...           AppMessage from the phone (inbox)
+//   sent                  the outbox message was acknowledged
+//   failed REASON         the outbox message failed (AppMessageResult)
+//   click BUTTON [long]   back, up, select or down on the top window
+//   worker TYPE           message from the background worker
+//   connected 0|1         phone connection changed
+//   quit                  leave the event loop (the app deinitializes)
+//
+// Lines written to stdout:
+//   out TUPLE...          app_message_outbox_send
+//   menu reload|redraw    menu_layer_reload_data / layer_mark_dirty on a menu
+//   glance N              app_glance_reload added N slices
+//   exit                  the app returned from main
+// plus what host_app_turn_end() (host_main.c) adds.
+//
+// Tuple types: u1/u2/u4 and i1/i2/i4 (integer of that width, decimal),
+// s (C string, hex without the NUL) and d (byte array, hex). Keys are the
+// names from package.json.
+
+#include <pebble.h>
+
+#include <errno.h>
+#include <malloc.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "host.h"
+
+// Logging
+
+static int s_log_verbose = 1;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number,
+             const char *fmt, ...) {
+  if (!s_log_verbose) return;
+  const char *level = log_level <= APP_LOG_LEVEL_ERROR ? "E" :
+                      log_level <= APP_LOG_LEVEL_WARNING ? "W" :
+                      log_level <= APP_LOG_LEVEL_INFO ? "I" : "D";
+  const char *file = strrchr(src_filename, '/');
+  fprintf(stderr, "[%s] %s:%d ", level, file ? file + 1 : src_filename, src_line_number);
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+void host_set_log_verbose(bool verbose) {
+  s_log_verbose = verbose;
+}
+
+void host_emit(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stdout, fmt, args);
+  va_end(args);
+  fputc('\n', stdout);
+  fflush(stdout);
+}
+
+// Time
+
+static uint64_t monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint16_t ms = ts.tv_nsec / 1000000;
+  if (t_utc) *t_utc = ts.tv_sec;
+  if (out_ms) *out_ms = ms;
+  return ms;
+}
+
+// Timers: handles are IDs, so cancelling a timer that already fired is
+// harmless like on the watch
+
+typedef struct HostTimer {
+  uintptr_t id;
+  uint64_t due;
+  AppTimerCallback callback;
+  void *data;
+  struct HostTimer *next;
+} HostTimer;
+
+static HostTimer *s_timers = NULL;
+static uintptr_t s_next_timer_id = 1;
+
+static HostTimer *find_timer(AppTimer *handle, HostTimer ***link) {
+  HostTimer **cursor = &s_timers;
+  while (*cursor && (*cursor)->id != (uintptr_t)handle) {
+    cursor = &(*cursor)->next;
+  }
+  if (link) *link = cursor;
+  return *cursor;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  HostTimer *timer = calloc(1, sizeof(HostTimer));
+  timer->id = s_next_timer_id++;
+  timer->due = monotonic_ms() + timeout_ms;
+  timer->callback = callback;
+  timer->data = callback_data;
+  timer->next = s_timers;
+  s_timers = timer;
+  return (AppTimer *)timer->id;
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+  HostTimer *timer = find_timer(timer_handle, NULL);
+  if (!timer) return false;
+  timer->due = monotonic_ms() + new_timeout_ms;
+  return true;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+  HostTimer **link;
+  HostTimer *timer = find_timer(timer_handle, &link);
+  if (timer) {
+    *link = timer->next;
+    free(timer);
+  }
+}
+
+// Earliest due timer (oldest first on a tie), or NULL
+static HostTimer *next_timer(void) {
+  HostTimer *next = NULL;
+  for (HostTimer *timer = s_timers; timer; timer = timer->next) {
+    if (!next || timer->due < next->due || (timer->due == next->due && timer->id < next->id)) {
+      next = timer;
+    }
+  }
+  return next;
+}
+
+static TickHandler s_tick_handler = NULL;
+static TimeUnits s_tick_units = 0;
+static time_t s_last_tick = 0;
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {
+  s_tick_handler = handler;
+  s_tick_units = tick_units;
+  s_last_tick = time(NULL);
+}
+
+void tick_timer_service_unsubscribe(void) {
+  s_tick_handler = NULL;
+}
+
+// Wall clock second at which the next tick is due (0: none)
+static time_t next_tick(void) {
+  if (!s_tick_handler) return 0;
+  if (s_tick_units & SECOND_UNIT) return s_last_tick + 1;
+  return s_last_tick - s_last_tick % 60 + 60;
+}
+
+static void fire_tick(time_t now) {
+  struct tm before = *localtime(&s_last_tick);
+  struct tm tick_time = *localtime(&now);
+  TimeUnits changed = SECOND_UNIT;
+  if (tick_time.tm_min != before.tm_min) changed |= MINUTE_UNIT;
+  if (tick_time.tm_hour != before.tm_hour) changed |= HOUR_UNIT;
+  if (tick_time.tm_mday != before.tm_mday) changed |= DAY_UNIT;
+  if (tick_time.tm_mon != before.tm_mon) changed |= MONTH_UNIT;
+  if (tick_time.tm_year != before.tm_year) changed |= YEAR_UNIT;
+  s_last_tick = now;
+  if (changed & s_tick_units) {
+    s_tick_handler(&tick_time, changed);
+  }
+}
+
+// System
+
+static AppLaunchReason s_launch_reason = APP_LAUNCH_USER;
+
+void host_set_launch_reason(AppLaunchReason reason) {
+  s_launch_reason = reason;
+}
+
+AppLaunchReason launch_reason(void) {
+  return s_launch_reason;
+}
+
+// The process heap, so differences between two calls are meaningful; the
+// free figure assumes a diorite-sized app heap
+#define HOST_APP_HEAP_SIZE 65536
+
+size_t heap_bytes_used(void) {
+  return mallinfo2().uordblks;
+}
+
+size_t heap_bytes_free(void) {
+  size_t used = heap_bytes_used();
+  return used < HOST_APP_HEAP_SIZE ? HOST_APP_HEAP_SIZE - used : 0;
+}
+
+static bool s_connected = true;
+static ConnectionHandlers s_connection_handlers;
+
+void connection_service_subscribe(ConnectionHandlers conn_handlers) {
+  s_connection_handlers = conn_handlers;
+}
+
+void connection_service_unsubscribe(void) {
+  memset(&s_connection_handlers, 0, sizeof(s_connection_handlers));
+}
+
+bool connection_service_peek_pebble_app_connection(void) {
+  return s_connected;
+}
+
+// Persistent storage (in memory: every run starts from a fresh install)
+
+typedef struct PersistEntry {
+  uint32_t key;
+  int size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+  struct PersistEntry *next;
+} PersistEntry;
+
+static PersistEntry *s_persist = NULL;
+
+static PersistEntry *find_entry(uint32_t key) {
+  for (PersistEntry *entry = s_persist; entry; entry = entry->next) {
+    if (entry->key == key) return entry;
+  }
+  return NULL;
+}
+
+static int write_entry(uint32_t key, const void *data, size_t size) {
+  if (size > PERSIST_DATA_MAX_LENGTH) size = PERSIST_DATA_MAX_LENGTH;
+  PersistEntry *entry = find_entry(key);
+  if (!entry) {
+    entry = calloc(1, sizeof(PersistEntry));
+    entry->key = key;
+    entry->next = s_persist;
+    s_persist = entry;
+  }
+  memcpy(entry->data, data, size);
+  entry->size = size;
+  return size;
+}
+
+bool persist_exists(const uint32_t key) {
+  return find_entry(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key) {
+  PersistEntry *entry = find_entry(key);
+  return entry ? entry->size : -1;
+}
+
+bool persist_read_bool(const uint32_t key) {
+  PersistEntry *entry = find_entry(key);
+  return entry && entry->data[0];
+}
+
+int32_t persist_read_int(const uint32_t key) {
+  int32_t value = 0;
+  PersistEntry *entry = find_entry(key);
+  if (entry) memcpy(&value, entry->data, entry->size < 4 ? entry->size : 4);
+  return value;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  PersistEntry *entry = find_entry(key);
+  if (!entry) return -1;
+  size_t size = (size_t)entry->size < buffer_size ? (size_t)entry->size : buffer_size;
+  memcpy(buffer, entry->data, size);
+  return size;
+}
+
+int persist_read_string(const uint32_t key, char *buffer, const size_t buffer_size) {
+  if (buffer_size == 0) return -1;
+  int size = persist_read_data(key, buffer, buffer_size);
+  if (size < 0) return size;
+  buffer[(size_t)size < buffer_size ? (size_t)size : buffer_size - 1] = '\0';
+  return size;
+}
+
+int persist_write_bool(const uint32_t key, const bool value) {
+  uint8_t byte = value;
+  return write_entry(key, &byte, 1);
+}
+
+int persist_write_int(const uint32_t key, const int32_t value) {
+  return write_entry(key, &value, sizeof(value));
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  return write_entry(key, data, size);
+}
+
+int persist_write_string(const uint32_t key, const char *cstring) {
+  return write_entry(key, cstring, strlen(cstring) + 1);
+}
+
+int persist_delete(const uint32_t key) {
+  for (PersistEntry **link = &s_persist; *link; link = &(*link)->next) {
+    if ((*link)->key == key) {
+      PersistEntry *entry = *link;
+      *link = entry->next;
+      free(entry);
+      return 0;
+    }
+  }
+  return 0;
+}
+
+// Dictionaries
+
+static Tuple *next_tuple(Tuple *tuple) {
+  return (Tuple *)((uint8_t *)tuple + sizeof(Tuple) + tuple->length);
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  Tuple *tuple = iter->dictionary->head;
+  for (uint8_t i = 0; i < iter->dictionary->count; i++) {
+    if (tuple->key == key) return tuple;
+    tuple = next_tuple(tuple);
+  }
+  return NULL;
+}
+
+uint32_t dict_size(DictionaryIterator *iter) {
+  Tuple *tuple = iter->dictionary->head;
+  for (uint8_t i = 0; i < iter->dictionary->count; i++) {
+    tuple = next_tuple(tuple);
+  }
+  return (uint8_t *)tuple - (uint8_t *)iter->dictionary;
+}
+
+static DictionaryResult write_tuple(DictionaryIterator *iter, uint32_t key, TupleType type,
+                                    const void *value, uint16_t length) {
+  if (!iter || !iter->cursor) return DICT_INVALID_ARGS;
+  if ((uint8_t *)iter->cursor + sizeof(Tuple) + length > (uint8_t *)iter->end) {
+    return DICT_NOT_ENOUGH_STORAGE;
+  }
+  Tuple *tuple = iter->cursor;
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = length;
+  memcpy(tuple->value, value, length);
+  iter->dictionary->count++;
+  iter->cursor = next_tuple(tuple);
+  return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key,
+                                 const uint8_t *data, const uint16_t size) {
+  return write_tuple(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key,
+                                    const char *cstring) {
+  return write_tuple(iter, key, TUPLE_CSTRING, cstring ? cstring : "",
+                     cstring ? strlen(cstring) + 1 : 1);
+}
+
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key,
+                                const void *integer, const uint8_t width_bytes,
+                                const bool is_signed) {
+  if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4) return DICT_INVALID_ARGS;
+  return write_tuple(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+  return dict_write_int(iter, key, &value, 1, false);
+}
+
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value) {
+  return dict_write_int(iter, key, &value, 2, false);
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value) {
+  return dict_write_int(iter, key, &value, 4, false);
+}
+
+DictionaryResult dict_write_int8(DictionaryIterator *iter, const uint32_t key, const int8_t value) {
+  return dict_write_int(iter, key, &value, 1, true);
+}
+
+DictionaryResult dict_write_int16(DictionaryIterator *iter, const uint32_t key, const int16_t value) {
+  return dict_write_int(iter, key, &value, 2, true);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value) {
+  return dict_write_int(iter, key, &value, 4, true);
+}
+
+// AppMessage
+
+static AppMessageInboxReceived s_inbox_received = NULL;
+static AppMessageInboxDropped s_inbox_dropped = NULL;
+static AppMessageOutboxSent s_outbox_sent = NULL;
+static AppMessageOutboxFailed s_outbox_failed = NULL;
+
+static uint8_t *s_inbox_buffer = NULL;
+static uint8_t *s_outbox_buffer = NULL;
+static uint32_t s_inbox_size = 0;
+static uint32_t s_outbox_size = 0;
+static DictionaryIterator s_outbox_iter;
+
+typedef enum {
+  OUTBOX_IDLE,     // Free for app_message_outbox_begin
+  OUTBOX_WRITING,  // Begun, not sent yet
+  OUTBOX_SENDING,  // Sent, waiting for "sent" or "failed"
+} OutboxState;
+
+static OutboxState s_outbox_state = OUTBOX_IDLE;
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+  AppMessageInboxReceived previous = s_inbox_received;
+  s_inbox_received = received_callback;
+  return previous;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+  AppMessageInboxDropped previous = s_inbox_dropped;
+  s_inbox_dropped = dropped_callback;
+  return previous;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+  AppMessageOutboxSent previous = s_outbox_sent;
+  s_outbox_sent = sent_callback;
+  return previous;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+  AppMessageOutboxFailed previous = s_outbox_failed;
+  s_outbox_failed = failed_callback;
+  return previous;
+}
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  if (s_inbox_buffer) return APP_MSG_INVALID_ARGS;
+  s_inbox_size = size_inbound;
+  s_outbox_size = size_outbound;
+  s_inbox_buffer = calloc(1, size_inbound);
+  s_outbox_buffer = calloc(1, size_outbound);
+  return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum(void) {
+  return 8200;
+}
+
+uint32_t app_message_outbox_size_maximum(void) {
+  return 8200;
+}
+
+static void iter_begin(DictionaryIterator *iter, uint8_t *buffer, uint32_t size) {
+  iter->dictionary = (Dictionary *)buffer;
+  iter->dictionary->count = 0;
+  iter->cursor = iter->dictionary->head;
+  iter->end = buffer + size;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  if (!s_outbox_buffer) return APP_MSG_INVALID_ARGS;
+  if (s_outbox_state != OUTBOX_IDLE) return APP_MSG_BUSY;
+  iter_begin(&s_outbox_iter, s_outbox_buffer, s_outbox_size);
+  s_outbox_state = OUTBOX_WRITING;
+  *iterator = &s_outbox_iter;
+  return APP_MSG_OK;
+}
+
+static const char *key_name(uint32_t key) {
+  uint32_t index = key - HOST_FIRST_MESSAGE_KEY;
+  if (key < HOST_FIRST_MESSAGE_KEY || index >= HOST_MESSAGE_KEY_COUNT ||
+      !HOST_MESSAGE_KEY_NAMES[index]) {
+    return NULL;
+  }
+  return HOST_MESSAGE_KEY_NAMES[index];
+}
+
+static bool key_for_name(const char *name, size_t length, uint32_t *key) {
+  for (uint32_t i = 0; i < HOST_MESSAGE_KEY_COUNT; i++) {
+    const char *candidate = HOST_MESSAGE_KEY_NAMES[i];
+    if (candidate && strlen(candidate) == length && strncmp(candidate, name, length) == 0) {
+      *key = HOST_FIRST_MESSAGE_KEY + i;
+      return true;
+    }
+  }
+  return false;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+  if (s_outbox_state != OUTBOX_WRITING) return APP_MSG_INVALID_ARGS;
+  s_outbox_state = OUTBOX_SENDING;
+
+  size_t capacity = 32 + s_outbox_size * 4;
+  char *line = malloc(capacity);
+  size_t pos = snprintf(line, capacity, "out");
+  Tuple *tuple = s_outbox_iter.dictionary->head;
+  for (uint8_t i = 0; i < s_outbox_iter.dictionary->count; i++, tuple = next_tuple(tuple)) {
+    const char *name = key_name(tuple->key);
+    if (name) {
+      pos += snprintf(line + pos, capacity - pos, " %s=", name);
+    } else {
+      pos += snprintf(line + pos, capacity - pos, " %lu=", (unsigned long)tuple->key);
+    }
+    if (tuple->type == TUPLE_UINT || tuple->type == TUPLE_INT) {
+      bool is_signed = tuple->type == TUPLE_INT;
+      long value = tuple->length == 1 ? (is_signed ? tuple->value->int8 : tuple->value->uint8) :
+                   tuple->length == 2 ? (is_signed ? tuple->value->int16 : tuple->value->uint16) :
+                   (is_signed ? (long)tuple->value->int32 : (long)tuple->value->uint32);
+      pos += snprintf(line + pos, capacity - pos, "%c%d:%ld", is_signed ? 'i' : 'u',
+                      tuple->length, value);
+    } else {
+      uint16_t length = tuple->length;
+      if (tuple->type == TUPLE_CSTRING) {
+        length = strnlen(tuple->value->cstring, length);
+      }
+      pos += snprintf(line + pos, capacity - pos, "%c:", tuple->type == TUPLE_CSTRING ? 's' : 'd');
+      for (uint16_t j = 0; j < length; j++) {
+        pos += snprintf(line + pos, capacity - pos, "%02x", tuple->value->data[j]);
+      }
+    }
+  }
+  host_emit("%s", line);
+  free(line);
+  return APP_MSG_OK;
+}
+
+static void outbox_result(bool sent, AppMessageResult reason) {
+  if (s_outbox_state != OUTBOX_SENDING) {
+    fprintf(stderr, "host: outbox result without a message in flight\n");
+    return;
+  }
+  // Callbacks read the sent dictionary and may begin the next one
+  s_outbox_state = OUTBOX_IDLE;
+  DictionaryIterator iter = s_outbox_iter;
+  iter.cursor = iter.dictionary->head;
+  if (sent && s_outbox_sent) {
+    s_outbox_sent(&iter, NULL);
+  } else if (!sent && s_outbox_failed) {
+    s_outbox_failed(&iter, reason, NULL);
+  }
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Decode hex into buffer (at most size bytes); returns the byte count
+static int decode_hex(const char *hex, size_t hex_length, uint8_t *buffer, size_t size) {
+  size_t count = hex_length / 2;
+  if (hex_length % 2 || count > size) return -1;
+  for (size_t i = 0; i < count; i++) {
+    int high = hex_value(hex[2 * i]);
+    int low = hex_value(hex[2 * i + 1]);
+    if (high < 0 || low < 0) return -1;
+    buffer[i] = high << 4 | low;
+  }
+  return count;
+}
+
+// Parse "NAME=TYPE:VALUE" into the inbox dictionary
+static DictionaryResult parse_tuple(DictionaryIterator *iter, const char *token, size_t length) {
+  const char *equals = memchr(token, '=', length);
+  const char *colon = equals ? memchr(equals, ':', token + length - equals) : NULL;
+  uint32_t key;
+  if (!colon || !key_for_name(token, equals - token, &key)) {
+    fprintf(stderr, "host: bad tuple %.*s\n", (int)length, token);
+    return DICT_INVALID_ARGS;
+  }
+  const char *type = equals + 1;
+  const char *value = colon + 1;
+  size_t value_length = token + length - value;
+
+  if (type[0] == 's' || type[0] == 'd') {
+    uint8_t *data = malloc(value_length / 2 + 1);
+    int count = decode_hex(value, value_length, data, value_length / 2);
+    DictionaryResult result = DICT_INVALID_ARGS;
+    if (count >= 0 && type[0] == 's') {
+      data[count] = '\0';
+      result = write_tuple(iter, key, TUPLE_CSTRING, data, count + 1);
+    } else if (count >= 0) {
+      result = write_tuple(iter, key, TUPLE_BYTE_ARRAY, data, count);
+    }
+    free(data);
+    return result;
+  }
+
+  int width = type[1] - '0';
+  long number = strtol(value, NULL, 10);
+  int32_t integer = (int32_t)number;
+  if ((type[0] != 'u' && type[0] != 'i') || (width != 1 && width != 2 && width != 4)) {
+    return DICT_INVALID_ARGS;
+  }
+  // Little-endian: the low bytes hold the narrower value
+  return write_tuple(iter, key, type[0] == 'i' ? TUPLE_INT : TUPLE_UINT, &integer, width);
+}
+
+static void inbox_message(const char *tuples) {
+  if (!s_inbox_buffer) {
+    fprintf(stderr, "host: message before app_message_open\n");
+    return;
+  }
+  DictionaryIterator iter;
+  iter_begin(&iter, s_inbox_buffer, s_inbox_size);
+  const char *cursor = tuples;
+  while (*cursor) {
+    while (*cursor == ' ') cursor++;
+    size_t length = strcspn(cursor, " ");
+    if (length == 0) break;
+    DictionaryResult result = parse_tuple(&iter, cursor, length);
+    if (result == DICT_NOT_ENOUGH_STORAGE) {
+      if (s_inbox_dropped) s_inbox_dropped(APP_MSG_BUFFER_OVERFLOW, NULL);
+      return;
+    }
+    cursor += length;
+  }
+  iter.cursor = iter.dictionary->head;
+  host_inbox_will_receive(&iter);
+  if (s_inbox_received) {
+    s_inbox_received(&iter, NULL);
+  }
+}
+
+// Background worker
+
+static AppWorkerMessageHandler s_worker_handler = NULL;
+
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler) {
+  s_worker_handler = handler;
+  return true;
+}
+
+bool app_worker_message_unsubscribe(void) {
+  s_worker_handler = NULL;
+  return true;
+}
+
+void app_worker_send_message(uint8_t type, AppWorkerMessage *data) {
+}
+
+// App glances: reported as the number of slices added
+
+struct AppGlanceReloadSession {
+  size_t slices;
+};
+
+AppGlanceResult app_glance_add_slice(AppGlanceReloadSession *session, AppGlanceSlice slice) {
+  session->slices++;
+  return APP_GLANCE_RESULT_SUCCESS;
+}
+
+void app_glance_reload(AppGlanceReloadCallback callback, void *context) {
+  AppGlanceReloadSession session = { 0 };
+  if (callback) {
+    callback(&session, 8, context);
+  }
+  host_emit("glance %zu", session.slices);
+}
+
+// Graphics: colors and fonts
+
+bool gcolor_equal(GColor8 x, GColor8 y) {
+  return x.argb == y.argb;
+}
+
+struct FontInfo {
+  int16_t line_height;
+};
+
+static struct FontInfo s_fonts[] = { { 14 }, { 18 }, { 24 }, { 28 } };
+
+GFont fonts_get_system_font(const char *font_key) {
+  if (strstr(font_key, "_28")) return &s_fonts[3];
+  if (strstr(font_key, "_24")) return &s_fonts[2];
+  if (strstr(font_key, "_18")) return &s_fonts[1];
+  return &s_fonts[0];
+}
+
+// Rough text layout: a fixed advance of half the line height, word wrapped
+GSize graphics_text_layout_get_content_size(const char *text, GFont const font, const GRect box,
+                                            const GTextOverflowMode overflow_mode,
+                                            const GTextAlignment alignment) {
+  int16_t line_height = font ? font->line_height : 14;
+  int16_t advance = line_height / 2;
+  int16_t per_line = box.size.w / advance > 0 ? box.size.w / advance : 1;
+  int16_t length = text ? strlen(text) : 0;
+  int16_t lines = length == 0 ? 0 : (overflow_mode == GTextOverflowModeWordWrap ?
+                                     (length + per_line - 1) / per_line : 1);
+  int16_t width = length < per_line ? length * advance : per_line * advance;
+  int16_t height = lines * line_height;
+  return GSize(width, height < box.size.h ? height : box.size.h);
+}
+
+struct GContext {
+  GColor fill_color;
+};
+
+static GContext s_context;
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {}
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {}
+void graphics_context_set_text_color(GContext *ctx, GColor color) {}
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width) {}
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {}
+void graphics_context_set_antialiased(GContext *ctx, bool enable) {}
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {}
+void graphics_draw_rect(GContext *ctx, GRect rect) {}
+void graphics_draw_round_rect(GContext *ctx, GRect rect, uint16_t radius) {}
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {}
+void graphics_draw_pixel(GContext *ctx, GPoint point) {}
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius) {}
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius) {}
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {}
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes *text_attributes) {}
+
+// Bitmaps: resources are allocated at the PNG's size and format like on the
+// watch, but not decoded (pixels stay clear)
+
+struct GBitmap {
+  GRect bounds;
+  GBitmapFormat format;
+  uint16_t row_size_bytes;
+  uint8_t *data;
+  GColor *palette;
+  bool owns_data;
+  bool owns_palette;
+};
+
+static uint16_t row_size(GBitmapFormat format, int16_t width) {
+  switch (format) {
+    case GBitmapFormat1Bit: return (width + 31) / 32 * 4;
+    case GBitmapFormat1BitPalette: return (width + 7) / 8;
+    case GBitmapFormat2BitPalette: return (width + 3) / 4;
+    case GBitmapFormat4BitPalette: return (width + 1) / 2;
+    default: return width;
+  }
+}
+
+static uint8_t palette_size(GBitmapFormat format) {
+  switch (format) {
+    case GBitmapFormat1BitPalette: return 2;
+    case GBitmapFormat2BitPalette: return 4;
+    case GBitmapFormat4BitPalette: return 16;
+    default: return 0;
+  }
+}
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format) {
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->format = format;
+  bitmap->row_size_bytes = row_size(format, size.w);
+  bitmap->data = calloc(1, bitmap->row_size_bytes * size.h);
+  bitmap->owns_data = true;
+  if (palette_size(format)) {
+    bitmap->palette = calloc(palette_size(format), sizeof(GColor));
+    bitmap->owns_palette = true;
+  }
+  return bitmap;
+}
+
+GBitmap *gbitmap_create_blank_with_palette(GSize size, GBitmapFormat format,
+                                           GColor *palette, bool free_on_destroy) {
+  GBitmap *bitmap = gbitmap_create_blank(size, format);
+  gbitmap_set_palette(bitmap, palette, free_on_destroy);
+  return bitmap;
+}
+
+// Width, height and palette format of a PNG resource from its IHDR chunk
+static bool read_png_header(const char *file, GSize *size, GBitmapFormat *format) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", HOST_RESOURCES_DIR, file);
+  FILE *png = fopen(path, "rb");
+  if (!png) return false;
+  uint8_t header[26];
+  bool ok = fread(header, 1, sizeof(header), png) == sizeof(header) &&
+            memcmp(header + 12, "IHDR", 4) == 0;
+  fclose(png);
+  if (!ok) return false;
+  size->w = header[18] << 8 | header[19];
+  size->h = header[22] << 8 | header[23];
+  uint8_t bit_depth = header[24];
+  *format = bit_depth == 1 ? GBitmapFormat1BitPalette :
+            bit_depth == 2 ? GBitmapFormat2BitPalette :
+            bit_depth == 4 ? GBitmapFormat4BitPalette : GBitmapFormat8Bit;
+  return true;
+}
+
+// Logs the host heap each one takes, so checkouts that load bitmaps
+// without measuring them can be compared (glibc malloc, chunk headers
+// included; not the watch heap)
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  GSize size;
+  GBitmapFormat format;
+  if (resource_id == 0 || resource_id > HOST_RESOURCE_COUNT ||
+      !read_png_header(HOST_RESOURCE_FILES[resource_id], &size, &format)) {
+    return NULL;
+  }
+  size_t heap_before = heap_bytes_used();
+  GBitmap *bitmap = gbitmap_create_blank(size, format);
+  if (bitmap->palette) {
+    bitmap->palette[0] = GColorBlack;
+    bitmap->palette[1] = GColorWhite;
+  }
+  if (s_log_verbose) {
+    fprintf(stderr, "host: bitmap %s %dx%d format %d: %zu B host heap\n",
+            HOST_RESOURCE_FILES[resource_id], size.w, size.h, format,
+            heap_bytes_used() - heap_before);
+  }
+  return bitmap;
+}
+
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect) {
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  *bitmap = *base_bitmap;
+  bitmap->bounds = sub_rect;
+  bitmap->owns_data = false;
+  bitmap->owns_palette = false;
+  return bitmap;
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if (!bitmap) return;
+  if (bitmap->owns_data) free(bitmap->data);
+  if (bitmap->owns_palette) free(bitmap->palette);
+  free(bitmap);
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap) {
+  return bitmap->row_size_bytes;
+}
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap) {
+  return bitmap->data;
+}
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+  return bitmap->bounds;
+}
+
+void gbitmap_set_bounds(GBitmap *bitmap, GRect bounds) {
+  bitmap->bounds = bounds;
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap) {
+  return bitmap->format;
+}
+
+GColor *gbitmap_get_palette(const GBitmap *bitmap) {
+  return bitmap->palette;
+}
+
+void gbitmap_set_palette(GBitmap *bitmap, GColor *palette, bool free_on_destroy) {
+  if (bitmap->owns_palette && bitmap->palette != palette) free(bitmap->palette);
+  bitmap->palette = palette;
+  bitmap->owns_palette = free_on_destroy;
+}
+
+// Layers
+
+typedef enum {
+  LAYER_PLAIN,
+  LAYER_TEXT,
+  LAYER_STATUS_BAR,
+  LAYER_SCROLL,
+  LAYER_MENU,
+  LAYER_MENU_CELL,
+} LayerKind;
+
+struct Layer {
+  LayerKind kind;
+  GRect frame;
+  GRect bounds;
+  bool hidden;
+  bool highlighted;  // Menu cells: drawn as the selected row
+  LayerUpdateProc update_proc;
+  Layer *parent;
+  Layer *first_child;
+  Layer *next_sibling;
+  void *owner;       // TextLayer, ScrollLayer or MenuLayer holding this layer
+};
+
+// Set when a layer needs drawing, cleared by the draw at the end of a turn
+static bool s_dirty = false;
+
+static void layer_init(Layer *layer, LayerKind kind, GRect frame, void *owner) {
+  memset(layer, 0, sizeof(Layer));
+  layer->kind = kind;
+  layer->frame = frame;
+  layer->bounds = GRect(0, 0, frame.size.w, frame.size.h);
+  layer->owner = owner;
+}
+
+static void layer_remove(Layer *layer) {
+  if (!layer->parent) return;
+  for (Layer **link = &layer->parent->first_child; *link; link = &(*link)->next_sibling) {
+    if (*link == layer) {
+      *link = layer->next_sibling;
+      break;
+    }
+  }
+  layer->parent = NULL;
+  layer->next_sibling = NULL;
+}
+
+// Detach a layer and its children before the layer's memory goes
+static void layer_deinit(Layer *layer) {
+  layer_remove(layer);
+  while (layer->first_child) {
+    layer_remove(layer->first_child);
+  }
+}
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = malloc(sizeof(Layer));
+  layer_init(layer, LAYER_PLAIN, frame, NULL);
+  return layer;
+}
+
+void layer_destroy(Layer *layer) {
+  if (!layer) return;
+  layer_deinit(layer);
+  free(layer);
+}
+
+void layer_mark_dirty(Layer *layer) {
+  if (layer && layer->kind == LAYER_MENU) {
+    host_emit("menu redraw");
+  }
+  s_dirty = true;
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+void layer_set_frame(Layer *layer, GRect frame) {
+  layer->frame = frame;
+  layer->bounds.size = frame.size;
+  s_dirty = true;
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+  return layer->bounds;
+}
+
+void layer_set_bounds(Layer *layer, GRect bounds) {
+  layer->bounds = bounds;
+  s_dirty = true;
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+  layer_remove(child);
+  child->parent = parent;
+  Layer **link = &parent->first_child;
+  while (*link) link = &(*link)->next_sibling;
+  *link = child;
+  s_dirty = true;
+}
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+  layer->hidden = hidden;
+  s_dirty = true;
+}
+
+struct TextLayer {
+  Layer layer;
+  const char *text;
+  GFont font;
+  GTextOverflowMode overflow_mode;
+};
+
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = calloc(1, sizeof(TextLayer));
+  layer_init(&text_layer->layer, LAYER_TEXT, frame, text_layer);
+  text_layer->font = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+  return text_layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer) {
+  if (!text_layer) return;
+  layer_deinit(&text_layer->layer);
+  free(text_layer);
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  text_layer->text = text;
+  s_dirty = true;
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+  text_layer->font = font;
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment) {}
+
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode) {
+  text_layer->overflow_mode = line_mode;
+}
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {}
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {}
+
+GSize text_layer_get_content_size(TextLayer *text_layer) {
+  GRect box = text_layer->layer.bounds;
+  box.size.h = INT16_MAX;
+  return graphics_text_layout_get_content_size(text_layer->text, text_layer->font, box,
+                                               text_layer->overflow_mode, GTextAlignmentLeft);
+}
+
+struct StatusBarLayer {
+  Layer layer;
+};
+
+StatusBarLayer *status_bar_layer_create(void) {
+  StatusBarLayer *status_bar = calloc(1, sizeof(StatusBarLayer));
+  layer_init(&status_bar->layer, LAYER_STATUS_BAR, GRect(0, 0, 144, STATUS_BAR_LAYER_HEIGHT),
+             status_bar);
+  return status_bar;
+}
+
+void status_bar_layer_destroy(StatusBarLayer *status_bar_layer) {
+  if (!status_bar_layer) return;
+  layer_deinit(&status_bar_layer->layer);
+  free(status_bar_layer);
+}
+
+Layer *status_bar_layer_get_layer(StatusBarLayer *status_bar_layer) {
+  return &status_bar_layer->layer;
+}
+
+void status_bar_layer_set_colors(StatusBarLayer *status_bar_layer, GColor background,
+                                 GColor foreground) {}
+
+// Windows
+
+#define WINDOW_STACK_MAX 8
+
+typedef struct {
+  ClickHandler single;
+  ClickHandler long_down;
+  ClickHandler long_up;
+} ClickSubscription;
+
+struct Window {
+  WindowHandlers handlers;
+  Layer root;
+  bool loaded;
+  ClickConfigProvider click_config_provider;
+  void *click_context;
+  MenuLayer *menu;       // Menu taking the clicks (menu_layer_set_click_config_onto_window)
+  ScrollLayer *scroll;   // Scroll layer taking the clicks
+  ClickSubscription clicks[NUM_BUTTONS];
+};
+
+static Window *s_window_stack[WINDOW_STACK_MAX];
+static uint8_t s_window_count = 0;
+
+// Window whose click config provider is running
+static Window *s_configuring = NULL;
+
+Window *window_create(void) {
+  Window *window = calloc(1, sizeof(Window));
+  layer_init(&window->root, LAYER_PLAIN, GRect(0, 0, 144, 168), NULL);
+  return window;
+}
+
+static int stack_index(Window *window) {
+  for (int i = 0; i < s_window_count; i++) {
+    if (s_window_stack[i] == window) return i;
+  }
+  return -1;
+}
+
+// Take a window off the stack: it disappears and unloads, and the one below
+// appears if it was on top
+static void remove_window(Window *window) {
+  int index = stack_index(window);
+  if (index < 0) return;
+  bool was_top = index == s_window_count - 1;
+  memmove(&s_window_stack[index], &s_window_stack[index + 1],
+          (s_window_count - index - 1) * sizeof(Window *));
+  s_window_count--;
+  if (was_top && window->handlers.disappear) window->handlers.disappear(window);
+  if (window->handlers.unload) window->handlers.unload(window);
+  window->loaded = false;
+  if (was_top && s_window_count > 0) {
+    Window *top = s_window_stack[s_window_count - 1];
+    if (top->handlers.appear) top->handlers.appear(top);
+  }
+  s_dirty = true;
+}
+
+void window_destroy(Window *window) {
+  if (!window) return;
+  remove_window(window);
+  layer_deinit(&window->root);
+  free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider) {
+  window_set_click_config_provider_with_context(window, click_config_provider, window);
+}
+
+void window_set_click_config_provider_with_context(Window *window,
+                                                   ClickConfigProvider click_config_provider,
+                                                   void *context) {
+  window->click_config_provider = click_config_provider;
+  window->click_context = context;
+}
+
+void window_set_background_color(Window *window, GColor background_color) {}
+
+Layer *window_get_root_layer(const Window *window) {
+  return (Layer *)&window->root;
+}
+
+void window_stack_push(Window *window, bool animated) {
+  if (stack_index(window) >= 0 || s_window_count == WINDOW_STACK_MAX) return;
+  Window *below = s_window_count > 0 ? s_window_stack[s_window_count - 1] : NULL;
+  if (below && below->handlers.disappear) below->handlers.disappear(below);
+  s_window_stack[s_window_count++] = window;
+  if (!window->loaded) {
+    window->loaded = true;
+    if (window->handlers.load) window->handlers.load(window);
+  }
+  if (window->handlers.appear) window->handlers.appear(window);
+  s_dirty = true;
+}
+
+Window *window_stack_pop(bool animated) {
+  if (s_window_count == 0) return NULL;
+  Window *top = s_window_stack[s_window_count - 1];
+  remove_window(top);
+  return top;
+}
+
+bool window_stack_contains_window(Window *window) {
+  return stack_index(window) >= 0;
+}
+
+Window *window_stack_get_top_window(void) {
+  return s_window_count > 0 ? s_window_stack[s_window_count - 1] : NULL;
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+  if (s_configuring) s_configuring->clicks[button_id].single = handler;
+}
+
+void window_single_repeating_click_subscribe(ButtonId button_id, uint16_t repeat_interval_ms,
+                                             ClickHandler handler) {
+  window_single_click_subscribe(button_id, handler);
+}
+
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms,
+                                 ClickHandler down_handler, ClickHandler up_handler) {
+  if (s_configuring) {
+    s_configuring->clicks[button_id].long_down = down_handler;
+    s_configuring->clicks[button_id].long_up = up_handler;
+  }
+}
+
+// Scroll layers
+
+struct ScrollLayer {
+  Layer layer;
+  Layer content;
+  ScrollLayerCallbacks callbacks;
+  void *context;
+};
+
+ScrollLayer *scroll_layer_create(GRect frame) {
+  ScrollLayer *scroll_layer = calloc(1, sizeof(ScrollLayer));
+  layer_init(&scroll_layer->layer, LAYER_SCROLL, frame, scroll_layer);
+  layer_init(&scroll_layer->content, LAYER_PLAIN, GRect(0, 0, frame.size.w, frame.size.h), NULL);
+  layer_add_child(&scroll_layer->layer, &scroll_layer->content);
+  scroll_layer->context = scroll_layer;
+  return scroll_layer;
+}
+
+void scroll_layer_destroy(ScrollLayer *scroll_layer) {
+  if (!scroll_layer) return;
+  layer_deinit(&scroll_layer->content);
+  layer_deinit(&scroll_layer->layer);
+  for (int i = 0; i < s_window_count; i++) {
+    if (s_window_stack[i]->scroll == scroll_layer) s_window_stack[i]->scroll = NULL;
+  }
+  free(scroll_layer);
+}
+
+Layer *scroll_layer_get_layer(const ScrollLayer *scroll_layer) {
+  return (Layer *)&scroll_layer->layer;
+}
+
+void scroll_layer_add_child(ScrollLayer *scroll_layer, Layer *child) {
+  layer_add_child(&scroll_layer->content, child);
+}
+
+void scroll_layer_set_click_config_onto_window(ScrollLayer *scroll_layer, Window *window) {
+  window->scroll = scroll_layer;
+}
+
+void scroll_layer_set_callbacks(ScrollLayer *scroll_layer, ScrollLayerCallbacks callbacks) {
+  scroll_layer->callbacks = callbacks;
+}
+
+void scroll_layer_set_context(ScrollLayer *scroll_layer, void *context) {
+  scroll_layer->context = context;
+}
+
+void scroll_layer_set_content_size(ScrollLayer *scroll_layer, GSize size) {
+  scroll_layer->content.frame.size = size;
+  scroll_layer->content.bounds.size = size;
+  s_dirty = true;
+}
+
+GSize scroll_layer_get_content_size(const ScrollLayer *scroll_layer) {
+  return scroll_layer->content.frame.size;
+}
+
+void scroll_layer_set_content_offset(ScrollLayer *scroll_layer, GPoint offset, bool animated) {
+  int16_t min_y = scroll_layer->layer.frame.size.h - scroll_layer->content.frame.size.h;
+  if (offset.y < min_y) offset.y = min_y;
+  if (offset.y > 0) offset.y = 0;
+  scroll_layer->content.frame.origin = GPoint(0, offset.y);
+  if (scroll_layer->callbacks.content_offset_changed_handler) {
+    scroll_layer->callbacks.content_offset_changed_handler(scroll_layer, scroll_layer->context);
+  }
+  s_dirty = true;
+}
+
+GPoint scroll_layer_get_content_offset(ScrollLayer *scroll_layer) {
+  return scroll_layer->content.frame.origin;
+}
+
+// Menu layers
+
+struct MenuLayer {
+  Layer layer;
+  MenuLayerCallbacks callbacks;
+  void *context;
+  MenuIndex selected;
+};
+
+MenuLayer *menu_layer_create(GRect frame) {
+  MenuLayer *menu_layer = calloc(1, sizeof(MenuLayer));
+  layer_init(&menu_layer->layer, LAYER_MENU, frame, menu_layer);
+  return menu_layer;
+}
+
+void menu_layer_destroy(MenuLayer *menu_layer) {
+  if (!menu_layer) return;
+  layer_deinit(&menu_layer->layer);
+  for (int i = 0; i < s_window_count; i++) {
+    if (s_window_stack[i]->menu == menu_layer) s_window_stack[i]->menu = NULL;
+  }
+  free(menu_layer);
+}
+
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer) {
+  return (Layer *)&menu_layer->layer;
+}
+
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context,
+                              MenuLayerCallbacks callbacks) {
+  menu_layer->callbacks = callbacks;
+  menu_layer->context = callback_context;
+}
+
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, Window *window) {
+  window->menu = menu_layer;
+}
+
+static uint16_t menu_sections(MenuLayer *menu_layer) {
+  return menu_layer->callbacks.get_num_sections ?
+         menu_layer->callbacks.get_num_sections(menu_layer, menu_layer->context) : 1;
+}
+
+static uint16_t menu_rows(MenuLayer *menu_layer, uint16_t section) {
+  return menu_layer->callbacks.get_num_rows ?
+         menu_layer->callbacks.get_num_rows(menu_layer, section, menu_layer->context) : 0;
+}
+
+// Move the selection to index (clamped to the rows there are), telling the app
+static void menu_select(MenuLayer *menu_layer, MenuIndex index) {
+  uint16_t sections = menu_sections(menu_layer);
+  if (index.section >= sections) index.section = sections ? sections - 1 : 0;
+  uint16_t rows = menu_rows(menu_layer, index.section);
+  if (index.row >= rows) index.row = rows ? rows - 1 : 0;
+  MenuIndex old_index = menu_layer->selected;
+  menu_layer->selected = index;
+  if ((old_index.section != index.section || old_index.row != index.row) &&
+      menu_layer->callbacks.selection_changed) {
+    menu_layer->callbacks.selection_changed(menu_layer, index, old_index, menu_layer->context);
+  }
+  s_dirty = true;
+}
+
+void menu_layer_reload_data(MenuLayer *menu_layer) {
+  host_emit("menu reload");
+  // Keep the selection on a row that still exists
+  menu_select(menu_layer, menu_layer->selected);
+}
+
+void menu_layer_set_selected_index(MenuLayer *menu_layer, MenuIndex index,
+                                   MenuRowAlign scroll_align, bool animated) {
+  menu_select(menu_layer, index);
+}
+
+void menu_layer_set_selected_next(MenuLayer *menu_layer, bool up, MenuRowAlign scroll_align,
+                                  bool animated) {
+  MenuIndex index = menu_layer->selected;
+  if (up) {
+    while (index.row == 0 && index.section > 0) {
+      index.section--;
+      index.row = menu_rows(menu_layer, index.section);
+    }
+    if (index.row > 0) index.row--;
+  } else {
+    index.row++;
+    while (index.row >= menu_rows(menu_layer, index.section) &&
+           index.section + 1 < menu_sections(menu_layer)) {
+      index.section++;
+      index.row = 0;
+    }
+  }
+  menu_select(menu_layer, index);
+}
+
+MenuIndex menu_layer_get_selected_index(const MenuLayer *menu_layer) {
+  return menu_layer->selected;
+}
+
+bool menu_layer_is_index_selected(const MenuLayer *menu_layer, MenuIndex *index) {
+  return index->section == menu_layer->selected.section && index->row == menu_layer->selected.row;
+}
+
+void menu_layer_set_normal_colors(MenuLayer *menu_layer, GColor background, GColor foreground) {}
+void menu_layer_set_highlight_colors(MenuLayer *menu_layer, GColor background, GColor foreground) {}
+
+bool menu_cell_layer_is_highlighted(const Layer *cell_layer) {
+  return cell_layer->highlighted;
+}
+
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title,
+                          const char *subtitle, GBitmap *icon) {}
+
+// Drawing: every section header and row of a menu, the update procs of
+// other layers
+
+static void draw_menu(MenuLayer *menu_layer) {
+  MenuLayerCallbacks *callbacks = &menu_layer->callbacks;
+  int16_t width = menu_layer->layer.bounds.size.w;
+  for (uint16_t section = 0; section < menu_sections(menu_layer); section++) {
+    Layer cell;
+    if (callbacks->draw_header) {
+      int16_t height = callbacks->get_header_height ?
+                       callbacks->get_header_height(menu_layer, section, menu_layer->context) : 0;
+      layer_init(&cell, LAYER_MENU_CELL, GRect(0, 0, width, height), NULL);
+      if (height > 0) {
+        callbacks->draw_header(&s_context, &cell, section, menu_layer->context);
+      }
+    }
+    for (uint16_t row = 0; row < menu_rows(menu_layer, section); row++) {
+      MenuIndex index = MenuIndex(section, row);
+      int16_t height = callbacks->get_cell_height ?
+                       callbacks->get_cell_height(menu_layer, &index, menu_layer->context) : 44;
+      layer_init(&cell, LAYER_MENU_CELL, GRect(0, 0, width, height), NULL);
+      cell.highlighted = menu_layer_is_index_selected(menu_layer, &index);
+      if (callbacks->draw_row) {
+        callbacks->draw_row(&s_context, &cell, &index, menu_layer->context);
+      }
+    }
+  }
+}
+
+static void draw_layer(Layer *layer) {
+  if (layer->hidden) return;
+  if (layer->kind == LAYER_MENU) {
+    draw_menu(layer->owner);
+  } else if (layer->update_proc) {
+    layer->update_proc(layer, &s_context);
+  }
+  for (Layer *child = layer->first_child; child; child = child->next_sibling) {
+    draw_layer(child);
+  }
+}
+
+static void draw_top_window(void) {
+  Window *top = window_stack_get_top_window();
+  if (!s_dirty || !top) return;
+  s_dirty = false;
+  draw_layer(&top->root);
+}
+
+// Clicks
+
+static ButtonId button_for_name(const char *name) {
+  if (strcmp(name, "back") == 0) return BUTTON_ID_BACK;
+  if (strcmp(name, "up") == 0) return BUTTON_ID_UP;
+  if (strcmp(name, "select") == 0) return BUTTON_ID_SELECT;
+  if (strcmp(name, "down") == 0) return BUTTON_ID_DOWN;
+  return NUM_BUTTONS;
+}
+
+static void click(ButtonId button, bool is_long) {
+  Window *window = window_stack_get_top_window();
+  if (!window) return;
+
+  MenuLayer *menu = window->menu;
+  if (menu && button != BUTTON_ID_BACK) {
+    if (button == BUTTON_ID_SELECT) {
+      MenuLayerSelectCallback callback = is_long ? menu->callbacks.select_long_click :
+                                                   menu->callbacks.select_click;
+      MenuIndex index = menu->selected;
+      if (callback) callback(menu, &index, menu->context);
+    } else {
+      menu_layer_set_selected_next(menu, button == BUTTON_ID_UP, MenuRowAlignCenter, true);
+    }
+    return;
+  }
+
+  // Subscriptions as the window is configured now
+  memset(window->clicks, 0, sizeof(window->clicks));
+  s_configuring = window;
+  if (window->scroll && window->scroll->callbacks.click_config_provider) {
+    window->scroll->callbacks.click_config_provider(window->scroll->context);
+  }
+  if (window->click_config_provider) {
+    window->click_config_provider(window->click_context);
+  }
+  s_configuring = NULL;
+
+  ClickSubscription *subscription = &window->clicks[button];
+  void *context = window->scroll && !window->click_config_provider ?
+                  window->scroll->context : window->click_context;
+  if (is_long && subscription->long_down) {
+    subscription->long_down(NULL, context);
+    if (subscription->long_up) subscription->long_up(NULL, context);
+  } else if (subscription->single) {
+    subscription->single(NULL, context);
+  } else if (button == BUTTON_ID_BACK) {
+    window_stack_pop(true);
+  } else if (window->scroll && button != BUTTON_ID_SELECT) {
+    GPoint offset = scroll_layer_get_content_offset(window->scroll);
+    offset.y += button == BUTTON_ID_UP ? 30 : -30;
+    scroll_layer_set_content_offset(window->scroll, offset, true);
+  }
+}
+
+// Event loop
+
+static bool s_quit = false;
+
+static void handle_line(char *line) {
+  char *arguments = strchr(line, ' ');
+  if (arguments) *arguments++ = '\0';
+  else arguments = line + strlen(line);
+
+  if (strcmp(line, "in") == 0) {
+    inbox_message(arguments);
+  } else if (strcmp(line, "sent") == 0) {
+    outbox_result(true, APP_MSG_OK);
+  } else if (strcmp(line, "failed") == 0) {
+    outbox_result(false, (AppMessageResult)atoi(arguments));
+  } else if (strcmp(line, "click") == 0) {
+    char *modifier = strchr(arguments, ' ');
+    if (modifier) *modifier++ = '\0';
+    ButtonId button = button_for_name(arguments);
+    if (button == NUM_BUTTONS) {
+      fprintf(stderr, "host: unknown button %s\n", arguments);
+      return;
+    }
+    click(button, modifier && strcmp(modifier, "long") == 0);
+  } else if (strcmp(line, "worker") == 0) {
+    AppWorkerMessage message = { 0 };
+    if (s_worker_handler) s_worker_handler(atoi(arguments), &message);
+  } else if (strcmp(line, "connected") == 0) {
+    s_connected = atoi(arguments) != 0;
+    if (s_connection_handlers.pebble_app_connection_handler) {
+      s_connection_handlers.pebble_app_connection_handler(s_connected);
+    }
+  } else if (strcmp(line, "quit") == 0) {
+    s_quit = true;
+  } else if (line[0]) {
+    fprintf(stderr, "host: unknown command %s\n", line);
+  }
+}
+
+static void end_turn(void) {
+  draw_top_window();
+  host_app_turn_end();
+}
+
+void app_event_loop(void) {
+  static char buffer[65536];
+  size_t used = 0;
+  bool input_open = true;
+
+  host_app_started();
+  end_turn();
+
+  while (!s_quit && input_open && s_window_count > 0) {
+    // Sleep until input, the next timer or the next tick
+    int timeout = -1;
+    HostTimer *timer = next_timer();
+    uint64_t now = monotonic_ms();
+    if (timer) {
+      timeout = timer->due > now ? (int)(timer->due - now) : 0;
+    }
+    time_t tick = next_tick();
+    if (tick) {
+      int tick_timeout = (int)((tick - time(NULL)) * 1000);
+      if (tick_timeout < 0) tick_timeout = 0;
+      if (timeout < 0 || tick_timeout < timeout) timeout = tick_timeout;
+    }
+
+    struct pollfd input = { .fd = STDIN_FILENO, .events = POLLIN };
+    int ready = poll(&input, 1, timeout);
+    if (ready < 0 && errno != EINTR) break;
+
+    if (ready > 0) {
+      ssize_t count = read(STDIN_FILENO, buffer + used, sizeof(buffer) - used - 1);
+      if (count <= 0) {
+        input_open = false;
+      } else {
+        used += count;
+        char *start = buffer;
+        char *newline;
+        while (!s_quit && (newline = memchr(start, '\n', buffer + used - start))) {
+          *newline = '\0';
+          handle_line(start);
+          end_turn();
+          start = newline + 1;
+        }
+        used -= start - buffer;
+        memmove(buffer, start, used);
+        if (used == sizeof(buffer) - 1) {
+          fprintf(stderr, "host: input line too long\n");
+          used = 0;
+        }
+      }
+    }
+
+    // One due timer per turn, so timers started meanwhile keep their order
+    timer = next_timer();
+    if (!s_quit && timer && timer->due <= monotonic_ms()) {
+      HostTimer **link;
+      find_timer((AppTimer *)timer->id, &link);
+      *link = timer->next;
+      AppTimerCallback callback = timer->callback;
+      void *data = timer->data;
+      free(timer);
+      callback(data);
+      end_turn();
+    }
+
+    tick = next_tick();
+    if (!s_quit && tick && time(NULL) >= tick) {
+      fire_tick(time(NULL));
+      end_turn();
+    }
+  }
+}
@@ -0,0 +1,220 @@
+#!/usr/bin/env node
+// Self-hostable caching proxy for the iRail API
+//
+// Usage: node irail_proxy.js [--port N] [--upstream URL]
+//
+// Serves the iRail paths the app uses (/connections/, /liveboard/,
+// /vehicle/, /v1/stations) so API_BASE_URL in src/pkjs/00-constants.js can
+// point here instead of https://api.irail.be. Identical queries from all
+// users are coalesced while in flight and cached:
+//   - /connections/ responses are trimmed to the fields the app reads
+//     (01-irail-parser.js schemas) and cached for a tenth of the time until
+//     the first departure, between CONNECTIONS_MIN_TTL and CONNECTIONS_MAX_TTL,
+//     so delays stay fresh for trains about to leave;
+//   - other paths are passed through with fixed TTLs.
+// GET /stats returns request, hit and upstream counters as JSON.
+
+'use strict';
+
+var http = require('http');
+var https = require('https');
+var url = require('url');
+var IRailParser = require('../src/pkjs/01-irail-parser.js');
+
+var CONNECTIONS_MIN_TTL = 15 * 1000;
+var CONNECTIONS_MAX_TTL = 5 * 60 * 1000;
+var CACHE_MAX_ENTRIES = 5000;
+var USER_AGENT = 'CommuterProxy (https://werknaam.be, commuter@werknaam.be)';
+
+// Cache lifetime per path for passed-through responses
+var PASS_THROUGH_TTL = {
+  '/liveboard/': 30 * 1000,
+  '/vehicle/': 60 * 60 * 1000,
+  '/v1/stations': 24 * 60 * 60 * 1000
+};
+
+// Only these query parameters change an answer (sorted into the cache key)
+var KEY_PARAMS = ['from', 'to', 'id', 'date', 'time', 'timesel', 'arrdep', 'lang', 'format'];
+
+function cacheKey(pathname, query) {
+  var parts = [pathname];
+  KEY_PARAMS.forEach(function(name) {
+    if (query[name] !== undefined) {
+      parts.push(name + '=' + query[name]);
+    }
+  });
+  return parts.join('&');
+}
+
+// Trim a /connections/ response; returns { body, ttl }
+function trimConnections(text, now) {
+  var response = IRailParser.parseConnections(text, 0);
+  var first = null;
+  (response.connection || []).forEach(function(conn) {
+    var depart = parseInt(conn.departure.time, 10) * 1000 + (parseInt(conn.departure.delay, 10) || 0) * 1000;
+    if (depart > now && (first === null || depart < first)) {
+      first = depart;
+    }
+  });
+  var ttl = first === null ? CONNECTIONS_MAX_TTL : (first - now) / 10;
+  return {
+    body: JSON.stringify({ connection: response.connection || [] }),
+    ttl: Math.max(CONNECTIONS_MIN_TTL, Math.min(CONNECTIONS_MAX_TTL, ttl))
+  };
+}
+
+function createProxy(options) {
+  var upstream = url.parse(options.upstream || 'https://api.irail.be');
+  var transport = upstream.protocol === 'http:' ? http : https;
+  var now = options.now || Date.now;
+
+  var cache = {};       // key -> { body, status, expires }
+  var cacheSize = 0;
+  var inFlight = {};    // key -> [callbacks]
+  var stats = { requests: 0, hits: 0, coalesced: 0, upstream: 0, upstreamErrors: 0,
+                bytesIn: 0, bytesOut: 0 };
+
+  function store(key, entry) {
+    if (!cache[key]) {
+      cacheSize++;
+    }
+    cache[key] = entry;
+    if (cacheSize > CACHE_MAX_ENTRIES) {
+      // Drop expired entries first, then everything if still full
+      var time = now();
+      Object.keys(cache).forEach(function(k) {
+        if (cache[k].expires <= time) {
+          delete cache[k];
+          cacheSize--;
+        }
+      });
+      if (cacheSize > CACHE_MAX_ENTRIES) {
+        cache = {};
+        cacheSize = 0;
+      }
+    }
+  }
+
+  function fetchUpstream(path, callback) {
+    stats.upstream++;
+    var request = transport.get({
+      protocol: upstream.protocol,
+      hostname: upstream.hostname,
+      port: upstream.port,
+      path: (upstream.pathname || '/').replace(/\/$/, '') + path,
+      headers: { 'User-Agent': USER_AGENT, 'Accept': 'application/json' }
+    }, function(response) {
+      var chunks = [];
+      response.setEncoding('utf8');
+      response.on('data', function(chunk) { chunks.push(chunk); });
+      response.on('end', function() {
+        var text = chunks.join('');
+        stats.bytesIn += text.length;
+        callback(null, response.statusCode, text);
+      });
+    });
+    request.on('error', function(e) {
+      stats.upstreamErrors++;
+      callback(e);
+    });
+  }
+
+  // Resolve a cacheable path, coalescing identical requests in flight
+  function resolve(pathname, query, path, callback) {
+    var key = cacheKey(pathname, query);
+    var entry = cache[key];
+    if (entry && entry.expires > now()) {
+      stats.hits++;
+      callback(entry.status, entry.body);
+      return;
+    }
+
+    if (inFlight[key]) {
+      stats.coalesced++;
+      inFlight[key].push(callback);
+      return;
+    }
+    inFlight[key] = [callback];
+
+    fetchUpstream(path, function(error, status, text) {
+      var waiting = inFlight[key];
+      delete inFlight[key];
+
+      var result = { status: 502, body: JSON.stringify({ error: 'Upstream unavailable' }) };
+      if (!error) {
+        result = { status: status, body: text };
+        if (status === 200) {
+          var ttl = PASS_THROUGH_TTL[pathname];
+          if (pathname === '/connections/') {
+            try {
+              var trimmed = trimConnections(text, now());
+              result.body = trimmed.body;
+              ttl = trimmed.ttl;
+            } catch (e) {
+              result = { status: 502, body: JSON.stringify({ error: 'Bad upstream response' }) };
+              ttl = 0;
+            }
+          }
+          if (ttl) {
+            store(key, { status: result.status, body: result.body, expires: now() + ttl });
+          }
+        }
+      }
+      waiting.forEach(function(cb) { cb(result.status, result.body); });
+    });
+  }
+
+  function handle(request, response) {
+    var parsed = url.parse(request.url, true);
+    var pathname = parsed.pathname;
+
+    function send(status, body) {
+      stats.bytesOut += body.length;
+      response.writeHead(status, { 'Content-Type': 'application/json; charset=utf-8' });
+      response.end(body);
+    }
+
+    if (pathname === '/stats') {
+      var copy = JSON.parse(JSON.stringify(stats));
+      copy.cacheEntries = cacheSize;
+      copy.hitRate = stats.requests ? (stats.hits + stats.coalesced) / stats.requests : 0;
+      send(200, JSON.stringify(copy));
+      return;
+    }
+    if (request.method !== 'GET' ||
+        (pathname !== '/connections/' && !PASS_THROUGH_TTL.hasOwnProperty(pathname))) {
+      send(404, JSON.stringify({ error: 'Not found' }));
+      return;
+    }
+
+    stats.requests++;
+    resolve(pathname, parsed.query, parsed.path, send);
+  }
+
+  var server = http.createServer(handle);
+  server.stats = stats;
+  return server;
+}
+
+module.exports = {
+  createProxy: createProxy,
+  trimConnections: trimConnections
+};
+
+if (require.main === module) {
+  var options = { port: 8080, upstream: 'https://api.irail.be' };
+  var argv = process.argv.slice(2);
+  for (var i = 0; i < argv.length; i++) {
+    if (argv[i] === '--port') {
+      options.port = parseInt(argv[++i], 10);
+    } else if (argv[i] === '--upstream') {
+      options.upstream = argv[++i];
+    } else {
+      console.error('Usage: node irail_proxy.js [--port N] [--upstream URL]');
+      process.exit(1);
+    }
+  }
+  createProxy(options).listen(options.port, function() {
+    console.log('iRail proxy on http://localhost:' + options.port + ' -> ' + options.upstream);
+  });
+}
@@ -0,0 +1,235 @@
+#!/usr/bin/env node
+// Mock iRail upstream for offline proxy benchmarks
+//
+// Usage: node mock_irail.js [--port N] [--latency MS] [--rate-limit N]
+//
+// Answers /connections/ with iRail-shaped responses of realistic size
+// (intermediate stops, occupancy, alerts) for any station pair, and
+// /liveboard/, /vehicle/, /disturbances/ and /v1/stations with small fixed
+// payloads. Each answer is delayed by --latency ms to stand in for the real
+// API. /disturbances/ carries an ETag and answers a matching If-None-Match
+// with 304, like iRail's feed when nothing changed.
+//
+// With --rate-limit, requests beyond N per second (bursts of 2N) get a 429
+// with Retry-After, like iRail throttling a client.
+
+'use strict';
+
+var http = require('http');
+var url = require('url');
+
+// Favorites of simulate.js, with the other members of their station groups
+var STATION_IDS = ['BE.NMBS.008813003', 'BE.NMBS.008821006', 'BE.NMBS.008892007',
+                   'BE.NMBS.008812005', 'BE.NMBS.008814001', 'BE.NMBS.008821121'];
+
+function station(id) {
+  return {
+    locationX: '4.356801', locationY: '50.845658', id: id,
+    '@id': 'http://irail.be/stations/NMBS/' + id.replace(/\D/g, ''),
+    standardname: 'Station ' + id.slice(-4), name: 'Station ' + id.slice(-4)
+  };
+}
+
+function endpoint(id, time, delay, vehicle, platform, stops) {
+  var stopList = [];
+  for (var i = 0; i < stops; i++) {
+    stopList.push({
+      id: String(i), station: 'Stop ' + i, stationinfo: station('BE.NMBS.00880' + (1000 + i)),
+      scheduledArrivalTime: String(time + i * 240), arrivalCanceled: '0', arrived: '0',
+      scheduledDepartureTime: String(time + i * 240 + 60), arrivalDelay: String(delay),
+      departureDelay: String(delay), departureCanceled: '0', left: '0', isExtraStop: '0',
+      platform: String(1 + i % 12), platforminfo: { name: String(1 + i % 12), normal: '1' }
+    });
+  }
+  return {
+    delay: String(delay), station: 'Station ' + id.slice(-4), stationinfo: station(id),
+    time: String(time), vehicle: 'BE.NMBS.' + vehicle,
+    vehicleinfo: { name: 'BE.NMBS.' + vehicle, shortname: vehicle.replace(/(\D+)/, '$1 '),
+                   number: vehicle.replace(/\D/g, ''), type: vehicle.replace(/\d/g, ''),
+                   locationX: '0', locationY: '0', '@id': 'http://irail.be/vehicle/' + vehicle },
+    platform: platform, platforminfo: { name: platform, normal: delay > 120 ? '0' : '1' },
+    canceled: '0', left: '0', walking: '0', isExtra: '0',
+    direction: { name: 'Terminus ' + id.slice(-3) },
+    stops: { number: String(stops), stop: stopList },
+    departureConnection: 'http://irail.be/connections/' + vehicle + '/' + time,
+    occupancy: { '@id': 'http://api.irail.be/terms/unknown', name: 'unknown' }
+  };
+}
+
+// Trains run every 15 minutes; a train keeps its vehicle, delay and
+// duration across requests, so a later lookup (detail refetch) finds it
+var INTERVAL = 900;
+
+function train(slot) {
+  return {
+    time: slot * INTERVAL,
+    vehicle: 'IC' + (1800 + slot % 100),
+    delay: (slot % 4 === 1) ? 180 : 0,
+    duration: 2400 + (slot % 3) * 300
+  };
+}
+
+function connectionsResponse(query) {
+  var now = Math.floor(Date.now() / 1000);
+  var from = query.from || 'BE.NMBS.008813003';
+  var to = query.to || 'BE.NMBS.008821006';
+  var first = Math.ceil((now + 300) / INTERVAL);
+  var connections = [];
+  for (var i = 0; i < 12; i++) {
+    var slot = first + i;
+    var run = train(slot);
+    var time = run.time;
+    var vehicle = run.vehicle;
+    var delay = run.delay;
+    var duration = run.duration;
+    connections.push({
+      id: String(i),
+      departure: endpoint(from, time, delay, vehicle, String(1 + slot % 12), 6),
+      arrival: endpoint(to, time + duration, delay, vehicle, String(1 + (slot + 5) % 12), 0),
+      duration: String(duration),
+      vias: { number: '0', via: [] },
+      alerts: { number: '1', alert: [{ id: '0', header: 'Works', lead: 'Works between stations ' +
+                                       'on weekend nights may cause delays.', link: '', startTime: String(now),
+                                       endTime: String(now + 86400) }] },
+      occupancy: { '@id': 'http://api.irail.be/terms/low', name: 'low' }
+    });
+  }
+  return { version: '1.3', timestamp: String(now), connection: connections };
+}
+
+// Stop list of the train with this vehicle (the next one, or one that left
+// up to an hour ago): its departure, 6 stops and its arrival, at the times
+// its connection has
+function vehicleResponse(query) {
+  var number = parseInt(String(query.id || '').replace(/\D/g, ''), 10) - 1800;
+  var earliest = Math.floor(Date.now() / 1000 / INTERVAL) - 4;
+  var run = train(earliest + ((number - earliest) % 100 + 100) % 100);
+  var stops = endpoint('BE.NMBS.008813003', run.time - 60, run.delay, run.vehicle, '1', 8).stops;
+  stops.stop[stops.stop.length - 1].scheduledArrivalTime = String(run.time + run.duration);
+  return { vehicle: query.id, stops: stops };
+}
+
+function liveboardResponse(query) {
+  var now = Math.floor(Date.now() / 1000);
+  var departures = [];
+  for (var i = 0; i < 20; i++) {
+    var vehicle = 'IC' + (1800 + i);
+    departures.push(endpoint(query.id || 'BE.NMBS.008813003', now + 120 + i * 180, 0, vehicle, String(1 + i % 12), 0));
+  }
+  return { version: '1.3', timestamp: String(now), departures: { number: String(departures.length), departure: departures } };
+}
+
+// The feed changes once an hour; its ETag follows
+function disturbancesResponse() {
+  var hour = Math.floor(Date.now() / 3600000);
+  return {
+    version: '1.3', timestamp: String(hour * 3600),
+    disturbance: [
+      { id: '0', title: 'IC 1801: delayed by a technical problem',
+        description: 'Train IC 1801 is delayed by a technical problem on the train.',
+        type: 'disturbance', link: '', timestamp: String(hour * 3600) },
+      { id: '1', title: 'Works between Station 3003 and Station 1006',
+        description: 'Weekend works: fewer trains between Station 3003 and Station 1006.',
+        type: 'planned', link: '', timestamp: String(hour * 3600 - 86400) }
+    ]
+  };
+}
+
+function createMockUpstream(options) {
+  var latency = options.latency || 0;
+  var stats = { requests: 0, throttled: 0, notModified: 0 };
+  var limit = { rate: 0, tokens: 0, at: 0 };
+
+  // Token bucket over all requests; false when this one is over the limit
+  function admit() {
+    if (!limit.rate) {
+      return true;
+    }
+    var now = Date.now();
+    limit.tokens = Math.min(limit.rate * 2, limit.tokens + (now - limit.at) * limit.rate / 1000);
+    limit.at = now;
+    if (limit.tokens < 1) {
+      return false;
+    }
+    limit.tokens -= 1;
+    return true;
+  }
+
+  var server = http.createServer(function(request, response) {
+    stats.requests++;
+    if (!admit()) {
+      stats.throttled++;
+      response.writeHead(429, { 'Content-Type': 'application/json',
+                                'Retry-After': String(Math.ceil((1 - limit.tokens) / limit.rate)) });
+      response.end('{"error":429,"message":"Too many requests"}');
+      return;
+    }
+    var parsed = url.parse(request.url, true);
+    var body;
+    var headers = { 'Content-Type': 'application/json' };
+    if (parsed.pathname === '/disturbances/') {
+      body = disturbancesResponse();
+      headers.ETag = '"' + body.timestamp + '"';
+      if (request.headers['if-none-match'] === headers.ETag) {
+        stats.notModified++;
+        setTimeout(function() {
+          response.writeHead(304, { ETag: headers.ETag });
+          response.end();
+        }, latency);
+        return;
+      }
+    } else if (parsed.pathname === '/connections/') {
+      body = connectionsResponse(parsed.query);
+    } else if (parsed.pathname === '/liveboard/') {
+      body = liveboardResponse(parsed.query);
+    } else if (parsed.pathname === '/vehicle/') {
+      body = vehicleResponse(parsed.query);
+    } else if (parsed.pathname === '/v1/stations') {
+      // Every station simulate.js seeds as a favorite, or its phone drops
+      // the missing ones from the cache when it refreshes the list
+      body = { version: '1.3', station: STATION_IDS.map(station) };
+    }
+
+    setTimeout(function() {
+      if (!body) {
+        response.writeHead(404, { 'Content-Type': 'application/json' });
+        response.end('{"error":404,"message":"Not found"}');
+        return;
+      }
+      response.writeHead(200, headers);
+      response.end(JSON.stringify(body));
+    }, latency);
+  });
+  server.stats = stats;
+  // Requests per second before answering 429 (0: no limit)
+  server.setRateLimit = function(rate) {
+    limit = { rate: rate, tokens: rate * 2, at: Date.now() };
+  };
+  server.setRateLimit(options.rateLimit || 0);
+  return server;
+}
+
+module.exports = {
+  createMockUpstream: createMockUpstream
+};
+
+if (require.main === module) {
+  var options = { port: 8081, latency: 200, rateLimit: 0 };
+  var argv = process.argv.slice(2);
+  for (var i = 0; i < argv.length; i++) {
+    if (argv[i] === '--port') {
+      options.port = parseInt(argv[++i], 10);
+    } else if (argv[i] === '--latency') {
+      options.latency = parseInt(argv[++i], 10);
+    } else if (argv[i] === '--rate-limit') {
+      options.rateLimit = parseFloat(argv[++i]);
+    } else {
+      console.error('Usage: node mock_irail.js [--port N] [--latency MS] [--rate-limit N]');
+      process.exit(1);
+    }
+  }
+  createMockUpstream(options).listen(options.port, function() {
+    console.log('Mock iRail on http://localhost:' + options.port + ' (' + options.latency + ' ms latency' +
+                (options.rateLimit ? ', ' + options.rateLimit + ' requests/s' : '') + ')');
+  });
+}
@@ -0,0 +1,955 @@
+#!/usr/bin/env node
+// Full-pipeline simulator: PebbleKit JS and the watch over a simulated link
+//
+// Usage: node simulate.js [--scenario NAME|all] [--latency MS] [--jitter MS]
+//                         [--mtu BYTES] [--drop RATE] [--bandwidth B/S]
+//                         [--irail-latency MS] [--sequential-groups] [--tree DIR]
+//                         [--verbose]
+//
+// Loads the real src/pkjs modules under Node with mocked Pebble,
+// localStorage and XMLHttpRequest; iRail requests go to mock_irail.js
+// in-process. AppMessages cross a simulated Bluetooth link: one message in
+// flight per direction, --latency ms (+ up to --jitter ms) each way plus
+// the dictionary's size at --bandwidth bytes/s (0: unlimited), dictionaries
+// over --mtu bytes rejected and --drop of them lost (nacked after the ack
+// timeout). The watch end is the C app itself: src/c built for Linux
+// against the Pebble API stand-in in scripts/host (make -C scripts/host,
+// run first by this script), one process per scenario. --tree runs the
+// src/pkjs and src/c of another checkout instead, e.g. an older commit to
+// compare against.
+//
+// Scenarios:
+//   cold-start       saved favorites, JS starts after the watch app
+//   route-toggle     destination cycled 5 times faster than the debounce
+//   background-wake  worker-launched glance refresh (IS_BACKGROUND)
+//   weak-link        cold start over a slow, lossy link: departures arrive as
+//                    compact rows, then their details (the phone doesn't
+//                    resend dropped ones, so it ends when the link is quiet)
+//   throttled        cold start against an iRail mock that answers 429 beyond
+//                    1 request per 2 s, so the watch goes through LOAD_STATE_THROTTLED
+//   station-group    cold start on a route between two station groups (3 x 2
+//                    member pairs); --sequential-groups fetches the pairs one
+//                    after another (CONFIG.GROUP_FETCH_SEQUENTIAL) to compare
+//   stops-failed     first departure opened, its first stops request lost on
+//                    the link: the list must stay as it was and the next
+//                    scroll must ask for the stops again
+//
+// Each scenario prints its milestones (ms since the watch app started),
+// per-type message counts and bytes in both directions, and how often the
+// app reloaded and redrew its menu. A scenario fails, and the exit status
+// is 1, when it doesn't complete or the watch falls back on the config
+// timeout instead of receiving the favorites.
+
+'use strict';
+
+var childProcess = require('child_process');
+var fs = require('fs');
+var http = require('http');
+var path = require('path');
+var readline = require('readline');
+var MockIRail = require('./mock_irail.js');
+
+var ROOT_DIR = path.join(__dirname, '..');
+var HOST_DIR = path.join(__dirname, 'host');
+
+// AppMessageResult codes the watch sees for a failed outbox message
+var APP_MSG_SEND_TIMEOUT = 2;
+var APP_MSG_BUFFER_OVERFLOW = 128;
+// weak-link: the phone is done with details once nothing went to the watch
+// for this long
+var DETAILS_QUIET_MS = 3000;
+
+// Of the checkout under test (--tree): its pkjs, its watch app built for
+// the host and the LoadState values from its types.h
+var pkjsDir = null;
+var hostBinary = null;
+var LOAD_STATE = null;
+
+function readLoadStates(typesPath) {
+  var source = fs.readFileSync(typesPath, 'utf8');
+  var body = /typedef enum \{([^}]*)\} LoadState;/.exec(source)[1];
+  var states = {};
+  (body.match(/LOAD_STATE_\w+/g) || []).forEach(function(name, index) {
+    states[name.replace('LOAD_STATE_', '')] = index;
+  });
+  return states;
+}
+
+function parseArgs(argv) {
+  var options = { scenario: 'all', latency: 40, jitter: 20, mtu: 512, drop: 0, bandwidth: 0,
+                  'irail-latency': 300, tree: ROOT_DIR, verbose: false, 'sequential-groups': false };
+  for (var i = 0; i < argv.length; i++) {
+    var name = argv[i].replace(/^--/, '');
+    if (name === 'verbose' || name === 'sequential-groups') {
+      options[name] = true;
+    } else if (name === 'scenario') {
+      options.scenario = argv[++i];
+    } else if (name === 'tree') {
+      options.tree = path.resolve(argv[++i]);
+    } else if (options.hasOwnProperty(name)) {
+      options[name] = parseFloat(argv[++i]);
+    } else {
+      console.error('Usage: node simulate.js [--scenario NAME|all] [--latency MS] [--jitter MS] ' +
+                    '[--mtu BYTES] [--drop RATE] [--bandwidth B/S] [--irail-latency MS] ' +
+                    '[--sequential-groups] [--tree DIR] [--verbose]');
+      process.exit(1);
+    }
+  }
+  return options;
+}
+
+// Deterministic pseudo-random numbers so runs are comparable (restarted
+// for each scenario)
+var SEED = 12345;
+var seed = SEED;
+function random() {
+  seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF;
+  return seed / 0x7FFFFFFF;
+}
+
+// Dictionary as pebble_host.c reads it: NAME=TYPE:VALUE tuples, numbers as
+// int32 (uint32 above its range) like PebbleKit JS, strings and byte arrays
+// in hex
+function encodeTuples(dict) {
+  return Object.keys(dict).map(function(key) {
+    var value = dict[key];
+    if (typeof value === 'string') {
+      return key + '=s:' + Buffer.from(value, 'utf8').toString('hex');
+    } else if (Array.isArray(value) || value instanceof Uint8Array) {
+      return key + '=d:' + Buffer.from(value).toString('hex');
+    }
+    var number = Number(value);
+    return key + (number > 0x7FFFFFFF ? '=u4:' : '=i4:') + Math.round(number);
+  }).join(' ');
+}
+
+function decodeTuples(text) {
+  var dict = {};
+  text.split(' ').forEach(function(tuple) {
+    var match = /^(\w+)=(\w+):(.*)$/.exec(tuple);
+    if (!match) {
+      return;
+    }
+    if (match[2] === 's') {
+      dict[match[1]] = Buffer.from(match[3], 'hex').toString('utf8');
+    } else if (match[2] === 'd') {
+      dict[match[1]] = Array.prototype.slice.call(Buffer.from(match[3], 'hex'));
+    } else {
+      dict[match[1]] = parseInt(match[3], 10);
+    }
+  });
+  return dict;
+}
+
+// Size of a dictionary as the watch inbox sees it: 1 byte count, then per
+// tuple a 7 byte header and the value (ints as int32, strings with NUL)
+function dictSize(dict) {
+  var size = 1;
+  Object.keys(dict).forEach(function(key) {
+    var value = dict[key];
+    if (typeof value === 'string') {
+      size += 7 + Buffer.byteLength(value, 'utf8') + 1;
+    } else if (Array.isArray(value)) {
+      size += 7 + value.length;
+    } else {
+      size += 7 + 4;
+    }
+  });
+  return size;
+}
+
+// Timers started by the pkjs modules (and the simulator) during a scenario,
+// so nothing outlives it
+var timers = new Set();
+var realSetTimeout = global.setTimeout;
+var realClearTimeout = global.clearTimeout;
+var realSetInterval = global.setInterval;
+var realClearInterval = global.clearInterval;
+
+global.setTimeout = function(fn, ms) {
+  var args = Array.prototype.slice.call(arguments, 2);
+  var handle = realSetTimeout(function() {
+    timers.delete(handle);
+    fn.apply(null, args);
+  }, ms);
+  timers.add(handle);
+  return handle;
+};
+global.clearTimeout = function(handle) {
+  timers.delete(handle);
+  realClearTimeout(handle);
+};
+global.setInterval = function(fn, ms) {
+  var handle = realSetInterval(fn, ms);
+  timers.add(handle);
+  return handle;
+};
+global.clearInterval = function(handle) {
+  timers.delete(handle);
+  realClearInterval(handle);
+};
+
+function clearAllTimers() {
+  timers.forEach(function(handle) {
+    realClearTimeout(handle);
+    realClearInterval(handle);
+  });
+  timers.clear();
+}
+
+// Bluetooth link: a FIFO per direction with one message in flight, like the
+// AppMessage outboxes on either end
+function Link(options, now, typeName) {
+  this.options = options;
+  this.now = now;
+  this.typeName = typeName;
+  this.queues = { toWatch: [], toPhone: [] };
+  this.busy = { toWatch: false, toPhone: false };
+  this.receivers = {};
+  this.stats = { toWatch: {}, toPhone: {}, rejected: 0, dropped: 0 };
+  // Messages to lose whatever the drop rate, by type name: how many
+  this.failures = {};
+  this.closed = false;
+}
+
+// Scenario over: acks still due (timers set while it ended) are dropped
+Link.prototype.close = function() {
+  this.closed = true;
+};
+
+Link.prototype.send = function(direction, dict, onAck, onNack) {
+  this.queues[direction].push({ dict: dict, onAck: onAck, onNack: onNack });
+  this.pump(direction);
+};
+
+Link.prototype.delay = function() {
+  return this.options.latency + random() * this.options.jitter;
+};
+
+// Time to put a dictionary of size bytes on the air
+Link.prototype.transfer = function(size) {
+  return this.options.bandwidth > 0 ? size / this.options.bandwidth * 1000 : 0;
+};
+
+Link.prototype.pump = function(direction) {
+  var self = this;
+  if (this.busy[direction] || this.queues[direction].length === 0) {
+    return;
+  }
+  var item = this.queues[direction].shift();
+  var size = dictSize(item.dict);
+  var type = this.typeName(item.dict.MESSAGE_TYPE);
+  var stats = this.stats[direction][type] = this.stats[direction][type] || { count: 0, bytes: 0 };
+
+  function done(ok, reason) {
+    if (self.closed) {
+      return;
+    }
+    self.busy[direction] = false;
+    if (ok && item.onAck) {
+      item.onAck();
+    } else if (!ok && item.onNack) {
+      item.onNack(reason);
+    }
+    self.pump(direction);
+  }
+
+  this.busy[direction] = true;
+  if (size > this.options.mtu) {
+    this.stats.rejected++;
+    setTimeout(function() { done(false, 'Message too big (' + size + ' B)'); }, 0);
+    return;
+  }
+  if (this.failures[type] > 0 || random() < this.options.drop) {
+    if (this.failures[type] > 0) {
+      this.failures[type]--;
+    }
+    this.stats.dropped++;
+    setTimeout(function() { done(false, 'Message dropped'); }, this.delay() * 2 + this.transfer(size) + 500);
+    return;
+  }
+
+  setTimeout(function() {
+    stats.count++;
+    stats.bytes += size;
+    self.receivers[direction](item.dict);
+    setTimeout(function() { done(true); }, self.delay());
+  }, this.delay() + this.transfer(size));
+};
+
+// Nothing queued or in flight in a direction
+Link.prototype.quiet = function(direction) {
+  return !this.busy[direction] && this.queues[direction].length === 0;
+};
+
+// The watch: a host build of the C app (scripts/host), driven over its
+// stdin/stdout. Milestones come from the app's own state as it reports it
+// after every event-loop turn.
+function Watch(link, now, log, options) {
+  this.link = link;
+  this.now = now;
+  this.log = log;
+  this.options = options;
+  this.milestones = [];
+  this.state = null;
+  this.configTimedOut = false;
+  this.staleIgnored = 0;
+  this.menuReloads = 0;
+  this.menuRedraws = 0;
+  this.glanceReloads = 0;
+  this.expectedStations = 0;
+  this.stationsDelivered = {};
+  this.retryAfter = 0;
+  this.alertRows = 0;
+  this.dashboardRoutes = 0;
+  this.background = false;
+  this.compactRows = false;
+  this.selectedRow = 0;
+  this.stopsReceived = 0;
+  this.onComplete = null;
+  this.onDetailsComplete = null;
+  this.onStop = null;
+  this.onExit = null;
+  this.process = null;
+}
+
+Watch.prototype.mark = function(name) {
+  this.milestones.push({ name: name, ms: this.now() });
+  this.log('watch: ' + name);
+};
+
+// Start the app; launched by the worker for a background glance refresh
+Watch.prototype.boot = function(launch) {
+  var self = this;
+  var args = ['--launch', launch || 'user'];
+  if (!this.options.verbose) {
+    args.push('--quiet');
+  }
+  this.process = childProcess.spawn(hostBinary, args,
+                                    { stdio: ['pipe', 'pipe', this.options.verbose ? 'pipe' : 'ignore'] });
+  readline.createInterface({ input: this.process.stdout }).on('line', function(line) {
+    self.handleLine(line);
+  });
+  if (this.options.verbose) {
+    readline.createInterface({ input: this.process.stderr }).on('line', function(line) {
+      self.log('watch log: ' + line);
+    });
+  }
+  this.process.on('exit', function() {
+    self.process = null;
+    if (self.onExit) {
+      self.onExit();
+    }
+  });
+  this.process.stdin.on('error', function() {});
+};
+
+Watch.prototype.command = function(line) {
+  if (this.process) {
+    this.process.stdin.write(line + '\n');
+  }
+};
+
+// Leave the app (it deinitializes like on the watch); done once it exited
+Watch.prototype.quit = function(done) {
+  if (!this.process) {
+    done();
+    return;
+  }
+  this.onExit = done;
+  this.command('quit');
+  this.process.stdin.end();
+};
+
+// Message from the phone delivered over the link
+Watch.prototype.receive = function(dict) {
+  switch (dict.MESSAGE_TYPE) {
+    case 6:  // SEND_STATION_COUNT
+      this.expectedStations = dict.CONFIG_STATION_COUNT;
+      this.stationsDelivered = {};
+      break;
+    case 7:  // SEND_STATION
+      this.stationsDelivered[dict.CONFIG_STATION_INDEX] = true;
+      break;
+    case 23:  // THROTTLED
+      this.retryAfter = dict.RETRY_AFTER;
+      break;
+    case 24:  // ALERTS
+      this.alertRows = dict.ALERT_ROWS || 0;
+      break;
+    case 19:  // DASHBOARD_ROUTES
+      this.dashboardRoutes = dict.DASHBOARD_ROUTES ? dict.DASHBOARD_ROUTES[1] || 0 : 0;
+      break;
+    case 14:  // SEND_STOP
+      if (dict.STOP_INDEX === undefined) {
+        this.mark('stops of leg ' + dict.LEG_INDEX + ' unavailable');
+      } else if (this.stopsReceived++ === 0) {
+        this.mark('first stop');
+      }
+      if (this.onStop) {
+        this.onStop(dict);
+      }
+      break;
+  }
+  this.command('in ' + encodeTuples(dict));
+};
+
+// Press a button on the top window
+Watch.prototype.click = function(button, long) {
+  this.command('click ' + button + (long ? ' long' : ''));
+};
+
+// Cycle the destination like SELECT on the "To" row (section 0, row 1)
+Watch.prototype.toggleDestination = function() {
+  while (this.selectedRow < 1) {
+    this.click('down');
+    this.selectedRow++;
+  }
+  this.click('select');
+};
+
+// Open the first departure (section 1, row 0), below the From and To rows
+// and the dashboard and alerts rows if there are any
+Watch.prototype.openFirstDeparture = function() {
+  var rows = 2 + (this.dashboardRoutes > 0 ? 1 : 0) + (this.state.alerts > 0 ? 1 : 0);
+  while (this.selectedRow < rows) {
+    this.click('down');
+    this.selectedRow++;
+  }
+  this.click('select');
+};
+
+// Background worker asking for a glance refresh (WORKER_REQUEST_GLANCE)
+Watch.prototype.workerWake = function() {
+  this.command('worker 100');
+};
+
+Watch.prototype.handleLine = function(line) {
+  var space = line.indexOf(' ');
+  var verb = space < 0 ? line : line.substring(0, space);
+  var rest = space < 0 ? '' : line.substring(space + 1);
+  var self = this;
+
+  if (verb === 'out') {
+    var dict = decodeTuples(rest);
+    if (dict.MESSAGE_TYPE === 1) {  // REQUEST_DATA
+      this.mark('request ' + dict.REQUEST_ID + ' sent');
+    } else if (dict.MESSAGE_TYPE === 13) {  // REQUEST_STOPS
+      this.mark('stops ' + dict.STOP_INDEX + '+ of leg ' + dict.LEG_INDEX + ' requested');
+    }
+    this.link.send('toPhone', dict, function() {
+      self.command('sent');
+    }, function(reason) {
+      if (dict.MESSAGE_TYPE === 13) {
+        self.mark('stops request failed');
+      }
+      self.log('watch: outbox failed (' + reason + ')');
+      self.command('failed ' + (/too big/.test(reason) ? APP_MSG_BUFFER_OVERFLOW : APP_MSG_SEND_TIMEOUT));
+    });
+  } else if (verb === 'state') {
+    var state = {};
+    rest.split(' ').forEach(function(pair) {
+      var parts = pair.split('=');
+      state[parts[0]] = parseInt(parts[1], 10);
+    });
+    this.stateChanged(this.state, state);
+    this.state = state;
+  } else if (line === 'menu reload') {
+    this.menuReloads++;
+    this.log('watch: ' + line);
+  } else if (line === 'menu redraw') {
+    this.menuRedraws++;
+    this.log('watch: ' + line);
+  } else if (verb === 'glance') {
+    this.glanceReloads++;
+  } else if (verb === 'stale') {
+    this.staleIgnored++;
+  } else if (verb !== 'exit') {
+    this.log('watch: unexpected line ' + line);
+  }
+};
+
+// Milestones from what changed in the app's state
+Watch.prototype.stateChanged = function(before, state) {
+  if (!before) {
+    this.mark('app start');
+    before = {};
+  }
+  if (state.background) {
+    this.background = true;
+  }
+
+  if (state.received && !before.received) {
+    var delivered = Object.keys(this.stationsDelivered).length;
+    if (this.expectedStations > 0 && delivered >= this.expectedStations) {
+      this.mark('stations received');
+    } else {
+      this.configTimedOut = true;
+      this.mark('config timeout, ' + state.stations + ' saved or default stations');
+    }
+  }
+
+  var sameRequest = state.request === before.request;
+  if (state.load !== before.load || !sameRequest) {
+    switch (state.load) {
+      case LOAD_STATE.FETCHING:
+        this.mark('request ' + state.request + ' acknowledged');
+        break;
+      case LOAD_STATE.RECEIVING:
+        this.compactRows = false;
+        this.mark('count ' + state.departures);
+        break;
+      case LOAD_STATE.THROTTLED:
+        this.mark(state.failed ? 'throttled, phone gave up' :
+                  'throttled, phone retries in ' + this.retryAfter + ' s');
+        break;
+      case LOAD_STATE.COMPLETE:
+        if (before.load !== LOAD_STATE.RECEIVING && !state.offline) {
+          this.mark('count ' + state.departures);
+        }
+        this.complete(state);
+        break;
+      case LOAD_STATE.ERROR:
+        this.mark('request ' + state.request + ' timed out');
+        break;
+    }
+  }
+
+  if (state.filled > 0 && !(sameRequest && before.filled > 0) && !state.offline) {
+    if (state.full < state.filled) {
+      this.compactRows = true;
+      this.mark('first rows shown (' + state.filled + ')');
+    } else {
+      this.mark('first departure');
+    }
+  }
+
+  if (this.compactRows && state.departures > 0 && state.full === state.departures &&
+      before.full < state.departures && sameRequest) {
+    this.compactRows = false;
+    this.mark('details complete');
+    if (this.onDetailsComplete) {
+      this.onDetailsComplete();
+    }
+  }
+
+  if (state.alerts !== before.alerts && (state.alerts > 0 || before.alerts > 0)) {
+    this.mark('alerts ' + state.alerts + ', rows 0x' + this.alertRows.toString(16));
+  }
+};
+
+Watch.prototype.complete = function(state) {
+  var what = this.background ? 'glance updated' :
+             state.offline ? 'offline list shown' : 'menu complete';
+  this.mark(what + ' (' + state.departures + ' departures, request ' + state.request + ')');
+  this.background = false;
+  if (this.onComplete) {
+    this.onComplete();
+  }
+};
+
+// Fresh pkjs modules and mocks for one scenario
+function createPhone(link, baseUrl, storage, verbose) {
+  Object.keys(require.cache).forEach(function(file) {
+    if (file.indexOf(pkjsDir) === 0) {
+      delete require.cache[file];
+    }
+  });
+
+  var listeners = {};
+  // Set once the scenario is over: late iRail answers and messages are dropped
+  var closed = false;
+  global.Pebble = {
+    addEventListener: function(name, fn) {
+      (listeners[name] = listeners[name] || []).push(fn);
+    },
+    sendAppMessage: function(dict, onAck, onNack) {
+      if (closed) {
+        return;
+      }
+      link.send('toWatch', dict, onAck ? function() { onAck({ data: dict }); } : null,
+                onNack ? function(reason) { onNack({ data: dict, error: { message: reason } }); } : null);
+    },
+    openURL: function() {}
+  };
+
+  global.localStorage = {
+    getItem: function(key) { return storage.hasOwnProperty(key) ? storage[key] : null; },
+    setItem: function(key, value) { storage[key] = String(value); },
+    removeItem: function(key) { delete storage[key]; }
+  };
+
+  // iRail requests go to the mock upstream
+  global.XMLHttpRequest = function() {
+    this.readyState = 0;
+    this.status = 0;
+    this.responseText = '';
+    this.timeout = 0;
+  };
+  global.XMLHttpRequest.prototype.open = function(method, url) {
+    this.method = method;
+    this.url = url.replace(/^https?:\/\/api\.irail\.be/, baseUrl);
+  };
+  global.XMLHttpRequest.prototype.getResponseHeader = function(name) {
+    return (this.responseHeaders && this.responseHeaders[name.toLowerCase()]) || null;
+  };
+  global.XMLHttpRequest.prototype.setRequestHeader = function(name, value) {
+    this.requestHeaders = this.requestHeaders || {};
+    this.requestHeaders[name] = value;
+  };
+  global.XMLHttpRequest.prototype.send = function() {
+    var xhr = this;
+    if (closed) {
+      return;
+    }
+    function finish(status, body) {
+      if (closed) {
+        return;
+      }
+      xhr.readyState = 4;
+      xhr.status = status;
+      xhr.responseText = body;
+      if (xhr.onreadystatechange) {
+        xhr.onreadystatechange();
+      }
+      if (status === 0) {
+        if (xhr.onerror) {
+          xhr.onerror();
+        }
+      } else if (xhr.onload) {
+        xhr.onload();
+      }
+    }
+    if (!/^http:/.test(this.url)) {
+      setTimeout(function() { finish(0, ''); }, 0);
+      return;
+    }
+    var request = http.get(this.url, { headers: this.requestHeaders || {} }, function(response) {
+      xhr.responseHeaders = response.headers;
+      var chunks = [];
+      response.on('data', function(chunk) { chunks.push(chunk); });
+      response.on('end', function() { finish(response.statusCode, Buffer.concat(chunks).toString('utf8')); });
+    });
+    request.on('error', function() { finish(0, ''); });
+  };
+
+  if (!verbose) {
+    storage.nmbs_log_level = storage.nmbs_log_level || 'error';
+  }
+  require(path.join(pkjsDir, 'index.js'));
+
+  return {
+    emit: function(name, event) {
+      (listeners[name] || []).forEach(function(fn) { fn(event || {}); });
+    },
+    close: function() {
+      closed = true;
+    },
+    constants: require(path.join(pkjsDir, '00-constants.js')),
+    log: require(path.join(pkjsDir, '00-log.js'))
+  };
+}
+
+// Saved favorites and station cache, as after a first configuration
+function seededStorage() {
+  var stations = [
+    { id: 'BE.NMBS.008813003', name: 'Brussels-Central', lat: 50.845658, lon: 4.356801 },
+    { id: 'BE.NMBS.008821006', name: 'Antwerp-Central', lat: 51.2172, lon: 4.421101 },
+    { id: 'BE.NMBS.008892007', name: 'Ghent-Sint-Pieters', lat: 51.035896, lon: 3.710675 }
+  ];
+  return {
+    nmbs_station_cache: JSON.stringify(stations),
+    nmbs_favorite_stations: JSON.stringify(stations.map(function(s) { return s.id; }))
+  };
+}
+
+// Favorites Brussels and Antwerp as station groups (00-constants.js), plus
+// Ghent; the member stations are in the cache. Traced, for the group fetch.
+function groupStorage() {
+  var storage = seededStorage();
+  var stations = JSON.parse(storage.nmbs_station_cache).concat([
+    { id: 'BE.NMBS.008812005', name: 'Brussels-North', lat: 50.859663, lon: 4.360846 },
+    { id: 'BE.NMBS.008814001', name: 'Brussels-South', lat: 50.835707, lon: 4.336531 },
+    { id: 'BE.NMBS.008821121', name: 'Antwerp-Berchem', lat: 51.19923, lon: 4.432221 }
+  ]);
+  storage.nmbs_station_cache = JSON.stringify(stations);
+  storage.nmbs_favorite_stations = JSON.stringify(['GROUP.BRUSSELS', 'GROUP.ANTWERP', 'BE.NMBS.008892007']);
+  storage.nmbs_trace_enabled = '1';
+  return storage;
+}
+
+var SCENARIOS = {
+  'cold-start': function(sim, done) {
+    sim.watch.boot();
+    // PebbleKit JS comes up a little after the watch app
+    setTimeout(function() { sim.phone.emit('ready'); }, 300);
+    sim.watch.onComplete = done;
+  },
+
+  'route-toggle': function(sim, done) {
+    sim.watch.boot();
+    setTimeout(function() { sim.phone.emit('ready'); }, 300);
+    sim.watch.onComplete = function() {
+      sim.watch.onComplete = null;
+      var toggles = 0;
+      (function toggle() {
+        sim.watch.toggleDestination();
+        if (++toggles < 5) {
+          setTimeout(toggle, 150);
+          return;
+        }
+        sim.watch.mark('last toggle');
+        sim.watch.onComplete = function() {
+          // Let superseded lists drain so their stale messages are counted
+          setTimeout(done, 1000);
+        };
+      })();
+    };
+  },
+
+  'background-wake': function(sim, done) {
+    sim.watch.boot('worker');
+    sim.watch.workerWake();
+    setTimeout(function() { sim.phone.emit('ready'); }, 300);
+    sim.watch.onComplete = done;
+  },
+
+  'throttled': {
+    irailRateLimit: 0.5,
+    run: function(sim, done) {
+      sim.watch.boot();
+      setTimeout(function() { sim.phone.emit('ready'); }, 300);
+      sim.watch.onComplete = done;
+    }
+  },
+
+  'station-group': {
+    storage: groupStorage,
+    run: function(sim, done) {
+      sim.watch.boot();
+      setTimeout(function() { sim.phone.emit('ready'); }, 300);
+      sim.watch.onComplete = function() {
+        sim.phone.log.getTrace().forEach(function(entry) {
+          if (entry.event === 'group_done') {
+            sim.watch.mark('phone: ' + entry.fields.pairs + ' member pairs fetched ' +
+                           (entry.fields.sequential ? 'sequentially' : 'in parallel') + ' in ' +
+                           entry.fields.ms + ' ms');
+          }
+        });
+        done();
+      };
+    }
+  },
+
+  'stops-failed': {
+    run: function(sim, done) {
+      sim.watch.boot();
+      setTimeout(function() { sim.phone.emit('ready'); }, 300);
+      sim.watch.onComplete = function() {
+        sim.watch.onComplete = null;
+        var departures = sim.watch.state.departures;
+        sim.link.failures.REQUEST_STOPS = 1;
+        // Once the alerts are in the menu no longer moves under the clicks;
+        // then scroll the detail window once the lost request came back failed
+        var opened = false;
+        var poll = setInterval(function() {
+          if (!opened && sim.watch.state.alerts > 0 && sim.link.quiet('toWatch')) {
+            opened = true;
+            sim.watch.openFirstDeparture();
+          } else if (opened && sim.link.failures.REQUEST_STOPS === 0 && sim.link.quiet('toPhone')) {
+            clearInterval(poll);
+            sim.watch.click('down');
+          }
+        }, 100);
+        sim.watch.onStop = function(dict) {
+          sim.watch.onStop = null;
+          var state = sim.watch.state;
+          if (dict.STOP_INDEX === undefined) {
+            sim.failures.push('stops unavailable');
+          }
+          if (state.failed || state.departures !== departures) {
+            sim.failures.push('departure list changed (failed=' + state.failed + ', ' +
+                              state.departures + ' departures)');
+          }
+          done();
+        };
+      };
+    }
+  },
+
+  'weak-link': {
+    link: { latency: 300, jitter: 100, drop: 0.1, bandwidth: 1500 },
+    run: function(sim, done) {
+      sim.watch.boot();
+      setTimeout(function() { sim.phone.emit('ready'); }, 300);
+      sim.watch.onDetailsComplete = done;
+      // The phone doesn't resend dropped details: once it has stopped
+      // sending, report how many rows got theirs
+      sim.watch.onComplete = function() {
+        var quietSince = null;
+        var poll = setInterval(function() {
+          if (!sim.link.quiet('toWatch')) {
+            quietSince = null;
+          } else if (quietSince === null) {
+            quietSince = Date.now();
+          } else if (Date.now() - quietSince >= DETAILS_QUIET_MS) {
+            clearInterval(poll);
+            sim.watch.mark('details stopped (' + sim.watch.state.full + ' of ' +
+                           sim.watch.state.departures + ' rows)');
+            done();
+          }
+        }, 100);
+        sim.watch.onDetailsComplete = function() {
+          clearInterval(poll);
+          done();
+        };
+      };
+    }
+  }
+};
+
+function scenarioRun(name) {
+  return typeof SCENARIOS[name] === 'function' ? SCENARIOS[name] : SCENARIOS[name].run;
+}
+
+// Scenario link settings over the command line ones
+function scenarioOptions(name, options) {
+  var merged = {};
+  Object.keys(options).forEach(function(key) { merged[key] = options[key]; });
+  var link = SCENARIOS[name].link || {};
+  Object.keys(link).forEach(function(key) { merged[key] = link[key]; });
+  return merged;
+}
+
+function report(name, sim, irail, failures) {
+  console.log('\n== ' + name + (failures.length ? ' FAILED (' + failures.join(', ') + ')' : ''));
+  if (SCENARIOS[name].link) {
+    var link = sim.link.options;
+    console.log('  link: ' + link.latency + ' ms +' + link.jitter + ' ms each way, ' +
+                link.bandwidth + ' B/s, drop rate ' + link.drop);
+  }
+  sim.watch.milestones.forEach(function(milestone) {
+    console.log('  ' + String(Math.round(milestone.ms)).padStart(6) + ' ms  ' + milestone.name);
+  });
+  ['toWatch', 'toPhone'].forEach(function(direction) {
+    var stats = sim.link.stats[direction];
+    var total = { count: 0, bytes: 0 };
+    var parts = Object.keys(stats).sort().map(function(type) {
+      total.count += stats[type].count;
+      total.bytes += stats[type].bytes;
+      return type + ' ' + stats[type].count;
+    });
+    console.log('  ' + (direction === 'toWatch' ? 'phone -> watch' : 'watch -> phone') + ': ' +
+                total.count + ' messages, ' + total.bytes + ' B (' + parts.join(', ') + ')');
+  });
+  console.log('  iRail requests: ' + irail.requests + ' (' + irail.throttled +
+              ' answered 429), stale messages ignored: ' +
+              sim.watch.staleIgnored + ', rejected: ' + sim.link.stats.rejected +
+              ', dropped: ' + sim.link.stats.dropped);
+  console.log('  menu reloads: ' + sim.watch.menuReloads + ', redraws: ' + sim.watch.menuRedraws +
+              ', glance reloads: ' + sim.watch.glanceReloads);
+}
+
+function runScenario(name, options, upstream, baseUrl, callback) {
+  seed = SEED;
+  var start = process.hrtime();
+  function now() {
+    var elapsed = process.hrtime(start);
+    return elapsed[0] * 1000 + elapsed[1] / 1e6;
+  }
+  function log(message) {
+    if (options.verbose) {
+      console.log('[' + Math.round(now()) + ' ms] ' + message);
+    }
+  }
+
+  var typeNames = {};
+  // Scenarios add what they found wrong
+  var sim = { failures: [] };
+  sim.link = new Link(scenarioOptions(name, options), now, function(type) { return typeNames[type] || String(type); });
+  sim.phone = createPhone(sim.link, baseUrl, (SCENARIOS[name].storage || seededStorage)(),
+                          options.verbose);
+  sim.phone.constants.CONFIG.GROUP_FETCH_SEQUENTIAL = options['sequential-groups'];
+  Object.keys(sim.phone.constants.MESSAGE_TYPES).forEach(function(key) {
+    typeNames[sim.phone.constants.MESSAGE_TYPES[key]] = key;
+  });
+  sim.watch = new Watch(sim.link, now, log, options);
+
+  sim.link.receivers.toWatch = function(dict) { sim.watch.receive(dict); };
+  sim.link.receivers.toPhone = function(dict) { sim.phone.emit('appmessage', { payload: dict }); };
+
+  var requestsBefore = upstream.stats.requests;
+  var throttledBefore = upstream.stats.throttled;
+  upstream.setRateLimit(SCENARIOS[name].irailRateLimit || 0);
+  var finished = false;
+  function finish(timedOut) {
+    if (finished) {
+      return;
+    }
+    finished = true;
+    realClearTimeout(guard);
+    sim.link.close();
+    sim.phone.close();
+    var failures = sim.failures.slice();
+    if (timedOut) {
+      failures.push('did not complete');
+    }
+    if (sim.watch.configTimedOut) {
+      failures.push('config timeout');
+    }
+    if (failures.length) {
+      process.exitCode = 1;
+    }
+    report(name, sim, { requests: upstream.stats.requests - requestsBefore,
+                        throttled: upstream.stats.throttled - throttledBefore }, failures);
+    clearAllTimers();
+    sim.watch.quit(callback);
+  }
+  var guard = realSetTimeout(function() { finish(true); }, 30000);
+  scenarioRun(name)(sim, function() { finish(false); });
+}
+
+var options = parseArgs(process.argv.slice(2));
+var names = options.scenario === 'all' ? Object.keys(SCENARIOS) : [options.scenario];
+names.forEach(function(name) {
+  if (!SCENARIOS[name]) {
+    console.error('Unknown scenario: ' + name + ' (' + Object.keys(SCENARIOS).join(', ') + ')');
+    process.exit(1);
+  }
+});
+
+// Build the watch app for the host (a no-op when it is up to date); another
+// checkout gets its own build directory
+var makeArgs = ['-C', HOST_DIR];
+var build = 'build';
+if (options.tree !== path.resolve(ROOT_DIR)) {
+  build = 'build-' + path.basename(options.tree).replace(/[^\w.-]/g, '_');
+  makeArgs.push('SRC=' + path.join(options.tree, 'src/c'), 'BUILD=' + build);
+}
+pkjsDir = path.join(options.tree, 'src/pkjs');
+hostBinary = path.join(HOST_DIR, build, 'nmbs_host');
+LOAD_STATE = readLoadStates(path.join(options.tree, 'src/c/types.h'));
+try {
+  childProcess.execFileSync('make', makeArgs, { stdio: ['ignore', 'ignore', 'inherit'] });
+} catch (e) {
+  console.error('Host build of the watch app failed (make ' + makeArgs.join(' ') + ')');
+  process.exit(1);
+}
+
+var upstream = MockIRail.createMockUpstream({ latency: options['irail-latency'] });
+upstream.listen(0, function() {
+  var baseUrl = 'http://localhost:' + upstream.address().port;
+  console.log('Link: ' + options.latency + ' ms +' + options.jitter + ' ms each way, MTU ' +
+              options.mtu + ' B, ' + (options.bandwidth || 'unlimited') + ' B/s, drop rate ' +
+              options.drop + '; iRail mock ' +
+              options['irail-latency'] + ' ms');
+  (function next(index) {
+    if (index >= names.length) {
+      // Requests still in flight lost their answer timers with the scenario
+      upstream.closeAllConnections();
+      upstream.close();
+      return;
+    }
+    runScenario(names[index], options, upstream, baseUrl, function() { next(index + 1); });
+  })(0);
+});
@@ -0,0 +1,37 @@
+#include "alerts.h"
+#include "state.h"
+#include "log.h"
+
+typedef struct {
+  char title[ALERT_TITLE_LEN];
+  uint8_t flags;
+} Alert;
+
+static Alert s_alerts[ALERTS_MAX];
+static uint8_t s_count = 0;
+
+void alerts_store(const uint8_t *data, uint16_t length) {
+  s_count = 0;
+  uint8_t count = length >= 1 ? data[0] : 0;
+  uint16_t pos = 1;
+  while (s_count < count && s_count < ALERTS_MAX && pos < length) {
+    Alert *alert = &s_alerts[s_count];
+    alert->flags = data[pos++];
+    const uint8_t *end = memchr(&data[pos], '\0', length - pos);
+    if (!end) break;
+    size_t len = end - &data[pos];
+    if (len >= sizeof(alert->title)) len = sizeof(alert->title) - 1;
+    memcpy(alert->title, &data[pos], len);
+    alert->title[len] = '\0';
+    pos = (end - data) + 1;
+    s_count++;
+  }
+  LOG_INFO("Stored %d alerts", s_count);
+  state_mark_alerts_changed();
+}
+
+uint8_t alerts_get_count(void) { return s_count; }
+
+const char* alerts_get_title(uint8_t index) { return s_alerts[index].title; }
+
+bool alerts_is_planned(uint8_t index) { return (s_alerts[index].flags & ALERT_FLAG_PLANNED) != 0; }
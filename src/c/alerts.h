@@ -0,0 +1,25 @@
+#pragma once
+
+#include <pebble.h>
+#include "types.h"
+
+// Disruption alerts from the phone.
+//
+// The phone follows iRail's disturbances feed and pushes the ones touching
+// the favorite stations or the trains on screen (MSG_ALERTS), only when
+// that set changes. The watch keeps the latest summaries for the menu;
+// rows of affected trains carry their own has_alert flag.
+//
+// Alert blob (ALERT_DATA), at most ALERTS_MAX alerts:
+//   u8  alert count
+//   per alert: u8 flags (bit 0 planned works), UTF-8 title NUL-terminated
+
+#define ALERT_FLAG_PLANNED 0x01
+
+// Replace the summaries with a received blob (an empty or invalid one
+// clears them)
+void alerts_store(const uint8_t *data, uint16_t length);
+
+uint8_t alerts_get_count(void);
+const char* alerts_get_title(uint8_t index);
+bool alerts_is_planned(uint8_t index);
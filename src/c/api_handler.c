@@ -1,24 +1,130 @@
 #include "api_handler.h"
 #include "state.h"
 #include "detail_window.h"
-#include "glances.h"
+#include "trace.h"
+#include "diagnostics.h"
+#include "energy.h"
+#include "snapshot.h"
+#include "countdown.h"
+#include "stop_list.h"
+#include "schedule.h"
+#include "station_dict.h"
+#include "dashboard.h"
+#include "alerts.h"
+#include "utils.h"
+#include "log.h"
+
+// Requests the user is waiting for that found the outbox busy; sent from
+// the outbox callbacks as soon as it is free, ahead of any report
+typedef enum {
+  PENDING_TRAIN_DATA = 1 << 0,
+  PENDING_DETAIL = 1 << 1,
+  PENDING_STOP_TRACKING = 1 << 2,
+  PENDING_STATION_DICT = 1 << 3,
+  PENDING_DASHBOARD = 1 << 4,
+} PendingRequest;
+
+static uint8_t s_pending = 0;
+
+// Detail request whose journey tracking a queued stop message ends
+static uint32_t s_stop_tracking_id = 0;
+
+// Station dictionary block a queued request asks for
+static uint8_t s_station_dict_block = 0;
+
+// Dashboard request a queued message carries
+static uint32_t s_dashboard_request_id = 0;
+
+// Trace and energy reports go out once this expires without a new request
+static AppTimer *s_report_timer = NULL;
+
+static void flush_outbox(void);
+
+static void report_timer_callback(void *data) {
+  s_report_timer = NULL;
+  flush_outbox();
+}
+
+// (Re)start the quiet period before reports may use the outbox
+static void schedule_reports(void) {
+  if (s_report_timer) {
+    app_timer_cancel(s_report_timer);
+  }
+  s_report_timer = app_timer_register(REPORT_DELAY_MS, report_timer_callback, NULL);
+}
+
+// A request finished: queue its trace behind anything the user asks next
+static void queue_trace(uint32_t request_id) {
+  trace_queue(request_id);
+  schedule_reports();
+}
+
+// Origin the phone located (station index), applied once all stations arrived
+#define LOCATED_ORIGIN_NONE 0xFF
+static uint8_t s_located_origin = LOCATED_ORIGIN_NONE;
+
+// Start from the station the phone is at; when that is the destination,
+// the route is reversed
+static void apply_located_origin(void) {
+  uint8_t origin = s_located_origin;
+  s_located_origin = LOCATED_ORIGIN_NONE;
+  if (origin == LOCATED_ORIGIN_NONE ||
+      (origin >= state_get_num_stations() && origin != SEARCHED_FROM_STATION_INDEX)) {
+    return;
+  }
 
-// Menu layer reference (needed for reload)
-static MenuLayer *s_menu_layer = NULL;
+  uint8_t from = state_get_from_station_index();
+  if (origin == state_get_to_station_index()) {
+    state_set_to_station_index(from != origin ? from : (origin + 1) % state_get_num_stations());
+  }
+  state_set_from_station_index(origin);
+  LOG_INFO("Located origin: %s", state_get_stations()[origin].name);
+}
 
 // Config timeout callback - fallback to defaults if no config received
 static void config_timeout_callback(void *data) {
   state_set_config_timeout_timer(NULL);
 
-  // If stations haven't been received yet, fall back to defaults
+  // If stations haven't been received yet, fall back to the last saved
+  // favorites, or the defaults if there are none
   if (!state_are_stations_received()) {
-    APP_LOG(APP_LOG_LEVEL_WARNING, "Config timeout - falling back to default stations");
-    state_load_default_stations();
-    menu_layer_reload_data(s_menu_layer);
+    if (state_load_saved_stations()) {
+      LOG_WARNING("Config timeout - using saved stations");
+    } else {
+      LOG_WARNING("Config timeout - falling back to default stations");
+      state_load_default_stations();
+    }
+    schedule_apply_active_route();
 
     // Request initial train data with default stations
-    api_handler_request_train_data();
+    api_handler_refresh();
+  }
+}
+
+// Show the active route's schedule snapshot instead of live data.
+// Returns false if there is no usable snapshot.
+static bool serve_snapshot(void) {
+  if (!snapshot_load_active_route()) {
+    return false;
+  }
+
+  AppTimer *timer = state_get_timeout_timer();
+  if (timer) {
+    app_timer_cancel(timer);
+    state_set_timeout_timer(NULL);
   }
+
+  state_set_load_state(LOAD_STATE_COMPLETE);
+  state_set_data_loading(false);
+  state_set_data_failed(false);
+  state_set_data_offline(true);
+
+  countdown_refresh();
+
+  // Glances update now; the menu skips changes made for a background update
+  state_flush_changes();
+  state_set_background_update(false);
+  return true;
 }
 
 // Timeout watchdog callback
@@ -26,27 +132,27 @@ static void loading_timeout_callback(void *data) {
   state_set_timeout_timer(NULL);
 
   if (state_get_load_state() == LOAD_STATE_CONNECTING ||
-      state_get_load_state() == LOAD_STATE_FETCHING) {
-    APP_LOG(APP_LOG_LEVEL_WARNING, "Loading timeout - transitioning to ERROR state");
+      state_get_load_state() == LOAD_STATE_FETCHING ||
+      state_get_load_state() == LOAD_STATE_THROTTLED) {
+    if (serve_snapshot()) {
+      LOG_WARNING("Loading timeout - showing schedule snapshot");
+      queue_trace(state_get_last_data_request_id());
+      return;
+    }
+
+    LOG_WARNING("Loading timeout - transitioning to ERROR state");
     state_set_load_state(LOAD_STATE_ERROR);
     state_set_data_loading(false);
     state_set_data_failed(true);
-    menu_layer_reload_data(s_menu_layer);
+    queue_trace(state_get_last_data_request_id());
   }
 }
 
-// Request train data from JavaScript
-void api_handler_request_train_data(void) {
-  if (state_get_num_stations() == 0) {
-    APP_LOG(APP_LOG_LEVEL_WARNING, "Cannot request data: no stations loaded");
-    return;
-  }
-
-  // Generate unique request ID
-  state_increment_data_request_id();
-
+static bool send_train_data_request(void) {
   DictionaryIterator *iter;
-  app_message_outbox_begin(&iter);
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    return false;
+  }
 
   Station *stations = state_get_stations();
   dict_write_uint8(iter, MESSAGE_KEY_MESSAGE_TYPE, MSG_REQUEST_DATA);
@@ -55,8 +161,37 @@ void api_handler_request_train_data(void) {
   dict_write_cstring(iter, MESSAGE_KEY_TO_STATION_ID,
                      stations[state_get_to_station_index()].irail_id);
   dict_write_uint32(iter, MESSAGE_KEY_REQUEST_ID, state_get_last_data_request_id());
+  if (state_is_background_update()) {
+    dict_write_uint8(iter, MESSAGE_KEY_IS_BACKGROUND, 1);
+  }
 
   app_message_outbox_send();
+  return true;
+}
+
+// Request train data from JavaScript
+void api_handler_request_train_data(void) {
+  if (state_get_num_stations() == 0) {
+    LOG_WARNING("Cannot request data: no stations loaded");
+    return;
+  }
+
+  // Without a phone there's no point waiting for the timeout
+  if (!connection_service_peek_pebble_app_connection() && serve_snapshot()) {
+    LOG_INFO("Phone not connected, showing schedule snapshot");
+    return;
+  }
+
+  // Generate unique request ID
+  state_increment_data_request_id();
+  schedule_reports();
+
+  if (!send_train_data_request()) {
+    // Goes out with the latest request ID once the outbox is free; the
+    // timeout below still covers it
+    LOG_WARNING("Outbox busy, data request queued");
+    s_pending |= PENDING_TRAIN_DATA;
+  }
 
   // Update state machine
   state_set_load_state(LOAD_STATE_CONNECTING);
@@ -71,12 +206,71 @@ void api_handler_request_train_data(void) {
   }
   state_set_timeout_timer(app_timer_register(LOADING_TIMEOUT_MS, loading_timeout_callback, NULL));
 
-  menu_layer_reload_data(s_menu_layer);
+  Station *stations = state_get_stations();
+  LOG_INFO("Requesting data [ID %lu]: %s -> %s",
+           (unsigned long)state_get_last_data_request_id(),
+           stations[state_get_from_station_index()].name,
+           stations[state_get_to_station_index()].name);
+}
+
+static bool send_dashboard_request(void) {
+  uint8_t routes[2 + DASHBOARD_MAX_ROUTES];
+  uint16_t length = dashboard_get_routes_blob(routes, sizeof(routes));
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    return false;
+  }
+  dict_write_uint8(iter, MESSAGE_KEY_MESSAGE_TYPE, MSG_REQUEST_DASHBOARD);
+  dict_write_data(iter, MESSAGE_KEY_DASHBOARD_ROUTES, routes, length);
+  dict_write_uint32(iter, MESSAGE_KEY_REQUEST_ID, s_dashboard_request_id);
+  app_message_outbox_send();
+  return true;
+}
+
+// Request all dashboard routes from JavaScript (answered route by route)
+void api_handler_request_dashboard(void) {
+  if (!dashboard_is_available()) {
+    LOG_WARNING("Cannot request dashboard: no usable routes");
+    return;
+  }
+
+  s_dashboard_request_id = dashboard_begin_request();
+  schedule_reports();
+
+  if (!send_dashboard_request()) {
+    // Goes out with the latest request ID once the outbox is free; the
+    // dashboard timeout still covers it
+    LOG_WARNING("Outbox busy, dashboard request [ID %lu] queued",
+                (unsigned long)s_dashboard_request_id);
+    s_pending |= PENDING_DASHBOARD;
+    return;
+  }
+
+  LOG_INFO("Requesting dashboard [ID %lu]: %d routes", (unsigned long)s_dashboard_request_id,
+           dashboard_get_route_count());
+}
 
-  APP_LOG(APP_LOG_LEVEL_INFO, "Requesting data [ID %lu]: %s -> %s",
-          (unsigned long)state_get_last_data_request_id(),
-          stations[state_get_from_station_index()].name,
-          stations[state_get_to_station_index()].name);
+// Request what the main menu shows
+void api_handler_refresh(void) {
+  if (dashboard_is_shown()) {
+    api_handler_request_dashboard();
+  } else {
+    api_handler_request_train_data();
+  }
+}
+
+static bool send_detail_request(void) {
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    return false;
+  }
+  dict_write_uint8(iter, MESSAGE_KEY_MESSAGE_TYPE, MSG_REQUEST_DETAILS);
+  // Rows dropped by the countdown are still in the phone's list
+  dict_write_uint8(iter, MESSAGE_KEY_DEPARTURE_INDEX,
+                   state_get_selected_departure_index() + state_get_departures_removed());
+  dict_write_uint32(iter, MESSAGE_KEY_REQUEST_ID, state_get_last_detail_request_id());
+  app_message_outbox_send();
+  return true;
 }
 
 // Request detail data for selected departure
@@ -84,39 +278,174 @@ void api_handler_request_detail_data(void) {
   uint16_t index = state_get_selected_departure_index();
   TrainDeparture *departure = &state_get_departures()[index];
 
-  APP_LOG(APP_LOG_LEVEL_INFO, "Selected train to %s", departure->destination);
+  LOG_INFO("Selected train to %s", departure->destination);
 
   // Generate unique request ID for detail request
   state_increment_detail_request_id();
 
   // Request fresh details from JavaScript
   state_set_detail_received(false);
+  stop_list_reset();
+  schedule_reports();
+
+  if (send_detail_request()) {
+    LOG_INFO("Detail request [ID %lu] sent for departure %d",
+             (unsigned long)state_get_last_detail_request_id(), index);
+  } else {
+    LOG_WARNING("Outbox busy, detail request [ID %lu] queued",
+                (unsigned long)state_get_last_detail_request_id());
+    s_pending |= PENDING_DETAIL;
+  }
+
+  // Show detail window
+  detail_window_show();
+}
 
+// Request a page of intermediate stops for a leg of the shown journey
+bool api_handler_request_stops(uint8_t leg_index, uint8_t first_stop) {
   DictionaryIterator *iter;
-  app_message_outbox_begin(&iter);
-  dict_write_uint8(iter, MESSAGE_KEY_MESSAGE_TYPE, MSG_REQUEST_DETAILS);
-  dict_write_uint8(iter, MESSAGE_KEY_DEPARTURE_INDEX, index);
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    LOG_WARNING("Outbox busy, stops of leg %d not requested", leg_index);
+    return false;
+  }
+  dict_write_uint8(iter, MESSAGE_KEY_MESSAGE_TYPE, MSG_REQUEST_STOPS);
+  dict_write_uint8(iter, MESSAGE_KEY_LEG_INDEX, leg_index);
+  dict_write_uint8(iter, MESSAGE_KEY_STOP_INDEX, first_stop);
   dict_write_uint32(iter, MESSAGE_KEY_REQUEST_ID, state_get_last_detail_request_id());
   app_message_outbox_send();
 
-  APP_LOG(APP_LOG_LEVEL_INFO, "Detail request [ID %lu] sent for departure %d",
-          (unsigned long)state_get_last_detail_request_id(), index);
+  LOG_DEBUG("Requested stops %d+ of leg %d", first_stop, leg_index);
+  return true;
+}
 
-  // Show detail window
-  detail_window_show();
+static bool send_station_dict_request(void) {
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    return false;
+  }
+  dict_write_uint8(iter, MESSAGE_KEY_MESSAGE_TYPE, MSG_REQUEST_STATION_DICT);
+  dict_write_uint8(iter, MESSAGE_KEY_STATION_DICT_BLOCK, s_station_dict_block);
+  app_message_outbox_send();
+  return true;
+}
+
+// Request a block of the station dictionary (queued if the outbox is busy)
+void api_handler_request_station_dict(uint8_t block) {
+  s_station_dict_block = block;
+  schedule_reports();
+  if (send_station_dict_request()) {
+    LOG_DEBUG("Requested station dictionary block %d", block);
+  } else {
+    LOG_WARNING("Outbox busy, station dictionary block %d queued", block);
+    s_pending |= PENDING_STATION_DICT;
+  }
+}
+
+static bool send_stop_tracking(void) {
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    return false;
+  }
+  dict_write_uint8(iter, MESSAGE_KEY_MESSAGE_TYPE, MSG_STOP_TRACKING);
+  dict_write_uint32(iter, MESSAGE_KEY_REQUEST_ID, s_stop_tracking_id);
+  app_message_outbox_send();
+  return true;
+}
+
+// Tell the phone to stop tracking the journey (detail window closed).
+// Without it the phone keeps polling the journey's vehicles, so a busy
+// outbox queues it rather than dropping it.
+void api_handler_stop_tracking(void) {
+  s_stop_tracking_id = state_get_last_detail_request_id();
+  if (!send_stop_tracking()) {
+    LOG_WARNING("Outbox busy, stop tracking [ID %lu] queued", (unsigned long)s_stop_tracking_id);
+    s_pending |= PENDING_STOP_TRACKING;
+  }
+}
+
+// The last row of the departure list arrived: show it
+static void complete_departures(void) {
+  state_set_load_state(LOAD_STATE_COMPLETE);
+  state_set_data_loading(false);
+
+  // Cancel timeout timer
+  AppTimer *timer = state_get_timeout_timer();
+  if (timer) {
+    app_timer_cancel(timer);
+    state_set_timeout_timer(NULL);
+  }
+
+  LOG_INFO("All departures received");
+  diag_heap_sample(DIAG_PHASE_DEPARTURES);
+
+  // Drop trains that left while the list was on its way
+  countdown_refresh();
+
+  // Glances and menu update now, so the trace includes the menu reload
+  state_flush_changes();
+
+  if (state_is_background_update()) {
+    // Background update - the menu ignored it, just exit
+    LOG_INFO("Background glance update complete, exiting");
+    state_set_background_update(false);
+    // App will exit naturally when window stack is empty
+  } else {
+    trace_menu_reload(state_get_last_data_request_id());
+  }
+
+  queue_trace(state_get_last_data_request_id());
+}
+
+// Store rows in the compact form (utils.h) from a list index on; their
+// destinations follow in MSG_DEPARTURE_DETAILS. Returns the index of the
+// last row stored, -1 if none.
+static int16_t store_compact_rows(uint8_t index, const uint8_t *data, uint16_t length) {
+  int16_t last = -1;
+  uint16_t pos = 0;
+  CompactDeparture row;
+  while (index < state_get_num_departures() && index < MAX_DEPARTURES &&
+         read_compact_departure(data, length, &pos, &row)) {
+    TrainDeparture *dep = &state_get_departures()[index];
+    time_t arrive = row.depart_timestamp + row.duration * 60;
+    dep->depart_timestamp = row.depart_timestamp;
+    strftime(dep->depart_time, sizeof(dep->depart_time), "%H:%M", localtime(&row.depart_timestamp));
+    strftime(dep->arrive_time, sizeof(dep->arrive_time), "%H:%M", localtime(&arrive));
+    format_duration(row.duration, dep->duration, sizeof(dep->duration));
+    strncpy(dep->platform, row.platform, sizeof(dep->platform) - 1);
+    strncpy(dep->train_type, row.train_type, sizeof(dep->train_type) - 1);
+    dep->destination[0] = '\0';
+    dep->station_label[0] = '\0';
+    dep->depart_delay = row.depart_delay;
+    dep->arrive_delay = row.arrive_delay;
+    dep->is_direct = row.is_direct;
+    dep->platform_changed = row.platform_changed;
+    dep->has_alert = row.has_alert;
+    dep->minutes_left = COUNTDOWN_UNKNOWN;
+    dep->fill = DEPARTURE_FILL_CORE;
+    state_mark_departure_changed(index);
+    trace_departure(state_get_last_data_request_id(), index);
+    last = index++;
+  }
+  return last;
 }
 
 // AppMessage callbacks
 static void inbox_received_callback(DictionaryIterator *iterator, void *context) {
+  diag_message_received(iterator);
+
   // Read message type
   Tuple *message_type_tuple = dict_find(iterator, MESSAGE_KEY_MESSAGE_TYPE);
   if (!message_type_tuple) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "No message type");
+    LOG_ERROR("No message type");
     return;
   }
 
   uint8_t message_type = message_type_tuple->value->uint8;
 
+  EnergyFeature feature = energy_feature_for_message(message_type);
+  energy_count(feature, ENERGY_METRIC_MSG_IN, 1);
+  energy_count(feature, ENERGY_METRIC_BYTES_IN, dict_size(iterator));
+
   if (message_type == MSG_REQUEST_ACK) {
     // JavaScript acknowledged the request and is fetching from API
     Tuple *request_id_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_ID);
@@ -125,13 +454,12 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
 
       // Validate this acknowledgment is for our current request
       if (request_id == state_get_last_data_request_id()) {
-        APP_LOG(APP_LOG_LEVEL_INFO, "Request acknowledged [ID %lu], fetching from iRail...",
-                (unsigned long)request_id);
+        LOG_DEBUG("Request acknowledged [ID %lu], fetching from iRail...",
+                  (unsigned long)request_id);
         state_set_load_state(LOAD_STATE_FETCHING);
-        menu_layer_reload_data(s_menu_layer);
       } else {
-        APP_LOG(APP_LOG_LEVEL_WARNING, "Ignoring stale acknowledgment [ID %lu] (expected %lu)",
-                (unsigned long)request_id, (unsigned long)state_get_last_data_request_id());
+        LOG_WARNING("Ignoring stale acknowledgment [ID %lu] (expected %lu)",
+                    (unsigned long)request_id, (unsigned long)state_get_last_data_request_id());
       }
     }
   } else if (message_type == MSG_SEND_COUNT) {
@@ -144,15 +472,22 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
 
       // Validate this response is for our current request
       if (request_id != state_get_last_data_request_id()) {
-        APP_LOG(APP_LOG_LEVEL_WARNING, "Ignoring stale count [ID %lu] (expected %lu)",
-                (unsigned long)request_id, (unsigned long)state_get_last_data_request_id());
+        LOG_WARNING("Ignoring stale count [ID %lu] (expected %lu)",
+                    (unsigned long)request_id, (unsigned long)state_get_last_data_request_id());
         return;
       }
 
+      // Live data replaces any snapshot being shown; the phone's offline
+      // timetable answer is scheduled times, labelled like a snapshot
+      Tuple *offline_tuple = dict_find(iterator, MESSAGE_KEY_IS_OFFLINE);
+      state_set_data_offline(offline_tuple && offline_tuple->value->uint8);
       state_set_num_departures(count_tuple->value->uint8);
+      for (uint8_t i = 0; i < state_get_num_departures() && i < MAX_DEPARTURES; i++) {
+        state_get_departures()[i].fill = DEPARTURE_FILL_NONE;
+      }
       state_set_load_state(LOAD_STATE_RECEIVING);
-      APP_LOG(APP_LOG_LEVEL_INFO, "Expecting %d departures [ID %lu]",
-              state_get_num_departures(), (unsigned long)request_id);
+      LOG_DEBUG("Expecting %d departures [ID %lu]",
+                state_get_num_departures(), (unsigned long)request_id);
 
       if (state_get_num_departures() == 0) {
         state_set_load_state(LOAD_STATE_COMPLETE);
@@ -162,7 +497,9 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
           app_timer_cancel(timer);
           state_set_timeout_timer(NULL);
         }
-        menu_layer_reload_data(s_menu_layer);
+        state_flush_changes();
+        trace_menu_reload(request_id);
+        queue_trace(request_id);
       }
     }
   } else if (message_type == MSG_SEND_DEPARTURE) {
@@ -175,8 +512,8 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
     if (request_id_tuple) {
       uint32_t request_id = request_id_tuple->value->uint32;
       if (request_id != state_get_last_data_request_id()) {
-        APP_LOG(APP_LOG_LEVEL_WARNING, "Ignoring stale departure [ID %lu] (expected %lu)",
-                (unsigned long)request_id, (unsigned long)state_get_last_data_request_id());
+        LOG_WARNING("Ignoring stale departure [ID %lu] (expected %lu)",
+                    (unsigned long)request_id, (unsigned long)state_get_last_data_request_id());
         return;
       }
     }
@@ -184,7 +521,24 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
     uint8_t index = index_tuple->value->uint8;
     if (index >= MAX_DEPARTURES) return;
 
-    TrainDeparture *dep = &state_get_departures()[index];
+    // Weak link: several rows in compact form, destinations come later
+    Tuple *rows_tuple = dict_find(iterator, MESSAGE_KEY_DEPARTURE_ROWS);
+    if (rows_tuple) {
+      int16_t last = store_compact_rows(index, rows_tuple->value->data, rows_tuple->length);
+      LOG_DEBUG("Received compact departures %d-%d", index, last);
+      if (last >= 0 && last == state_get_num_departures() - 1) {
+        complete_departures();
+      }
+      return;
+    }
+
+    // Weak link: a row whose details were lost is resent whole, possibly
+    // after the list is complete and departed trains were dropped
+    bool list_complete = state_get_load_state() == LOAD_STATE_COMPLETE;
+    int16_t row = index - state_get_departures_removed();
+    if (row < 0 || row >= state_get_num_departures()) return;
+
+    TrainDeparture *dep = &state_get_departures()[row];
 
     // Read all fields
     Tuple *dest = dict_find(iterator, MESSAGE_KEY_DESTINATION);
@@ -198,6 +552,8 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
     Tuple *arrive_delay = dict_find(iterator, MESSAGE_KEY_ARRIVE_DELAY);
     Tuple *is_direct = dict_find(iterator, MESSAGE_KEY_IS_DIRECT);
     Tuple *platform_changed = dict_find(iterator, MESSAGE_KEY_PLATFORM_CHANGED);
+    Tuple *station_label = dict_find(iterator, MESSAGE_KEY_STATION_LABEL);
+    Tuple *has_alert = dict_find(iterator, MESSAGE_KEY_HAS_ALERT);
 
     // Copy string data
     if (dest) strncpy(dep->destination, dest->value->cstring, sizeof(dep->destination) - 1);
@@ -206,49 +562,92 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
     if (platform) strncpy(dep->platform, platform->value->cstring, sizeof(dep->platform) - 1);
     if (train_type) strncpy(dep->train_type, train_type->value->cstring, sizeof(dep->train_type) - 1);
     if (duration) strncpy(dep->duration, duration->value->cstring, sizeof(dep->duration) - 1);
+    dep->station_label[0] = '\0';
+    if (station_label) strncpy(dep->station_label, station_label->value->cstring, sizeof(dep->station_label) - 1);
 
     // Copy numeric data
     dep->depart_delay = depart_delay ? depart_delay->value->int8 : 0;
     dep->arrive_delay = arrive_delay ? arrive_delay->value->int8 : 0;
     dep->is_direct = is_direct ? (is_direct->value->uint8 != 0) : true;
     dep->platform_changed = platform_changed ? (platform_changed->value->uint8 != 0) : false;
+    dep->has_alert = has_alert ? (has_alert->value->uint8 != 0) : false;
 
     // Store timestamp for glance expiration (avoids parsing later)
     dep->depart_timestamp = depart_ts ? (time_t)depart_ts->value->int32 : 0;
+    dep->minutes_left = COUNTDOWN_UNKNOWN;  // Computed once the list is complete
+    dep->fill = DEPARTURE_FILL_FULL;
+    state_mark_departure_changed(row);
+
+    LOG_DEBUG("Received departure %d: %s", index, dep->destination);
+    trace_departure(state_get_last_data_request_id(), index);
+
+    // If this is the last departure, complete loading; a resent row only
+    // needs its countdown
+    if (list_complete) {
+      countdown_refresh();
+    } else if (index == state_get_num_departures() - 1) {
+      complete_departures();
+    }
+  } else if (message_type == MSG_DEPARTURE_DETAILS) {
+    // Destination of a row sent in compact form; it can arrive after the
+    // list is complete and departed trains were dropped from the top
+    Tuple *request_id_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_ID);
+    Tuple *index_tuple = dict_find(iterator, MESSAGE_KEY_DEPARTURE_INDEX);
+    if (!request_id_tuple || !index_tuple) return;
+    if (request_id_tuple->value->uint32 != state_get_last_data_request_id()) {
+      LOG_WARNING("Ignoring stale departure details [ID %lu] (expected %lu)",
+                  (unsigned long)request_id_tuple->value->uint32,
+                  (unsigned long)state_get_last_data_request_id());
+      return;
+    }
 
-    APP_LOG(APP_LOG_LEVEL_INFO, "Received departure %d: %s", index, dep->destination);
-
-    // If this is the last departure, complete loading
-    if (index == state_get_num_departures() - 1) {
-      state_set_load_state(LOAD_STATE_COMPLETE);
-      state_set_data_loading(false);
-
-      // Cancel timeout timer
-      AppTimer *timer = state_get_timeout_timer();
-      if (timer) {
-        app_timer_cancel(timer);
-        state_set_timeout_timer(NULL);
-      }
-
-      APP_LOG(APP_LOG_LEVEL_INFO, "All departures received");
+    int16_t index = index_tuple->value->uint8 - state_get_departures_removed();
+    if (index < 0 || index >= state_get_num_departures()) return;
 
-      // Update glances with fresh data
-      glances_update();
+    TrainDeparture *dep = &state_get_departures()[index];
+    Tuple *dest = dict_find(iterator, MESSAGE_KEY_DESTINATION);
+    Tuple *station_label = dict_find(iterator, MESSAGE_KEY_STATION_LABEL);
+    if (dest) strncpy(dep->destination, dest->value->cstring, sizeof(dep->destination) - 1);
+    if (station_label) strncpy(dep->station_label, station_label->value->cstring, sizeof(dep->station_label) - 1);
+    dep->fill = DEPARTURE_FILL_FULL;
+    state_mark_departure_changed(index);
+  } else if (message_type == MSG_THROTTLED) {
+    // iRail is rate limiting the phone: JS retries in RETRY_AFTER seconds,
+    // or gave up (0). Either way this isn't "No connections found".
+    Tuple *request_id_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_ID);
+    Tuple *retry_tuple = dict_find(iterator, MESSAGE_KEY_RETRY_AFTER);
+    if (!request_id_tuple || !retry_tuple) return;
+    if (request_id_tuple->value->uint32 != state_get_last_data_request_id()) {
+      LOG_WARNING("Ignoring stale throttle notice [ID %lu] (expected %lu)",
+                  (unsigned long)request_id_tuple->value->uint32,
+                  (unsigned long)state_get_last_data_request_id());
+      return;
+    }
+    // Rows already arriving (e.g. the offline answer) win over the notice
+    if (!state_is_data_loading() || state_get_load_state() == LOAD_STATE_RECEIVING) return;
+
+    uint32_t retry_after = retry_tuple->value->uint32;
+    AppTimer *timer = state_get_timeout_timer();
+    if (timer) {
+      app_timer_cancel(timer);
+      state_set_timeout_timer(NULL);
+    }
 
-      if (state_is_background_update()) {
-        // Background update - don't show UI, just exit
-        APP_LOG(APP_LOG_LEVEL_INFO, "Background glance update complete, exiting");
-        state_set_background_update(false);
-        // App will exit naturally when window stack is empty
-      } else {
-        // Normal update - refresh UI (only after all departures received)
-        menu_layer_reload_data(s_menu_layer);
-      }
+    if (retry_after > 0) {
+      LOG_WARNING("iRail throttled, phone retries in %lu s", (unsigned long)retry_after);
+      state_set_load_state(LOAD_STATE_THROTTLED);
+      // Wait out the retry before the usual timeout starts counting
+      state_set_timeout_timer(app_timer_register(retry_after * 1000 + LOADING_TIMEOUT_MS,
+                                                 loading_timeout_callback, NULL));
+    } else if (serve_snapshot()) {
+      LOG_WARNING("iRail throttled - showing schedule snapshot");
+      queue_trace(state_get_last_data_request_id());
     } else {
-      // Intermediate departure - just mark dirty to redraw without resetting scroll
-      if (!state_is_background_update()) {
-        layer_mark_dirty(menu_layer_get_layer(s_menu_layer));
-      }
+      LOG_WARNING("iRail throttled, phone gave up");
+      state_set_load_state(LOAD_STATE_THROTTLED);
+      state_set_data_loading(false);
+      state_set_data_failed(true);
+      queue_trace(state_get_last_data_request_id());
     }
   } else if (message_type == MSG_SEND_DETAIL) {
     // Received connection detail data (leg-by-leg)
@@ -260,8 +659,8 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
     if (request_id_tuple) {
       uint32_t request_id = request_id_tuple->value->uint32;
       if (request_id != state_get_last_detail_request_id()) {
-        APP_LOG(APP_LOG_LEVEL_WARNING, "Ignoring stale detail [ID %lu] (expected %lu)",
-                (unsigned long)request_id, (unsigned long)state_get_last_detail_request_id());
+        LOG_WARNING("Ignoring stale detail [ID %lu] (expected %lu)",
+                    (unsigned long)request_id, (unsigned long)state_get_last_detail_request_id());
         return;
       }
     }
@@ -271,8 +670,8 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
     if (leg_count_tuple) {
       // First message: leg count
       journey->leg_count = leg_count_tuple->value->uint8;
-      APP_LOG(APP_LOG_LEVEL_INFO, "Expecting %d legs [ID %lu]", journey->leg_count,
-              request_id_tuple ? (unsigned long)request_id_tuple->value->uint32 : 0);
+      LOG_DEBUG("Expecting %d legs [ID %lu]", journey->leg_count,
+                request_id_tuple ? (unsigned long)request_id_tuple->value->uint32 : 0);
     } else if (leg_index_tuple) {
       // Subsequent messages: individual leg data
       uint8_t leg_index = leg_index_tuple->value->uint8;
@@ -311,21 +710,81 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
         leg->depart_platform_changed = depart_platform_changed ? (depart_platform_changed->value->uint8 != 0) : false;
         leg->arrive_platform_changed = arrive_platform_changed ? (arrive_platform_changed->value->uint8 != 0) : false;
 
-        APP_LOG(APP_LOG_LEVEL_INFO, "Received leg %d: %s -> %s", leg_index, leg->depart_station, leg->arrive_station);
+        LOG_DEBUG("Received leg %d: %s -> %s", leg_index, leg->depart_station, leg->arrive_station);
+        state_mark_leg_changed(leg_index);
 
-        // If this is the last leg, mark as received and update UI
+        // If this is the last leg, mark as received (the detail window redraws)
         if (leg_index == journey->leg_count - 1) {
           state_set_detail_received(true);
-          APP_LOG(APP_LOG_LEVEL_INFO, "All legs received");
-
-          // Update detail window if it's currently shown
-          Window *detail_win = detail_window_get_instance();
-          if (detail_win && window_stack_contains_window(detail_win)) {
-            detail_window_update();
-          }
+          LOG_INFO("All legs received");
+          diag_heap_sample(DIAG_PHASE_DETAIL);
         }
       }
     }
+  } else if (message_type == MSG_SEND_STOP) {
+    // Intermediate stop of a journey leg (one message per stop)
+    Tuple *request_id_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_ID);
+    Tuple *leg_index_tuple = dict_find(iterator, MESSAGE_KEY_LEG_INDEX);
+    Tuple *stop_index_tuple = dict_find(iterator, MESSAGE_KEY_STOP_INDEX);
+    Tuple *stop_count_tuple = dict_find(iterator, MESSAGE_KEY_LEG_STOP_COUNT);
+
+    if (!leg_index_tuple ||
+        (request_id_tuple && request_id_tuple->value->uint32 != state_get_last_detail_request_id())) {
+      return;
+    }
+
+    uint8_t leg_index = leg_index_tuple->value->uint8;
+    if (!stop_index_tuple || !stop_count_tuple) {
+      // No stop index: the phone couldn't get this leg's stops
+      LOG_WARNING("Stops of leg %d unavailable", leg_index);
+      stop_list_mark_failed(leg_index);
+    } else {
+      Tuple *name = dict_find(iterator, MESSAGE_KEY_STOP_NAME);
+      Tuple *time = dict_find(iterator, MESSAGE_KEY_STOP_TIME);
+      Tuple *delay = dict_find(iterator, MESSAGE_KEY_STOP_DELAY);
+      stop_list_store(leg_index, stop_index_tuple->value->uint8, stop_count_tuple->value->uint8,
+                      name ? name->value->cstring : "", time ? time->value->cstring : "",
+                      delay ? delay->value->int8 : 0);
+    }
+
+    // Stops change the height of their leg
+    state_mark_detail_changed();
+  } else if (message_type == MSG_LEG_UPDATE) {
+    // Tracked journey changed: patch only the fields that were sent
+    Tuple *request_id_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_ID);
+    Tuple *leg_index_tuple = dict_find(iterator, MESSAGE_KEY_LEG_INDEX);
+    JourneyDetail *journey = state_get_journey_detail();
+
+    if (!leg_index_tuple || leg_index_tuple->value->uint8 >= journey->leg_count ||
+        (request_id_tuple && request_id_tuple->value->uint32 != state_get_last_detail_request_id())) {
+      return;
+    }
+
+    uint8_t leg_index = leg_index_tuple->value->uint8;
+    JourneyLeg *leg = &journey->legs[leg_index];
+    Tuple *depart_delay = dict_find(iterator, MESSAGE_KEY_LEG_DEPART_DELAY);
+    Tuple *arrive_delay = dict_find(iterator, MESSAGE_KEY_LEG_ARRIVE_DELAY);
+    Tuple *depart_platform = dict_find(iterator, MESSAGE_KEY_LEG_DEPART_PLATFORM);
+    Tuple *arrive_platform = dict_find(iterator, MESSAGE_KEY_LEG_ARRIVE_PLATFORM);
+    Tuple *depart_platform_changed = dict_find(iterator, MESSAGE_KEY_LEG_DEPART_PLATFORM_CHANGED);
+    Tuple *arrive_platform_changed = dict_find(iterator, MESSAGE_KEY_LEG_ARRIVE_PLATFORM_CHANGED);
+
+    if (depart_delay) leg->depart_delay = depart_delay->value->int8;
+    if (arrive_delay) leg->arrive_delay = arrive_delay->value->int8;
+    if (depart_platform) {
+      strncpy(leg->depart_platform, depart_platform->value->cstring, sizeof(leg->depart_platform) - 1);
+      leg->depart_platform[sizeof(leg->depart_platform) - 1] = '\0';
+    }
+    if (arrive_platform) {
+      strncpy(leg->arrive_platform, arrive_platform->value->cstring, sizeof(leg->arrive_platform) - 1);
+      leg->arrive_platform[sizeof(leg->arrive_platform) - 1] = '\0';
+    }
+    if (depart_platform_changed) leg->depart_platform_changed = depart_platform_changed->value->uint8 != 0;
+    if (arrive_platform_changed) leg->arrive_platform_changed = arrive_platform_changed->value->uint8 != 0;
+
+    LOG_INFO("Leg %d updated: +%d/+%d, platforms %s/%s", leg_index, leg->depart_delay,
+             leg->arrive_delay, leg->depart_platform, leg->arrive_platform);
+    state_mark_leg_changed(leg_index);
   } else if (message_type == MSG_SEND_STATION_COUNT) {
     // Received station count from JavaScript
     Tuple *count_tuple = dict_find(iterator, MESSAGE_KEY_CONFIG_STATION_COUNT);
@@ -333,7 +792,20 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
       uint8_t count = count_tuple->value->uint8;
       state_set_num_stations((count > MAX_FAVORITE_STATIONS) ? MAX_FAVORITE_STATIONS : count);
       state_set_stations_received(false);  // Reset flag
-      APP_LOG(APP_LOG_LEVEL_INFO, "Expecting %d favorite stations", state_get_num_stations());
+      LOG_INFO("Expecting %d favorite stations", state_get_num_stations());
+    }
+
+    // Station the phone is at: a favorite, or any other station nearby
+    Tuple *origin_index = dict_find(iterator, MESSAGE_KEY_ORIGIN_STATION_INDEX);
+    Tuple *origin_name = dict_find(iterator, MESSAGE_KEY_ORIGIN_STATION_NAME);
+    Tuple *origin_id = dict_find(iterator, MESSAGE_KEY_ORIGIN_STATION_ID);
+    if (origin_index) {
+      s_located_origin = origin_index->value->uint8;
+    } else if (origin_name && origin_id) {
+      state_select_searched_station(false, origin_name->value->cstring, origin_id->value->cstring);
+      s_located_origin = SEARCHED_FROM_STATION_INDEX;
+    } else {
+      s_located_origin = LOCATED_ORIGIN_NONE;
     }
   } else if (message_type == MSG_SEND_STATION) {
     // Received individual station data
@@ -359,68 +831,271 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
       station->irail_id[sizeof(station->irail_id) - 1] = '\0';
     }
 
-    APP_LOG(APP_LOG_LEVEL_INFO, "Received station %d: %s (%s)", index, station->name, station->irail_id);
+    LOG_DEBUG("Received station %d: %s (%s)", index, station->name, station->irail_id);
 
     // If this is the last station, mark as complete and update UI
     if (index == state_get_num_stations() - 1) {
       state_set_stations_received(true);
-      APP_LOG(APP_LOG_LEVEL_INFO, "All stations received, requesting initial data");
+      LOG_INFO("All stations received, requesting initial data");
+      diag_heap_sample(DIAG_PHASE_STATIONS);
+
+      // Keep them for launches without the phone
+      state_save_stations();
 
       // Cancel config timeout timer since we got the config
       AppTimer *config_timer = state_get_config_timeout_timer();
       if (config_timer) {
         app_timer_cancel(config_timer);
         state_set_config_timeout_timer(NULL);
-        APP_LOG(APP_LOG_LEVEL_INFO, "Config timeout timer cancelled");
+        LOG_INFO("Config timeout timer cancelled");
       }
 
-      menu_layer_reload_data(s_menu_layer);
+      // Start on the scheduled route right away, from where the phone is
+      schedule_apply_active_route();
+      apply_located_origin();
 
-      // Request initial train data now that we have stations
-      api_handler_request_train_data();
+      // Request initial train data (or the dashboard) now that we have stations
+      api_handler_refresh();
     }
-  } else if (message_type == MSG_SET_ACTIVE_ROUTE) {
-    // Set active route based on smart schedule
-    Tuple *from_index_tuple = dict_find(iterator, MESSAGE_KEY_CONFIG_FROM_INDEX);
-    Tuple *to_index_tuple = dict_find(iterator, MESSAGE_KEY_CONFIG_TO_INDEX);
-
-    if (from_index_tuple && to_index_tuple) {
-      uint8_t from_idx = from_index_tuple->value->uint8;
-      uint8_t to_idx = to_index_tuple->value->uint8;
-
-      if (from_idx < state_get_num_stations() && to_idx < state_get_num_stations()) {
-        state_set_from_station_index(from_idx);
-        state_set_to_station_index(to_idx);
-        APP_LOG(APP_LOG_LEVEL_INFO, "Active route set: %s -> %s",
-                state_get_stations()[from_idx].name, state_get_stations()[to_idx].name);
-        menu_layer_reload_data(s_menu_layer);
-        api_handler_request_train_data();
+  } else if (message_type == MSG_SNAPSHOT) {
+    // Schedule snapshot for one route (kept for phone-less use)
+    Tuple *slot_tuple = dict_find(iterator, MESSAGE_KEY_SNAPSHOT_SLOT);
+    Tuple *data_tuple = dict_find(iterator, MESSAGE_KEY_SNAPSHOT_DATA);
+    if (slot_tuple && data_tuple) {
+      snapshot_store(slot_tuple->value->uint8, data_tuple->value->data, data_tuple->length);
+    }
+  } else if (message_type == MSG_SCHEDULE_TABLE) {
+    // Compiled smart schedules (the watch picks the active route itself)
+    Tuple *data_tuple = dict_find(iterator, MESSAGE_KEY_SCHEDULE_DATA);
+    if (data_tuple) {
+      schedule_store(data_tuple->value->data, data_tuple->length);
+    }
+  } else if (message_type == MSG_DASHBOARD_ROUTES) {
+    // Dashboard routes picked in the settings (sent with the stations)
+    Tuple *routes_tuple = dict_find(iterator, MESSAGE_KEY_DASHBOARD_ROUTES);
+    if (routes_tuple) {
+      dashboard_store_routes(routes_tuple->value->data, routes_tuple->length);
+    }
+  } else if (message_type == MSG_DASHBOARD_DATA) {
+    // One dashboard route, in the order the phone's fetches finished
+    Tuple *request_id_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_ID);
+    Tuple *route_tuple = dict_find(iterator, MESSAGE_KEY_ROUTE_INDEX);
+    Tuple *data_tuple = dict_find(iterator, MESSAGE_KEY_DASHBOARD_DATA);
+    if (request_id_tuple && route_tuple) {
+      dashboard_store_route_data(request_id_tuple->value->uint32, route_tuple->value->uint8,
+                                 data_tuple ? data_tuple->value->data : NULL,
+                                 data_tuple ? data_tuple->length : 0);
+    }
+  } else if (message_type == MSG_ALERTS) {
+    // Disruption summaries, and which rows of the current list they touch
+    Tuple *data_tuple = dict_find(iterator, MESSAGE_KEY_ALERT_DATA);
+    Tuple *rows_tuple = dict_find(iterator, MESSAGE_KEY_ALERT_ROWS);
+    Tuple *request_id_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_ID);
+    if (data_tuple) {
+      alerts_store(data_tuple->value->data, data_tuple->length);
+    }
+    if (rows_tuple && request_id_tuple &&
+        request_id_tuple->value->uint32 == state_get_last_data_request_id()) {
+      // Bit per row as the phone sent them; departed trains were dropped
+      uint32_t mask = rows_tuple->value->uint32 >> state_get_departures_removed();
+      for (uint8_t i = 0; i < state_get_num_departures() && i < MAX_DEPARTURES; i++) {
+        TrainDeparture *dep = &state_get_departures()[i];
+        bool has_alert = (mask >> i) & 1;
+        if (dep->has_alert != has_alert) {
+          dep->has_alert = has_alert;
+          state_mark_departure_changed(i);
+        }
       }
     }
+  } else if (message_type == MSG_STATION_DICT) {
+    // Block of the station dictionary for the station search
+    Tuple *block_tuple = dict_find(iterator, MESSAGE_KEY_STATION_DICT_BLOCK);
+    Tuple *data_tuple = dict_find(iterator, MESSAGE_KEY_STATION_DICT_DATA);
+    if (!block_tuple) return;
+
+    if (data_tuple) {
+      station_dict_store(block_tuple->value->uint8, data_tuple->value->data, data_tuple->length);
+    } else {
+      // No data: the phone has no station list
+      station_dict_mark_unavailable(block_tuple->value->uint8);
+    }
   }
 }
 
 static void inbox_dropped_callback(AppMessageResult reason, void *context) {
-  APP_LOG(APP_LOG_LEVEL_ERROR, "Message dropped: %d", (int)reason);
+  LOG_ERROR("Message dropped: %d", (int)reason);
+  diag_message_dropped();
 }
 
 static void outbox_failed_callback(DictionaryIterator *iterator, AppMessageResult reason, void *context) {
-  APP_LOG(APP_LOG_LEVEL_ERROR, "Outbox send failed: %d", (int)reason);
+  LOG_ERROR("Outbox send failed: %d", (int)reason);
+  diag_message_failed();
 
-  // Set error state and update UI
-  state_set_data_loading(false);
-  state_set_data_failed(true);
-  menu_layer_reload_data(s_menu_layer);
+  // Losing a trace or energy report doesn't affect the data shown; it is
+  // tried again after the next quiet period
+  Tuple *message_type_tuple = dict_find(iterator, MESSAGE_KEY_MESSAGE_TYPE);
+  uint8_t message_type = message_type_tuple ? message_type_tuple->value->uint8 : 0;
+  if (message_type == MSG_TRACE_REPORT || message_type == MSG_ENERGY_REPORT) {
+    if (message_type == MSG_TRACE_REPORT) {
+      Tuple *request_id_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_ID);
+      if (request_id_tuple) {
+        trace_send_failed(request_id_tuple->value->uint32);
+      }
+    } else {
+      energy_export_failed();
+    }
+    schedule_reports();
+    flush_outbox();
+    return;
+  }
+
+  // The phone would keep tracking a closed journey: try again while it is
+  // connected (it stops tracking by itself once the journey is over)
+  if (message_type == MSG_STOP_TRACKING) {
+    if (connection_service_peek_pebble_app_connection()) {
+      s_pending |= PENDING_STOP_TRACKING;
+    }
+    flush_outbox();
+    return;
+  }
+
+  // A page of stops is asked for again on the next scroll
+  if (message_type == MSG_REQUEST_STOPS) {
+    Tuple *leg_index_tuple = dict_find(iterator, MESSAGE_KEY_LEG_INDEX);
+    if (leg_index_tuple) {
+      stop_list_request_failed(leg_index_tuple->value->uint8);
+    }
+    flush_outbox();
+    return;
+  }
+
+  // The station search can't go on without the block it waits for
+  if (message_type == MSG_REQUEST_STATION_DICT) {
+    Tuple *block_tuple = dict_find(iterator, MESSAGE_KEY_STATION_DICT_BLOCK);
+    if (block_tuple) {
+      station_dict_mark_unavailable(block_tuple->value->uint8);
+    }
+    flush_outbox();
+    return;
+  }
+
+  // The dashboard shows the failure on its routes, not the departure list
+  if (message_type == MSG_REQUEST_DASHBOARD) {
+    Tuple *request_id_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_ID);
+    if (request_id_tuple) {
+      dashboard_request_failed(request_id_tuple->value->uint32);
+    }
+    flush_outbox();
+    return;
+  }
+
+  // Only the departure list's own request fails it
+  if (message_type == MSG_REQUEST_DATA) {
+    state_set_data_loading(false);
+    state_set_data_failed(true);
+  }
+  flush_outbox();
 }
 
 static void outbox_sent_callback(DictionaryIterator *iterator, void *context) {
-  APP_LOG(APP_LOG_LEVEL_INFO, "Outbox send success!");
+  LOG_DEBUG("Outbox send success!");
+  diag_message_sent(iterator);
+
+  Tuple *message_type_tuple = dict_find(iterator, MESSAGE_KEY_MESSAGE_TYPE);
+  if (message_type_tuple) {
+    uint8_t message_type = message_type_tuple->value->uint8;
+    if (message_type == MSG_ENERGY_REPORT) {
+      Tuple *hour_tuple = dict_find(iterator, MESSAGE_KEY_ENERGY_HOUR);
+      if (hour_tuple) {
+        energy_mark_exported(hour_tuple->value->uint32);
+      }
+    } else if (message_type != MSG_TRACE_REPORT) {
+      EnergyFeature feature = energy_feature_for_message(message_type);
+      energy_count(feature, ENERGY_METRIC_MSG_OUT, 1);
+      energy_count(feature, ENERGY_METRIC_BYTES_OUT, dict_size(iterator));
+    }
+  }
+
+  // Use the idle outbox for whatever waits for it
+  flush_outbox();
 }
 
-// Initialize API handler
-void api_handler_init(MenuLayer *menu_layer) {
-  s_menu_layer = menu_layer;
+// Send what waits for the outbox, one message at a time (the next goes from
+// the outbox callbacks): requests that found it busy first, then reports
+// once the quiet period passed and no list is loading
+static void flush_outbox(void) {
+  if (s_pending & PENDING_TRAIN_DATA) {
+    if (send_train_data_request()) {
+      s_pending &= ~PENDING_TRAIN_DATA;
+      LOG_INFO("Queued data request [ID %lu] sent",
+               (unsigned long)state_get_last_data_request_id());
+    }
+    return;
+  }
+  if (s_pending & PENDING_DASHBOARD) {
+    if (send_dashboard_request()) {
+      s_pending &= ~PENDING_DASHBOARD;
+      LOG_INFO("Queued dashboard request [ID %lu] sent", (unsigned long)s_dashboard_request_id);
+    }
+    return;
+  }
+  if (s_pending & PENDING_DETAIL) {
+    if (send_detail_request()) {
+      s_pending &= ~PENDING_DETAIL;
+      LOG_INFO("Queued detail request [ID %lu] sent",
+               (unsigned long)state_get_last_detail_request_id());
+    }
+    return;
+  }
+  if (s_pending & PENDING_STATION_DICT) {
+    if (send_station_dict_request()) {
+      s_pending &= ~PENDING_STATION_DICT;
+      LOG_DEBUG("Queued station dictionary block %d requested", s_station_dict_block);
+    }
+    return;
+  }
+  if (s_pending & PENDING_STOP_TRACKING) {
+    if (send_stop_tracking()) {
+      s_pending &= ~PENDING_STOP_TRACKING;
+      LOG_INFO("Queued stop tracking [ID %lu] sent", (unsigned long)s_stop_tracking_id);
+    }
+    return;
+  }
 
+  if (s_report_timer || state_is_data_loading() ||
+      !connection_service_peek_pebble_app_connection()) {
+    return;
+  }
+  // Traces first, then one closed energy hour per free outbox
+  if (!trace_send_next()) {
+    energy_export_next();
+  }
+}
+
+// Whether a dashboard route is waiting for the phone or gave up on it
+static bool dashboard_incomplete(void) {
+  for (uint8_t i = 0; i < dashboard_get_route_count(); i++) {
+    if (dashboard_get_status(i) != DASHBOARD_ROUTE_READY) return true;
+  }
+  return false;
+}
+
+// Refresh with live data once the phone is back
+static void app_connection_handler(bool connected) {
+  LOG_INFO("Phone %s", connected ? "connected" : "disconnected");
+  if (!connected || !state_are_stations_received()) return;
+
+  if (dashboard_is_shown()) {
+    if (dashboard_incomplete()) {
+      api_handler_request_dashboard();
+    }
+  } else if (state_is_data_offline()) {
+    api_handler_request_train_data();
+  }
+}
+
+// Initialize API handler
+void api_handler_init(void) {
   // Register AppMessage callbacks
   app_message_register_inbox_received(inbox_received_callback);
   app_message_register_inbox_dropped(inbox_dropped_callback);
@@ -430,9 +1105,15 @@ void api_handler_init(MenuLayer *menu_layer) {
   // Open AppMessage with appropriate buffer sizes
   app_message_open(512, 512);
 
-  // Start config timeout timer (fallback to defaults if no config received)
-  state_set_config_timeout_timer(app_timer_register(CONFIG_TIMEOUT_MS, config_timeout_callback, NULL));
-  APP_LOG(APP_LOG_LEVEL_INFO, "Config timeout timer started (%d ms)", CONFIG_TIMEOUT_MS);
+  connection_service_subscribe((ConnectionHandlers) {
+    .pebble_app_connection_handler = app_connection_handler
+  });
+
+  // Start config timeout timer (fallback to saved or default stations if no
+  // config received); without a phone connection don't wait at all
+  uint32_t config_timeout = connection_service_peek_pebble_app_connection() ? CONFIG_TIMEOUT_MS : 0;
+  state_set_config_timeout_timer(app_timer_register(config_timeout, config_timeout_callback, NULL));
+  LOG_INFO("Config timeout timer started (%lu ms)", (unsigned long)config_timeout);
 }
 
 // Handle timeout
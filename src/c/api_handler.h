@@ -2,14 +2,39 @@
 
 #include <pebble.h>
 
+// Departure lists arrive as MSG_SEND_COUNT, then one MSG_SEND_DEPARTURE per
+// train. On a weak Bluetooth link the phone switches to a two-part form:
+// MSG_SEND_DEPARTURE with DEPARTURE_ROWS packs several rows from
+// DEPARTURE_INDEX on in the compact form of utils.h (times, platform, train
+// type), then one MSG_DEPARTURE_DETAILS per row adds its destination. The
+// list is complete once its last row arrived in either form; rows show as
+// they arrive, with placeholders for what is still missing.
+
 // Initialize API handler (register AppMessage callbacks)
-void api_handler_init(MenuLayer *menu_layer);
+void api_handler_init(void);
 
 // Request train data from JavaScript
 void api_handler_request_train_data(void);
 
+// Request all dashboard routes from JavaScript (see dashboard.h)
+void api_handler_request_dashboard(void);
+
+// Request what the main menu shows: the dashboard or the selected route
+void api_handler_refresh(void);
+
 // Request detail data for selected departure
 void api_handler_request_detail_data(void);
 
+// Request a page of intermediate stops for a leg of the shown journey
+// (false if the outbox is busy)
+bool api_handler_request_stops(uint8_t leg_index, uint8_t first_stop);
+
+// Request a block of the station dictionary (see station_dict.h); a busy
+// outbox queues it, the search's own timeout covers the wait
+void api_handler_request_station_dict(uint8_t block);
+
+// Tell the phone to stop tracking the journey (detail window closed)
+void api_handler_stop_tracking(void);
+
 // Handle timeout (called by timeout timer)
 void api_handler_handle_timeout(void);
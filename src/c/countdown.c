@@ -0,0 +1,117 @@
+#include "countdown.h"
+#include "state.h"
+#include "api_handler.h"
+#include "dashboard.h"
+#include "log.h"
+
+// Menu layer reference (needed to keep the selection)
+static MenuLayer *s_menu_layer = NULL;
+
+// Minutes until a departure leaves (including its delay), -1 once it left
+static int16_t minutes_until(const TrainDeparture *departure, time_t now) {
+  if (departure->depart_timestamp == 0) return COUNTDOWN_UNKNOWN;
+
+  int32_t seconds = (int32_t)(departure->depart_timestamp + departure->depart_delay * 60 - now);
+  if (seconds < 0) return -1;
+  return seconds / 60 < COUNTDOWN_UNKNOWN ? seconds / 60 : COUNTDOWN_UNKNOWN - 1;
+}
+
+// Countdown value as displayed (-1 when no countdown is shown)
+static int16_t shown_minutes(int16_t minutes) {
+  return (minutes >= 0 && minutes <= COUNTDOWN_SHOW_MINUTES) ? minutes : -1;
+}
+
+// Drop trains that already left from the top of the list; returns how many.
+// A departed train behind a more heavily delayed one stays until that one
+// leaves too, so rows keep mapping onto the phone's list.
+static uint8_t prune(time_t now) {
+  TrainDeparture *departures = state_get_departures();
+  uint8_t count = 0;
+  while (count < state_get_num_departures() && minutes_until(&departures[count], now) < 0) {
+    count++;
+  }
+  if (count > 0) {
+    state_remove_departures(count);
+  }
+  return count;
+}
+
+// Recompute minutes_left; rows whose displayed countdown changed are marked
+static void update_minutes(time_t now) {
+  TrainDeparture *departures = state_get_departures();
+  for (uint8_t i = 0; i < state_get_num_departures(); i++) {
+    int16_t minutes = minutes_until(&departures[i], now);
+    if (shown_minutes(minutes) != shown_minutes(departures[i].minutes_left)) {
+      state_mark_departure_changed(i);
+    }
+    departures[i].minutes_left = minutes;
+  }
+}
+
+// Keep the same train selected after rows were dropped above it
+static void shift_selection(uint8_t removed) {
+  MenuIndex selected = menu_layer_get_selected_index(s_menu_layer);
+  if (selected.section != 1) return;
+
+  selected.row = selected.row >= removed ? selected.row - removed : 0;
+  menu_layer_set_selected_index(s_menu_layer, selected, MenuRowAlignNone, false);
+  state_set_selected_row(selected.row);
+}
+
+static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
+  // The dashboard keeps its own rows; refresh all routes once one runs out
+  if (dashboard_is_shown()) {
+    if (!state_is_background_update() && dashboard_prune(time(NULL))) {
+      LOG_INFO("A dashboard route ran out of departures, refreshing");
+      api_handler_request_dashboard();
+    }
+    return;
+  }
+
+  // Leave lists that are still arriving (or never shown) alone
+  if (state_is_data_loading() || state_is_background_update() ||
+      state_get_num_departures() == 0) {
+    return;
+  }
+
+  time_t now = time(NULL);
+  uint8_t removed = prune(now);
+  update_minutes(now);
+
+  if (removed > 0) {
+    LOG_DEBUG("Dropped %d departed trains, %d left", removed, state_get_num_departures());
+    shift_selection(removed);
+  }
+
+  // Only go to the network when the list is about to run out
+  if (removed > 0 && state_get_num_departures() <= COUNTDOWN_REFRESH_THRESHOLD) {
+    LOG_INFO("Only %d departures left, refreshing", state_get_num_departures());
+    api_handler_request_train_data();
+  }
+}
+
+void countdown_init(MenuLayer *menu_layer) {
+  s_menu_layer = menu_layer;
+  tick_timer_service_subscribe(MINUTE_UNIT, tick_handler);
+}
+
+void countdown_deinit(void) {
+  tick_timer_service_unsubscribe();
+}
+
+void countdown_refresh(void) {
+  time_t now = time(NULL);
+  prune(now);
+  update_minutes(now);
+}
+
+void countdown_format(const TrainDeparture *departure, char *buffer, size_t size) {
+  int16_t minutes = shown_minutes(departure->minutes_left);
+  if (minutes < 0) {
+    buffer[0] = '\0';
+  } else if (minutes == 0) {
+    snprintf(buffer, size, "now");
+  } else {
+    snprintf(buffer, size, "in %d min", minutes);
+  }
+}
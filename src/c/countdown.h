@@ -0,0 +1,32 @@
+#pragma once
+
+#include <pebble.h>
+#include "types.h"
+
+// Minute-tick countdown for the departure list.
+//
+// Once a minute the minutes until each (delayed) departure are recomputed,
+// trains that already left are dropped from the top of the list and the menu
+// is only redrawn if a shown countdown changed. No network traffic is caused
+// unless the list is about to run short.
+
+// Countdowns are shown for trains leaving within this many minutes
+#define COUNTDOWN_SHOW_MINUTES 60
+
+// Request fresh data once pruning leaves this many departures or fewer
+#define COUNTDOWN_REFRESH_THRESHOLD 2
+
+// minutes_left of a departure without a known timestamp
+#define COUNTDOWN_UNKNOWN INT16_MAX
+
+// Subscribe to minute ticks
+void countdown_init(MenuLayer *menu_layer);
+
+// Unsubscribe from minute ticks
+void countdown_deinit(void);
+
+// Drop departed trains and compute minutes_left for a freshly loaded list
+void countdown_refresh(void);
+
+// Format a departure's countdown ("in 5 min", "now"), or "" if not shown
+void countdown_format(const TrainDeparture *departure, char *buffer, size_t size);
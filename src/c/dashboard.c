@@ -0,0 +1,212 @@
+#include "dashboard.h"
+#include "state.h"
+#include "diagnostics.h"
+#include "utils.h"
+#include "log.h"
+
+typedef struct {
+  uint8_t from;
+  uint8_t to;
+  DashboardRouteStatus status;
+  uint8_t num_departures;
+  CompactDeparture departures[DASHBOARD_ROWS_PER_ROUTE];
+} DashboardRoute;
+
+static DashboardRoute s_routes[DASHBOARD_MAX_ROUTES];
+static uint8_t s_route_count = 0;
+static bool s_shown = false;
+
+// Current request (answers to older ones are ignored)
+static uint32_t s_request_id = 0;
+static AppTimer *s_timeout_timer = NULL;
+
+static bool parse_routes(const uint8_t *data, uint16_t length) {
+  if (length < 2 || data[0] != DASHBOARD_VERSION || data[1] > DASHBOARD_MAX_ROUTES ||
+      length != 2 + data[1]) {
+    return false;
+  }
+  s_route_count = data[1];
+  for (uint8_t i = 0; i < s_route_count; i++) {
+    s_routes[i] = (DashboardRoute) {
+      .from = data[2 + i] >> 4,
+      .to = data[2 + i] & 0x0F,
+      .status = DASHBOARD_ROUTE_LOADING,
+    };
+  }
+  return true;
+}
+
+// Sample the heap once every route has its answer
+static void check_complete(void) {
+  for (uint8_t i = 0; i < s_route_count; i++) {
+    if (s_routes[i].status == DASHBOARD_ROUTE_LOADING) return;
+  }
+  if (s_timeout_timer) {
+    app_timer_cancel(s_timeout_timer);
+    s_timeout_timer = NULL;
+  }
+  diag_heap_sample(DIAG_PHASE_DASHBOARD);
+}
+
+// Give up on the routes still waiting for an answer
+static void fail_loading_routes(const char *reason) {
+  for (uint8_t i = 0; i < s_route_count; i++) {
+    if (s_routes[i].status == DASHBOARD_ROUTE_LOADING) {
+      LOG_WARNING("Dashboard route %d %s", i, reason);
+      s_routes[i].status = DASHBOARD_ROUTE_FAILED;
+      state_mark_dashboard_changed();
+    }
+  }
+}
+
+static void timeout_callback(void *data) {
+  s_timeout_timer = NULL;
+  fail_loading_routes("timed out");
+}
+
+void dashboard_init(void) {
+  uint8_t buffer[2 + DASHBOARD_MAX_ROUTES];
+  int length = persist_exists(PERSIST_KEY_DASHBOARD_ROUTES) ?
+               persist_read_data(PERSIST_KEY_DASHBOARD_ROUTES, buffer, sizeof(buffer)) : 0;
+  if (length > 0 && parse_routes(buffer, length)) {
+    LOG_INFO("Loaded dashboard with %d routes", s_route_count);
+  }
+  s_shown = persist_exists(PERSIST_KEY_DASHBOARD_SHOWN) &&
+            persist_read_bool(PERSIST_KEY_DASHBOARD_SHOWN);
+}
+
+void dashboard_deinit(void) {
+  if (s_timeout_timer) {
+    app_timer_cancel(s_timeout_timer);
+    s_timeout_timer = NULL;
+  }
+}
+
+void dashboard_store_routes(const uint8_t *data, uint16_t length) {
+  if (!parse_routes(data, length)) {
+    LOG_WARNING("Ignoring invalid dashboard routes (%d bytes)", length);
+    return;
+  }
+  persist_write_data(PERSIST_KEY_DASHBOARD_ROUTES, data, length);
+  LOG_INFO("Stored dashboard with %d routes", s_route_count);
+  state_mark_dashboard_changed();
+}
+
+uint16_t dashboard_get_routes_blob(uint8_t *buffer, uint16_t size) {
+  if (size < 2 + s_route_count) return 0;
+  buffer[0] = DASHBOARD_VERSION;
+  buffer[1] = s_route_count;
+  for (uint8_t i = 0; i < s_route_count; i++) {
+    buffer[2 + i] = (s_routes[i].from << 4) | s_routes[i].to;
+  }
+  return 2 + s_route_count;
+}
+
+bool dashboard_is_available(void) {
+  if (s_route_count == 0 || !state_are_stations_received()) return false;
+  for (uint8_t i = 0; i < s_route_count; i++) {
+    if (s_routes[i].from >= state_get_num_stations() || s_routes[i].to >= state_get_num_stations()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool dashboard_is_shown(void) { return s_shown && dashboard_is_available(); }
+
+void dashboard_set_shown(bool shown) {
+  if (shown == s_shown) return;
+  s_shown = shown;
+  persist_write_bool(PERSIST_KEY_DASHBOARD_SHOWN, shown);
+  state_mark_dashboard_changed();
+}
+
+uint8_t dashboard_get_route_count(void) { return s_route_count; }
+
+void dashboard_get_route(uint8_t route, uint8_t *from_index, uint8_t *to_index) {
+  *from_index = s_routes[route].from;
+  *to_index = s_routes[route].to;
+}
+
+DashboardRouteStatus dashboard_get_status(uint8_t route) { return s_routes[route].status; }
+
+uint8_t dashboard_get_num_departures(uint8_t route) { return s_routes[route].num_departures; }
+
+const CompactDeparture* dashboard_get_departure(uint8_t route, uint8_t index) {
+  return &s_routes[route].departures[index];
+}
+
+uint32_t dashboard_begin_request(void) {
+  s_request_id++;
+  for (uint8_t i = 0; i < s_route_count; i++) {
+    s_routes[i].status = DASHBOARD_ROUTE_LOADING;
+    s_routes[i].num_departures = 0;
+  }
+  state_mark_dashboard_changed();
+
+  if (s_timeout_timer) {
+    app_timer_cancel(s_timeout_timer);
+  }
+  s_timeout_timer = app_timer_register(LOADING_TIMEOUT_MS, timeout_callback, NULL);
+  return s_request_id;
+}
+
+void dashboard_store_route_data(uint32_t request_id, uint8_t route, const uint8_t *data,
+                                uint16_t length) {
+  if (request_id != s_request_id || route >= s_route_count) {
+    LOG_WARNING("Ignoring stale dashboard route %d [ID %lu] (expected %lu)", route,
+                (unsigned long)request_id, (unsigned long)s_request_id);
+    return;
+  }
+
+  DashboardRoute *entry = &s_routes[route];
+  entry->num_departures = 0;
+  entry->status = DASHBOARD_ROUTE_FAILED;
+
+  if (data && length >= 1) {
+    uint8_t count = data[0] < DASHBOARD_ROWS_PER_ROUTE ? data[0] : DASHBOARD_ROWS_PER_ROUTE;
+    uint16_t pos = 1;
+    for (uint8_t i = 0; i < count; i++) {
+      if (!read_compact_departure(data, length, &pos, &entry->departures[i])) break;
+      entry->num_departures++;
+    }
+    entry->status = DASHBOARD_ROUTE_READY;
+  }
+
+  LOG_INFO("Dashboard route %d: %d departures%s", route, entry->num_departures,
+           entry->status == DASHBOARD_ROUTE_FAILED ? " (failed)" : "");
+  state_mark_dashboard_changed();
+  check_complete();
+}
+
+void dashboard_request_failed(uint32_t request_id) {
+  if (request_id != s_request_id) return;
+  if (s_timeout_timer) {
+    app_timer_cancel(s_timeout_timer);
+    s_timeout_timer = NULL;
+  }
+  fail_loading_routes("not requested");
+}
+
+bool dashboard_prune(time_t now) {
+  bool ran_out = false;
+  for (uint8_t i = 0; i < s_route_count; i++) {
+    DashboardRoute *entry = &s_routes[i];
+    if (entry->status != DASHBOARD_ROUTE_READY || entry->num_departures == 0) continue;
+
+    uint8_t removed = 0;
+    while (removed < entry->num_departures &&
+           entry->departures[removed].depart_timestamp +
+           entry->departures[removed].depart_delay * 60 < now) {
+      removed++;
+    }
+    if (removed == 0) continue;
+
+    entry->num_departures -= removed;
+    memmove(entry->departures, entry->departures + removed,
+            entry->num_departures * sizeof(CompactDeparture));
+    state_mark_dashboard_changed();
+    ran_out = ran_out || entry->num_departures == 0;
+  }
+  return ran_out;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <pebble.h>
+#include "types.h"
+
+// Multi-route dashboard on the main menu.
+//
+// Up to DASHBOARD_MAX_ROUTES routes picked in the settings are shown as
+// menu sections, each with its next DASHBOARD_ROWS_PER_ROUTE departures.
+// One MSG_REQUEST_DASHBOARD asks for all of them. The phone fetches the
+// routes concurrently and answers with one MSG_DASHBOARD_DATA per route, in
+// whatever order the fetches finish. Rows live in fixed slots, so the whole
+// dashboard takes the same memory however many trains the phone finds.
+//
+// Route list blob (MSG_DASHBOARD_ROUTES from the phone, sent back as is in
+// MSG_REQUEST_DASHBOARD):
+//   u8  version (DASHBOARD_VERSION)
+//   u8  route count (at most DASHBOARD_MAX_ROUTES)
+//   per route: u8 from station index << 4 | to station index
+//
+// Route data blob (MSG_DASHBOARD_DATA with ROUTE_INDEX; no blob means the
+// phone couldn't get the route), little-endian:
+//   u8  departure count (at most DASHBOARD_ROWS_PER_ROUTE)
+//   per departure: a compact departure row (see utils.h)
+
+#define DASHBOARD_VERSION 1
+
+typedef enum {
+  DASHBOARD_ROUTE_LOADING,  // Requested, no answer yet
+  DASHBOARD_ROUTE_READY,    // Departures received (possibly none)
+  DASHBOARD_ROUTE_FAILED    // The phone couldn't get it, or no answer in time
+} DashboardRouteStatus;
+
+// Load the persisted route list and mode
+void dashboard_init(void);
+
+// Cancel the loading timeout
+void dashboard_deinit(void);
+
+// Store a route list received from JS
+void dashboard_store_routes(const uint8_t *data, uint16_t length);
+
+// Route list blob to send with a dashboard request; returns its length
+uint16_t dashboard_get_routes_blob(uint8_t *buffer, uint16_t size);
+
+// Whether there are routes and all of them are between known stations
+bool dashboard_is_available(void);
+
+// Whether the menu shows the dashboard instead of the selected route
+bool dashboard_is_shown(void);
+void dashboard_set_shown(bool shown);
+
+// Routes and their departures
+uint8_t dashboard_get_route_count(void);
+void dashboard_get_route(uint8_t route, uint8_t *from_index, uint8_t *to_index);
+DashboardRouteStatus dashboard_get_status(uint8_t route);
+uint8_t dashboard_get_num_departures(uint8_t route);
+const CompactDeparture* dashboard_get_departure(uint8_t route, uint8_t index);
+
+// Start a new request: all routes loading, answers to older requests
+// ignored, routes still loading after LOADING_TIMEOUT_MS marked failed
+uint32_t dashboard_begin_request(void);
+
+// Store one route's answer (data NULL: the phone couldn't get it)
+void dashboard_store_route_data(uint32_t request_id, uint8_t route, const uint8_t *data,
+                                uint16_t length);
+
+// The request never reached the phone: its routes still loading fail
+void dashboard_request_failed(uint32_t request_id);
+
+// Drop departed trains; returns true if a route ran out of them
+bool dashboard_prune(time_t now);
@@ -0,0 +1,141 @@
+#include "decorations.h"
+#include "log.h"
+
+// Shimmer band width and the pause (in pixels of travel) between sweeps
+#define SHIMMER_BAND 24
+#define SHIMMER_PAUSE 60
+
+typedef enum {
+  DECORATION_SKELETON,
+  DECORATION_DOTTED_LINE,
+  DECORATION_JOURNEY_LINE,
+  DECORATION_COUNT
+} DecorationId;
+
+typedef void (*DecorationRenderer)(uint8_t *data, uint16_t bytes_per_row, GSize size);
+
+typedef struct {
+  GBitmap *bitmap;
+  GSize size;
+  GColor palette[2];  // 0 = background (clear), 1 = ink
+} Decoration;
+
+static Decoration s_decorations[DECORATION_COUNT];
+
+// Palettized bitmaps store the leftmost pixel in the most significant bit
+static inline void set_pixel(uint8_t *data, uint16_t bytes_per_row, int16_t x, int16_t y) {
+  data[y * bytes_per_row + x / 8] |= 0x80 >> (x % 8);
+}
+
+// Skeleton strip: the sparse dither (every 3rd pixel), twice as wide as the
+// placeholder plus the band, with the denser shimmer band in the middle
+static void render_skeleton(uint8_t *data, uint16_t bytes_per_row, GSize size) {
+  int16_t band_start = (size.w - SHIMMER_BAND) / 2;
+  for (int16_t y = 0; y < size.h; y++) {
+    for (int16_t x = 0; x < size.w; x++) {
+      bool in_band = x >= band_start && x < band_start + SHIMMER_BAND;
+      if (in_band ? (x + y) % 3 != 1 : (x + y) % 3 == 0) {
+        set_pixel(data, bytes_per_row, x, y);
+      }
+    }
+  }
+}
+
+static void render_dotted_line(uint8_t *data, uint16_t bytes_per_row, GSize size) {
+  for (int16_t x = 0; x < size.w; x++) {
+    if (x % 4 != 3) {
+      set_pixel(data, bytes_per_row, x, 0);
+    }
+  }
+}
+
+static void render_journey_line(uint8_t *data, uint16_t bytes_per_row, GSize size) {
+  for (int16_t y = 0; y < size.h; y++) {
+    if (y % 4 < 2) {
+      set_pixel(data, bytes_per_row, 0, y);
+      set_pixel(data, bytes_per_row, 1, y);
+    }
+  }
+}
+
+static const DecorationRenderer s_renderers[DECORATION_COUNT] = {
+  [DECORATION_SKELETON] = render_skeleton,
+  [DECORATION_DOTTED_LINE] = render_dotted_line,
+  [DECORATION_JOURNEY_LINE] = render_journey_line,
+};
+
+// Rendered bitmap for a decoration at size, with its ink set to color
+static GBitmap *decoration_get(DecorationId id, GSize size, GColor color) {
+  Decoration *decoration = &s_decorations[id];
+
+  if (!decoration->bitmap || decoration->size.w != size.w || decoration->size.h != size.h) {
+    if (decoration->bitmap) {
+      gbitmap_destroy(decoration->bitmap);
+    }
+    decoration->palette[0] = GColorClear;
+    decoration->palette[1] = color;
+    decoration->bitmap = gbitmap_create_blank_with_palette(size, GBitmapFormat1BitPalette,
+                                                           decoration->palette, false);
+    if (!decoration->bitmap) {
+      LOG_ERROR("Decoration %d (%dx%d) not created", id, size.w, size.h);
+      return NULL;
+    }
+    decoration->size = size;
+
+    uint8_t *data = gbitmap_get_data(decoration->bitmap);
+    uint16_t bytes_per_row = gbitmap_get_bytes_per_row(decoration->bitmap);
+    memset(data, 0, bytes_per_row * size.h);
+    s_renderers[id](data, bytes_per_row, size);
+    LOG_DEBUG("Decoration %d rendered at %dx%d (%d B)", id, size.w, size.h,
+              bytes_per_row * size.h);
+  }
+
+  decoration->palette[1] = color;
+  return decoration->bitmap;
+}
+
+void decorations_draw_skeleton(GContext *ctx, GRect rect, GColor color, uint16_t shimmer_frame) {
+  GSize strip_size = GSize(rect.size.w * 2 + SHIMMER_BAND, rect.size.h);
+  GBitmap *strip = decoration_get(DECORATION_SKELETON, strip_size, color);
+  if (!strip) return;
+
+  // The band sits at rect.size.w in the strip; sliding the window left over
+  // it sweeps the band across the placeholder from left to right. Steps are
+  // a multiple of the dither period, so the dither itself stays put.
+  int16_t travel = rect.size.w + SHIMMER_BAND;
+  int16_t position = (shimmer_frame * DECORATION_SHIMMER_STEP) % (travel + SHIMMER_PAUSE);
+  if (shimmer_frame == 0 || position > travel) {
+    position = travel;
+  }
+  int16_t window_x = travel - position;
+  window_x -= window_x % 3;
+
+  gbitmap_set_bounds(strip, GRect(window_x, 0, rect.size.w, rect.size.h));
+  graphics_context_set_compositing_mode(ctx, GCompOpSet);
+  graphics_draw_bitmap_in_rect(ctx, strip, rect);
+}
+
+void decorations_draw_dotted_line(GContext *ctx, GPoint origin, int16_t width, GColor color) {
+  GBitmap *line = decoration_get(DECORATION_DOTTED_LINE, GSize(width, 1), color);
+  if (!line) return;
+
+  graphics_context_set_compositing_mode(ctx, GCompOpSet);
+  graphics_draw_bitmap_in_rect(ctx, line, GRect(origin.x, origin.y, width, 1));
+}
+
+void decorations_draw_journey_line(GContext *ctx, GPoint origin, int16_t height, GColor color) {
+  GBitmap *line = decoration_get(DECORATION_JOURNEY_LINE, GSize(2, height), color);
+  if (!line) return;
+
+  graphics_context_set_compositing_mode(ctx, GCompOpSet);
+  graphics_draw_bitmap_in_rect(ctx, line, GRect(origin.x, origin.y, 2, height));
+}
+
+void decorations_deinit(void) {
+  for (uint8_t i = 0; i < DECORATION_COUNT; i++) {
+    if (s_decorations[i].bitmap) {
+      gbitmap_destroy(s_decorations[i].bitmap);
+      s_decorations[i].bitmap = NULL;
+    }
+  }
+}
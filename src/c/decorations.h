@@ -0,0 +1,25 @@
+#pragma once
+
+#include <pebble.h>
+
+// Pre-rendered decorations: the skeleton placeholder, dotted header borders
+// and the dotted journey line are rendered once into small 1-bit bitmaps and
+// blitted, instead of being drawn pixel by pixel on every frame. Bitmaps are
+// (re)built for the size first asked for, so each platform gets its own, and
+// drawn through a two-colour palette so selected rows reuse the same pixels.
+
+// Shimmer frames advance the highlight band by this many pixels
+#define DECORATION_SHIMMER_STEP 3
+
+// Dithered placeholder filling rect. Each shimmer frame moves a denser band
+// across it; frame 0 and the frames between sweeps show no band.
+void decorations_draw_skeleton(GContext *ctx, GRect rect, GColor color, uint16_t shimmer_frame);
+
+// Horizontal dotted line (3 pixels on, 1 off) starting at origin
+void decorations_draw_dotted_line(GContext *ctx, GPoint origin, int16_t width, GColor color);
+
+// Vertical line of 2x2 dots every 4 pixels starting at origin
+void decorations_draw_journey_line(GContext *ctx, GPoint origin, int16_t height, GColor color);
+
+// Free the rendered bitmaps
+void decorations_deinit(void);
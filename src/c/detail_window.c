@@ -1,6 +1,17 @@
 #include "detail_window.h"
 #include "state.h"
 #include "utils.h"
+#include "diagnostics.h"
+#include "energy.h"
+#include "stop_list.h"
+#include "api_handler.h"
+#include "decorations.h"
+
+// Layout (heights in pixels)
+#define DETAIL_TOP_MARGIN 8
+#define LEG_BASE_HEIGHT 135   // Leg without intermediate stops (incl. spacing)
+#define LEG_STOPS_OFFSET 87   // First stop row below the top of its leg
+#define STOP_ROW_HEIGHT 18
 
 // UI elements
 static Window *s_detail_window = NULL;
@@ -13,8 +24,101 @@ static void detail_window_load(Window *window);
 static void detail_window_unload(Window *window);
 static void detail_content_update_proc(Layer *layer, GContext *ctx);
 
+// Stop rows shown for a leg (none if the phone couldn't provide them)
+static uint8_t stop_rows(uint8_t leg_index) {
+  if (stop_list_leg_failed(leg_index)) return 0;
+  return state_get_journey_detail()->legs[leg_index].stop_count;
+}
+
+static int16_t leg_height(uint8_t leg_index) {
+  return LEG_BASE_HEIGHT + stop_rows(leg_index) * STOP_ROW_HEIGHT;
+}
+
+// Content rows currently inside the scroll layer's frame
+static void get_visible_range(int16_t *top, int16_t *bottom) {
+  GPoint offset = scroll_layer_get_content_offset(s_detail_scroll_layer);
+  *top = -offset.y;
+  *bottom = *top + layer_get_bounds(scroll_layer_get_layer(s_detail_scroll_layer)).size.h;
+}
+
+// Visible stop rows of a leg whose first row is at stops_y; false if none
+static bool get_visible_stops(uint8_t leg_index, int16_t stops_y, int16_t top, int16_t bottom,
+                              uint8_t *first, uint8_t *last) {
+  uint8_t rows = stop_rows(leg_index);
+  int16_t stops_end = stops_y + rows * STOP_ROW_HEIGHT;
+  if (rows == 0 || stops_end <= top || stops_y >= bottom) return false;
+
+  *first = top > stops_y ? (top - stops_y) / STOP_ROW_HEIGHT : 0;
+  *last = bottom < stops_end ? (bottom - 1 - stops_y) / STOP_ROW_HEIGHT : rows - 1;
+  return true;
+}
+
+// Ask the phone for stops that scrolled into view
+static void request_visible_stops(void) {
+  if (!s_detail_scroll_layer || !state_is_detail_received()) return;
+
+  int16_t top, bottom;
+  get_visible_range(&top, &bottom);
+
+  JourneyDetail *journey = state_get_journey_detail();
+  int16_t leg_y = DETAIL_TOP_MARGIN;
+  for (uint8_t i = 0; i < journey->leg_count && leg_y < bottom; i++) {
+    uint8_t first, last;
+    if (get_visible_stops(i, leg_y + LEG_STOPS_OFFSET, top, bottom, &first, &last)) {
+      stop_list_request_range(i, first, last);
+    }
+    leg_y += leg_height(i);
+  }
+}
+
+static void scroll_offset_changed_handler(ScrollLayer *scroll_layer, void *context) {
+  request_visible_stops();
+}
+
+// Draw the visible intermediate stops of a leg
+static void draw_stops(GContext *ctx, GRect bounds, uint8_t leg_index, int16_t stops_y,
+                       int16_t top, int16_t bottom) {
+  uint8_t first, last;
+  if (!get_visible_stops(leg_index, stops_y, top, bottom, &first, &last)) return;
+
+  const int16_t stop_x = 18;
+  const int16_t time_width = 46;
+  GFont font = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+  graphics_context_set_text_color(ctx, GColorBlack);
+
+  for (uint16_t s = first; s <= last; s++) {
+    int16_t y = stops_y + s * STOP_ROW_HEIGHT;
+    const IntermediateStop *stop = stop_list_get(leg_index, s);
+
+    // Journey line continues past every stop
+    graphics_context_set_fill_color(ctx, GColorBlack);
+    graphics_fill_rect(ctx, GRect(stop_x - 8, y + 7, 4, 4), 1, GCornersAll);
+
+    if (!stop) {
+      // Requested from the phone, drawn once it arrives
+      graphics_draw_text(ctx, "...", font, GRect(stop_x, y, time_width, STOP_ROW_HEIGHT),
+                         GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+      continue;
+    }
+
+    static char stop_time_str[12];
+    if (stop->delay > 0) {
+      snprintf(stop_time_str, sizeof(stop_time_str), "%s+%d", stop->time, stop->delay);
+    } else {
+      snprintf(stop_time_str, sizeof(stop_time_str), "%s", stop->time);
+    }
+    graphics_draw_text(ctx, stop_time_str, font, GRect(stop_x, y, time_width, STOP_ROW_HEIGHT),
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+    graphics_draw_text(ctx, stop->name, font,
+                       GRect(stop_x + time_width, y, bounds.size.w - stop_x - time_width - 8, STOP_ROW_HEIGHT),
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+  }
+}
+
 // Custom drawing function for detail window content
 static void detail_content_update_proc(Layer *layer, GContext *ctx) {
+  energy_count(ENERGY_FEATURE_DETAIL, ENERGY_METRIC_REDRAWS, 1);
+
   if (!state_is_detail_received()) {
     // Show loading message
     graphics_context_set_text_color(ctx, GColorBlack);
@@ -30,8 +134,12 @@ static void detail_content_update_proc(Layer *layer, GContext *ctx) {
 
   JourneyDetail *journey = state_get_journey_detail();
 
+  // Only legs and stops inside the visible region are drawn
+  int16_t visible_top, visible_bottom;
+  get_visible_range(&visible_top, &visible_bottom);
+
   // Draw each leg
-  int16_t y_offset = 8;
+  int16_t y_offset = DETAIL_TOP_MARGIN;
   const int16_t margin = 8;
   const int16_t platform_box_size = 16;
   const int16_t line_height = 20;
@@ -39,6 +147,12 @@ static void detail_content_update_proc(Layer *layer, GContext *ctx) {
 
   for (uint8_t i = 0; i < journey->leg_count; i++) {
     JourneyLeg *leg = &journey->legs[i];
+    const int16_t leg_y = y_offset;
+    if (leg_y >= visible_bottom) break;
+    if (leg_y + leg_height(i) <= visible_top) {
+      y_offset += leg_height(i);
+      continue;
+    }
 
     // Abbreviate station names
     char depart_abbrev[32];
@@ -106,10 +220,7 @@ static void detail_content_update_proc(Layer *layer, GContext *ctx) {
 
     // Journey line - Draw dotted vertical line
     const int16_t line_x = margin + 2;
-    for (int16_t dot_y = y_offset; dot_y < y_offset + line_height * 2; dot_y += 4) {
-      graphics_context_set_fill_color(ctx, GColorBlack);
-      graphics_fill_rect(ctx, GRect(line_x, dot_y, 2, 2), 0, GCornerNone);
-    }
+    decorations_draw_journey_line(ctx, GPoint(line_x, y_offset), line_height * 2, GColorBlack);
 
     // Vehicle + direction text
     static char vehicle_line[64];
@@ -137,6 +248,10 @@ static void detail_content_update_proc(Layer *layer, GContext *ctx) {
 
     y_offset += line_height;
 
+    // Intermediate stops (fetched while scrolled into view)
+    draw_stops(ctx, layer_get_bounds(layer), i, y_offset, visible_top, visible_bottom);
+    y_offset += stop_rows(i) * STOP_ROW_HEIGHT;
+
     // Draw arrival row - Time + delay
     static char arrive_time_str[16];
     if (leg->arrive_delay > 0) {
@@ -206,10 +321,45 @@ void detail_window_update(void) {
   if (s_detail_scroll_layer) {
     Layer *window_layer = window_get_root_layer(s_detail_window);
     GRect bounds = layer_get_bounds(window_layer);
-    int16_t content_height = 24 + (state_get_journey_detail()->leg_count * 128);
+    int16_t content_height = DETAIL_TOP_MARGIN + 16;
+    for (uint8_t i = 0; i < state_get_journey_detail()->leg_count; i++) {
+      content_height += leg_height(i);
+    }
     layer_set_frame(s_detail_content_layer, GRect(0, 0, bounds.size.w, content_height));
     scroll_layer_set_content_size(s_detail_scroll_layer, GSize(bounds.size.w, content_height));
   }
+
+  request_visible_stops();
+}
+
+// Redraw after a leg was patched in place (no-op while it's scrolled away)
+void detail_window_update_leg(uint8_t leg_index) {
+  if (!s_detail_content_layer || !state_is_detail_received()) return;
+
+  int16_t top, bottom;
+  get_visible_range(&top, &bottom);
+
+  int16_t leg_y = DETAIL_TOP_MARGIN;
+  for (uint8_t i = 0; i < leg_index; i++) {
+    leg_y += leg_height(i);
+  }
+  if (leg_y < bottom && leg_y + leg_height(leg_index) > top) {
+    layer_mark_dirty(s_detail_content_layer);
+  }
+}
+
+// State change batch: relayout when the journey or its stops changed,
+// otherwise redraw patched legs that are in view
+static void detail_state_changed(const StateChanges *changes, void *context) {
+  if (changes->flags & STATE_CHANGE_DETAIL) {
+    detail_window_update();
+    return;
+  }
+  for (uint8_t i = 0; i < state_get_journey_detail()->leg_count; i++) {
+    if (changes->legs & (1 << i)) {
+      detail_window_update_leg(i);
+    }
+  }
 }
 
 // Detail window lifecycle
@@ -231,6 +381,9 @@ static void detail_window_load(Window *window) {
   // Create ScrollLayer
   s_detail_scroll_layer = scroll_layer_create(scroll_bounds);
   scroll_layer_set_click_config_onto_window(s_detail_scroll_layer, window);
+  scroll_layer_set_callbacks(s_detail_scroll_layer, (ScrollLayerCallbacks) {
+    .content_offset_changed_handler = scroll_offset_changed_handler,
+  });
 
   // Create custom Layer for detail content (large height for scrolling)
   s_detail_content_layer = layer_create(GRect(0, 0, scroll_bounds.size.w, 2000));
@@ -244,9 +397,18 @@ static void detail_window_load(Window *window) {
 
   // Set initial content - mark dirty AFTER adding to hierarchy to ensure first draw
   layer_mark_dirty(s_detail_content_layer);
+
+  // Legs and stops arriving from now on redraw the window
+  state_subscribe(detail_state_changed, NULL);
+
+  diag_heap_sample(DIAG_PHASE_DETAIL);
 }
 
 static void detail_window_unload(Window *window) {
+  // Live updates are only needed while the journey is on screen
+  api_handler_stop_tracking();
+  state_unsubscribe(detail_state_changed);
+
   layer_destroy(s_detail_content_layer);
   s_detail_content_layer = NULL;
   scroll_layer_destroy(s_detail_scroll_layer);
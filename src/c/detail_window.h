@@ -11,5 +11,8 @@ void detail_window_destroy(void);
 // Update detail window content (triggers redraw)
 void detail_window_update(void);
 
+// Redraw after a leg was patched in place (no-op while it's scrolled away)
+void detail_window_update_leg(uint8_t leg_index);
+
 // Get detail window instance (for checking if it's on stack)
 Window* detail_window_get_instance(void);
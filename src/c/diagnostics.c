@@ -0,0 +1,192 @@
+#include "diagnostics.h"
+
+// Upper bounds (exclusive, ms) of the draw time histogram buckets; the last
+// bucket counts everything slower
+static const uint16_t DRAW_BUCKET_LIMITS[] = {2, 5, 10, 20, 50};
+#define NUM_DRAW_BUCKETS (ARRAY_LENGTH(DRAW_BUCKET_LIMITS) + 1)
+
+static const char *PHASE_NAMES[DIAG_NUM_PHASES] = {
+  "Start", "Stations", "Trains", "Detail", "Dashboard"
+};
+
+// Heap high-water marks per phase (0 = phase not reached yet), over every
+// sample from the phase's event until the next phase is reached
+static size_t s_heap_used_max[DIAG_NUM_PHASES];
+static size_t s_heap_free_min[DIAG_NUM_PHASES];
+static DiagPhase s_heap_phase = DIAG_NUM_PHASES;
+
+// Draw timing
+static uint32_t s_draw_buckets[NUM_DRAW_BUCKETS];
+static uint32_t s_draw_count = 0;
+static uint32_t s_draw_total_ms = 0;
+static uint16_t s_draw_max_ms = 0;
+
+// AppMessage traffic
+static uint32_t s_msg_in_count = 0;
+static uint32_t s_msg_in_bytes = 0;
+static uint32_t s_msg_out_count = 0;
+static uint32_t s_msg_out_bytes = 0;
+static uint32_t s_msg_dropped = 0;
+static uint32_t s_msg_failed = 0;
+
+// Marquee
+static uint32_t s_marquee_frames = 0;
+
+// Menu updates from state changes
+static uint32_t s_menu_reloads = 0;
+static uint32_t s_menu_redraws = 0;
+static uint32_t s_menu_skips = 0;
+
+// Last schedule snapshot decode
+static uint16_t s_snapshot_bytes = 0;
+static uint32_t s_snapshot_decode_ms = 0;
+
+// Icon sheet load
+static size_t s_icons_heap_bytes = 0;
+static uint32_t s_icons_load_ms = 0;
+
+static uint32_t now_ms(void) {
+  time_t seconds;
+  uint16_t milliseconds;
+  time_ms(&seconds, &milliseconds);
+  return (uint32_t)seconds * 1000 + milliseconds;
+}
+
+// Fold the current heap usage into the phase last reached
+static void heap_sample_current(void) {
+  if (s_heap_phase == DIAG_NUM_PHASES) return;
+
+  size_t used = heap_bytes_used();
+  size_t free_bytes = heap_bytes_free();
+
+  if (used > s_heap_used_max[s_heap_phase]) {
+    s_heap_used_max[s_heap_phase] = used;
+  }
+  if (s_heap_free_min[s_heap_phase] == 0 || free_bytes < s_heap_free_min[s_heap_phase]) {
+    s_heap_free_min[s_heap_phase] = free_bytes;
+  }
+}
+
+void diag_heap_sample(DiagPhase phase) {
+  s_heap_phase = phase;
+  heap_sample_current();
+}
+
+uint32_t diag_draw_begin(void) {
+  return now_ms();
+}
+
+void diag_draw_end(uint32_t start) {
+  uint32_t elapsed = now_ms() - start;
+
+  uint8_t bucket = 0;
+  while (bucket < ARRAY_LENGTH(DRAW_BUCKET_LIMITS) && elapsed >= DRAW_BUCKET_LIMITS[bucket]) {
+    bucket++;
+  }
+  s_draw_buckets[bucket]++;
+
+  s_draw_count++;
+  s_draw_total_ms += elapsed;
+  if (elapsed > s_draw_max_ms) {
+    s_draw_max_ms = (elapsed > UINT16_MAX) ? UINT16_MAX : (uint16_t)elapsed;
+  }
+  heap_sample_current();
+}
+
+void diag_message_received(DictionaryIterator *iter) {
+  s_msg_in_count++;
+  s_msg_in_bytes += dict_size(iter);
+  heap_sample_current();
+}
+
+void diag_message_sent(DictionaryIterator *iter) {
+  s_msg_out_count++;
+  s_msg_out_bytes += dict_size(iter);
+  heap_sample_current();
+}
+
+void diag_message_dropped(void) {
+  s_msg_dropped++;
+}
+
+void diag_message_failed(void) {
+  s_msg_failed++;
+}
+
+void diag_marquee_frame(void) {
+  s_marquee_frames++;
+}
+
+void diag_menu_reload(void) {
+  s_menu_reloads++;
+}
+
+void diag_menu_redraw(void) {
+  s_menu_redraws++;
+}
+
+void diag_menu_skip(void) {
+  s_menu_skips++;
+}
+
+void diag_snapshot_decoded(uint16_t bytes, uint32_t elapsed_ms) {
+  s_snapshot_bytes = bytes;
+  s_snapshot_decode_ms = elapsed_ms;
+}
+
+void diag_icons_loaded(size_t heap_bytes, uint32_t elapsed_ms) {
+  s_icons_heap_bytes = heap_bytes;
+  s_icons_load_ms = elapsed_ms;
+}
+
+void diag_format(char *buffer, size_t size) {
+  size_t len = 0;
+
+  len += snprintf(buffer + len, size - len, "Heap now %u/%u B\n",
+                  (unsigned)heap_bytes_used(), (unsigned)(heap_bytes_used() + heap_bytes_free()));
+  for (uint8_t i = 0; i < DIAG_NUM_PHASES && len < size; i++) {
+    if (s_heap_used_max[i] == 0) {
+      len += snprintf(buffer + len, size - len, "%s: -\n", PHASE_NAMES[i]);
+    } else {
+      len += snprintf(buffer + len, size - len, "%s: %u used, %u free\n", PHASE_NAMES[i],
+                      (unsigned)s_heap_used_max[i], (unsigned)s_heap_free_min[i]);
+    }
+  }
+
+  if (len < size) {
+    len += snprintf(buffer + len, size - len, "\nRow draw: %lu, avg %lu max %u ms\n",
+                    (unsigned long)s_draw_count,
+                    (unsigned long)(s_draw_count ? s_draw_total_ms / s_draw_count : 0),
+                    s_draw_max_ms);
+  }
+  for (uint8_t i = 0; i < NUM_DRAW_BUCKETS && len < size; i++) {
+    if (i < ARRAY_LENGTH(DRAW_BUCKET_LIMITS)) {
+      len += snprintf(buffer + len, size - len, " <%ums: %lu\n",
+                      DRAW_BUCKET_LIMITS[i], (unsigned long)s_draw_buckets[i]);
+    } else {
+      len += snprintf(buffer + len, size - len, " >=%ums: %lu\n",
+                      DRAW_BUCKET_LIMITS[i - 1], (unsigned long)s_draw_buckets[i]);
+    }
+  }
+
+  if (len < size) {
+    len += snprintf(buffer + len, size - len,
+                    "\nMsg in: %lu (%lu B)\nMsg out: %lu (%lu B)\nDropped: %lu Failed: %lu\n"
+                    "\nMarquee frames: %lu\nMenu: %lu reload, %lu redraw, %lu skip",
+                    (unsigned long)s_msg_in_count, (unsigned long)s_msg_in_bytes,
+                    (unsigned long)s_msg_out_count, (unsigned long)s_msg_out_bytes,
+                    (unsigned long)s_msg_dropped, (unsigned long)s_msg_failed,
+                    (unsigned long)s_marquee_frames, (unsigned long)s_menu_reloads,
+                    (unsigned long)s_menu_redraws, (unsigned long)s_menu_skips);
+  }
+
+  if (len < size && s_snapshot_bytes > 0) {
+    len += snprintf(buffer + len, size - len, "\nSnapshot: %u B, %lu ms",
+                    s_snapshot_bytes, (unsigned long)s_snapshot_decode_ms);
+  }
+
+  if (len < size) {
+    len += snprintf(buffer + len, size - len, "\nIcons: %u B, %lu ms",
+                    (unsigned)s_icons_heap_bytes, (unsigned long)s_icons_load_ms);
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <pebble.h>
+
+// Lightweight runtime counters shown in the hidden diagnostics window
+// (long-press SELECT on the main menu).
+
+// App phases at which heap usage is sampled
+typedef enum {
+  DIAG_PHASE_STARTUP,     // Main window pushed, resources loaded
+  DIAG_PHASE_STATIONS,    // Favorite stations received
+  DIAG_PHASE_DEPARTURES,  // All departures received
+  DIAG_PHASE_DETAIL,      // Journey detail received
+  DIAG_PHASE_DASHBOARD,   // All dashboard routes answered
+  DIAG_NUM_PHASES
+} DiagPhase;
+
+// A phase was reached: record heap usage for it. Menu row draws and
+// AppMessages sampled until the next phase count towards its high-water mark.
+void diag_heap_sample(DiagPhase phase);
+
+// Time a menu row draw: pass the value returned by diag_draw_begin to diag_draw_end
+uint32_t diag_draw_begin(void);
+void diag_draw_end(uint32_t start);
+
+// AppMessage traffic
+void diag_message_received(DictionaryIterator *iter);
+void diag_message_sent(DictionaryIterator *iter);
+void diag_message_dropped(void);
+void diag_message_failed(void);
+
+// Marquee animation frames
+void diag_marquee_frame(void);
+
+// Menu updates from state changes: full reloads, redraws, and batches skipped
+void diag_menu_reload(void);
+void diag_menu_redraw(void);
+void diag_menu_skip(void);
+
+// Schedule snapshot decoded (blob size and decode time)
+void diag_snapshot_decoded(uint16_t bytes, uint32_t elapsed_ms);
+
+// Menu icons loaded (heap taken and load time)
+void diag_icons_loaded(size_t heap_bytes, uint32_t elapsed_ms);
+
+// Format all counters as multi-line text
+void diag_format(char *buffer, size_t size);
@@ -0,0 +1,82 @@
+#include "diagnostics_window.h"
+#include "diagnostics.h"
+
+// Refresh interval while the window is shown
+#define DIAGNOSTICS_REFRESH_MS 1000
+
+// UI elements
+static Window *s_diag_window = NULL;
+static ScrollLayer *s_diag_scroll_layer = NULL;
+static TextLayer *s_diag_text_layer = NULL;
+static AppTimer *s_diag_refresh_timer = NULL;
+
+static char s_diag_text[512];
+
+// Regenerate text and resize the scrollable content to fit it
+static void diagnostics_refresh(void) {
+  diag_format(s_diag_text, sizeof(s_diag_text));
+  text_layer_set_text(s_diag_text_layer, s_diag_text);
+
+  GRect bounds = layer_get_bounds(scroll_layer_get_layer(s_diag_scroll_layer));
+  GSize text_size = text_layer_get_content_size(s_diag_text_layer);
+  layer_set_frame(text_layer_get_layer(s_diag_text_layer),
+                  GRect(4, 0, bounds.size.w - 8, text_size.h + 8));
+  scroll_layer_set_content_size(s_diag_scroll_layer, GSize(bounds.size.w, text_size.h + 8));
+}
+
+static void refresh_timer_callback(void *data) {
+  diagnostics_refresh();
+  s_diag_refresh_timer = app_timer_register(DIAGNOSTICS_REFRESH_MS, refresh_timer_callback, NULL);
+}
+
+// Diagnostics window lifecycle
+static void diagnostics_window_load(Window *window) {
+  Layer *window_layer = window_get_root_layer(window);
+  GRect bounds = layer_get_bounds(window_layer);
+
+  s_diag_scroll_layer = scroll_layer_create(bounds);
+  scroll_layer_set_click_config_onto_window(s_diag_scroll_layer, window);
+
+  // Height is set to fit the text in diagnostics_refresh
+  s_diag_text_layer = text_layer_create(GRect(4, 0, bounds.size.w - 8, 2000));
+  text_layer_set_font(s_diag_text_layer, fonts_get_system_font(FONT_KEY_GOTHIC_14));
+  scroll_layer_add_child(s_diag_scroll_layer, text_layer_get_layer(s_diag_text_layer));
+
+  layer_add_child(window_layer, scroll_layer_get_layer(s_diag_scroll_layer));
+
+  diagnostics_refresh();
+  s_diag_refresh_timer = app_timer_register(DIAGNOSTICS_REFRESH_MS, refresh_timer_callback, NULL);
+}
+
+static void diagnostics_window_unload(Window *window) {
+  if (s_diag_refresh_timer) {
+    app_timer_cancel(s_diag_refresh_timer);
+    s_diag_refresh_timer = NULL;
+  }
+  text_layer_destroy(s_diag_text_layer);
+  s_diag_text_layer = NULL;
+  scroll_layer_destroy(s_diag_scroll_layer);
+  s_diag_scroll_layer = NULL;
+}
+
+// Create and show the diagnostics window
+void diagnostics_window_show(void) {
+  if (!s_diag_window) {
+    s_diag_window = window_create();
+    window_set_window_handlers(s_diag_window, (WindowHandlers) {
+      .load = diagnostics_window_load,
+      .unload = diagnostics_window_unload,
+    });
+  }
+
+  const bool animated = true;
+  window_stack_push(s_diag_window, animated);
+}
+
+// Destroy the diagnostics window
+void diagnostics_window_destroy(void) {
+  if (s_diag_window) {
+    window_destroy(s_diag_window);
+    s_diag_window = NULL;
+  }
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <pebble.h>
+
+// Create and show the diagnostics window
+void diagnostics_window_show(void);
+
+// Destroy the diagnostics window
+void diagnostics_window_destroy(void);
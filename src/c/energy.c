@@ -0,0 +1,165 @@
+#include "energy.h"
+#include "types.h"
+#include "state.h"
+#include "log.h"
+
+typedef struct {
+  uint32_t hour;  // time() / 3600, 0 = empty slot
+  uint32_t counters[ENERGY_NUM_FEATURES][ENERGY_NUM_METRICS];
+} EnergyBucket;
+
+_Static_assert(sizeof(EnergyBucket) <= PERSIST_DATA_MAX_LENGTH, "EnergyBucket too large to persist");
+
+static EnergyBucket s_current;
+
+// Hour held by each ring slot (0 = empty) and the last hour delivered to JS,
+// read once at init so exports don't probe persist storage
+static uint32_t s_slot_hours[ENERGY_BUCKET_COUNT];
+static uint32_t s_exported = 0;
+
+// Failed exports this session; exports stop after ENERGY_MAX_EXPORT_FAILURES
+static uint8_t s_export_failures = 0;
+#define ENERGY_MAX_EXPORT_FAILURES 2
+
+static uint32_t current_hour(void) {
+  return (uint32_t)(time(NULL) / 3600);
+}
+
+static uint32_t slot_key(uint32_t hour) {
+  return PERSIST_KEY_ENERGY_BUCKETS + (hour % ENERGY_BUCKET_COUNT);
+}
+
+static bool read_bucket(uint32_t key, EnergyBucket *bucket) {
+  return persist_exists(key) &&
+         persist_read_data(key, bucket, sizeof(*bucket)) == (int)sizeof(*bucket);
+}
+
+static void save_current(void) {
+  if (s_current.hour != 0) {
+    persist_write_data(slot_key(s_current.hour), &s_current, sizeof(s_current));
+    s_slot_hours[s_current.hour % ENERGY_BUCKET_COUNT] = s_current.hour;
+  }
+}
+
+// Start a new bucket if the hour changed since the last count
+static void roll_bucket(void) {
+  uint32_t hour = current_hour();
+  if (s_current.hour == hour) return;
+
+  save_current();
+  memset(&s_current, 0, sizeof(s_current));
+  s_current.hour = hour;
+}
+
+void energy_init(void) {
+  EnergyBucket bucket;
+  for (uint32_t i = 0; i < ENERGY_BUCKET_COUNT; i++) {
+    s_slot_hours[i] = read_bucket(PERSIST_KEY_ENERGY_BUCKETS + i, &bucket) ? bucket.hour : 0;
+  }
+  s_exported = persist_exists(PERSIST_KEY_ENERGY_EXPORTED) ?
+               (uint32_t)persist_read_int(PERSIST_KEY_ENERGY_EXPORTED) : 0;
+
+  uint32_t hour = current_hour();
+  if (!read_bucket(slot_key(hour), &s_current) || s_current.hour != hour) {
+    memset(&s_current, 0, sizeof(s_current));
+    s_current.hour = hour;
+  }
+
+  // Wakes the worker accumulated while the app wasn't running. The worker
+  // owns the total; the app only moves its own mark, so no wake is lost
+  // to the two writing the same key.
+  if (persist_exists(PERSIST_KEY_WORKER_WAKES)) {
+    uint32_t total = (uint32_t)persist_read_int(PERSIST_KEY_WORKER_WAKES);
+    uint32_t seen = persist_exists(PERSIST_KEY_WORKER_WAKES_SEEN) ?
+                    (uint32_t)persist_read_int(PERSIST_KEY_WORKER_WAKES_SEEN) : 0;
+    if (total != seen) {
+      energy_count(ENERGY_FEATURE_BACKGROUND, ENERGY_METRIC_WORKER_WAKES, total - seen);
+      persist_write_int(PERSIST_KEY_WORKER_WAKES_SEEN, (int32_t)total);
+    }
+  }
+
+  EnergyFeature feature;
+  switch (launch_reason()) {
+    case APP_LAUNCH_WORKER:
+    case APP_LAUNCH_WAKEUP:
+      feature = ENERGY_FEATURE_BACKGROUND;
+      break;
+    case APP_LAUNCH_PHONE:
+      feature = ENERGY_FEATURE_CONFIG;
+      break;
+    default:
+      feature = ENERGY_FEATURE_FOREGROUND;
+      break;
+  }
+  energy_count(feature, ENERGY_METRIC_LAUNCHES, 1);
+}
+
+void energy_deinit(void) {
+  save_current();
+}
+
+void energy_count(EnergyFeature feature, EnergyMetric metric, uint32_t amount) {
+  roll_bucket();
+  uint32_t *counter = &s_current.counters[feature][metric];
+  *counter = (*counter > UINT32_MAX - amount) ? UINT32_MAX : *counter + amount;
+}
+
+EnergyFeature energy_feature_for_message(uint8_t message_type) {
+  switch (message_type) {
+    case MSG_REQUEST_DETAILS:
+    case MSG_SEND_DETAIL:
+      return ENERGY_FEATURE_DETAIL;
+    case MSG_SEND_STATION_COUNT:
+    case MSG_SEND_STATION:
+    case MSG_SCHEDULE_TABLE:
+    case MSG_DASHBOARD_ROUTES:
+      return ENERGY_FEATURE_CONFIG;
+    case MSG_SNAPSHOT:
+      return ENERGY_FEATURE_BACKGROUND;
+    default:
+      return state_is_background_update() ? ENERGY_FEATURE_BACKGROUND : ENERGY_FEATURE_FOREGROUND;
+  }
+}
+
+bool energy_export_next(void) {
+  if (s_export_failures >= ENERGY_MAX_EXPORT_FAILURES) return false;
+
+  // Oldest closed hour that hasn't been exported yet
+  uint32_t oldest_hour = 0;
+  for (uint32_t i = 0; i < ENERGY_BUCKET_COUNT; i++) {
+    uint32_t hour = s_slot_hours[i];
+    if (hour == 0 || hour <= s_exported || hour >= s_current.hour) continue;
+    if (oldest_hour == 0 || hour < oldest_hour) {
+      oldest_hour = hour;
+    }
+  }
+  if (oldest_hour == 0) return false;
+
+  EnergyBucket bucket;
+  if (!read_bucket(slot_key(oldest_hour), &bucket) || bucket.hour != oldest_hour) {
+    // Overwritten since init; forget the slot
+    s_slot_hours[oldest_hour % ENERGY_BUCKET_COUNT] = 0;
+    return false;
+  }
+
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) return false;
+
+  dict_write_uint8(iter, MESSAGE_KEY_MESSAGE_TYPE, MSG_ENERGY_REPORT);
+  dict_write_uint32(iter, MESSAGE_KEY_ENERGY_HOUR, bucket.hour);
+  dict_write_data(iter, MESSAGE_KEY_ENERGY_DATA, (const uint8_t *)bucket.counters,
+                  sizeof(bucket.counters));
+  app_message_outbox_send();
+
+  LOG_DEBUG("Exporting energy bucket for hour %lu", (unsigned long)bucket.hour);
+  return true;
+}
+
+void energy_mark_exported(uint32_t hour) {
+  s_exported = hour;
+  persist_write_int(PERSIST_KEY_ENERGY_EXPORTED, (int32_t)hour);
+}
+
+void energy_export_failed(void) {
+  s_export_failures++;
+}
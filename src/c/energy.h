@@ -0,0 +1,53 @@
+#pragma once
+
+#include <pebble.h>
+
+// Radio and energy accounting per feature.
+//
+// Counters are kept in hourly buckets, persisted in a small ring in watch
+// storage and exported to PebbleKit JS (MSG_ENERGY_REPORT) once an hour has
+// closed, where they are merged with the phone-side HTTP counters.
+
+// What the work was done for
+typedef enum {
+  ENERGY_FEATURE_FOREGROUND,   // User-visible departure list
+  ENERGY_FEATURE_BACKGROUND,   // Worker-driven glance refresh
+  ENERGY_FEATURE_DETAIL,       // Journey detail window
+  ENERGY_FEATURE_CONFIG,       // Favorite stations and active route
+  ENERGY_NUM_FEATURES
+} EnergyFeature;
+
+// What was counted
+typedef enum {
+  ENERGY_METRIC_MSG_IN,        // AppMessages received
+  ENERGY_METRIC_MSG_OUT,       // AppMessages sent
+  ENERGY_METRIC_BYTES_IN,      // AppMessage payload bytes received
+  ENERGY_METRIC_BYTES_OUT,     // AppMessage payload bytes sent
+  ENERGY_METRIC_LAUNCHES,      // App launches
+  ENERGY_METRIC_WORKER_WAKES,  // Background worker tick wakeups
+  ENERGY_METRIC_REDRAWS,       // Rows/layers drawn
+  ENERGY_NUM_METRICS
+} EnergyMetric;
+
+// Load the current hour's bucket and count this launch
+void energy_init(void);
+
+// Persist the current bucket (call on exit)
+void energy_deinit(void);
+
+// Add to a counter in the current hour's bucket
+void energy_count(EnergyFeature feature, EnergyMetric metric, uint32_t amount);
+
+// Feature a message type belongs to
+EnergyFeature energy_feature_for_message(uint8_t message_type);
+
+// Send the oldest closed bucket not yet exported; false if there is none or
+// the outbox is busy. The caller decides when the outbox is free for it
+// (api_handler: no request pending or loading).
+bool energy_export_next(void);
+
+// Mark a bucket as exported (called once its report was delivered)
+void energy_mark_exported(uint32_t hour);
+
+// An energy report failed; after a few, exports wait for the next launch
+void energy_export_failed(void);
@@ -1,16 +1,17 @@
 #include "glances.h"
 #include "state.h"
 #include "api_handler.h"
+#include "log.h"
 
 // AppGlance update callback (only on platforms with AppGlance support)
 #if defined(PBL_HEALTH)
 static void update_app_glance(AppGlanceReloadSession *session, size_t limit, void *context) {
-  APP_LOG(APP_LOG_LEVEL_INFO, "Updating AppGlance (limit: %zu, departures: %d)",
-          limit, state_get_num_departures());
+  LOG_INFO("Updating AppGlance (limit: %zu, departures: %d)",
+           limit, state_get_num_departures());
 
   // Check if we have space for at least one slice
   if (limit < 1) {
-    APP_LOG(APP_LOG_LEVEL_WARNING, "AppGlance limit too low: %zu", limit);
+    LOG_WARNING("AppGlance limit too low: %zu", limit);
     return;
   }
 
@@ -44,14 +45,23 @@ static void update_app_glance(AppGlanceReloadSession *session, size_t limit, voi
 
     AppGlanceResult result = app_glance_add_slice(session, slice);
     if (result != APP_GLANCE_RESULT_SUCCESS) {
-      APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to add train slice %d: %d", i, result);
+      LOG_ERROR("Failed to add train slice %d: %d", i, result);
     }
   }
 
-  APP_LOG(APP_LOG_LEVEL_INFO, "AppGlance updated with %d train slices", max_slices);
+  LOG_INFO("AppGlance updated with %d train slices", max_slices);
 }
 #endif  // PBL_HEALTH
 
+// State change batch: refresh the glance when a complete departure list
+// arrives or loses trains
+static void glances_state_changed(const StateChanges *changes, void *context) {
+  if ((changes->flags & (STATE_CHANGE_LOAD_STATE | STATE_CHANGE_DEPARTURE_LIST)) &&
+      state_get_load_state() == LOAD_STATE_COMPLETE && !state_is_data_loading()) {
+    glances_update();
+  }
+}
+
 // Update app glances (handles platform checks internally)
 void glances_update(void) {
   #if defined(PBL_HEALTH)
@@ -63,11 +73,11 @@ void glances_update(void) {
 void glances_update_on_exit(void) {
   #if defined(PBL_HEALTH)
     if (state_get_num_departures() > 0) {
-      APP_LOG(APP_LOG_LEVEL_INFO, "Updating glances on app exit (departures: %d)",
-              state_get_num_departures());
+      LOG_INFO("Updating glances on app exit (departures: %d)",
+               state_get_num_departures());
       app_glance_reload(update_app_glance, NULL);
     } else {
-      APP_LOG(APP_LOG_LEVEL_INFO, "No departures to show in glances");
+      LOG_INFO("No departures to show in glances");
     }
   #endif
 }
@@ -75,7 +85,7 @@ void glances_update_on_exit(void) {
 // Worker message handler
 static void worker_message_handler(uint16_t type, AppWorkerMessage *data) {
   if (type == WORKER_REQUEST_GLANCE) {
-    APP_LOG(APP_LOG_LEVEL_INFO, "Worker requesting glance update");
+    LOG_INFO("Worker requesting glance update");
     state_set_background_update(true);
     api_handler_request_train_data();  // Reuse existing function!
   }
@@ -85,4 +95,7 @@ static void worker_message_handler(uint16_t type, AppWorkerMessage *data) {
 void glances_handle_worker_request(void) {
   // Subscribe to worker messages for background glance updates
   app_worker_message_subscribe(worker_message_handler);
+
+  // Refresh the glance from departure list changes
+  state_subscribe(glances_state_changed, NULL);
 }
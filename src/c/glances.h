@@ -8,5 +8,6 @@ void glances_update(void);
 // Update glances on app exit
 void glances_update_on_exit(void);
 
-// Handle worker message requesting glance update
+// Handle worker messages requesting a glance update, and refresh the
+// glance when the departure list changes
 void glances_handle_worker_request(void);
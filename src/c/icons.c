@@ -0,0 +1,67 @@
+#include "icons.h"
+#include "diagnostics.h"
+#include "log.h"
+
+static GBitmap *s_sheet = NULL;
+static GBitmap *s_icons[ICON_COUNT];
+
+// Palettes swapped onto an icon before it is drawn (background stays clear)
+static GColor s_palette_normal[2];
+static GColor s_palette_highlighted[2];
+
+static uint32_t now_ms(void) {
+  time_t seconds;
+  uint16_t milliseconds;
+  time_ms(&seconds, &milliseconds);
+  return (uint32_t)seconds * 1000 + milliseconds;
+}
+
+void icons_init(void) {
+  uint32_t start = now_ms();
+  size_t heap_before = heap_bytes_used();
+
+  s_sheet = gbitmap_create_with_resource(RESOURCE_ID_ICON_SHEET);
+  if (!s_sheet) {
+    LOG_ERROR("Icon sheet not loaded");
+    return;
+  }
+
+  // The build tool decides which palette entry holds the (black) icon pixels
+  GColor *palette = gbitmap_get_palette(s_sheet);
+  uint8_t ink = (palette && gcolor_equal(palette[0], GColorWhite)) ? 1 : 0;
+  s_palette_normal[ink] = GColorBlack;
+  s_palette_normal[!ink] = GColorClear;
+  s_palette_highlighted[ink] = GColorWhite;
+  s_palette_highlighted[!ink] = GColorClear;
+
+  for (uint8_t i = 0; i < ICON_COUNT; i++) {
+    s_icons[i] = gbitmap_create_as_sub_bitmap(s_sheet, GRect(0, i * ICON_SIZE, ICON_SIZE, ICON_SIZE));
+  }
+
+  size_t heap_bytes = heap_bytes_used() - heap_before;
+  uint32_t elapsed = now_ms() - start;
+  diag_icons_loaded(heap_bytes, elapsed);
+  LOG_INFO("Loaded %d icons from 1 resource: %u B heap in %lu ms",
+           ICON_COUNT, (unsigned)heap_bytes, (unsigned long)elapsed);
+}
+
+void icons_deinit(void) {
+  for (uint8_t i = 0; i < ICON_COUNT; i++) {
+    if (s_icons[i]) {
+      gbitmap_destroy(s_icons[i]);
+      s_icons[i] = NULL;
+    }
+  }
+  if (s_sheet) {
+    gbitmap_destroy(s_sheet);
+    s_sheet = NULL;
+  }
+}
+
+void icons_draw(GContext *ctx, IconId icon, GPoint origin, bool highlighted) {
+  if (icon >= ICON_COUNT || !s_icons[icon]) return;
+
+  gbitmap_set_palette(s_icons[icon], highlighted ? s_palette_highlighted : s_palette_normal, false);
+  graphics_context_set_compositing_mode(ctx, GCompOpSet);
+  graphics_draw_bitmap_in_rect(ctx, s_icons[icon], GRect(origin.x, origin.y, ICON_SIZE, ICON_SIZE));
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <pebble.h>
+
+// Menu icons, cut as sub-bitmaps from one 1-bit sprite sheet
+// (resources/icons_1bit.png, packed by scripts/generate_icons.sh --sheet).
+// The sheet has a two-colour palette; highlighted rows draw the same pixels
+// with a white-on-clear palette instead of loading inverted copies.
+
+#define ICON_SIZE 16
+
+// Icons in sheet order (top to bottom, see SHEET_ICONS in generate_icons.sh)
+typedef enum {
+  ICON_SWITCH,
+  ICON_AIRPORT,
+  ICON_START,
+  ICON_FINISH,
+  ICON_COUNT
+} IconId;
+
+// Load the sheet and cut out the icons
+void icons_init(void);
+
+// Free the sheet and its sub-bitmaps
+void icons_deinit(void);
+
+// Draw an icon at origin: black, or white on a highlighted row
+void icons_draw(GContext *ctx, IconId icon, GPoint origin, bool highlighted);
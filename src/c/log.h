@@ -0,0 +1,33 @@
+#pragma once
+
+#include <pebble.h>
+
+// Compile-time log levels. Calls above LOG_LEVEL compile to dead code: the
+// arguments are still type-checked, but no format strings or formatting calls
+// end up in the binary. Release builds (`COMMUTER_RELEASE=1 pebble build`,
+// which defines RELEASE) keep only warnings and errors.
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+  #if defined(RELEASE)
+    #define LOG_LEVEL LOG_LEVEL_WARNING
+  #else
+    #define LOG_LEVEL LOG_LEVEL_DEBUG
+  #endif
+#endif
+
+#define LOG_AT(min_level, app_level, fmt, ...)           \
+  do {                                                   \
+    if (LOG_LEVEL >= (min_level)) {                      \
+      APP_LOG(app_level, fmt, ##__VA_ARGS__);            \
+    }                                                    \
+  } while (0)
+
+#define LOG_ERROR(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, APP_LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_WARNING(fmt, ...) LOG_AT(LOG_LEVEL_WARNING, APP_LOG_LEVEL_WARNING, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) LOG_AT(LOG_LEVEL_INFO, APP_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, APP_LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
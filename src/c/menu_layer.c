@@ -1,22 +1,46 @@
 #include "menu_layer.h"
 #include "state.h"
 #include "api_handler.h"
+#include "diagnostics.h"
+#include "diagnostics_window.h"
+#include "station_search_window.h"
+#include "energy.h"
+#include "countdown.h"
+#include "icons.h"
+#include "decorations.h"
+#include "dashboard.h"
+#include "alerts.h"
+#include "log.h"
+
+// Most sections the menu shows: route + connections, or one per dashboard route
+#define MAX_SECTIONS (DASHBOARD_MAX_ROUTES > 2 ? DASHBOARD_MAX_ROUTES : 2)
+
+// Skeleton shimmer (runs while no stations are known)
+#define SHIMMER_INTERVAL_MS 100
+static AppTimer *s_shimmer_timer = NULL;
+static uint16_t s_shimmer_frame = 0;
+
+static void shimmer_timer_callback(void *data) {
+  MenuLayer *menu_layer = (MenuLayer *)data;
+
+  if (state_get_num_stations() > 0) {
+    s_shimmer_timer = NULL;
+    s_shimmer_frame = 0;
+    return;
+  }
 
-// Icon resources (set by menu_layer_init)
-static GBitmap *s_icon_switch = NULL;
-static GBitmap *s_icon_switch_white = NULL;
-static GBitmap *s_icon_airport = NULL;
-static GBitmap *s_icon_airport_white = NULL;
-static GBitmap *s_icon_start = NULL;
-static GBitmap *s_icon_start_white = NULL;
-static GBitmap *s_icon_finish = NULL;
-static GBitmap *s_icon_finish_white = NULL;
+  // Only the frame changes: each redraw is the same single blit per skeleton
+  s_shimmer_frame++;
+  layer_mark_dirty(menu_layer_get_layer(menu_layer));
+  s_shimmer_timer = app_timer_register(SHIMMER_INTERVAL_MS, shimmer_timer_callback, menu_layer);
+}
 
 // Marquee timer callback
 static void marquee_timer_callback(void *data) {
   // Slow scroll: 1 pixel per frame
   if (state_get_marquee_offset() < state_get_marquee_max_offset()) {
     state_set_marquee_offset(state_get_marquee_offset() + 1);
+    diag_marquee_frame();
 
     // Redraw the menu layer (we need to get menu layer from data passed in)
     MenuLayer *menu_layer = (MenuLayer *)data;
@@ -30,19 +54,76 @@ static void marquee_timer_callback(void *data) {
   }
 }
 
+// Departure rows are on screen: the list is complete, or still arriving
+// but its first row is there (the others show placeholders)
+static bool departures_shown(void) {
+  if (state_is_data_failed() || state_get_num_departures() == 0) return false;
+  return !state_is_data_loading() ||
+         (state_get_load_state() == LOAD_STATE_RECEIVING &&
+          state_get_departures()[0].fill != DEPARTURE_FILL_NONE);
+}
+
+// Section 0 rows after "From" and "To": the way to the dashboard, then the
+// disruption alerts (each only when there is something to show)
+static bool is_dashboard_row(uint16_t row) {
+  return row == 2 && dashboard_is_available();
+}
+
+static bool is_alerts_row(uint16_t row) {
+  return row >= 2 && !is_dashboard_row(row) && alerts_get_count() > 0;
+}
+
+// Alert summary shown on the alerts row (SELECT steps through them)
+static uint8_t s_alert_index = 0;
+
+// "!" in a circle in the row's text colour; planned works get an outline
+static void draw_alert_badge(GContext *ctx, GPoint center, bool selected, bool planned) {
+  GColor color = selected ? GColorWhite : GColorBlack;
+  if (planned) {
+    graphics_context_set_stroke_color(ctx, color);
+    graphics_draw_circle(ctx, center, 6);
+    graphics_context_set_text_color(ctx, color);
+  } else {
+    graphics_context_set_fill_color(ctx, color);
+    graphics_fill_circle(ctx, center, 6);
+    graphics_context_set_text_color(ctx, selected ? GColorBlack : GColorWhite);
+  }
+  graphics_draw_text(ctx,
+                     "!",
+                     fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD),
+                     GRect(center.x - 6, center.y - 9, 12, 14),
+                     GTextOverflowModeFill,
+                     GTextAlignmentCenter,
+                     NULL);
+}
+
 // MenuLayer Callbacks
 static uint16_t menu_get_num_sections_callback(MenuLayer *menu_layer, void *context) {
+  // Dashboard: one section per route
+  if (dashboard_is_shown()) {
+    return dashboard_get_route_count();
+  }
   return 2;  // Section 0: Station selectors, Section 1: Train departures
 }
 
 static uint16_t menu_get_num_rows_callback(MenuLayer *menu_layer,
                                             uint16_t section_index,
                                             void *context) {
+  if (dashboard_is_shown()) {
+    // 1 row for loading, error, or when no departures
+    if (dashboard_get_status(section_index) != DASHBOARD_ROUTE_READY ||
+        dashboard_get_num_departures(section_index) == 0) {
+      return 1;
+    }
+    return dashboard_get_num_departures(section_index);
+  }
+
   if (section_index == 0) {
-    return 2;  // "From" and "To" selectors
+    // "From" and "To" selectors, plus the way to the dashboard and alerts
+    return 2 + (dashboard_is_available() ? 1 : 0) + (alerts_get_count() > 0 ? 1 : 0);
   } else {
     // Show 1 row for loading, error, or when no departures
-    if (state_is_data_loading() || state_is_data_failed() || state_get_num_departures() == 0) {
+    if (!departures_shown()) {
       return 1;
     }
     return state_get_num_departures();
@@ -65,20 +146,23 @@ static void menu_draw_header_callback(GContext *ctx,
   graphics_context_set_fill_color(ctx, GColorBlack);
   graphics_fill_rect(ctx, bounds, 0, GCornerNone);
 
-  // Draw dotted border on top
-  graphics_context_set_stroke_color(ctx, GColorWhite);
-  graphics_context_set_stroke_width(ctx, 1);
-  for (int x = 0; x < bounds.size.w; x += 4) {
-    graphics_draw_line(ctx, GPoint(x, 0), GPoint(x + 2, 0));
-  }
-
-  // Draw dotted border on bottom
-  for (int x = 0; x < bounds.size.w; x += 4) {
-    graphics_draw_line(ctx, GPoint(x, bounds.size.h - 1), GPoint(x + 2, bounds.size.h - 1));
+  // Draw dotted borders on top and bottom
+  decorations_draw_dotted_line(ctx, GPoint(0, 0), bounds.size.w, GColorWhite);
+  decorations_draw_dotted_line(ctx, GPoint(0, bounds.size.h - 1), bounds.size.w, GColorWhite);
+
+  // Draw header text (the route's stations on the dashboard)
+  static char route_text[64];
+  const char *header_text;
+  if (dashboard_is_shown()) {
+    uint8_t from_index, to_index;
+    dashboard_get_route(section_index, &from_index, &to_index);
+    snprintf(route_text, sizeof(route_text), "%s > %s",
+             state_get_stations()[from_index].name, state_get_stations()[to_index].name);
+    header_text = route_text;
+  } else {
+    header_text = (section_index == 0) ? "Route" :
+                  state_is_data_offline() ? "Scheduled (offline)" : "Connections";
   }
-
-  // Draw header text
-  const char *header_text = (section_index == 0) ? "Route" : "Connections";
   graphics_context_set_text_color(ctx, GColorWhite);
   graphics_draw_text(ctx,
                      header_text,
@@ -89,37 +173,172 @@ static void menu_draw_header_callback(GContext *ctx,
                      NULL);
 }
 
-static void menu_draw_row_callback(GContext *ctx,
-                                    const Layer *cell_layer,
-                                    MenuIndex *cell_index,
-                                    void *context) {
+// Dashboard row: departure and arrival times and platform on one short line
+static void draw_dashboard_row(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index) {
   GRect bounds = layer_get_bounds(cell_layer);
+  bool selected = menu_cell_layer_is_highlighted(cell_layer);
+  GColor text_color = selected ? GColorWhite : GColorBlack;
+  graphics_context_set_text_color(ctx, text_color);
+
+  // Loading, error, or no departures
+  DashboardRouteStatus status = dashboard_get_status(cell_index->section);
+  if (status != DASHBOARD_ROUTE_READY || dashboard_get_num_departures(cell_index->section) == 0) {
+    const char *message = status == DASHBOARD_ROUTE_LOADING ? "Loading..." :
+                          status == DASHBOARD_ROUTE_FAILED ? "Connection failed" :
+                          "No connections found";
+    graphics_draw_text(ctx,
+                       message,
+                       fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD),
+                       GRect(4, 2, bounds.size.w - 8, 18),
+                       GTextOverflowModeTrailingEllipsis,
+                       GTextAlignmentCenter,
+                       NULL);
+    return;
+  }
+
+  const CompactDeparture *departure =
+    dashboard_get_departure(cell_index->section, cell_index->row);
+
+  // Platform box on the right, sized to the shorter row
+  const int16_t platform_box_size = 20;
+  const int16_t platform_box_margin = 4;
+  GRect platform_box = GRect(
+    bounds.size.w - platform_box_size - platform_box_margin,
+    (bounds.size.h - platform_box_size) / 2,
+    platform_box_size,
+    platform_box_size
+  );
+
+  // Times are formatted here, the rows only keep the timestamp
+  char depart_time[6], arrive_time[6];
+  time_t arrive = departure->depart_timestamp + departure->duration * 60;
+  strftime(depart_time, sizeof(depart_time), "%H:%M", localtime(&departure->depart_timestamp));
+  strftime(arrive_time, sizeof(arrive_time), "%H:%M", localtime(&arrive));
+
+  static char time_range[32];
+  bool has_delay = (departure->depart_delay > 0 || departure->arrive_delay > 0);
+  GFont time_font;
+  int16_t time_y = 0;
+  if (has_delay) {
+    time_font = fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD);
+    time_y = 2;
+    snprintf(time_range, sizeof(time_range), "%s+%d > %s+%d",
+             depart_time, departure->depart_delay, arrive_time, departure->arrive_delay);
+  } else {
+    time_font = fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
+    snprintf(time_range, sizeof(time_range), "%s > %s", depart_time, arrive_time);
+  }
+
+  // Alert badge and connection icon between the times and the platform
+  int16_t alert_space = departure->has_alert ? 14 : 0;
+  int16_t icon_space = !departure->is_direct ? 18 : 0;  // 16px icon + 2px gap
+  int16_t time_width = bounds.size.w - platform_box_size - platform_box_margin - alert_space -
+                       icon_space - 8;
+  graphics_draw_text(ctx,
+                     time_range,
+                     time_font,
+                     GRect(4, time_y, time_width, 20),
+                     GTextOverflowModeTrailingEllipsis,
+                     GTextAlignmentLeft,
+                     NULL);
+  if (departure->has_alert) {
+    draw_alert_badge(ctx, GPoint(4 + time_width + 7, bounds.size.h / 2), selected, false);
+  }
+  if (!departure->is_direct) {
+    icons_draw(ctx, ICON_SWITCH,
+               GPoint(4 + time_width + alert_space + 2, (bounds.size.h - ICON_SIZE) / 2), selected);
+  }
+
+  // Platform box: filled, or an outline when the platform changed
+  GColor platform_bg_color = selected ? GColorWhite : GColorBlack;
+  GColor platform_text_color = selected ? GColorBlack : GColorWhite;
+  if (departure->platform_changed) {
+    graphics_context_set_stroke_color(ctx, platform_bg_color);
+    graphics_context_set_stroke_width(ctx, 1);
+    graphics_draw_round_rect(ctx, platform_box, 2);
+  } else {
+    graphics_context_set_fill_color(ctx, platform_bg_color);
+    graphics_fill_rect(ctx, platform_box, 2, GCornersAll);
+  }
+
+  graphics_context_set_text_color(ctx, departure->platform_changed ? text_color : platform_text_color);
+  GRect platform_text_rect = platform_box;
+  platform_text_rect.origin.y -= 3;
+  graphics_draw_text(ctx,
+                     departure->platform,
+                     fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD),
+                     platform_text_rect,
+                     GTextOverflowModeTrailingEllipsis,
+                     GTextAlignmentCenter,
+                     NULL);
+}
+
+static void draw_row(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index) {
+  GRect bounds = layer_get_bounds(cell_layer);
+
+  if (dashboard_is_shown()) {
+    draw_dashboard_row(ctx, cell_layer, cell_index);
+    return;
+  }
 
   // Section 0: Station selectors
   if (cell_index->section == 0) {
     bool selected = menu_cell_layer_is_highlighted(cell_layer);
     GColor text_color = selected ? GColorWhite : GColorBlack;
 
+    // Disruption alerts: one summary at a time
+    if (is_alerts_row(cell_index->row)) {
+      if (s_alert_index >= alerts_get_count()) s_alert_index = 0;
+      draw_alert_badge(ctx, GPoint(12, 12), selected, alerts_is_planned(s_alert_index));
+
+      static char alert_text[ALERT_TITLE_LEN + 8];
+      if (alerts_get_count() > 1) {
+        snprintf(alert_text, sizeof(alert_text), "%d/%d %s", s_alert_index + 1,
+                 alerts_get_count(), alerts_get_title(s_alert_index));
+      } else {
+        snprintf(alert_text, sizeof(alert_text), "%s", alerts_get_title(s_alert_index));
+      }
+      graphics_context_set_text_color(ctx, text_color);
+      graphics_draw_text(ctx,
+                         alert_text,
+                         fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD),
+                         GRect(24, 2, bounds.size.w - 28, 20),
+                         GTextOverflowModeTrailingEllipsis,
+                         GTextAlignmentLeft,
+                         NULL);
+      return;
+    }
+
+    // Third row: switch to the dashboard
+    if (is_dashboard_row(cell_index->row)) {
+      icons_draw(ctx, ICON_SWITCH, GPoint(4, 4), selected);
+      graphics_context_set_text_color(ctx, text_color);
+      graphics_draw_text(ctx,
+                         "Dashboard",
+                         fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD),
+                         GRect(24, 0, bounds.size.w - 28, 20),
+                         GTextOverflowModeTrailingEllipsis,
+                         GTextAlignmentLeft,
+                         NULL);
+      return;
+    }
+
     // Draw icon on the left
-    GBitmap *icon;
+    IconId icon;
     const char *station_name;
 
     if (cell_index->row == 0) {
       // "From" station selector - use start icon
-      icon = selected ? s_icon_start_white : s_icon_start;
+      icon = ICON_START;
       station_name = (state_get_num_stations() > 0) ? state_get_stations()[state_get_from_station_index()].name : NULL;
     } else {
       // "To" station selector - use finish icon
-      icon = selected ? s_icon_finish_white : s_icon_finish;
+      icon = ICON_FINISH;
       station_name = (state_get_num_stations() > 0) ? state_get_stations()[state_get_to_station_index()].name : NULL;
     }
 
     // Draw icon (16x16) with some padding
-    if (icon) {
-      GRect icon_rect = GRect(4, 4, 16, 16);
-      graphics_context_set_compositing_mode(ctx, GCompOpSet);
-      graphics_draw_bitmap_in_rect(ctx, icon, icon_rect);
-    }
+    icons_draw(ctx, icon, GPoint(4, 4), selected);
 
     // Draw station name or skeleton
     if (station_name) {
@@ -139,16 +358,7 @@ static void menu_draw_row_callback(GContext *ctx,
       // When selected, background is black so use white dither
       // When not selected, background is white so use black dither
       GColor dither_color = selected ? GColorWhite : GColorBlack;
-      graphics_context_set_stroke_color(ctx, dither_color);
-
-      // Create sparse dithered pattern (every 3rd pixel for less opacity)
-      for (int y = skeleton_rect.origin.y; y < skeleton_rect.origin.y + skeleton_rect.size.h; y++) {
-        for (int x = skeleton_rect.origin.x; x < skeleton_rect.origin.x + skeleton_rect.size.w; x++) {
-          if ((x + y) % 3 == 0) {
-            graphics_draw_pixel(ctx, GPoint(x, y));
-          }
-        }
-      }
+      decorations_draw_skeleton(ctx, skeleton_rect, dither_color, s_shimmer_frame);
     }
 
     return;
@@ -172,7 +382,7 @@ static void menu_draw_row_callback(GContext *ctx,
   }
 
   // Show loading indicator based on state machine
-  if (state_is_data_loading()) {
+  if (state_is_data_loading() && !departures_shown()) {
     bool selected = menu_cell_layer_is_highlighted(cell_layer);
     GColor text_color = selected ? GColorWhite : GColorBlack;
     graphics_context_set_text_color(ctx, text_color);
@@ -185,6 +395,9 @@ static void menu_draw_row_callback(GContext *ctx,
       case LOAD_STATE_FETCHING:
         loading_message = "Loading trains...";
         break;
+      case LOAD_STATE_THROTTLED:
+        loading_message = "iRail busy, retrying...";
+        break;
       case LOAD_STATE_RECEIVING:
         loading_message = "Receiving trains...";
         break;
@@ -212,7 +425,8 @@ static void menu_draw_row_callback(GContext *ctx,
     GColor text_color = selected ? GColorWhite : GColorBlack;
     graphics_context_set_text_color(ctx, text_color);
     graphics_draw_text(ctx,
-                       "Connection failed",
+                       state_get_load_state() == LOAD_STATE_THROTTLED ?
+                       "iRail busy, try later" : "Connection failed",
                        fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD),
                        GRect(4, 10, bounds.size.w - 8, 24),
                        GTextOverflowModeTrailingEllipsis,
@@ -240,6 +454,18 @@ static void menu_draw_row_callback(GContext *ctx,
 
   // Check if this row is selected
   bool selected = menu_cell_layer_is_highlighted(cell_layer);
+
+  // Row still on its way: placeholders for the times and the details (all
+  // placeholders share the station selector's size, so one bitmap serves)
+  GSize skeleton_size = GSize(bounds.size.w - 40, 16);
+  if (departure->fill == DEPARTURE_FILL_NONE) {
+    GColor dither_color = selected ? GColorWhite : GColorBlack;
+    decorations_draw_skeleton(ctx, GRect(4, 3, skeleton_size.w, skeleton_size.h), dither_color,
+                              s_shimmer_frame);
+    decorations_draw_skeleton(ctx, GRect(4, 23, skeleton_size.w, skeleton_size.h), dither_color,
+                              s_shimmer_frame);
+    return;
+  }
   GColor text_color = selected ? GColorWhite : GColorBlack;
   GColor platform_bg_color = selected ? GColorWhite : GColorBlack;
   GColor platform_text_color = selected ? GColorBlack : GColorWhite;
@@ -256,14 +482,16 @@ static void menu_draw_row_callback(GContext *ctx,
     platform_box_size
   );
 
-  // Draw time range on the left (primary, bold, larger)
+  // Draw time range on the left (primary, bold, larger), leaving room for
+  // the alert badge
   const int16_t text_margin = 4;
+  const int16_t alert_space = departure->has_alert ? 14 : 0;
   static char time_range[32];
 
   GRect time_rect = GRect(
     text_margin,
     0,
-    bounds.size.w - platform_box_size - platform_box_margin - text_margin - 4,
+    bounds.size.w - platform_box_size - platform_box_margin - text_margin - alert_space - 4,
     20
   );
 
@@ -297,6 +525,10 @@ static void menu_draw_row_callback(GContext *ctx,
                      GTextAlignmentLeft,
                      NULL);
 
+  if (departure->has_alert) {
+    draw_alert_badge(ctx, GPoint(time_rect.origin.x + time_rect.size.w + 7, 10), selected, false);
+  }
+
   // Draw train type in small box (below time, on the left)
   const int16_t train_type_box_width = 16;
   const int16_t train_type_box_height = 16;
@@ -321,8 +553,20 @@ static void menu_draw_row_callback(GContext *ctx,
     train_type_box_height
   );
 
-  static char detail_text[80];
-  snprintf(detail_text, sizeof(detail_text), "%s · %s",
+  // Countdown and group member station are left out when empty
+  static char detail_text[96];
+  char countdown[12];
+  countdown_format(departure, countdown, sizeof(countdown));
+  detail_text[0] = '\0';
+  if (countdown[0]) {
+    snprintf(detail_text, sizeof(detail_text), "%s · ", countdown);
+  }
+  size_t used = strlen(detail_text);
+  if (departure->station_label[0]) {
+    snprintf(detail_text + used, sizeof(detail_text) - used, "%s · ", departure->station_label);
+    used = strlen(detail_text);
+  }
+  snprintf(detail_text + used, sizeof(detail_text) - used, "%s · %s",
            departure->duration, departure->destination);
 
   graphics_context_set_text_color(ctx, text_color);
@@ -339,8 +583,13 @@ static void menu_draw_row_callback(GContext *ctx,
 
   bool needs_scroll = text_size.w > details_rect.size.w;
 
-  // Draw details text first (before boxes to allow proper layering)
-  if (selected && needs_scroll) {
+  // Draw details text first (before boxes to allow proper layering); a
+  // placeholder while the destination is still on its way (the masks below
+  // cut it to the details area)
+  if (departure->fill == DEPARTURE_FILL_CORE) {
+    decorations_draw_skeleton(ctx, GRect(details_x, train_type_y, skeleton_size.w, skeleton_size.h),
+                              selected ? GColorWhite : GColorBlack, s_shimmer_frame);
+  } else if (selected && needs_scroll) {
     // Calculate how far we need to scroll (text width - visible width)
     state_set_marquee_max_offset(text_size.w - details_rect.size.w);
 
@@ -388,18 +637,7 @@ static void menu_draw_row_callback(GContext *ctx,
 
   if (is_airport) {
     // Draw airport icon instead of train type box
-    GRect icon_rect = GRect(
-      train_type_box.origin.x,
-      train_type_box.origin.y,
-      16,
-      16
-    );
-
-    GBitmap *icon = selected ? s_icon_airport_white : s_icon_airport;
-    if (icon) {
-      graphics_context_set_compositing_mode(ctx, GCompOpSet);
-      graphics_draw_bitmap_in_rect(ctx, icon, icon_rect);
-    }
+    icons_draw(ctx, ICON_AIRPORT, train_type_box.origin, selected);
   } else {
     // Draw train type box background (on top of masks)
     graphics_context_set_fill_color(ctx, platform_bg_color);
@@ -425,19 +663,11 @@ static void menu_draw_row_callback(GContext *ctx,
 
   // Draw connection icon if this train requires a connection
   if (!departure->is_direct) {
-    GRect icon_rect = GRect(
-      train_type_box.origin.x + train_type_box.size.w + 2,
-      train_type_box.origin.y,
-      16,
-      16
-    );
+    GPoint icon_origin = GPoint(train_type_box.origin.x + train_type_box.size.w + 2,
+                                train_type_box.origin.y);
 
-    // Use white icon when selected, black icon otherwise
-    GBitmap *icon = selected ? s_icon_switch_white : s_icon_switch;
-    if (icon) {
-      graphics_context_set_compositing_mode(ctx, GCompOpSet);
-      graphics_draw_bitmap_in_rect(ctx, icon, icon_rect);
-    }
+    // Same pixels in white when selected, black otherwise
+    icons_draw(ctx, ICON_SWITCH, icon_origin, selected);
   }
 
   // Draw platform box background (drawn last to appear on top)
@@ -466,11 +696,21 @@ static void menu_draw_row_callback(GContext *ctx,
                      NULL);
 }
 
+static void menu_draw_row_callback(GContext *ctx,
+                                    const Layer *cell_layer,
+                                    MenuIndex *cell_index,
+                                    void *context) {
+  uint32_t draw_start = diag_draw_begin();
+  draw_row(ctx, cell_layer, cell_index);
+  diag_draw_end(draw_start);
+  energy_count(ENERGY_FEATURE_FOREGROUND, ENERGY_METRIC_REDRAWS, 1);
+}
+
 static int16_t menu_get_cell_height_callback(MenuLayer *menu_layer,
                                               MenuIndex *cell_index,
                                               void *context) {
-  // Section 0: Station selector rows are shorter
-  if (cell_index->section == 0) {
+  // Section 0: Station selector rows (and dashboard rows) are shorter
+  if (cell_index->section == 0 || dashboard_is_shown()) {
     return PBL_IF_ROUND_ELSE(
       MENU_CELL_ROUND_FOCUSED_SHORT_CELL_HEIGHT,
       24  // Shorter height for station selectors
@@ -504,54 +744,164 @@ static void menu_selection_changed_callback(MenuLayer *menu_layer,
   state_set_marquee_timer(app_timer_register(500, marquee_timer_callback, menu_layer));
 }
 
+// Record the shape the menu is laid out with and reload it
+static void reload_menu(MenuLayer *menu_layer);
+
 static void menu_select_callback(MenuLayer *menu_layer,
                                   MenuIndex *cell_index,
                                   void *context) {
+  // Dashboard: open the route (whichever row of it was selected)
+  if (dashboard_is_shown()) {
+    uint8_t from_index, to_index;
+    dashboard_get_route(cell_index->section, &from_index, &to_index);
+    state_set_from_station_index(from_index);
+    state_set_to_station_index(to_index);
+    dashboard_set_shown(false);
+    reload_menu(menu_layer);
+    menu_layer_set_selected_index(menu_layer, MenuIndex(1, 0), MenuRowAlignCenter, false);
+    LOG_INFO("Opening dashboard route %d", cell_index->section);
+    api_handler_request_train_data();
+    return;
+  }
+
   // Section 0: Station selectors
   if (cell_index->section == 0) {
     if (state_get_num_stations() == 0) {
-      APP_LOG(APP_LOG_LEVEL_WARNING, "No stations loaded yet");
+      LOG_WARNING("No stations loaded yet");
       return;
     }
 
-    if (cell_index->row == 0) {
+    if (is_alerts_row(cell_index->row)) {
+      // Next alert summary
+      s_alert_index = (s_alert_index + 1) % alerts_get_count();
+      layer_mark_dirty(menu_layer_get_layer(menu_layer));
+    } else if (is_dashboard_row(cell_index->row)) {
+      // Switch to the dashboard
+      dashboard_set_shown(true);
+      reload_menu(menu_layer);
+      menu_layer_set_selected_index(menu_layer, MenuIndex(0, 0), MenuRowAlignTop, false);
+      api_handler_request_dashboard();
+    } else if (cell_index->row == 0) {
       // "From" station selector
-      uint8_t new_index = (state_get_from_station_index() + 1) % state_get_num_stations();
+      // A station picked by search falls back to the first favorite
+      uint8_t new_index = state_get_from_station_index() + 1;
+      if (new_index >= state_get_num_stations()) new_index = 0;
       state_set_from_station_index(new_index);
-      layer_mark_dirty(menu_layer_get_layer(menu_layer));
-      APP_LOG(APP_LOG_LEVEL_INFO, "From station changed to: %s", state_get_stations()[new_index].name);
+      LOG_INFO("From station changed to: %s", state_get_stations()[new_index].name);
       // Request new data
       api_handler_request_train_data();
     } else {
       // "To" station selector
-      uint8_t new_index = (state_get_to_station_index() + 1) % state_get_num_stations();
+      uint8_t new_index = state_get_to_station_index() + 1;
+      if (new_index >= state_get_num_stations()) new_index = 0;
       state_set_to_station_index(new_index);
-      layer_mark_dirty(menu_layer_get_layer(menu_layer));
-      APP_LOG(APP_LOG_LEVEL_INFO, "To station changed to: %s", state_get_stations()[new_index].name);
+      LOG_INFO("To station changed to: %s", state_get_stations()[new_index].name);
       // Request new data
       api_handler_request_train_data();
     }
     return;
   }
 
-  // Section 1: Train row selected - request details
+  // Section 1: Train row selected - request details (once the row is there)
+  if (!departures_shown() || state_get_departures()[cell_index->row].fill == DEPARTURE_FILL_NONE) {
+    return;
+  }
   state_set_selected_departure_index(cell_index->row);
   api_handler_request_detail_data();
 }
 
-// Initialize menu layer
-void menu_layer_init(MenuLayer *menu_layer, GBitmap *icon_switch, GBitmap *icon_switch_white,
-                      GBitmap *icon_airport, GBitmap *icon_airport_white,
-                      GBitmap *icon_start, GBitmap *icon_start_white,
-                      GBitmap *icon_finish, GBitmap *icon_finish_white) {
-  s_icon_switch = icon_switch;
-  s_icon_switch_white = icon_switch_white;
-  s_icon_airport = icon_airport;
-  s_icon_airport_white = icon_airport_white;
-  s_icon_start = icon_start;
-  s_icon_start_white = icon_start_white;
-  s_icon_finish = icon_finish;
-  s_icon_finish_white = icon_finish_white;
+// Long-press on a station selector searches all stations for it; elsewhere
+// it opens the hidden diagnostics window
+static void menu_select_long_callback(MenuLayer *menu_layer,
+                                       MenuIndex *cell_index,
+                                       void *context) {
+  if (!dashboard_is_shown() && cell_index->section == 0 && cell_index->row < 2 &&
+      state_get_num_stations() > 0) {
+    station_search_window_show(cell_index->row == 1);
+    return;
+  }
+  diagnostics_window_show();
+}
+
+// Sections and row counts the menu was last laid out with (a different
+// count needs a reload)
+static uint16_t s_laid_out_sections;
+static uint16_t s_laid_out_rows[MAX_SECTIONS];
+
+// Whether the sections or row counts differ from the laid out ones (and
+// record the new ones)
+static bool update_layout(MenuLayer *menu_layer) {
+  bool changed = false;
+  uint16_t sections = menu_get_num_sections_callback(menu_layer, NULL);
+  if (sections != s_laid_out_sections) {
+    s_laid_out_sections = sections;
+    changed = true;
+  }
+  for (uint16_t i = 0; i < MAX_SECTIONS; i++) {
+    uint16_t rows = i < sections ? menu_get_num_rows_callback(menu_layer, i, NULL) : 0;
+    if (rows != s_laid_out_rows[i]) {
+      s_laid_out_rows[i] = rows;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+static void reload_menu(MenuLayer *menu_layer) {
+  update_layout(menu_layer);
+  menu_layer_reload_data(menu_layer);
+  diag_menu_reload();
+}
+
+// State change batch: reload only when the rows changed shape, otherwise
+// redraw only when something shown on screen changed
+static void menu_state_changed(const StateChanges *changes, void *context) {
+  MenuLayer *menu_layer = (MenuLayer *)context;
+
+  // Background glance updates never show the menu
+  if (state_is_background_update()) return;
+
+  if (update_layout(menu_layer)) {
+    menu_layer_reload_data(menu_layer);
+    diag_menu_reload();
+    return;
+  }
+
+  const uint8_t menu_flags = STATE_CHANGE_STATIONS | STATE_CHANGE_DEPARTURE_LIST |
+                             STATE_CHANGE_LOAD_STATE | STATE_CHANGE_DASHBOARD |
+                             STATE_CHANGE_ALERTS;
+  if ((changes->flags & menu_flags) || (changes->departure_rows && departures_shown())) {
+    layer_mark_dirty(menu_layer_get_layer(menu_layer));
+    diag_menu_redraw();
+  } else {
+    diag_menu_skip();
+  }
+}
+
+// Redraw the menu from state changes
+void menu_layer_subscribe_state(MenuLayer *menu_layer) {
+  update_layout(menu_layer);
+  state_subscribe(menu_state_changed, menu_layer);
+}
+
+void menu_layer_unsubscribe_state(void) {
+  state_unsubscribe(menu_state_changed);
+}
+
+// Start the skeleton shimmer (stops by itself once stations are known)
+void menu_layer_start_shimmer(MenuLayer *menu_layer) {
+  if (!s_shimmer_timer && state_get_num_stations() == 0) {
+    s_shimmer_frame = 0;
+    s_shimmer_timer = app_timer_register(SHIMMER_INTERVAL_MS, shimmer_timer_callback, menu_layer);
+  }
+}
+
+// Stop the skeleton shimmer
+void menu_layer_stop_shimmer(void) {
+  if (s_shimmer_timer) {
+    app_timer_cancel(s_shimmer_timer);
+    s_shimmer_timer = NULL;
+  }
 }
 
 // Get menu layer callbacks
@@ -564,6 +914,7 @@ MenuLayerCallbacks menu_layer_get_callbacks(void) {
     .draw_row = menu_draw_row_callback,
     .get_cell_height = menu_get_cell_height_callback,
     .select_click = menu_select_callback,
+    .select_long_click = menu_select_long_callback,
     .selection_changed = menu_selection_changed_callback,
   };
 }
@@ -3,11 +3,15 @@
 #include <pebble.h>
 #include "types.h"
 
-// Initialize menu layer (must be called after resources are loaded)
-void menu_layer_init(MenuLayer *menu_layer, GBitmap *icon_switch, GBitmap *icon_switch_white,
-                      GBitmap *icon_airport, GBitmap *icon_airport_white,
-                      GBitmap *icon_start, GBitmap *icon_start_white,
-                      GBitmap *icon_finish, GBitmap *icon_finish_white);
-
 // Get menu layer callbacks (returns MenuLayerCallbacks struct)
 MenuLayerCallbacks menu_layer_get_callbacks(void);
+
+// Redraw the menu from state changes (reloads only when rows are added or removed)
+void menu_layer_subscribe_state(MenuLayer *menu_layer);
+void menu_layer_unsubscribe_state(void);
+
+// Start the skeleton shimmer (stops by itself once stations are known)
+void menu_layer_start_shimmer(MenuLayer *menu_layer);
+
+// Stop the skeleton shimmer
+void menu_layer_stop_shimmer(void);
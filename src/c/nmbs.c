@@ -6,22 +6,22 @@
 #include "detail_window.h"
 #include "api_handler.h"
 #include "glances.h"
+#include "diagnostics.h"
+#include "diagnostics_window.h"
+#include "station_search_window.h"
+#include "energy.h"
+#include "countdown.h"
+#include "icons.h"
+#include "decorations.h"
+#include "schedule.h"
+#include "dashboard.h"
+#include "log.h"
 
 // UI elements
 static Window *s_main_window = NULL;
 static MenuLayer *s_menu_layer = NULL;
 static StatusBarLayer *s_status_bar = NULL;
 
-// Resources
-static GBitmap *s_icon_switch = NULL;
-static GBitmap *s_icon_switch_white = NULL;
-static GBitmap *s_icon_airport = NULL;
-static GBitmap *s_icon_airport_white = NULL;
-static GBitmap *s_icon_start = NULL;
-static GBitmap *s_icon_start_white = NULL;
-static GBitmap *s_icon_finish = NULL;
-static GBitmap *s_icon_finish_white = NULL;
-
 // Main window lifecycle
 static void window_load(Window *window) {
   Layer *window_layer = window_get_root_layer(window);
@@ -42,18 +42,17 @@ static void window_load(Window *window) {
   s_menu_layer = menu_layer_create(menu_bounds);
   menu_layer_set_click_config_onto_window(s_menu_layer, window);
 
-  // Initialize menu layer module with icons
-  menu_layer_init(s_menu_layer,
-                   s_icon_switch, s_icon_switch_white,
-                   s_icon_airport, s_icon_airport_white,
-                   s_icon_start, s_icon_start_white,
-                   s_icon_finish, s_icon_finish_white);
-
   // Set up MenuLayer callbacks
   menu_layer_set_callbacks(s_menu_layer, NULL, menu_layer_get_callbacks());
 
   // Add MenuLayer to window
   layer_add_child(window_layer, menu_layer_get_layer(s_menu_layer));
+
+  // Reload or redraw as state changes
+  menu_layer_subscribe_state(s_menu_layer);
+
+  // Animate the station skeletons until the phone sends the stations
+  menu_layer_start_shimmer(s_menu_layer);
 }
 
 static void window_unload(Window *window) {
@@ -63,6 +62,8 @@ static void window_unload(Window *window) {
     app_timer_cancel(timer);
     state_set_marquee_timer(NULL);
   }
+  menu_layer_stop_shimmer();
+  menu_layer_unsubscribe_state();
 
   // Destroy MenuLayer
   menu_layer_destroy(s_menu_layer);
@@ -73,19 +74,15 @@ static void window_unload(Window *window) {
 
 // App initialization
 static void init(void) {
-  // Load resources
-  s_icon_switch = gbitmap_create_with_resource(RESOURCE_ID_ICON_SWITCH);
-  s_icon_switch_white = gbitmap_create_with_resource(RESOURCE_ID_ICON_SWITCH_WHITE);
-  s_icon_airport = gbitmap_create_with_resource(RESOURCE_ID_ICON_AIRPORT);
-  s_icon_airport_white = gbitmap_create_with_resource(RESOURCE_ID_ICON_AIRPORT_WHITE);
-  s_icon_start = gbitmap_create_with_resource(RESOURCE_ID_ICON_START);
-  s_icon_start_white = gbitmap_create_with_resource(RESOURCE_ID_ICON_START_WHITE);
-  s_icon_finish = gbitmap_create_with_resource(RESOURCE_ID_ICON_FINISH);
-  s_icon_finish_white = gbitmap_create_with_resource(RESOURCE_ID_ICON_FINISH_WHITE);
+  // Load the menu icons from the sprite sheet
+  icons_init();
 
   // Initialize state with default stations
   state_init();
 
+  // Load this hour's energy counters and count the launch
+  energy_init();
+
   // Create main window
   s_main_window = window_create();
   window_set_window_handlers(s_main_window, (WindowHandlers) {
@@ -98,37 +95,57 @@ static void init(void) {
   window_stack_push(s_main_window, animated);
 
   // Initialize API handler (registers AppMessage callbacks)
-  api_handler_init(s_menu_layer);
+  api_handler_init();
+
+  // Count down to departures and drop departed trains every minute
+  countdown_init(s_menu_layer);
+
+  // Load the smart-schedule table (route is picked once stations are known)
+  schedule_init();
 
-  // Subscribe to worker messages for background glance updates
+  // Load the dashboard routes and whether the menu showed them last time
+  dashboard_init();
+
+  // Subscribe to worker messages for background glance updates (and
+  // refresh the glance from state changes)
   glances_handle_worker_request();
 
+  diag_heap_sample(DIAG_PHASE_STARTUP);
+
   // Don't request data immediately - wait for JavaScript to be ready
   // JavaScript will send stations or we'll use defaults, then request data
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "NMBS Schedule App initialized");
-  APP_LOG(APP_LOG_LEVEL_INFO, "Waiting for JavaScript to send configuration...");
+  LOG_DEBUG("NMBS Schedule App initialized");
+  LOG_INFO("Waiting for JavaScript to send configuration...");
 }
 
 static void deinit(void) {
   // Destroy resources
-  gbitmap_destroy(s_icon_switch);
-  gbitmap_destroy(s_icon_switch_white);
-  gbitmap_destroy(s_icon_airport);
-  gbitmap_destroy(s_icon_airport_white);
-  gbitmap_destroy(s_icon_start);
-  gbitmap_destroy(s_icon_start_white);
-  gbitmap_destroy(s_icon_finish);
-  gbitmap_destroy(s_icon_finish_white);
+  icons_deinit();
+  decorations_deinit();
 
   // Update glances before exiting
   glances_update_on_exit();
 
+  // Stop minute ticks
+  countdown_deinit();
+  schedule_deinit();
+  dashboard_deinit();
+
+  // Persist energy counters
+  energy_deinit();
+
   // Unsubscribe from worker messages
   app_worker_message_unsubscribe();
 
   // Destroy detail window if it exists
   detail_window_destroy();
 
+  // Destroy diagnostics window if it exists
+  diagnostics_window_destroy();
+
+  // Destroy station search window if it exists
+  station_search_window_destroy();
+
   // Destroy main window
   window_destroy(s_main_window);
 }
@@ -0,0 +1,139 @@
+#include "schedule.h"
+#include "state.h"
+#include "api_handler.h"
+#include "dashboard.h"
+#include "log.h"
+
+// Intervals as stored (without the version/count header)
+static uint8_t s_entries[SCHEDULE_TABLE_MAX_ENTRIES * SCHEDULE_ENTRY_SIZE];
+static uint8_t s_count = 0;
+
+// Fires at the next interval boundary
+static AppTimer *s_boundary_timer = NULL;
+
+static uint16_t read_u16(const uint8_t *data) {
+  return data[0] | (data[1] << 8);
+}
+
+static uint16_t entry_start(uint8_t index) {
+  return read_u16(&s_entries[index * SCHEDULE_ENTRY_SIZE]);
+}
+
+static uint16_t entry_end(uint8_t index) {
+  return read_u16(&s_entries[index * SCHEDULE_ENTRY_SIZE + 2]);
+}
+
+// Index of the first interval ending after minute (s_count if none)
+static uint8_t find_interval(uint16_t minute) {
+  uint8_t low = 0;
+  uint8_t high = s_count;
+  while (low < high) {
+    uint8_t mid = (low + high) / 2;
+    if (entry_end(mid) <= minute) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+// Minutes from minute until the next interval starts or ends
+static uint16_t minutes_to_boundary(uint16_t minute) {
+  uint8_t index = find_interval(minute);
+  if (index == s_count) {
+    // Past the last interval: next boundary is the first start next week
+    return SCHEDULE_MINUTES_PER_WEEK - minute + entry_start(0);
+  }
+  uint16_t start = entry_start(index);
+  return (start > minute ? start : entry_end(index)) - minute;
+}
+
+static bool parse_table(const uint8_t *data, uint16_t length) {
+  if (length < 2 || data[0] != SCHEDULE_TABLE_VERSION || data[1] > SCHEDULE_TABLE_MAX_ENTRIES ||
+      length != 2 + data[1] * SCHEDULE_ENTRY_SIZE) {
+    return false;
+  }
+  s_count = data[1];
+  memcpy(s_entries, data + 2, s_count * SCHEDULE_ENTRY_SIZE);
+  return true;
+}
+
+// Switch to the route for now and fetch its departures if it changed. The
+// dashboard doesn't show the route (opening one of its routes fetches that
+// route anyway), so nothing is fetched while it is shown.
+static void apply_and_refresh(void) {
+  if (schedule_apply_active_route() && !dashboard_is_shown()) {
+    api_handler_request_train_data();
+  }
+}
+
+static void boundary_timer_callback(void *data) {
+  s_boundary_timer = NULL;
+  apply_and_refresh();
+}
+
+static void arm_boundary_timer(const struct tm *now) {
+  if (s_boundary_timer) {
+    app_timer_cancel(s_boundary_timer);
+    s_boundary_timer = NULL;
+  }
+  if (s_count == 0) return;
+
+  uint16_t minute = now->tm_wday * 24 * 60 + now->tm_hour * 60 + now->tm_min;
+  uint32_t delay_ms = ((uint32_t)minutes_to_boundary(minute) * 60 - now->tm_sec) * 1000;
+  s_boundary_timer = app_timer_register(delay_ms, boundary_timer_callback, NULL);
+  LOG_DEBUG("Next schedule boundary in %lu min", (unsigned long)(delay_ms / 60000));
+}
+
+void schedule_init(void) {
+  uint8_t buffer[2 + SCHEDULE_TABLE_MAX_ENTRIES * SCHEDULE_ENTRY_SIZE];
+  int length = persist_exists(PERSIST_KEY_SCHEDULE_TABLE) ?
+               persist_read_data(PERSIST_KEY_SCHEDULE_TABLE, buffer, sizeof(buffer)) : 0;
+  if (length > 0 && parse_table(buffer, length)) {
+    LOG_INFO("Loaded schedule table with %d intervals", s_count);
+  }
+}
+
+void schedule_deinit(void) {
+  if (s_boundary_timer) {
+    app_timer_cancel(s_boundary_timer);
+    s_boundary_timer = NULL;
+  }
+}
+
+void schedule_store(const uint8_t *data, uint16_t length) {
+  if (!parse_table(data, length)) {
+    LOG_WARNING("Ignoring invalid schedule table (%d bytes)", length);
+    return;
+  }
+  persist_write_data(PERSIST_KEY_SCHEDULE_TABLE, data, length);
+  LOG_INFO("Stored schedule table with %d intervals", s_count);
+
+  apply_and_refresh();
+}
+
+bool schedule_apply_active_route(void) {
+  if (!state_are_stations_received()) return false;
+
+  time_t now = time(NULL);
+  struct tm *local = localtime(&now);
+  uint16_t minute = local->tm_wday * 24 * 60 + local->tm_hour * 60 + local->tm_min;
+  arm_boundary_timer(local);
+
+  uint8_t index = find_interval(minute);
+  if (index == s_count || entry_start(index) > minute) return false;
+
+  uint8_t route = s_entries[index * SCHEDULE_ENTRY_SIZE + 4];
+  uint8_t from = route >> 4;
+  uint8_t to = route & 0x0F;
+  if (from >= state_get_num_stations() || to >= state_get_num_stations() ||
+      (from == state_get_from_station_index() && to == state_get_to_station_index())) {
+    return false;
+  }
+
+  state_set_from_station_index(from);
+  state_set_to_station_index(to);
+  LOG_INFO("Scheduled route: %s -> %s", state_get_stations()[from].name, state_get_stations()[to].name);
+  return true;
+}
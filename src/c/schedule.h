@@ -0,0 +1,38 @@
+#pragma once
+
+#include <pebble.h>
+#include "types.h"
+
+// Smart schedules evaluated on the watch.
+//
+// PebbleKit JS compiles the smart schedules into a table of minute-of-week
+// intervals (MSG_SCHEDULE_TABLE, see src/pkjs/01-schedule-table.js), which is
+// kept in persistent storage. The active route is picked from it as soon as
+// the favorite stations are known, without waiting for the phone, and again
+// at every interval boundary while the app runs.
+//
+// Blob layout (little-endian):
+//   u8  version (SCHEDULE_TABLE_VERSION)
+//   u8  interval count (at most SCHEDULE_TABLE_MAX_ENTRIES)
+//   per interval, sorted and non-overlapping:
+//     u16 first minute of the week (Sunday 00:00 = 0)
+//     u16 end minute (exclusive)
+//     u8  from station index << 4 | to station index
+// The background worker reads the same key (see worker.c).
+
+#define SCHEDULE_TABLE_VERSION 1
+#define SCHEDULE_ENTRY_SIZE 5
+#define SCHEDULE_MINUTES_PER_WEEK (7 * 24 * 60)
+
+// Load the persisted table
+void schedule_init(void);
+
+// Cancel the boundary timer
+void schedule_deinit(void);
+
+// Store a table received from JS and switch to its route for now
+void schedule_store(const uint8_t *data, uint16_t length);
+
+// Select the scheduled route for the current time (once stations are known)
+// and arm the timer for the next boundary. Returns true if the route changed.
+bool schedule_apply_active_route(void);
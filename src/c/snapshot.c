@@ -0,0 +1,196 @@
+#include "snapshot.h"
+#include "types.h"
+#include "state.h"
+#include "diagnostics.h"
+#include "utils.h"
+#include "log.h"
+
+// Common train types, enum-coded in the blob (must match TRAIN_TYPES in 03-snapshot.js)
+static const char *TRAIN_TYPES[] = {
+  "IC", "L", "S", "P", "EXT", "ICE", "TGV", "EUR", "THA", "EC", "INT", "BUS"
+};
+
+#define TYPE_STRING_FLAG 0x80
+#define FLAG_DIRECT 0x01
+#define FLAG_PLATFORM_CHANGED 0x02
+#define HEADER_SIZE 15
+#define MAX_STRINGS 48
+
+// Each slot spans two persist keys (PERSIST_DATA_MAX_LENGTH each)
+static uint32_t slot_key(uint8_t slot, uint8_t part) {
+  return PERSIST_KEY_SNAPSHOTS + slot * 2 + part;
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Numeric station code from an iRail ID (BE.NMBS.008813003 -> 8813003)
+static uint32_t station_code(const char *irail_id) {
+  uint32_t code = 0;
+  for (const char *p = irail_id; *p; p++) {
+    if (*p >= '0' && *p <= '9') {
+      code = code * 10 + (*p - '0');
+    }
+  }
+  return code;
+}
+
+// Read an unsigned LEB128 value; returns false past the end of the blob
+static bool read_varint(const uint8_t *data, uint16_t length, uint16_t *pos, uint32_t *value) {
+  *value = 0;
+  for (uint8_t shift = 0; shift < 32 && *pos < length; shift += 7) {
+    uint8_t byte = data[(*pos)++];
+    *value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+static void copy_string(char *dest, size_t size, const char *src) {
+  strncpy(dest, src, size - 1);
+  dest[size - 1] = '\0';
+}
+
+void snapshot_store(uint8_t slot, const uint8_t *data, uint16_t length) {
+  if (slot >= SNAPSHOT_MAX_ROUTES || length < HEADER_SIZE || length > SNAPSHOT_MAX_BYTES ||
+      data[0] != SNAPSHOT_VERSION) {
+    LOG_WARNING("Ignoring snapshot for slot %d (%d bytes)", slot, length);
+    return;
+  }
+
+  uint16_t first = length > PERSIST_DATA_MAX_LENGTH ? PERSIST_DATA_MAX_LENGTH : length;
+  persist_write_data(slot_key(slot, 0), data, first);
+  if (length > first) {
+    persist_write_data(slot_key(slot, 1), data + first, length - first);
+  } else {
+    persist_delete(slot_key(slot, 1));
+  }
+
+  LOG_INFO("Stored snapshot slot %d: %d departures, %d bytes", slot, data[13], length);
+}
+
+// Read a slot into buffer; returns its length or 0 if missing
+static uint16_t read_slot(uint8_t slot, uint8_t *buffer) {
+  int first = persist_get_size(slot_key(slot, 0));
+  if (first < HEADER_SIZE) return 0;
+  persist_read_data(slot_key(slot, 0), buffer, first);
+
+  int second = persist_get_size(slot_key(slot, 1));
+  if (second > 0 && first + second <= SNAPSHOT_MAX_BYTES) {
+    persist_read_data(slot_key(slot, 1), buffer + first, second);
+    return first + second;
+  }
+  return first;
+}
+
+// Decode departures after `now` into the state departure list
+static uint8_t decode(const uint8_t *data, uint16_t length, time_t now) {
+  uint8_t count = data[13];
+  uint8_t string_count = data[14];
+  if (string_count > MAX_STRINGS) return 0;
+
+  // Index the interned strings in place
+  const char *strings[MAX_STRINGS];
+  uint16_t pos = HEADER_SIZE;
+  for (uint8_t i = 0; i < string_count; i++) {
+    strings[i] = (const char *)&data[pos];
+    while (pos < length && data[pos]) pos++;
+    if (pos >= length) return 0;
+    pos++;
+  }
+
+  TrainDeparture *departures = state_get_departures();
+  uint8_t stored = 0;
+  time_t depart = (time_t)read_u32(&data[9]);
+
+  for (uint8_t i = 0; i < count && stored < MAX_DEPARTURES; i++) {
+    uint32_t delta, duration;
+    if (!read_varint(data, length, &pos, &delta) ||
+        !read_varint(data, length, &pos, &duration) ||
+        pos + 6 > length) {
+      break;
+    }
+    depart += delta * 60;
+
+    uint8_t type = data[pos];
+    uint8_t destination = data[pos + 1];
+    uint8_t platform = data[pos + 2];
+    uint8_t flags = data[pos + 3];
+    int8_t depart_delay = (int8_t)data[pos + 4];
+    int8_t arrive_delay = (int8_t)data[pos + 5];
+    pos += 6;
+
+    if (destination >= string_count || platform >= string_count) break;
+
+    // Keep trains that haven't left yet, counting their known delay
+    if (depart + depart_delay * 60 < now) continue;
+
+    TrainDeparture *dep = &departures[stored++];
+    memset(dep, 0, sizeof(*dep));
+    dep->depart_timestamp = depart;
+    time_t arrive = depart + duration * 60;
+    strftime(dep->depart_time, sizeof(dep->depart_time), "%H:%M", localtime(&depart));
+    strftime(dep->arrive_time, sizeof(dep->arrive_time), "%H:%M", localtime(&arrive));
+    format_duration(duration, dep->duration, sizeof(dep->duration));
+
+    if (type & TYPE_STRING_FLAG) {
+      uint8_t index = type & ~TYPE_STRING_FLAG;
+      copy_string(dep->train_type, sizeof(dep->train_type), index < string_count ? strings[index] : "?");
+    } else {
+      copy_string(dep->train_type, sizeof(dep->train_type),
+                  type < ARRAY_LENGTH(TRAIN_TYPES) ? TRAIN_TYPES[type] : "?");
+    }
+    copy_string(dep->destination, sizeof(dep->destination), strings[destination]);
+    copy_string(dep->platform, sizeof(dep->platform), strings[platform]);
+
+    dep->is_direct = (flags & FLAG_DIRECT) != 0;
+    dep->platform_changed = (flags & FLAG_PLATFORM_CHANGED) != 0;
+    dep->fill = DEPARTURE_FILL_FULL;
+    dep->depart_delay = depart_delay;
+    dep->arrive_delay = arrive_delay;
+  }
+
+  return stored;
+}
+
+bool snapshot_load_active_route(void) {
+  if (state_get_num_stations() == 0) return false;
+
+  Station *stations = state_get_stations();
+  uint32_t from = station_code(stations[state_get_from_station_index()].irail_id);
+  uint32_t to = station_code(stations[state_get_to_station_index()].irail_id);
+
+  uint8_t *buffer = malloc(SNAPSHOT_MAX_BYTES);
+  if (!buffer) return false;
+
+  bool found = false;
+  for (uint8_t slot = 0; slot < SNAPSHOT_MAX_ROUTES && !found; slot++) {
+    uint16_t length = read_slot(slot, buffer);
+    if (length == 0 || buffer[0] != SNAPSHOT_VERSION ||
+        read_u32(&buffer[1]) != from || read_u32(&buffer[5]) != to) {
+      continue;
+    }
+
+    time_t seconds;
+    uint16_t milliseconds;
+    time_ms(&seconds, &milliseconds);
+    uint32_t start = (uint32_t)seconds * 1000 + milliseconds;
+
+    uint8_t count = decode(buffer, length, seconds);
+
+    time_ms(&seconds, &milliseconds);
+    uint32_t elapsed = (uint32_t)seconds * 1000 + milliseconds - start;
+    diag_snapshot_decoded(length, elapsed);
+    LOG_INFO("Snapshot slot %d: %d upcoming departures from %d bytes in %lu ms",
+             slot, count, length, (unsigned long)elapsed);
+
+    if (count > 0) {
+      state_set_num_departures(count);
+      found = true;
+    }
+  }
+
+  free(buffer);
+  return found;
+}
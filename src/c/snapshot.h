@@ -0,0 +1,33 @@
+#pragma once
+
+#include <pebble.h>
+
+// Schedule snapshots for phone-less operation.
+//
+// PebbleKit JS pushes a compact snapshot of the next few hours of departures
+// for the active route and the smart-schedule routes (MSG_SNAPSHOT, one
+// route per message). Each is kept in persistent storage and used to fill the
+// departure list when the phone can't be reached. Live data replaces it as
+// soon as the phone answers again.
+//
+// Blob layout (little-endian), see also src/pkjs/03-snapshot.js:
+//   u8  version (SNAPSHOT_VERSION)
+//   u32 from station code, u32 to station code (digits of the iRail ID)
+//   u32 first departure (Unix time)
+//   u8  departure count, u8 string count
+//   strings: NUL-terminated, interned destinations, platforms and types
+//   per departure:
+//     varint minutes since previous departure, varint duration in minutes
+//     u8 train type (index into TRAIN_TYPES in snapshot.c, or 0x80 | string index)
+//     u8 destination string, u8 platform string
+//     u8 flags (bit 0 direct, bit 1 platform changed)
+//     s8 departure delay, s8 arrival delay (minutes, as of the push)
+
+#define SNAPSHOT_VERSION 1
+
+// Store a snapshot blob received from JS in a route slot
+void snapshot_store(uint8_t slot, const uint8_t *data, uint16_t length);
+
+// Fill the departure list for the active route from its snapshot, skipping
+// trains that already left. Returns false if no usable snapshot exists.
+bool snapshot_load_active_route(void);
@@ -1,4 +1,5 @@
 #include "state.h"
+#include "trace.h"
 
 // Default fallback stations (if no config received)
 const Station DEFAULT_STATIONS[] = {
@@ -10,8 +11,8 @@ const Station DEFAULT_STATIONS[] = {
 };
 const uint8_t NUM_DEFAULT_STATIONS = sizeof(DEFAULT_STATIONS) / sizeof(Station);
 
-// Station data
-static Station s_stations[MAX_FAVORITE_STATIONS];
+// Station data (favorites, then the slots for stations picked by search)
+static Station s_stations[MAX_FAVORITE_STATIONS + 2];
 static uint8_t s_num_stations = 0;
 static uint8_t s_from_station_index = 0;
 static uint8_t s_to_station_index = 1;
@@ -20,12 +21,14 @@ static bool s_stations_received = false;
 // Departure data
 static TrainDeparture s_departures[MAX_DEPARTURES];
 static uint8_t s_num_departures = 0;
+static uint8_t s_departures_removed = 0;
 
 // Loading state
 static LoadState s_load_state = LOAD_STATE_IDLE;
 static bool s_data_loading = false;
 static bool s_data_failed = false;
 static bool s_is_background_update = false;
+static bool s_data_offline = false;
 static AppTimer *s_timeout_timer = NULL;
 
 // Request ID tracking
@@ -37,12 +40,86 @@ static uint16_t s_selected_departure_index = 0;
 static JourneyDetail s_journey_detail;
 static bool s_detail_received = false;
 
+// Change tracking
+typedef struct {
+  StateObserver observer;
+  void *context;
+} StateSubscription;
+
+static StateSubscription s_subscriptions[STATE_MAX_OBSERVERS];
+static StateChanges s_pending_changes;
+static AppTimer *s_flush_timer = NULL;
+
 // Marquee animation state
 static AppTimer *s_marquee_timer = NULL;
 static int16_t s_marquee_offset = 0;
 static uint16_t s_selected_row = 0;
 static int16_t s_marquee_max_offset = 0;
 
+static void flush_timer_callback(void *data) {
+  s_flush_timer = NULL;
+  state_flush_changes();
+}
+
+// Record a change; the first one in a turn schedules the batch
+static void record_change(uint8_t flags, uint16_t departure_rows, uint8_t legs) {
+  s_pending_changes.flags |= flags;
+  s_pending_changes.departure_rows |= departure_rows;
+  s_pending_changes.legs |= legs;
+  if (!s_flush_timer) {
+    s_flush_timer = app_timer_register(0, flush_timer_callback, NULL);
+  }
+}
+
+void state_subscribe(StateObserver observer, void *context) {
+  for (uint8_t i = 0; i < STATE_MAX_OBSERVERS; i++) {
+    if (!s_subscriptions[i].observer || s_subscriptions[i].observer == observer) {
+      s_subscriptions[i] = (StateSubscription) { observer, context };
+      return;
+    }
+  }
+}
+
+void state_unsubscribe(StateObserver observer) {
+  for (uint8_t i = 0; i < STATE_MAX_OBSERVERS; i++) {
+    if (s_subscriptions[i].observer == observer) {
+      s_subscriptions[i] = (StateSubscription) { NULL, NULL };
+    }
+  }
+}
+
+void state_flush_changes(void) {
+  if (s_flush_timer) {
+    app_timer_cancel(s_flush_timer);
+    s_flush_timer = NULL;
+  }
+  if (!s_pending_changes.flags && !s_pending_changes.departure_rows && !s_pending_changes.legs) {
+    return;
+  }
+
+  // Observers may change state again; that goes into the next batch
+  StateChanges changes = s_pending_changes;
+  s_pending_changes = (StateChanges) { 0 };
+  for (uint8_t i = 0; i < STATE_MAX_OBSERVERS; i++) {
+    if (s_subscriptions[i].observer) {
+      s_subscriptions[i].observer(&changes, s_subscriptions[i].context);
+    }
+  }
+}
+
+void state_mark_departure_changed(uint8_t index) {
+  if (index < MAX_DEPARTURES) record_change(0, 1 << index, 0);
+}
+
+void state_mark_leg_changed(uint8_t leg_index) {
+  if (leg_index < 4) record_change(0, 0, 1 << leg_index);
+}
+
+void state_mark_detail_changed(void) { record_change(STATE_CHANGE_DETAIL, 0, 0); }
+
+void state_mark_dashboard_changed(void) { record_change(STATE_CHANGE_DASHBOARD, 0, 0); }
+void state_mark_alerts_changed(void) { record_change(STATE_CHANGE_ALERTS, 0, 0); }
+
 // Initialize state (start with no stations - wait for config from JS)
 void state_init(void) {
   s_num_stations = 0;
@@ -63,34 +140,128 @@ void state_load_default_stations(void) {
   s_from_station_index = 0;
   s_to_station_index = 1;
   s_stations_received = true;
+  record_change(STATE_CHANGE_STATIONS, 0, 0);
+}
+
+// Persist the favorite stations (one key per station)
+void state_save_stations(void) {
+  persist_write_int(PERSIST_KEY_STATION_COUNT, s_num_stations);
+  for (uint8_t i = 0; i < s_num_stations; i++) {
+    persist_write_data(PERSIST_KEY_STATIONS + i, &s_stations[i], sizeof(Station));
+  }
+}
+
+// Restore the favorite stations saved by state_save_stations
+bool state_load_saved_stations(void) {
+  if (!persist_exists(PERSIST_KEY_STATION_COUNT)) {
+    return false;
+  }
+
+  uint8_t count = persist_read_int(PERSIST_KEY_STATION_COUNT);
+  if (count < 2 || count > MAX_FAVORITE_STATIONS) {
+    return false;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    if (persist_read_data(PERSIST_KEY_STATIONS + i, &s_stations[i], sizeof(Station)) !=
+        (int)sizeof(Station)) {
+      return false;
+    }
+    s_stations[i].name[sizeof(s_stations[i].name) - 1] = '\0';
+    s_stations[i].irail_id[sizeof(s_stations[i].irail_id) - 1] = '\0';
+  }
+
+  s_num_stations = count;
+  s_from_station_index = 0;
+  s_to_station_index = 1;
+  s_stations_received = true;
+  record_change(STATE_CHANGE_STATIONS, 0, 0);
+  return true;
 }
 
 // Station management
 Station* state_get_stations(void) { return s_stations; }
 uint8_t state_get_num_stations(void) { return s_num_stations; }
-void state_set_num_stations(uint8_t count) { s_num_stations = count; }
+void state_set_num_stations(uint8_t count) {
+  if (count != s_num_stations) record_change(STATE_CHANGE_STATIONS, 0, 0);
+  s_num_stations = count;
+}
 bool state_are_stations_received(void) { return s_stations_received; }
-void state_set_stations_received(bool received) { s_stations_received = received; }
+void state_set_stations_received(bool received) {
+  if (received != s_stations_received) record_change(STATE_CHANGE_STATIONS, 0, 0);
+  s_stations_received = received;
+}
+
+void state_select_searched_station(bool is_destination, const char *name, const char *irail_id) {
+  uint8_t index = is_destination ? SEARCHED_TO_STATION_INDEX : SEARCHED_FROM_STATION_INDEX;
+  Station *station = &s_stations[index];
+  strncpy(station->name, name, sizeof(station->name) - 1);
+  station->name[sizeof(station->name) - 1] = '\0';
+  strncpy(station->irail_id, irail_id, sizeof(station->irail_id) - 1);
+  station->irail_id[sizeof(station->irail_id) - 1] = '\0';
+
+  if (is_destination) {
+    s_to_station_index = index;
+  } else {
+    s_from_station_index = index;
+  }
+  record_change(STATE_CHANGE_STATIONS, 0, 0);
+}
 
 uint8_t state_get_from_station_index(void) { return s_from_station_index; }
-void state_set_from_station_index(uint8_t index) { s_from_station_index = index; }
+void state_set_from_station_index(uint8_t index) {
+  if (index != s_from_station_index) record_change(STATE_CHANGE_STATIONS, 0, 0);
+  s_from_station_index = index;
+}
 uint8_t state_get_to_station_index(void) { return s_to_station_index; }
-void state_set_to_station_index(uint8_t index) { s_to_station_index = index; }
+void state_set_to_station_index(uint8_t index) {
+  if (index != s_to_station_index) record_change(STATE_CHANGE_STATIONS, 0, 0);
+  s_to_station_index = index;
+}
 
 // Departure data management
 TrainDeparture* state_get_departures(void) { return s_departures; }
 uint8_t state_get_num_departures(void) { return s_num_departures; }
-void state_set_num_departures(uint8_t count) { s_num_departures = count; }
+void state_set_num_departures(uint8_t count) {
+  // The phone's count can exceed what fits; rows past the array are dropped
+  s_num_departures = count < MAX_DEPARTURES ? count : MAX_DEPARTURES;
+  s_departures_removed = 0;
+  record_change(STATE_CHANGE_DEPARTURE_LIST, 0, 0);
+}
+
+void state_remove_departures(uint8_t count) {
+  if (count > s_num_departures) count = s_num_departures;
+  memmove(s_departures, s_departures + count, (s_num_departures - count) * sizeof(TrainDeparture));
+  s_num_departures -= count;
+  s_departures_removed += count;
+  if (count > 0) record_change(STATE_CHANGE_DEPARTURE_LIST, 0, 0);
+}
+
+uint8_t state_get_departures_removed(void) { return s_departures_removed; }
 
 // Loading state
 LoadState state_get_load_state(void) { return s_load_state; }
-void state_set_load_state(LoadState state) { s_load_state = state; }
+void state_set_load_state(LoadState state) {
+  if (state != s_load_state) record_change(STATE_CHANGE_LOAD_STATE, 0, 0);
+  s_load_state = state;
+  trace_load_state(s_last_data_request_id, state);
+}
 bool state_is_data_loading(void) { return s_data_loading; }
-void state_set_data_loading(bool loading) { s_data_loading = loading; }
+void state_set_data_loading(bool loading) {
+  if (loading != s_data_loading) record_change(STATE_CHANGE_LOAD_STATE, 0, 0);
+  s_data_loading = loading;
+}
 bool state_is_data_failed(void) { return s_data_failed; }
-void state_set_data_failed(bool failed) { s_data_failed = failed; }
+void state_set_data_failed(bool failed) {
+  if (failed != s_data_failed) record_change(STATE_CHANGE_LOAD_STATE, 0, 0);
+  s_data_failed = failed;
+}
 bool state_is_background_update(void) { return s_is_background_update; }
 void state_set_background_update(bool is_background) { s_is_background_update = is_background; }
+bool state_is_data_offline(void) { return s_data_offline; }
+void state_set_data_offline(bool offline) {
+  if (offline != s_data_offline) record_change(STATE_CHANGE_LOAD_STATE, 0, 0);
+  s_data_offline = offline;
+}
 
 // Request ID tracking
 uint32_t state_get_last_data_request_id(void) { return s_last_data_request_id; }
@@ -112,7 +283,10 @@ uint16_t state_get_selected_departure_index(void) { return s_selected_departure_
 void state_set_selected_departure_index(uint16_t index) { s_selected_departure_index = index; }
 JourneyDetail* state_get_journey_detail(void) { return &s_journey_detail; }
 bool state_is_detail_received(void) { return s_detail_received; }
-void state_set_detail_received(bool received) { s_detail_received = received; }
+void state_set_detail_received(bool received) {
+  if (received != s_detail_received) record_change(STATE_CHANGE_DETAIL, 0, 0);
+  s_detail_received = received;
+}
 
 // Marquee animation state
 AppTimer* state_get_marquee_timer(void) { return s_marquee_timer; }
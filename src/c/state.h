@@ -6,12 +6,53 @@
 extern const Station DEFAULT_STATIONS[];
 extern const uint8_t NUM_DEFAULT_STATIONS;
 
+// Change tracking: setters record what they changed, and subscribers get
+// the changes in one batch per event-loop turn (or on state_flush_changes),
+// so they can invalidate just the rows or legs that are affected.
+typedef enum {
+  STATE_CHANGE_STATIONS = 1 << 0,        // Station list or the selected route
+  STATE_CHANGE_DEPARTURE_LIST = 1 << 1,  // Departures replaced or dropped
+  STATE_CHANGE_LOAD_STATE = 1 << 2,      // Load state, loading, failed or offline
+  STATE_CHANGE_DETAIL = 1 << 3,          // Journey detail (re)loaded or its stops
+  STATE_CHANGE_DASHBOARD = 1 << 4,       // Dashboard routes, mode or departures
+  STATE_CHANGE_ALERTS = 1 << 5,          // Disruption alert summaries
+} StateChangeFlags;
+
+typedef struct {
+  uint8_t flags;             // StateChangeFlags
+  uint16_t departure_rows;   // Bit per departure whose fields changed
+  uint8_t legs;              // Bit per journey leg whose fields changed
+} StateChanges;
+
+typedef void (*StateObserver)(const StateChanges *changes, void *context);
+
+// Maximum number of subscribers
+#define STATE_MAX_OBSERVERS 4
+
+// Subscribe to / unsubscribe from change batches
+void state_subscribe(StateObserver observer, void *context);
+void state_unsubscribe(StateObserver observer);
+
+// Deliver the pending changes now instead of at the end of this turn
+void state_flush_changes(void);
+
+// Record changes made through the pointers returned by the getters
+void state_mark_departure_changed(uint8_t index);
+void state_mark_leg_changed(uint8_t leg_index);
+void state_mark_detail_changed(void);
+void state_mark_dashboard_changed(void);
+void state_mark_alerts_changed(void);
+
 // Initialize state (start with no stations - wait for config from JS)
 void state_init(void);
 
 // Load default fallback stations (called if config fails)
 void state_load_default_stations(void);
 
+// Persist the favorite stations / restore them when the phone is unreachable
+void state_save_stations(void);
+bool state_load_saved_stations(void);
+
 // Station management
 Station* state_get_stations(void);
 uint8_t state_get_num_stations(void);
@@ -19,6 +60,14 @@ void state_set_num_stations(uint8_t count);
 bool state_are_stations_received(void);
 void state_set_stations_received(bool received);
 
+// Station indices used by stations picked with the on-watch search (they
+// are not favorites, so they are neither counted nor saved)
+#define SEARCHED_FROM_STATION_INDEX MAX_FAVORITE_STATIONS
+#define SEARCHED_TO_STATION_INDEX (MAX_FAVORITE_STATIONS + 1)
+
+// Use a station picked by search as origin or destination
+void state_select_searched_station(bool is_destination, const char *name, const char *irail_id);
+
 uint8_t state_get_from_station_index(void);
 void state_set_from_station_index(uint8_t index);
 uint8_t state_get_to_station_index(void);
@@ -27,8 +76,14 @@ void state_set_to_station_index(uint8_t index);
 // Departure data management
 TrainDeparture* state_get_departures(void);
 uint8_t state_get_num_departures(void);
+// Clamped to MAX_DEPARTURES
 void state_set_num_departures(uint8_t count);
 
+// Drop departures from the front of the list; the count dropped since the
+// list was (re)loaded maps rows back to the phone's list for detail requests
+void state_remove_departures(uint8_t count);
+uint8_t state_get_departures_removed(void);
+
 // Loading state
 LoadState state_get_load_state(void);
 void state_set_load_state(LoadState state);
@@ -38,6 +93,8 @@ bool state_is_data_failed(void);
 void state_set_data_failed(bool failed);
 bool state_is_background_update(void);
 void state_set_background_update(bool is_background);
+bool state_is_data_offline(void);
+void state_set_data_offline(bool offline);
 
 // Request ID tracking (for idempotency)
 uint32_t state_get_last_data_request_id(void);
@@ -0,0 +1,295 @@
+#include "station_dict.h"
+#include "api_handler.h"
+#include "log.h"
+
+// Prefix index
+static bool s_index_loaded = false;
+static uint8_t s_block_count = 0;
+static uint8_t s_heads[STATION_DICT_MAX_BLOCKS][STATION_DICT_HEAD_LENGTH];
+
+// Recently received blocks
+typedef struct {
+  bool used;
+  uint8_t block;
+  uint16_t length;
+  uint32_t last_read;  // s_read_counter when last read (least recent is replaced)
+  uint8_t data[STATION_DICT_BLOCK_MAX_BYTES];
+} CachedBlock;
+
+static CachedBlock s_cache[STATION_DICT_CACHE_BLOCKS];
+static uint32_t s_read_counter = 0;
+
+// Running search (s_callback is NULL when there is none)
+static StationDictCallback s_callback = NULL;
+static char s_prefix[STATION_DICT_NAME_MAX];
+static uint8_t s_prefix_length = 0;
+static uint8_t s_next_block = 0;
+static StationMatch s_matches[STATION_DICT_MAX_MATCHES];
+static uint8_t s_match_count = 0;
+
+// Block requested from the phone for the running search
+static bool s_waiting = false;
+static uint8_t s_waiting_block = 0;
+static AppTimer *s_timeout_timer = NULL;
+
+// Lookup latency of the running search
+static uint32_t s_search_start = 0;
+static uint32_t s_decode_ms = 0;
+static uint8_t s_blocks_read = 0;
+static uint8_t s_blocks_fetched = 0;
+
+static uint32_t now_ms(void) {
+  time_t seconds;
+  uint16_t milliseconds;
+  time_ms(&seconds, &milliseconds);
+  return (uint32_t)seconds * 1000 + milliseconds;
+}
+
+static char to_upper(char c) {
+  return (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+}
+
+// 0 if name starts with the prefix (ignoring case), < 0 if it sorts before
+// the prefix, > 0 after it
+static int compare_prefix(const char *name) {
+  for (uint8_t i = 0; i < s_prefix_length; i++) {
+    uint8_t c = (uint8_t)to_upper(name[i]);
+    if (c != (uint8_t)s_prefix[i]) {
+      return c < (uint8_t)s_prefix[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+// Compare a block's head with the start of the prefix
+static int compare_head(uint8_t block) {
+  for (uint8_t i = 0; i < STATION_DICT_HEAD_LENGTH && i < s_prefix_length; i++) {
+    if (s_heads[block][i] != (uint8_t)s_prefix[i]) {
+      return s_heads[block][i] < (uint8_t)s_prefix[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+// First block that can hold a name starting with the prefix. Heads are
+// truncated, so a run of matches can start in the block before the first
+// head that doesn't sort before the prefix.
+static uint8_t find_start_block(void) {
+  uint8_t low = 0;
+  uint8_t high = s_block_count;
+  while (low < high) {
+    uint8_t mid = (low + high) / 2;
+    if (compare_head(mid) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low > 0 ? low - 1 : 0;
+}
+
+static CachedBlock* find_cached(uint8_t block) {
+  for (uint8_t i = 0; i < STATION_DICT_CACHE_BLOCKS; i++) {
+    if (s_cache[i].used && s_cache[i].block == block) {
+      s_cache[i].last_read = ++s_read_counter;
+      return &s_cache[i];
+    }
+  }
+  return NULL;
+}
+
+static void clear_cache(void) {
+  for (uint8_t i = 0; i < STATION_DICT_CACHE_BLOCKS; i++) {
+    s_cache[i].used = false;
+  }
+}
+
+static void clear_waiting(void) {
+  s_waiting = false;
+  if (s_timeout_timer) {
+    app_timer_cancel(s_timeout_timer);
+    s_timeout_timer = NULL;
+  }
+}
+
+static void finish_search(bool available) {
+  clear_waiting();
+  LOG_INFO("Station search '%s': %d matches, %d blocks read (%d from phone), "
+           "decoded in %lu ms, %lu ms total", s_prefix, s_match_count, s_blocks_read,
+           s_blocks_fetched, (unsigned long)s_decode_ms,
+           (unsigned long)(now_ms() - s_search_start));
+
+  StationDictCallback callback = s_callback;
+  s_callback = NULL;
+  callback(s_matches, s_match_count, available);
+}
+
+static void timeout_callback(void *data) {
+  s_timeout_timer = NULL;
+  LOG_WARNING("Station dictionary block %d not received", s_waiting_block);
+  finish_search(false);
+}
+
+static void request_block(uint8_t block) {
+  api_handler_request_station_dict(block);
+  s_waiting = true;
+  s_waiting_block = block;
+  s_blocks_fetched++;
+  s_timeout_timer = app_timer_register(STATION_DICT_TIMEOUT_MS, timeout_callback, NULL);
+}
+
+// Collect matches from a block; true once no later station can match
+static bool scan_block(const uint8_t *data, uint16_t length) {
+  char name[STATION_DICT_NAME_MAX];
+  uint8_t name_length = 0;
+  uint16_t offset = 0;
+
+  while (offset < length) {
+    uint8_t shared = data[offset];
+    uint8_t suffix = offset + 1 < length ? data[offset + 1] : 0;
+    if (shared > name_length || shared + suffix >= STATION_DICT_NAME_MAX ||
+        offset + 2 + suffix + 3 > length) {
+      LOG_WARNING("Corrupt station dictionary block at byte %d", offset);
+      return true;
+    }
+
+    memcpy(name + shared, &data[offset + 2], suffix);
+    name_length = shared + suffix;
+    name[name_length] = '\0';
+    offset += 2 + suffix;
+    uint32_t number = data[offset] | (data[offset + 1] << 8) | ((uint32_t)data[offset + 2] << 16);
+    offset += 3;
+
+    int order = compare_prefix(name);
+    if (order > 0) {
+      return true;
+    }
+    if (order == 0) {
+      StationMatch *match = &s_matches[s_match_count++];
+      memcpy(match->name, name, name_length + 1);
+      match->number = number;
+      if (s_match_count == STATION_DICT_MAX_MATCHES) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Walk blocks from s_next_block until the search is done or a block has to
+// come from the phone
+static void continue_search(void) {
+  if (!s_index_loaded) {
+    request_block(STATION_DICT_INDEX_BLOCK);
+    return;
+  }
+
+  while (s_next_block < s_block_count) {
+    CachedBlock *cached = find_cached(s_next_block);
+    if (!cached) {
+      request_block(s_next_block);
+      return;
+    }
+
+    uint32_t start = now_ms();
+    bool done = scan_block(cached->data, cached->length);
+    s_decode_ms += now_ms() - start;
+    s_blocks_read++;
+    s_next_block++;
+    if (done) break;
+  }
+  finish_search(true);
+}
+
+void station_dict_search(const char *prefix, StationDictCallback callback) {
+  station_dict_cancel();
+
+  s_prefix_length = 0;
+  while (prefix[s_prefix_length] && s_prefix_length < STATION_DICT_NAME_MAX - 1) {
+    s_prefix[s_prefix_length] = to_upper(prefix[s_prefix_length]);
+    s_prefix_length++;
+  }
+  s_prefix[s_prefix_length] = '\0';
+
+  s_callback = callback;
+  s_match_count = 0;
+  s_search_start = now_ms();
+  s_decode_ms = 0;
+  s_blocks_read = 0;
+  s_blocks_fetched = 0;
+  s_next_block = s_index_loaded ? find_start_block() : 0;
+  continue_search();
+}
+
+void station_dict_cancel(void) {
+  clear_waiting();
+  s_callback = NULL;
+}
+
+static bool store_index(const uint8_t *data, uint16_t length) {
+  if (length < 6 || data[0] != STATION_DICT_VERSION || data[1] > STATION_DICT_MAX_BLOCKS ||
+      length != 6 + data[1] * STATION_DICT_HEAD_LENGTH) {
+    return false;
+  }
+  s_block_count = data[1];
+  memcpy(s_heads, &data[6], s_block_count * STATION_DICT_HEAD_LENGTH);
+  s_index_loaded = true;
+
+  // Blocks of an earlier dictionary may not match the new index
+  clear_cache();
+  LOG_INFO("Station dictionary: %d stations in %d blocks, %d bytes (index %d)",
+           data[2] | (data[3] << 8), s_block_count, data[4] | (data[5] << 8), length);
+  return true;
+}
+
+static void store_block(uint8_t block, const uint8_t *data, uint16_t length) {
+  CachedBlock *slot = &s_cache[0];
+  for (uint8_t i = 0; i < STATION_DICT_CACHE_BLOCKS; i++) {
+    if (!s_cache[i].used || s_cache[i].block == block) {
+      slot = &s_cache[i];
+      break;
+    }
+    if (s_cache[i].last_read < slot->last_read) {
+      slot = &s_cache[i];
+    }
+  }
+  slot->used = true;
+  slot->block = block;
+  slot->length = length;
+  slot->last_read = ++s_read_counter;
+  memcpy(slot->data, data, length);
+}
+
+void station_dict_store(uint8_t block, const uint8_t *data, uint16_t length) {
+  if (block == STATION_DICT_INDEX_BLOCK) {
+    if (!store_index(data, length)) {
+      LOG_WARNING("Ignoring invalid station dictionary index (%d bytes)", length);
+      station_dict_mark_unavailable(block);
+      return;
+    }
+  } else if (block < s_block_count && length <= STATION_DICT_BLOCK_MAX_BYTES) {
+    store_block(block, data, length);
+  } else {
+    LOG_WARNING("Ignoring station dictionary block %d (%d bytes)", block, length);
+    return;
+  }
+
+  if (s_callback && s_waiting && s_waiting_block == block) {
+    clear_waiting();
+    if (block == STATION_DICT_INDEX_BLOCK) {
+      s_next_block = find_start_block();
+    }
+    continue_search();
+  }
+}
+
+void station_dict_mark_unavailable(uint8_t block) {
+  if (s_callback && s_waiting && s_waiting_block == block) {
+    LOG_WARNING("Station dictionary block %d unavailable", block);
+    finish_search(false);
+  }
+}
+
+void station_dict_format_id(uint32_t number, char *buffer, size_t size) {
+  snprintf(buffer, size, "BE.NMBS.%09lu", (unsigned long)number);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <pebble.h>
+#include "types.h"
+
+// Dictionary of all iRail stations for the on-watch station search.
+//
+// PebbleKit JS builds it from its station cache (see
+// src/pkjs/01-station-dict.js): names folded to ASCII, sorted by their
+// upper-cased bytes and front-coded in blocks that each start with a full
+// name. The whole dictionary is several kilobytes, more than the persistent
+// storage left next to the snapshots, so it stays on the phone. The watch
+// keeps its small prefix index, binary-searches it for the first block a
+// prefix can be in and requests only the blocks the search walks through,
+// keeping the last STATION_DICT_CACHE_BLOCKS of them. RAM use is fixed by
+// STATION_DICT_MAX_BLOCKS and STATION_DICT_BLOCK_MAX_BYTES.
+//
+// Index blob (block STATION_DICT_INDEX_BLOCK):
+//   u8  version (STATION_DICT_VERSION)
+//   u8  block count (at most STATION_DICT_MAX_BLOCKS)
+//   u16 station count (little-endian)
+//   u16 dictionary size in bytes, index included (little-endian)
+//   per block: STATION_DICT_HEAD_LENGTH upper-cased bytes of its first name,
+//              0-padded
+// Block blob (at most STATION_DICT_BLOCK_MAX_BYTES), per station:
+//   u8  bytes shared with the previous name in the block (0 for the first)
+//   u8  length of the rest of the name, then its bytes
+//   u24 station number, the digits of "BE.NMBS.<number>" (little-endian)
+
+#define STATION_DICT_VERSION 1
+#define STATION_DICT_HEAD_LENGTH 4
+#define STATION_DICT_INDEX_BLOCK 255
+#define STATION_DICT_CACHE_BLOCKS 2
+#define STATION_DICT_NAME_MAX 24
+#define STATION_DICT_MAX_MATCHES 8
+
+// Give up on an unanswered block after this long
+#define STATION_DICT_TIMEOUT_MS 10000
+
+typedef struct {
+  char name[STATION_DICT_NAME_MAX];
+  uint32_t number;
+} StationMatch;
+
+// Search result: the first matches in name order, or available == false if
+// the phone couldn't provide the dictionary
+typedef void (*StationDictCallback)(const StationMatch *matches, uint8_t count, bool available);
+
+// Find the first STATION_DICT_MAX_MATCHES stations whose name starts with
+// prefix (case-insensitive). The callback runs once the search is done, which
+// is right away if the blocks it needs are on the watch. Replaces a running
+// search.
+void station_dict_search(const char *prefix, StationDictCallback callback);
+
+// Drop a running search (its callback is not called)
+void station_dict_cancel(void);
+
+// Store a block (or the index) received from JS and continue the search
+void station_dict_store(uint8_t block, const uint8_t *data, uint16_t length);
+
+// The phone couldn't provide a block; fails the running search
+void station_dict_mark_unavailable(uint8_t block);
+
+// Format a station number as its iRail ID ("BE.NMBS.008813003")
+void station_dict_format_id(uint32_t number, char *buffer, size_t size);
@@ -0,0 +1,257 @@
+#include "station_search_window.h"
+#include "station_dict.h"
+#include "state.h"
+#include "api_handler.h"
+#include "log.h"
+
+// Height of the wheel above the matches
+#define WHEEL_HEIGHT 48
+
+// Wheel auto-repeat while UP/DOWN are held
+#define WHEEL_REPEAT_MS 100
+
+static const char WHEEL_LETTERS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ-' ";
+
+// UI elements
+static Window *s_search_window = NULL;
+static Layer *s_wheel_layer = NULL;
+static MenuLayer *s_results_layer = NULL;
+
+// Search state
+static bool s_is_destination = false;
+static char s_query[STATION_DICT_NAME_MAX];
+static uint8_t s_query_length = 0;
+static uint8_t s_wheel_index = 0;
+static bool s_picking = false;  // Matches have the focus instead of the wheel
+
+// Latest search result
+static StationMatch s_matches[STATION_DICT_MAX_MATCHES];
+static uint8_t s_match_count = 0;
+static bool s_searching = false;
+static bool s_available = true;
+
+static void search_done(const StationMatch *matches, uint8_t count, bool available) {
+  memcpy(s_matches, matches, count * sizeof(StationMatch));
+  s_match_count = count;
+  s_searching = false;
+  s_available = available;
+  menu_layer_set_selected_index(s_results_layer, MenuIndex(0, 0), MenuRowAlignTop, false);
+  menu_layer_reload_data(s_results_layer);
+}
+
+static void start_search(void) {
+  s_searching = true;
+  menu_layer_reload_data(s_results_layer);
+  station_dict_search(s_query, search_done);
+}
+
+static void set_picking(bool picking) {
+  s_picking = picking;
+  if (picking) {
+    menu_layer_set_highlight_colors(s_results_layer, GColorBlack, GColorWhite);
+  } else {
+    // Without the focus the matches are only a preview
+    menu_layer_set_highlight_colors(s_results_layer, GColorWhite, GColorBlack);
+  }
+  layer_mark_dirty(s_wheel_layer);
+}
+
+static void pick_selected(void) {
+  uint16_t row = menu_layer_get_selected_index(s_results_layer).row;
+  if (row >= s_match_count) return;
+
+  char irail_id[32];
+  station_dict_format_id(s_matches[row].number, irail_id, sizeof(irail_id));
+  state_select_searched_station(s_is_destination, s_matches[row].name, irail_id);
+  LOG_INFO("%s station picked: %s (%s)", s_is_destination ? "To" : "From",
+           s_matches[row].name, irail_id);
+
+  window_stack_pop(true);
+  api_handler_request_train_data();
+}
+
+// Wheel: query so far, then the letter SELECT would add
+static void wheel_update_proc(Layer *layer, GContext *ctx) {
+  GRect bounds = layer_get_bounds(layer);
+  GFont label_font = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+  GFont query_font = fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD);
+
+  graphics_context_set_text_color(ctx, GColorBlack);
+  graphics_draw_text(ctx, s_is_destination ? "To station" : "From station", label_font,
+                     GRect(4, 0, bounds.size.w - 8, 16),
+                     GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+
+  // Keep the end of a long query in view
+  const int16_t box_width = 18;
+  GSize query_size = graphics_text_layout_get_content_size(s_query, query_font,
+                                                           GRect(0, 0, 1000, 30),
+                                                           GTextOverflowModeWordWrap,
+                                                           GTextAlignmentLeft);
+  int16_t query_x = 4;
+  if (query_x + query_size.w + box_width > bounds.size.w - 4) {
+    query_x = bounds.size.w - 4 - box_width - query_size.w;
+  }
+  graphics_draw_text(ctx, s_query, query_font, GRect(query_x, 14, query_size.w + 4, 30),
+                     GTextOverflowModeWordWrap, GTextAlignmentLeft, NULL);
+
+  if (!s_picking) {
+    char letter[2] = { WHEEL_LETTERS[s_wheel_index], '\0' };
+    if (letter[0] == ' ') letter[0] = '_';
+    GRect box = GRect(query_x + query_size.w + 1, 19, box_width, 24);
+    graphics_context_set_fill_color(ctx, GColorBlack);
+    graphics_fill_rect(ctx, box, 3, GCornersAll);
+    graphics_context_set_text_color(ctx, GColorWhite);
+    graphics_draw_text(ctx, letter, query_font, GRect(box.origin.x, 14, box_width, 30),
+                       GTextOverflowModeFill, GTextAlignmentCenter, NULL);
+  }
+
+  graphics_context_set_stroke_color(ctx, GColorBlack);
+  graphics_draw_line(ctx, GPoint(0, bounds.size.h - 1), GPoint(bounds.size.w, bounds.size.h - 1));
+}
+
+// Matches (or one row explaining why there are none)
+static uint16_t results_get_num_rows(MenuLayer *menu_layer, uint16_t section_index, void *context) {
+  return s_match_count > 0 ? s_match_count : 1;
+}
+
+static void results_draw_row(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index,
+                             void *context) {
+  const char *text;
+  if (s_match_count > 0) {
+    text = s_matches[cell_index->row].name;
+  } else if (s_searching) {
+    text = "Searching...";
+  } else if (!s_available) {
+    text = "Phone not available";
+  } else {
+    text = "No stations";
+  }
+  menu_cell_basic_draw(ctx, cell_layer, text, NULL, NULL);
+}
+
+static int16_t results_get_cell_height(MenuLayer *menu_layer, MenuIndex *cell_index,
+                                       void *context) {
+  return 28;
+}
+
+static void turn_wheel(int8_t step) {
+  uint8_t count = sizeof(WHEEL_LETTERS) - 1;
+  s_wheel_index = (s_wheel_index + count + step) % count;
+  layer_mark_dirty(s_wheel_layer);
+}
+
+static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
+  if (s_picking) {
+    menu_layer_set_selected_next(s_results_layer, true, MenuRowAlignCenter, true);
+  } else {
+    turn_wheel(-1);
+  }
+}
+
+static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
+  if (s_picking) {
+    menu_layer_set_selected_next(s_results_layer, false, MenuRowAlignCenter, true);
+  } else {
+    turn_wheel(1);
+  }
+}
+
+static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
+  if (s_picking) {
+    pick_selected();
+    return;
+  }
+  if (s_query_length < sizeof(s_query) - 1) {
+    s_query[s_query_length++] = WHEEL_LETTERS[s_wheel_index];
+    s_query[s_query_length] = '\0';
+    s_wheel_index = 0;
+    layer_mark_dirty(s_wheel_layer);
+    start_search();
+  }
+}
+
+static void select_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+  if (!s_picking && s_match_count > 0) {
+    set_picking(true);
+  }
+}
+
+static void back_click_handler(ClickRecognizerRef recognizer, void *context) {
+  if (s_picking) {
+    set_picking(false);
+  } else if (s_query_length > 0) {
+    s_query[--s_query_length] = '\0';
+    layer_mark_dirty(s_wheel_layer);
+    start_search();
+  } else {
+    window_stack_pop(true);
+  }
+}
+
+static void click_config_provider(void *context) {
+  window_single_repeating_click_subscribe(BUTTON_ID_UP, WHEEL_REPEAT_MS, up_click_handler);
+  window_single_repeating_click_subscribe(BUTTON_ID_DOWN, WHEEL_REPEAT_MS, down_click_handler);
+  window_single_click_subscribe(BUTTON_ID_SELECT, select_click_handler);
+  window_long_click_subscribe(BUTTON_ID_SELECT, 0, select_long_click_handler, NULL);
+  window_single_click_subscribe(BUTTON_ID_BACK, back_click_handler);
+}
+
+// Search window lifecycle
+static void search_window_load(Window *window) {
+  Layer *window_layer = window_get_root_layer(window);
+  GRect bounds = layer_get_bounds(window_layer);
+
+  s_wheel_layer = layer_create(GRect(0, 0, bounds.size.w, WHEEL_HEIGHT));
+  layer_set_update_proc(s_wheel_layer, wheel_update_proc);
+  layer_add_child(window_layer, s_wheel_layer);
+
+  // The window's own click config drives the list, so BACK can return to the wheel
+  s_results_layer = menu_layer_create(GRect(0, WHEEL_HEIGHT, bounds.size.w,
+                                            bounds.size.h - WHEEL_HEIGHT));
+  menu_layer_set_callbacks(s_results_layer, NULL, (MenuLayerCallbacks) {
+    .get_num_rows = results_get_num_rows,
+    .draw_row = results_draw_row,
+    .get_cell_height = results_get_cell_height,
+  });
+  layer_add_child(window_layer, menu_layer_get_layer(s_results_layer));
+
+  s_query[0] = '\0';
+  s_query_length = 0;
+  s_wheel_index = 0;
+  s_match_count = 0;
+  s_available = true;
+  set_picking(false);
+
+  // Also fetches the dictionary index early, while the first letter is picked
+  start_search();
+}
+
+static void search_window_unload(Window *window) {
+  station_dict_cancel();
+  menu_layer_destroy(s_results_layer);
+  s_results_layer = NULL;
+  layer_destroy(s_wheel_layer);
+  s_wheel_layer = NULL;
+}
+
+void station_search_window_show(bool is_destination) {
+  if (!s_search_window) {
+    s_search_window = window_create();
+    window_set_click_config_provider(s_search_window, click_config_provider);
+    window_set_window_handlers(s_search_window, (WindowHandlers) {
+      .load = search_window_load,
+      .unload = search_window_unload,
+    });
+  }
+
+  s_is_destination = is_destination;
+  const bool animated = true;
+  window_stack_push(s_search_window, animated);
+}
+
+void station_search_window_destroy(void) {
+  if (s_search_window) {
+    window_destroy(s_search_window);
+    s_search_window = NULL;
+  }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <pebble.h>
+
+// Station search: spell a station name on a letter wheel and use any
+// iRail station as origin or destination, without changing the favorites.
+// UP/DOWN turn the wheel, SELECT adds its letter and BACK removes one; the
+// first matches are listed below the wheel. Long-pressing SELECT moves to the
+// matches, where SELECT picks one and BACK returns to the wheel.
+
+// Create and show the search window for the origin or the destination
+void station_search_window_show(bool is_destination);
+
+// Destroy the search window
+void station_search_window_destroy(void);
@@ -0,0 +1,128 @@
+#include "stop_list.h"
+#include "state.h"
+#include "api_handler.h"
+#include "log.h"
+
+// Ring of recently received stops
+static IntermediateStop s_stops[STOP_RING_SIZE];
+
+// Legs the phone couldn't provide stops for (bit per leg)
+static uint8_t s_failed_legs = 0;
+
+// Page currently requested from the phone
+static bool s_pending = false;
+static uint8_t s_pending_leg = 0;
+static uint8_t s_pending_end = 0;
+static AppTimer *s_pending_timer = NULL;
+
+// Position of a leg's first stop across all legs
+static uint16_t leg_base(uint8_t leg_index) {
+  JourneyDetail *journey = state_get_journey_detail();
+  uint16_t base = 0;
+  for (uint8_t i = 0; i < leg_index && i < journey->leg_count; i++) {
+    base += journey->legs[i].stop_count;
+  }
+  return base;
+}
+
+static void clear_slots(void) {
+  for (uint8_t i = 0; i < STOP_RING_SIZE; i++) {
+    s_stops[i].position = STOP_POSITION_NONE;
+  }
+}
+
+static void clear_pending(void) {
+  s_pending = false;
+  if (s_pending_timer) {
+    app_timer_cancel(s_pending_timer);
+    s_pending_timer = NULL;
+  }
+}
+
+static void pending_timeout_callback(void *data) {
+  s_pending_timer = NULL;
+  LOG_WARNING("Stops of leg %d not received", s_pending_leg);
+  s_pending = false;
+}
+
+void stop_list_reset(void) {
+  clear_slots();
+  clear_pending();
+  s_failed_legs = 0;
+}
+
+const IntermediateStop* stop_list_get(uint8_t leg_index, uint8_t stop_index) {
+  uint16_t position = leg_base(leg_index) + stop_index;
+  const IntermediateStop *stop = &s_stops[position % STOP_RING_SIZE];
+  return stop->position == position ? stop : NULL;
+}
+
+bool stop_list_leg_failed(uint8_t leg_index) {
+  return (s_failed_legs & (1 << leg_index)) != 0;
+}
+
+void stop_list_request_range(uint8_t leg_index, uint8_t first, uint8_t last) {
+  if (s_pending || stop_list_leg_failed(leg_index)) return;
+
+  for (uint16_t i = first; i <= last; i++) {
+    if (stop_list_get(leg_index, i)) continue;
+
+    // Pages are aligned so rows scrolled back and forth reuse the same requests
+    uint8_t page_first = (i / STOPS_PAGE_SIZE) * STOPS_PAGE_SIZE;
+    if (api_handler_request_stops(leg_index, page_first)) {
+      s_pending = true;
+      s_pending_leg = leg_index;
+      s_pending_end = page_first + STOPS_PAGE_SIZE;
+      s_pending_timer = app_timer_register(STOPS_REQUEST_TIMEOUT_MS, pending_timeout_callback, NULL);
+    }
+    return;
+  }
+}
+
+void stop_list_store(uint8_t leg_index, uint8_t stop_index, uint8_t stop_count,
+                     const char *name, const char *time, int8_t delay) {
+  JourneyDetail *journey = state_get_journey_detail();
+  if (leg_index >= journey->leg_count) return;
+
+  // The vehicle's stop list can differ from the count in the connection;
+  // positions of later legs shift, so start over
+  JourneyLeg *leg = &journey->legs[leg_index];
+  if (leg->stop_count != stop_count) {
+    LOG_DEBUG("Leg %d has %d stops (expected %d)", leg_index, stop_count, leg->stop_count);
+    leg->stop_count = stop_count;
+    clear_slots();
+  }
+
+  if (stop_index < stop_count) {
+    uint16_t position = leg_base(leg_index) + stop_index;
+    IntermediateStop *stop = &s_stops[position % STOP_RING_SIZE];
+    strncpy(stop->name, name, sizeof(stop->name) - 1);
+    stop->name[sizeof(stop->name) - 1] = '\0';
+    strncpy(stop->time, time, sizeof(stop->time) - 1);
+    stop->time[sizeof(stop->time) - 1] = '\0';
+    stop->delay = delay;
+    stop->position = position;
+  }
+
+  // Last stop of the requested page (or of the leg)
+  if (s_pending && leg_index == s_pending_leg &&
+      (stop_index + 1 >= s_pending_end || stop_index + 1 >= stop_count)) {
+    clear_pending();
+  }
+}
+
+void stop_list_mark_failed(uint8_t leg_index) {
+  if (leg_index < 8) {
+    s_failed_legs |= 1 << leg_index;
+  }
+  if (s_pending && leg_index == s_pending_leg) {
+    clear_pending();
+  }
+}
+
+void stop_list_request_failed(uint8_t leg_index) {
+  if (s_pending && leg_index == s_pending_leg) {
+    LOG_WARNING("Stops request for leg %d failed", leg_index);
+    clear_pending();
+  }
+}
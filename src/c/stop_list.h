@@ -0,0 +1,42 @@
+#pragma once
+
+#include <pebble.h>
+#include "types.h"
+
+// Intermediate stops of the journey shown in the detail window.
+//
+// Stops are only requested from the phone, STOPS_PAGE_SIZE at a time, once
+// the detail window scrolls them into view. They are kept in a ring of
+// STOP_RING_SIZE slots indexed by their position across all legs, so
+// neighbouring rows never evict each other and memory stays the same however
+// long a leg is. Scrolled-away stops are overwritten and fetched again if
+// they come back into view.
+
+// position of an unused ring slot
+#define STOP_POSITION_NONE UINT16_MAX
+
+// Give up on an unanswered page after this long (the next scroll retries)
+#define STOPS_REQUEST_TIMEOUT_MS 10000
+
+// Forget all stops (new journey detail requested)
+void stop_list_reset(void);
+
+// Cached stop of a leg, or NULL if it isn't on the watch
+const IntermediateStop* stop_list_get(uint8_t leg_index, uint8_t stop_index);
+
+// Whether the phone couldn't provide the stops of a leg
+bool stop_list_leg_failed(uint8_t leg_index);
+
+// Request the page holding the first missing stop in [first, last] of a leg
+void stop_list_request_range(uint8_t leg_index, uint8_t first, uint8_t last);
+
+// Store a received stop (stop_count is the leg's count on the phone)
+void stop_list_store(uint8_t leg_index, uint8_t stop_index, uint8_t stop_count,
+                     const char *name, const char *time, int8_t delay);
+
+// The phone couldn't provide the stops of a leg
+void stop_list_mark_failed(uint8_t leg_index);
+
+// The request for a page of a leg never reached the phone (the next scroll
+// retries)
+void stop_list_request_failed(uint8_t leg_index);
@@ -0,0 +1,141 @@
+#include "trace.h"
+#include "log.h"
+
+#if TRACE_ENABLED
+
+typedef struct {
+  uint32_t request_id;
+  uint32_t start_ms;
+  bool queued;            // Waiting for the outbox
+  uint8_t send_attempts;
+  uint16_t stage_ms[TRACE_NUM_STAGES];
+  uint16_t departure_ms[MAX_DEPARTURES];
+} TraceRecord;
+
+// Ring of recent requests (request_id 0 = unused slot)
+static TraceRecord s_records[TRACE_MAX_REQUESTS];
+static uint8_t s_next_record = 0;
+
+static uint32_t now_ms(void) {
+  time_t seconds;
+  uint16_t milliseconds;
+  time_ms(&seconds, &milliseconds);
+  return (uint32_t)seconds * 1000 + milliseconds;
+}
+
+static TraceRecord *find_record(uint32_t request_id) {
+  for (uint8_t i = 0; i < TRACE_MAX_REQUESTS; i++) {
+    if (s_records[i].request_id == request_id) {
+      return &s_records[i];
+    }
+  }
+  return NULL;
+}
+
+// Milliseconds since the request was sent, clamped below TRACE_NOT_REACHED
+static uint16_t elapsed_ms(const TraceRecord *record) {
+  uint32_t elapsed = now_ms() - record->start_ms;
+  return (elapsed >= TRACE_NOT_REACHED) ? TRACE_NOT_REACHED - 1 : (uint16_t)elapsed;
+}
+
+static void begin_record(uint32_t request_id) {
+  TraceRecord *record = &s_records[s_next_record];
+  s_next_record = (s_next_record + 1) % TRACE_MAX_REQUESTS;
+
+  record->request_id = request_id;
+  record->start_ms = now_ms();
+  record->queued = false;
+  record->send_attempts = 0;
+  memset(record->stage_ms, 0xFF, sizeof(record->stage_ms));
+  memset(record->departure_ms, 0xFF, sizeof(record->departure_ms));
+}
+
+static void mark_stage(uint32_t request_id, TraceStage stage) {
+  TraceRecord *record = find_record(request_id);
+  if (record && record->stage_ms[stage] == TRACE_NOT_REACHED) {
+    record->stage_ms[stage] = elapsed_ms(record);
+  }
+}
+
+void trace_load_state(uint32_t request_id, LoadState state) {
+  switch (state) {
+    case LOAD_STATE_CONNECTING:
+      begin_record(request_id);
+      break;
+    case LOAD_STATE_FETCHING:
+      mark_stage(request_id, TRACE_STAGE_ACK);
+      break;
+    case LOAD_STATE_RECEIVING:
+      mark_stage(request_id, TRACE_STAGE_COUNT);
+      break;
+    case LOAD_STATE_COMPLETE:
+      mark_stage(request_id, TRACE_STAGE_COMPLETE);
+      break;
+    case LOAD_STATE_ERROR:
+      mark_stage(request_id, TRACE_STAGE_ERROR);
+      break;
+    default:
+      break;
+  }
+}
+
+void trace_departure(uint32_t request_id, uint8_t index) {
+  TraceRecord *record = find_record(request_id);
+  if (record && index < MAX_DEPARTURES) {
+    record->departure_ms[index] = elapsed_ms(record);
+  }
+}
+
+void trace_menu_reload(uint32_t request_id) {
+  mark_stage(request_id, TRACE_STAGE_MENU_RELOAD);
+}
+
+void trace_queue(uint32_t request_id) {
+  TraceRecord *record = find_record(request_id);
+  if (record) {
+    record->queued = true;
+  }
+}
+
+bool trace_send_next(void) {
+  TraceRecord *record = NULL;
+  for (uint8_t i = 0; i < TRACE_MAX_REQUESTS && !record; i++) {
+    if (s_records[i].request_id != 0 && s_records[i].queued) {
+      record = &s_records[i];
+    }
+  }
+  if (!record) return false;
+
+  // Stage offsets followed by per-departure offsets, little-endian uint16
+  uint16_t data[TRACE_NUM_STAGES + MAX_DEPARTURES];
+  memcpy(data, record->stage_ms, sizeof(record->stage_ms));
+  memcpy(&data[TRACE_NUM_STAGES], record->departure_ms, sizeof(record->departure_ms));
+
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    LOG_DEBUG("Trace [ID %lu] not sent: outbox busy", (unsigned long)record->request_id);
+    return false;
+  }
+
+  dict_write_uint8(iter, MESSAGE_KEY_MESSAGE_TYPE, MSG_TRACE_REPORT);
+  dict_write_uint32(iter, MESSAGE_KEY_REQUEST_ID, record->request_id);
+  dict_write_data(iter, MESSAGE_KEY_TRACE_DATA, (const uint8_t *)data, sizeof(data));
+  app_message_outbox_send();
+
+  record->queued = false;
+  record->send_attempts++;
+  return true;
+}
+
+void trace_send_failed(uint32_t request_id) {
+  TraceRecord *record = find_record(request_id);
+  if (!record) return;
+  if (record->send_attempts < TRACE_MAX_SEND_ATTEMPTS) {
+    record->queued = true;
+  } else {
+    LOG_WARNING("Trace [ID %lu] dropped after %d sends", (unsigned long)request_id,
+                record->send_attempts);
+  }
+}
+
+#endif  // TRACE_ENABLED
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <pebble.h>
+#include "types.h"
+
+// Per-request latency trace for train data requests.
+//
+// Stage timestamps are recorded against the request ID as the LoadState
+// machine advances (see state_set_load_state) and queued once the request
+// completes. api_handler sends queued traces to PebbleKit JS as
+// MSG_TRACE_REPORT when the outbox has nothing the user is waiting for; there
+// they are merged with the phone-side stages into a latency report. All
+// offsets are milliseconds since the request was sent. Compiled out of
+// release builds.
+
+#ifndef TRACE_ENABLED
+  #if defined(RELEASE)
+    #define TRACE_ENABLED 0
+  #else
+    #define TRACE_ENABLED 1
+  #endif
+#endif
+
+// Watch-side stages (request send is the origin)
+typedef enum {
+  TRACE_STAGE_ACK,          // LOAD_STATE_FETCHING: JS acknowledged
+  TRACE_STAGE_COUNT,        // LOAD_STATE_RECEIVING: departure count received
+  TRACE_STAGE_COMPLETE,     // LOAD_STATE_COMPLETE: last departure received
+  TRACE_STAGE_ERROR,        // LOAD_STATE_ERROR: timed out
+  TRACE_STAGE_MENU_RELOAD,  // Menu reloaded with the final data
+  TRACE_NUM_STAGES
+} TraceStage;
+
+// Number of requests kept in the trace ring
+#define TRACE_MAX_REQUESTS 4
+
+// Offset value for stages that were never reached
+#define TRACE_NOT_REACHED 0xFFFF
+
+// Sends tried per trace before it is dropped
+#define TRACE_MAX_SEND_ATTEMPTS 2
+
+#if TRACE_ENABLED
+
+// Record a LoadState transition for a request (CONNECTING starts a new trace)
+void trace_load_state(uint32_t request_id, LoadState state);
+
+// Record a departure message arriving
+void trace_departure(uint32_t request_id, uint8_t index);
+
+// Record the menu being reloaded with a request's data
+void trace_menu_reload(uint32_t request_id);
+
+// Queue a request's trace for sending
+void trace_queue(uint32_t request_id);
+
+// Send the next queued trace; false if none is queued or the outbox is busy
+bool trace_send_next(void);
+
+// A trace report failed: queue it again, up to TRACE_MAX_SEND_ATTEMPTS sends
+void trace_send_failed(uint32_t request_id);
+
+#else
+
+static inline void trace_load_state(uint32_t request_id, LoadState state) {}
+static inline void trace_departure(uint32_t request_id, uint8_t index) {}
+static inline void trace_menu_reload(uint32_t request_id) {}
+static inline void trace_queue(uint32_t request_id) {}
+static inline bool trace_send_next(void) { return false; }
+static inline void trace_send_failed(uint32_t request_id) {}
+
+#endif  // TRACE_ENABLED
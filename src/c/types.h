@@ -10,12 +10,65 @@
 #define MSG_SEND_DETAIL 5
 #define MSG_SEND_STATION_COUNT 6
 #define MSG_SEND_STATION 7
-#define MSG_SET_ACTIVE_ROUTE 8
+#define MSG_SCHEDULE_TABLE 8
 #define MSG_REQUEST_ACK 9
+#define MSG_TRACE_REPORT 10
+#define MSG_ENERGY_REPORT 11
+#define MSG_SNAPSHOT 12
+#define MSG_REQUEST_STOPS 13
+#define MSG_SEND_STOP 14
+#define MSG_STOP_TRACKING 15
+#define MSG_LEG_UPDATE 16
+#define MSG_REQUEST_STATION_DICT 17
+#define MSG_STATION_DICT 18
+#define MSG_DASHBOARD_ROUTES 19
+#define MSG_REQUEST_DASHBOARD 20
+#define MSG_DASHBOARD_DATA 21
+#define MSG_DEPARTURE_DETAILS 22
+#define MSG_THROTTLED 23
+#define MSG_ALERTS 24
 
 // Worker message type for glance updates
 #define WORKER_REQUEST_GLANCE 100
 
+// Persistent storage keys
+#define PERSIST_KEY_WORKER_WAKES 1      // Written by the worker (see worker.c)
+#define PERSIST_KEY_ENERGY_EXPORTED 2   // Last energy hour delivered to JS
+#define PERSIST_KEY_STATION_COUNT 3     // Number of saved favorite stations
+#define PERSIST_KEY_SCHEDULE_TABLE 4    // Compiled smart schedules (see schedule.h)
+#define PERSIST_KEY_DASHBOARD_ROUTES 5  // Dashboard route list (see dashboard.h)
+#define PERSIST_KEY_DASHBOARD_SHOWN 6   // Whether the menu shows the dashboard
+#define PERSIST_KEY_WORKER_WAKES_SEEN 7 // Worker wake total already counted by the app
+#define PERSIST_KEY_ENERGY_BUCKETS 100  // First of ENERGY_BUCKET_COUNT hourly buckets
+#define PERSIST_KEY_STATIONS 110        // First of MAX_FAVORITE_STATIONS saved stations
+#define PERSIST_KEY_SNAPSHOTS 120       // First of 2 * SNAPSHOT_MAX_ROUTES snapshot keys
+
+// Hourly energy buckets kept on the watch
+#define ENERGY_BUCKET_COUNT 12
+
+// Schedule snapshots kept on the watch (see snapshot.h)
+#define SNAPSHOT_MAX_ROUTES 3
+#define SNAPSHOT_MAX_BYTES 400
+
+// Smart-schedule intervals kept on the watch (see schedule.h)
+#define SCHEDULE_TABLE_MAX_ENTRIES 48
+
+// Intermediate stops kept on the watch (see stop_list.h)
+#define STOP_RING_SIZE 16
+#define STOPS_PAGE_SIZE 6
+
+// Station dictionary limits (see station_dict.h)
+#define STATION_DICT_MAX_BLOCKS 64
+#define STATION_DICT_BLOCK_MAX_BYTES 256
+
+// Dashboard limits (see dashboard.h)
+#define DASHBOARD_MAX_ROUTES 3
+#define DASHBOARD_ROWS_PER_ROUTE 3
+
+// Disruption alert summaries (see alerts.h)
+#define ALERTS_MAX 4
+#define ALERT_TITLE_LEN 48
+
 // Maximum number of departures and stations
 #define MAX_DEPARTURES 11
 #define MAX_FAVORITE_STATIONS 6
@@ -23,12 +76,14 @@
 // Loading timeout
 #define LOADING_TIMEOUT_MS 10000  // 10 seconds
 #define CONFIG_TIMEOUT_MS 5000    // 5 seconds to wait for config from JS
+#define REPORT_DELAY_MS 2000      // Trace/energy reports wait this long after a user request
 
 // Loading state machine for detailed user feedback
 typedef enum {
   LOAD_STATE_IDLE,           // Not loading
   LOAD_STATE_CONNECTING,     // Waiting for JS to acknowledge request
   LOAD_STATE_FETCHING,       // JS is calling iRail API
+  LOAD_STATE_THROTTLED,      // iRail is rate limiting; JS retries later, or gave up
   LOAD_STATE_RECEIVING,      // Receiving departure data
   LOAD_STATE_COMPLETE,       // All data received
   LOAD_STATE_ERROR          // Error occurred
@@ -49,12 +104,38 @@ typedef struct {
   char platform[4];
   char train_type[8];
   char duration[8];
+  char station_label[16];  // Group member used (e.g., "North"), empty otherwise
+  int16_t minutes_left;  // Minutes until (delayed) departure, see countdown.h
   int8_t depart_delay;  // Minutes of departure delay (0 = on time)
   int8_t arrive_delay;  // Minutes of arrival delay (0 = on time)
   bool is_direct;  // true = direct train, false = requires connection
   bool platform_changed;  // true = platform changed from original
+  bool has_alert;  // An iRail alert or a disruption touches this train
+  uint8_t fill;  // DepartureFill: how much of the row has arrived
 } TrainDeparture;
 
+// How much of a departure row has arrived (weak links send rows in two
+// parts, see api_handler.h)
+typedef enum {
+  DEPARTURE_FILL_NONE,  // Counted, nothing received yet
+  DEPARTURE_FILL_CORE,  // Times, platform and train type; no destination yet
+  DEPARTURE_FILL_FULL   // Everything
+} DepartureFill;
+
+// Departure in the compact row format (dashboard rows and departure lists
+// on a weak link, see utils.h)
+typedef struct {
+  time_t depart_timestamp;
+  uint16_t duration;      // Minutes
+  int8_t depart_delay;    // Minutes of departure delay (0 = on time)
+  int8_t arrive_delay;    // Minutes of arrival delay (0 = on time)
+  char platform[4];
+  char train_type[4];
+  bool is_direct;
+  bool platform_changed;
+  bool has_alert;
+} CompactDeparture;
+
 // Journey leg data structure
 typedef struct {
   char depart_station[32];
@@ -72,6 +153,14 @@ typedef struct {
   bool arrive_platform_changed;
 } JourneyLeg;
 
+// Intermediate stop of a journey leg (streamed on demand)
+typedef struct {
+  char name[24];
+  char time[6];
+  int8_t delay;       // Minutes of arrival delay (0 = on time)
+  uint16_t position;  // Stop number across all legs, STOP_POSITION_NONE if unused
+} IntermediateStop;
+
 // Journey detail (collection of legs)
 typedef struct {
   JourneyLeg legs[4];      // Max 3 connections = 4 legs
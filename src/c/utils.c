@@ -31,3 +31,52 @@ void abbreviate_station_name(const char *input, char *output, size_t output_size
     output[output_size - 1] = '\0';
   }
 }
+
+void format_duration(uint32_t minutes, char *buffer, size_t size) {
+  if (minutes >= 60) {
+    if (minutes % 60) {
+      snprintf(buffer, size, "%luh%lum", (unsigned long)(minutes / 60), (unsigned long)(minutes % 60));
+    } else {
+      snprintf(buffer, size, "%luh", (unsigned long)(minutes / 60));
+    }
+  } else {
+    snprintf(buffer, size, "%lum", (unsigned long)minutes);
+  }
+}
+
+#define COMPACT_FIXED_SIZE 9
+#define COMPACT_FLAG_DIRECT 0x01
+#define COMPACT_FLAG_PLATFORM_CHANGED 0x02
+#define COMPACT_FLAG_ALERT 0x04
+
+// Copy a NUL-terminated string out of a blob; returns false past its end
+static bool read_string(const uint8_t *data, uint16_t length, uint16_t *pos, char *dest,
+                        size_t size) {
+  uint16_t start = *pos;
+  while (*pos < length && data[*pos]) (*pos)++;
+  if (*pos >= length) return false;
+
+  size_t count = (size_t)(*pos - start) < size - 1 ? (size_t)(*pos - start) : size - 1;
+  memcpy(dest, &data[start], count);
+  dest[count] = '\0';
+  (*pos)++;
+  return true;
+}
+
+bool read_compact_departure(const uint8_t *data, uint16_t length, uint16_t *pos,
+                            CompactDeparture *departure) {
+  if (*pos + COMPACT_FIXED_SIZE > length) return false;
+
+  const uint8_t *p = &data[*pos];
+  departure->depart_timestamp = (time_t)(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+  departure->duration = p[4] | (p[5] << 8);
+  departure->depart_delay = (int8_t)p[6];
+  departure->arrive_delay = (int8_t)p[7];
+  departure->is_direct = (p[8] & COMPACT_FLAG_DIRECT) != 0;
+  departure->platform_changed = (p[8] & COMPACT_FLAG_PLATFORM_CHANGED) != 0;
+  departure->has_alert = (p[8] & COMPACT_FLAG_ALERT) != 0;
+  *pos += COMPACT_FIXED_SIZE;
+
+  return read_string(data, length, pos, departure->platform, sizeof(departure->platform)) &&
+         read_string(data, length, pos, departure->train_type, sizeof(departure->train_type));
+}
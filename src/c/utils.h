@@ -2,5 +2,20 @@
 
 #include <pebble.h>
 
+#include "types.h"
+
 // Helper function to abbreviate station names for display
 void abbreviate_station_name(const char *input, char *output, size_t output_size);
+
+// Trip duration as the phone formats it ("45m", "1h", "1h12m")
+void format_duration(uint32_t minutes, char *buffer, size_t size);
+
+// Compact departure row, little-endian:
+//   u32 departure (Unix time), u16 duration in minutes
+//   s8 departure delay, s8 arrival delay (minutes)
+//   u8 flags (bit 0 direct, bit 1 platform changed, bit 2 alert)
+//   platform, train type: NUL-terminated
+// Reads the row at *pos and moves past it; returns false if it runs past
+// the end of the blob
+bool read_compact_departure(const uint8_t *data, uint16_t length, uint16_t *pos,
+                            CompactDeparture *departure);
@@ -1,8 +1,13 @@
 // Constants for NMBS Pebble App
 
-// API URLs
-var IRAIL_API_URL = 'https://api.irail.be/connections/';
-var IRAIL_STATIONS_URL = 'https://api.irail.be/v1/stations?format=json';
+// API URLs (point API_BASE_URL at a self-hosted scripts/irail_proxy.js to
+// share cached answers between users)
+var API_BASE_URL = 'https://api.irail.be';
+var IRAIL_API_URL = API_BASE_URL + '/connections/';
+var IRAIL_STATIONS_URL = API_BASE_URL + '/v1/stations?format=json';
+var IRAIL_LIVEBOARD_URL = API_BASE_URL + '/liveboard/';
+var IRAIL_VEHICLE_URL = API_BASE_URL + '/vehicle/';
+var IRAIL_DISTURBANCES_URL = API_BASE_URL + '/disturbances/';
 
 // Default station IDs (fallback if no config and backward compatibility)
 var STATION_IDS = {
@@ -13,6 +18,17 @@ var STATION_IDS = {
   'Leuven': 'BE.NMBS.008833001'
 };
 
+// Station groups offered as favorites: departures from/to any member are
+// merged into one list (keep in sync with stationGroups in config.html)
+var STATION_GROUPS = [
+  { id: 'GROUP.BRUSSELS', name: 'Brussels (Central/North/South)',
+    members: ['BE.NMBS.008813003', 'BE.NMBS.008812005', 'BE.NMBS.008814001'] },
+  { id: 'GROUP.ANTWERP', name: 'Antwerp (Central/Berchem)',
+    members: ['BE.NMBS.008821006', 'BE.NMBS.008821121'] },
+  { id: 'GROUP.GHENT', name: 'Ghent (Sint-Pieters/Dampoort)',
+    members: ['BE.NMBS.008892007', 'BE.NMBS.008893120'] }
+];
+
 // Message type constants
 var MESSAGE_TYPES = {
   REQUEST_DATA: 1,
@@ -22,8 +38,23 @@ var MESSAGE_TYPES = {
   SEND_DETAIL: 5,
   SEND_STATION_COUNT: 6,
   SEND_STATION: 7,
-  SET_ACTIVE_ROUTE: 8,
-  REQUEST_ACK: 9
+  SCHEDULE_TABLE: 8,
+  REQUEST_ACK: 9,
+  TRACE_REPORT: 10,
+  ENERGY_REPORT: 11,
+  SNAPSHOT: 12,
+  REQUEST_STOPS: 13,
+  SEND_STOP: 14,
+  STOP_TRACKING: 15,
+  LEG_UPDATE: 16,
+  REQUEST_STATION_DICT: 17,
+  STATION_DICT: 18,
+  DASHBOARD_ROUTES: 19,
+  REQUEST_DASHBOARD: 20,
+  DASHBOARD_DATA: 21,
+  DEPARTURE_DETAILS: 22,
+  THROTTLED: 23,
+  ALERTS: 24
 };
 
 // LocalStorage keys
@@ -34,7 +65,16 @@ var STORAGE_KEYS = {
   STATION_CACHE: 'nmbs_station_cache',
   FAVORITE_STATIONS: 'nmbs_favorite_stations',
   SMART_SCHEDULES: 'nmbs_smart_schedules',
-  LANGUAGE: 'nmbs_language'
+  DASHBOARD_ROUTES: 'nmbs_dashboard_routes',
+  LANGUAGE: 'nmbs_language',
+  LOG_LEVEL: 'nmbs_log_level',
+  TRACE_ENABLED: 'nmbs_trace_enabled',
+  ENERGY: 'nmbs_energy',
+  TIMETABLE: 'nmbs_timetable',
+  TIMETABLE_META: 'nmbs_timetable_meta',
+  SNAPSHOT_SENT: 'nmbs_snapshot_sent',
+  VEHICLE_STOPS: 'nmbs_vehicle_stops',
+  DISRUPTIONS: 'nmbs_disruptions'
 };
 
 // Configuration limits
@@ -44,7 +84,56 @@ var CONFIG = {
   MAX_FAVORITE_STATIONS: 6,      // Maximum favorite stations
   USER_AGENT: 'WerknaamCommuter <https://werknaam.be, commuter@werknaam.be>',
   CONFIG_URL: 'https://assets-eu.gbgk.net/nmbs-pebble/config.html',
-  DEFAULT_LANGUAGE: 'en'         // Default language for API requests
+  APP_VERSION: '1.3.0',          // Keep in sync with package.json (tags energy records)
+  DEFAULT_LANGUAGE: 'en',        // Default language for API requests
+  DEFAULT_LOG_LEVEL: 'warn',     // Overridable via localStorage (nmbs_log_level)
+  TRACE_BUFFER_SIZE: 128,        // Events kept in the trace ring buffer
+  LATENCY_REPORT_SIZE: 32,       // Requests kept for latency percentiles
+  LATENCY_SUMMARY_EVERY: 10,     // Log percentiles after this many reports
+  ENERGY_HOURS_KEPT: 48,         // Hourly energy records kept in localStorage
+  TIMETABLE_URL: '',             // Offline timetable (scripts/build_timetable.js output), '' = disabled
+  TIMETABLE_REFRESH_MS: 24 * 60 * 60 * 1000,  // Re-download the offline timetable daily
+  TIMETABLE_MIN_CHANGE: 180,     // Minimum transfer time in seconds for offline planning
+  SNAPSHOT_HOURS: 4,             // Hours of departures pushed to the watch per route
+  SNAPSHOT_MAX_ROUTES: 3,        // Must match SNAPSHOT_MAX_ROUTES in types.h
+  SNAPSHOT_MAX_BYTES: 400,       // Must match SNAPSHOT_MAX_BYTES in types.h
+  SNAPSHOT_MAX_PAGES: 4,         // iRail requests per route and refresh
+  SNAPSHOT_REFRESH_MS: 30 * 60 * 1000,  // Re-push snapshots at most every 30 minutes
+  LIVEBOARD_FANOUT: false,       // Answer routes from one liveboard per origin (03-liveboard.js);
+                                 // direct trains only, so off by default
+  GROUP_FETCH_SEQUENTIAL: false, // Fetch a group route's member pairs one after another
+                                 // (simulate.js --sequential-groups compares)
+  LIVEBOARD_TTL_MS: 60 * 1000,   // Reuse an origin's liveboard for this long
+  LIVEBOARD_MIN_RESULTS: 3,      // Fewer direct matches fall back to /connections/
+  LIVEBOARD_VEHICLE_FETCHES: 8,  // Uncached vehicle stop lists fetched per liveboard
+  STOPS_PAGE_SIZE: 6,            // Must match STOPS_PAGE_SIZE in types.h
+  SCHEDULE_TABLE_MAX_ENTRIES: 48,  // Must match SCHEDULE_TABLE_MAX_ENTRIES in types.h
+  TRACKING_MIN_INTERVAL_MS: 30 * 1000,      // Fastest vehicle poll while a journey is open
+  TRACKING_MAX_INTERVAL_MS: 5 * 60 * 1000,  // Slowest poll, long before the next event
+  STATION_DICT_BLOCK_ENTRIES: 16,    // Stations per front-coded dictionary block
+  STATION_DICT_BLOCK_MAX_BYTES: 256, // Must match STATION_DICT_BLOCK_MAX_BYTES in types.h
+  STATION_DICT_MAX_BLOCKS: 64,       // Must match STATION_DICT_MAX_BLOCKS in types.h
+  DASHBOARD_MAX_ROUTES: 3,       // Must match DASHBOARD_MAX_ROUTES in types.h
+  DASHBOARD_ROWS_PER_ROUTE: 3,   // Must match DASHBOARD_ROWS_PER_ROUTE in types.h
+  LINK_SLOW_RTT_MS: 600,         // Acks slower than this (on average) make the link weak
+  LINK_MAX_FAILURE_RATE: 0.2,    // So does a higher share of failed sends
+  LINK_FIRST_BATCH: 3,           // Compact rows in the first message of a list on a weak link
+  LINK_MAX_RETRIES: 2,           // Resends of a failed compact batch
+  IRAIL_RATE_PER_S: 3,           // iRail's documented limit per client...
+  IRAIL_BURST: 5,                // ...with bursts of this many requests
+  IRAIL_BACKOFF_MS: 1000,        // First wait after a 429/5xx without Retry-After (then doubled)
+  IRAIL_MAX_BACKOFF_MS: 60 * 1000,
+  IRAIL_MAX_RETRIES: 2,          // Retries of a throttled request
+  IRAIL_MAX_RETRY_WAIT_MS: 8000, // Longer waits fail the request (within LOADING_TIMEOUT_MS in types.h)
+  DISRUPTIONS_POLL_MS: 5 * 60 * 1000,  // Ask the disturbances feed at most this often
+  DISRUPTIONS_CACHE_MAX: 40,     // Disturbances kept in localStorage
+  ALERTS_MAX: 4,                 // Must match ALERTS_MAX in types.h
+  ALERT_TITLE_LEN: 48,           // Must match ALERT_TITLE_LEN in types.h
+  LOCATION_ORIGIN: true,         // Start from the station nearest to the phone (03-station-locator.js)
+  LOCATION_TIMEOUT_MS: 2000,     // Wait for a fix at launch (well under CONFIG_TIMEOUT_MS in types.h)
+  LOCATION_MAX_AGE_MS: 10 * 60 * 1000,  // Accept a cached fix this old
+  LOCATION_FAVORITE_KM: 1.5,     // A favorite this close becomes the origin
+  LOCATION_STATION_KM: 1         // Otherwise any station this close
 };
 
 // Supported languages
@@ -58,7 +147,11 @@ var LANGUAGES = [
 module.exports = {
   IRAIL_API_URL: IRAIL_API_URL,
   IRAIL_STATIONS_URL: IRAIL_STATIONS_URL,
+  IRAIL_LIVEBOARD_URL: IRAIL_LIVEBOARD_URL,
+  IRAIL_VEHICLE_URL: IRAIL_VEHICLE_URL,
+  IRAIL_DISTURBANCES_URL: IRAIL_DISTURBANCES_URL,
   STATION_IDS: STATION_IDS,
+  STATION_GROUPS: STATION_GROUPS,
   MESSAGE_TYPES: MESSAGE_TYPES,
   STORAGE_KEYS: STORAGE_KEYS,
   CONFIG: CONFIG,
@@ -0,0 +1,127 @@
+// Logging and tracing for NMBS Pebble App
+//
+// Messages below the current level are dropped before they are built: pass a
+// function instead of a string for anything expensive to format, e.g.
+//   Log.debug(function() { return 'Payload: ' + JSON.stringify(payload); });
+//
+// Trace mode records structured events into a fixed-size ring buffer instead
+// of printing them, so it can stay on during normal use and be dumped later.
+var Constants = require('./00-constants.js');
+
+var LEVELS = {
+  error: 0,
+  warn: 1,
+  info: 2,
+  debug: 3
+};
+
+var currentLevel = LEVELS[Constants.CONFIG.DEFAULT_LOG_LEVEL];
+
+// Trace ring buffer
+var traceEnabled = false;
+var traceBuffer = [];
+var traceNext = 0;     // Slot the next event is written to
+var traceDropped = 0;  // Events overwritten since the last clear
+
+  // Load level and trace settings from localStorage
+function init() {
+    try {
+      var storedLevel = localStorage.getItem(Constants.STORAGE_KEYS.LOG_LEVEL);
+      if (storedLevel && LEVELS.hasOwnProperty(storedLevel)) {
+        currentLevel = LEVELS[storedLevel];
+      }
+      traceEnabled = localStorage.getItem(Constants.STORAGE_KEYS.TRACE_ENABLED) === '1';
+    } catch (e) {
+      console.log('Error loading log settings: ' + e.message);
+    }
+  }
+
+function setLevel(name) {
+    if (LEVELS.hasOwnProperty(name)) {
+      currentLevel = LEVELS[name];
+    }
+  }
+
+function isEnabled(name) {
+    return LEVELS[name] <= currentLevel;
+  }
+
+  // Print a message if its level is enabled (message may be a function)
+function write(level, prefix, message) {
+    if (level > currentLevel) {
+      return;
+    }
+    console.log(prefix + (typeof message === 'function' ? message() : message));
+  }
+
+function error(message) { write(LEVELS.error, '[E] ', message); }
+function warn(message) { write(LEVELS.warn, '[W] ', message); }
+function info(message) { write(LEVELS.info, '', message); }
+function debug(message) { write(LEVELS.debug, '', message); }
+
+function setTraceEnabled(enabled) {
+    traceEnabled = enabled;
+  }
+
+function isTraceEnabled() {
+    return traceEnabled;
+  }
+
+  // Record a structured trace event (no-op unless tracing is enabled)
+  // fields should be a small flat object; it is stored by reference.
+function trace(event, fields) {
+    if (!traceEnabled) {
+      return;
+    }
+
+    var entry = { t: Date.now(), event: event, fields: fields || null };
+    if (traceBuffer.length < Constants.CONFIG.TRACE_BUFFER_SIZE) {
+      traceBuffer.push(entry);
+    } else {
+      traceBuffer[traceNext] = entry;
+      traceDropped++;
+    }
+    traceNext = (traceNext + 1) % Constants.CONFIG.TRACE_BUFFER_SIZE;
+  }
+
+  // Return trace events in chronological order
+function getTrace() {
+    if (traceBuffer.length < Constants.CONFIG.TRACE_BUFFER_SIZE) {
+      return traceBuffer.slice();
+    }
+    return traceBuffer.slice(traceNext).concat(traceBuffer.slice(0, traceNext));
+  }
+
+  // Print all trace events (one JSON line each) and clear the buffer
+function dumpTrace() {
+    var events = getTrace();
+    console.log('Trace dump: ' + events.length + ' events (' + traceDropped + ' dropped)');
+    for (var i = 0; i < events.length; i++) {
+      console.log('TRACE ' + JSON.stringify(events[i]));
+    }
+    clearTrace();
+    return events;
+  }
+
+function clearTrace() {
+    traceBuffer = [];
+    traceNext = 0;
+    traceDropped = 0;
+  }
+
+init();
+
+module.exports = {
+  setLevel: setLevel,
+  isEnabled: isEnabled,
+  error: error,
+  warn: warn,
+  info: info,
+  debug: debug,
+  setTraceEnabled: setTraceEnabled,
+  isTraceEnabled: isTraceEnabled,
+  trace: trace,
+  getTrace: getTrace,
+  dumpTrace: dumpTrace,
+  clearTrace: clearTrace
+};
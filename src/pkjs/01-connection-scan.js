@@ -0,0 +1,340 @@
+// Connection-scan journey planner over a compact timetable
+//
+// Pure functions, no Pebble or localStorage dependencies, so the same code
+// runs in PebbleKit JS and in scripts/build_timetable.js / bench_timetable.js.
+//
+// Timetable format (version 1), as written by scripts/build_timetable.js:
+//   {
+//     v: 1,
+//     start: 'YYYYMMDD',          // First service day covered
+//     days: 7,                    // Number of service days covered
+//     stations: [[iRailId, name], ...],
+//     services: ['1111100', ...], // Active-day mask per service, one char per day
+//     trips: [[serviceIdx, type, number, headsign], ...],
+//     platforms: ['', '1', ...],
+//     connections: [dep, arr, depSecs, arrSecs, trip, depPlatform, arrPlatform, ...]
+//   }
+// connections is a flat array of STRIDE ints sorted by depSecs. Times are
+// GTFS service-day seconds (may exceed 24h for trains running past midnight).
+
+var STRIDE = 7;
+var C_DEP = 0;
+var C_ARR = 1;
+var C_DEP_SECS = 2;
+var C_ARR_SECS = 3;
+var C_TRIP = 4;
+var C_DEP_PLATFORM = 5;
+var C_ARR_PLATFORM = 6;
+
+var DAY_SECS = 86400;
+var UNREACHED = 0x7FFFFFFF;
+
+  // Parse 'YYYYMMDD' into a local Date at noon (avoids DST edge cases)
+function parseServiceDate(yyyymmdd) {
+    return new Date(parseInt(yyyymmdd.substring(0, 4), 10),
+                    parseInt(yyyymmdd.substring(4, 6), 10) - 1,
+                    parseInt(yyyymmdd.substring(6, 8), 10), 12);
+  }
+
+  // Unix time of a service day's GTFS origin (noon minus 12h, local time)
+function serviceDayOrigin(date) {
+    var noon = new Date(date.getFullYear(), date.getMonth(), date.getDate(), 12);
+    return Math.floor(noon.getTime() / 1000) - DAY_SECS / 2;
+  }
+
+  // Keep only trips that call at one of stationIds (and their full stop
+  // sequence, so one-transfer journeys between those stations survive).
+  // Stations, services and platforms are reindexed to what is still used.
+function filterTimetable(tt, stationIds) {
+    var wanted = {};
+    for (var i = 0; i < tt.stations.length; i++) {
+      if (stationIds.indexOf(tt.stations[i][0]) !== -1) {
+        wanted[i] = true;
+      }
+    }
+
+    var conns = tt.connections;
+    var keepTrip = {};
+    for (var c = 0; c < conns.length; c += STRIDE) {
+      if (wanted[conns[c + C_DEP]] || wanted[conns[c + C_ARR]]) {
+        keepTrip[conns[c + C_TRIP]] = true;
+      }
+    }
+
+    var stationMap = {}, tripMap = {}, serviceMap = {}, platformMap = {};
+    var out = {
+      v: tt.v, start: tt.start, days: tt.days,
+      stations: [], services: [], trips: [], platforms: [], connections: []
+    };
+
+    function remap(map, list, index, value) {
+      if (!map.hasOwnProperty(index)) {
+        map[index] = list.length;
+        list.push(value);
+      }
+      return map[index];
+    }
+
+    for (c = 0; c < conns.length; c += STRIDE) {
+      var trip = conns[c + C_TRIP];
+      if (!keepTrip[trip]) {
+        continue;
+      }
+      var t = tt.trips[trip];
+      if (!tripMap.hasOwnProperty(trip)) {
+        remap(tripMap, out.trips, trip,
+              [remap(serviceMap, out.services, t[0], tt.services[t[0]]), t[1], t[2], t[3]]);
+      }
+      out.connections.push(
+          remap(stationMap, out.stations, conns[c + C_DEP], tt.stations[conns[c + C_DEP]]),
+          remap(stationMap, out.stations, conns[c + C_ARR], tt.stations[conns[c + C_ARR]]),
+          conns[c + C_DEP_SECS],
+          conns[c + C_ARR_SECS],
+          tripMap[trip],
+          remap(platformMap, out.platforms, conns[c + C_DEP_PLATFORM], tt.platforms[conns[c + C_DEP_PLATFORM]]),
+          remap(platformMap, out.platforms, conns[c + C_ARR_PLATFORM], tt.platforms[conns[c + C_ARR_PLATFORM]]));
+    }
+    return out;
+  }
+
+  // Build the dated connection list for a service day plus the spill-over of
+  // the previous day (trains past midnight) and the next day (late queries).
+  // Returns null if the date is outside the timetable horizon.
+function buildDay(tt, date) {
+    var first = parseServiceDate(tt.start);
+    var dayIndex = Math.round((serviceDayOrigin(date) - serviceDayOrigin(first)) / DAY_SECS);
+    if (dayIndex < 0 || dayIndex >= tt.days) {
+      return null;
+    }
+
+    var conns = tt.connections;
+    var count = conns.length / STRIDE;
+    var dep = [], arr = [], conn = [], trip = [];
+    var origins = [];
+
+    for (var d = -1; d <= 1; d++) {
+      var index = dayIndex + d;
+      if (index < 0 || index >= tt.days) {
+        continue;
+      }
+      var when = new Date(date.getTime() + d * DAY_SECS * 1000);
+      origins.push({ index: index, origin: serviceDayOrigin(when),
+                     // Only the part after midnight matters for yesterday
+                     minSecs: d < 0 ? DAY_SECS : 0 });
+    }
+
+    var active = tt.trips.map(function(trip) { return tt.services[trip[0]]; });
+    for (var o = 0; o < origins.length; o++) {
+      var day = origins[o];
+      for (var i = 0; i < count; i++) {
+        var c = i * STRIDE;
+        if (conns[c + C_DEP_SECS] < day.minSecs ||
+            active[conns[c + C_TRIP]].charAt(day.index) !== '1') {
+          continue;
+        }
+        conn.push(i);
+        // The same trip on different days must not be treated as one run
+        trip.push(conns[c + C_TRIP] + o * tt.trips.length);
+        dep.push(day.origin + conns[c + C_DEP_SECS]);
+        arr.push(day.origin + conns[c + C_ARR_SECS]);
+      }
+    }
+
+    // Merge the days into one list ordered by departure
+    var order = conn.map(function(_, k) { return k; });
+    order.sort(function(a, b) { return dep[a] - dep[b] || arr[a] - arr[b]; });
+
+    var result = {
+      dep: new Int32Array(order.length),
+      arr: new Int32Array(order.length),
+      conn: new Int32Array(order.length),
+      trip: new Int32Array(order.length),
+      tripCount: origins.length * tt.trips.length
+    };
+    for (var k = 0; k < order.length; k++) {
+      result.dep[k] = dep[order[k]];
+      result.arr[k] = arr[order[k]];
+      result.conn[k] = conn[order[k]];
+      result.trip[k] = trip[order[k]];
+    }
+    return result;
+  }
+
+  // First index in day with a departure at or after time
+function lowerBound(day, time) {
+    var lo = 0, hi = day.dep.length;
+    while (lo < hi) {
+      var mid = (lo + hi) >> 1;
+      if (day.dep[mid] < time) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+function findStation(tt, iRailId) {
+    for (var i = 0; i < tt.stations.length; i++) {
+      if (tt.stations[i][0] === iRailId) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  // TypedArray.prototype.fill is missing on older phone JS engines
+function fillArray(array, value) {
+    for (var i = 0; i < array.length; i++) {
+      array[i] = value;
+    }
+  }
+
+  // Scratch arrays reused across scans of the same timetable
+function Workspace(tt, day) {
+    this.arrival = new Int32Array(tt.stations.length);
+    this.enter = new Int32Array(tt.stations.length);
+    this.exit = new Int32Array(tt.stations.length);
+    this.boarded = new Int32Array(day.tripCount);
+  }
+
+  // Earliest-arrival scan from `from` at `time`. Returns the journey legs as
+  // [{ enter, exit }] day indices (boarding and alighting connection), or null.
+function scan(tt, day, ws, from, to, time, minChange) {
+    var conns = tt.connections;
+    fillArray(ws.arrival, UNREACHED);
+    fillArray(ws.enter, -1);
+    fillArray(ws.boarded, -1);
+    ws.arrival[from] = time;
+
+    for (var i = lowerBound(day, time); i < day.dep.length; i++) {
+      var depTime = day.dep[i];
+      if (depTime > ws.arrival[to]) {
+        break;
+      }
+
+      var c = day.conn[i] * STRIDE;
+      var trip = day.trip[i];
+      if (ws.boarded[trip] === -1) {
+        var station = conns[c + C_DEP];
+        if (ws.arrival[station] === UNREACHED ||
+            ws.arrival[station] + (station === from ? 0 : minChange) > depTime) {
+          continue;
+        }
+        ws.boarded[trip] = i;
+      }
+
+      var target = conns[c + C_ARR];
+      if (day.arr[i] < ws.arrival[target]) {
+        ws.arrival[target] = day.arr[i];
+        ws.enter[target] = ws.boarded[trip];
+        ws.exit[target] = i;
+      }
+    }
+
+    if (ws.enter[to] === -1) {
+      return null;
+    }
+
+    // Walk back from the destination to the origin
+    var legs = [];
+    var at = to;
+    while (at !== from && legs.length < tt.stations.length) {
+      legs.unshift({ enter: ws.enter[at], exit: ws.exit[at] });
+      at = conns[day.conn[ws.enter[at]] * STRIDE + C_DEP];
+    }
+    return legs;
+  }
+
+  // Intermediate stops between boarding and alighting (as iRail stops.number)
+function countStops(tt, day, leg) {
+    var trip = day.trip[leg.enter];
+    var stops = -1;
+    for (var i = leg.enter; i <= leg.exit; i++) {
+      if (day.trip[i] === trip) {
+        stops++;
+      }
+    }
+    return stops;
+  }
+
+  // iRail-shaped departure/arrival endpoint for a connection
+function endpoint(tt, day, index, isDeparture, stops) {
+    var c = day.conn[index] * STRIDE;
+    var trip = tt.trips[tt.connections[c + C_TRIP]];
+    var station = tt.stations[tt.connections[c + (isDeparture ? C_DEP : C_ARR)]];
+    var result = {
+      time: String(isDeparture ? day.dep[index] : day.arr[index]),
+      delay: '0',
+      platform: tt.platforms[tt.connections[c + (isDeparture ? C_DEP_PLATFORM : C_ARR_PLATFORM)]],
+      platforminfo: { normal: '1' },
+      vehicle: 'BE.NMBS.' + trip[1] + trip[2],
+      vehicleinfo: { type: trip[1], shortname: trip[1] + ' ' + trip[2] },
+      direction: { name: trip[3] },
+      stationinfo: { name: station[1] }
+    };
+    if (stops !== undefined) {
+      result.stops = { number: String(stops) };
+    }
+    return result;
+  }
+
+  // Convert scan legs into an iRail /connections/ entry
+function toConnection(tt, day, legs) {
+    var first = legs[0];
+    var last = legs[legs.length - 1];
+    var vias = [];
+    for (var i = 0; i + 1 < legs.length; i++) {
+      vias.push({
+        arrival: endpoint(tt, day, legs[i].exit, false),
+        departure: endpoint(tt, day, legs[i + 1].enter, true, countStops(tt, day, legs[i + 1]))
+      });
+    }
+    return {
+      duration: String(day.arr[last.exit] - day.dep[first.enter]),
+      departure: endpoint(tt, day, first.enter, true, countStops(tt, day, first)),
+      arrival: endpoint(tt, day, last.exit, false),
+      vias: { number: String(vias.length), via: vias }
+    };
+  }
+
+  // Plan up to maxResults journeys departing from `time` (Unix seconds).
+  // Journeys dominated by a later departure with the same arrival are dropped.
+  // Returns { connection: [...] } shaped like an iRail response, or null if
+  // either station is not in the timetable or the date is out of range.
+function plan(tt, day, fromId, toId, time, maxResults, minChange) {
+    var from = findStation(tt, fromId);
+    var to = findStation(tt, toId);
+    if (from === -1 || to === -1 || from === to || !day) {
+      return null;
+    }
+
+    var ws = new Workspace(tt, day);
+    var journeys = [];
+    var lastArrival = -1;
+    while (journeys.length < maxResults) {
+      var legs = scan(tt, day, ws, from, to, time, minChange);
+      if (!legs) {
+        break;
+      }
+      var arrival = day.arr[legs[legs.length - 1].exit];
+      if (arrival === lastArrival) {
+        journeys.pop();
+      }
+      journeys.push(legs);
+      lastArrival = arrival;
+      time = day.dep[legs[0].enter] + 1;
+    }
+
+    return {
+      connection: journeys.map(function(legs) { return toConnection(tt, day, legs); })
+    };
+  }
+
+module.exports = {
+  STRIDE: STRIDE,
+  parseServiceDate: parseServiceDate,
+  filterTimetable: filterTimetable,
+  buildDay: buildDay,
+  plan: plan
+};
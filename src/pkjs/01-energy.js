@@ -0,0 +1,117 @@
+// Radio and energy accounting per feature for NMBS Pebble App
+//
+// The phone counts its own HTTP requests per hour and feature; the watch
+// sends its hourly AppMessage/launch/wake/redraw counters (MSG_ENERGY_REPORT,
+// see src/c/energy.h) once an hour has closed. Both are merged into one
+// record per hour, kept in localStorage and printed as a single "ENERGY" line
+// per closed hour so they can be collected from the logs and compared across
+// releases.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+
+// Order must match EnergyFeature and EnergyMetric in src/c/energy.h
+var FEATURES = ['foreground', 'background', 'detail', 'config'];
+var WATCH_METRICS = ['msgIn', 'msgOut', 'bytesIn', 'bytesOut', 'launches', 'workerWakes', 'redraws'];
+
+var FEATURE = {
+  FOREGROUND: 'foreground',
+  BACKGROUND: 'background',
+  DETAIL: 'detail',
+  CONFIG: 'config'
+};
+
+function currentHour() {
+    return Math.floor(Date.now() / 3600000);
+  }
+
+function loadBuckets() {
+    try {
+      var json = localStorage.getItem(Constants.STORAGE_KEYS.ENERGY);
+      if (json) {
+        return JSON.parse(json);
+      }
+    } catch (e) {
+      Log.error('Error loading energy buckets: ' + e.message);
+    }
+    return {};
+  }
+
+function saveBuckets(buckets) {
+    // Drop the oldest hours beyond the retention limit
+    var hours = Object.keys(buckets).map(Number).sort(function(a, b) { return a - b; });
+    while (hours.length > Constants.CONFIG.ENERGY_HOURS_KEPT) {
+      delete buckets[hours.shift()];
+    }
+
+    try {
+      localStorage.setItem(Constants.STORAGE_KEYS.ENERGY, JSON.stringify(buckets));
+    } catch (e) {
+      Log.error('Error saving energy buckets: ' + e.message);
+    }
+  }
+
+function getBucket(buckets, hour) {
+    if (!buckets[hour]) {
+      buckets[hour] = { hour: hour, version: Constants.CONFIG.APP_VERSION, phone: {}, watch: null };
+    }
+    return buckets[hour];
+  }
+
+function addPhoneCount(feature, metric, amount) {
+    var buckets = loadBuckets();
+    var phone = getBucket(buckets, currentHour()).phone;
+    var counters = phone[feature] = phone[feature] || { httpRequests: 0, httpBytes: 0 };
+    counters[metric] += amount;
+    saveBuckets(buckets);
+  }
+
+  // Count an HTTP request being sent for a feature
+function countHttpRequest(feature) {
+    addPhoneCount(feature, 'httpRequests', 1);
+  }
+
+  // Count HTTP response payload bytes for a feature
+function countHttpBytes(feature, bytes) {
+    addPhoneCount(feature, 'httpBytes', bytes);
+  }
+
+  // Merge a closed hour of watch counters (byte array of little-endian
+  // uint32, feature-major) and export the combined record
+function addWatchReport(watchHour, data) {
+    if (!data) {
+      return;
+    }
+
+    var watch = {};
+    for (var f = 0; f < FEATURES.length; f++) {
+      var counters = {};
+      for (var m = 0; m < WATCH_METRICS.length; m++) {
+        var offset = (f * WATCH_METRICS.length + m) * 4;
+        counters[WATCH_METRICS[m]] = (data[offset] | (data[offset + 1] << 8) |
+                                      (data[offset + 2] << 16)) + data[offset + 3] * 16777216;
+      }
+      watch[FEATURES[f]] = counters;
+    }
+
+    var buckets = loadBuckets();
+    var bucket = getBucket(buckets, watchHour);
+    bucket.watch = watch;
+    saveBuckets(buckets);
+
+    Log.debug(function() { return 'ENERGY ' + JSON.stringify(bucket); });
+  }
+
+  // All kept hourly records, oldest first
+function exportBuckets() {
+    var buckets = loadBuckets();
+    return Object.keys(buckets).map(Number).sort(function(a, b) { return a - b; })
+        .map(function(hour) { return buckets[hour]; });
+  }
+
+module.exports = {
+  FEATURE: FEATURE,
+  countHttpRequest: countHttpRequest,
+  countHttpBytes: countHttpBytes,
+  addWatchReport: addWatchReport,
+  exportBuckets: exportBuckets
+};
@@ -0,0 +1,281 @@
+// Field-selective parser for iRail /connections/ responses
+//
+// The connections payload carries full stop lists, occupancy data and alert
+// descriptions that the app never uses (of the alerts, only the headers).
+// Instead of JSON.parse'ing the whole document and walking the result, this
+// scanner walks the raw response text once, only materializes the fields
+// listed in the schemas below and skips everything else in place. It stops
+// as soon as enough connections have been read.
+
+// Fields read from a departure/arrival endpoint (see 03-data-processor.js)
+var ENDPOINT_SCHEMA = {
+  time: true,
+  delay: true,
+  platform: true,
+  platforminfo: { normal: true },
+  vehicle: true,
+  vehicleinfo: { type: true, shortname: true },
+  direction: { name: true },
+  stationinfo: { name: true },
+  stops: { number: true }
+};
+
+// Fields read from a single via (transfer)
+var VIA_SCHEMA = {
+  arrival: ENDPOINT_SCHEMA,
+  departure: ENDPOINT_SCHEMA
+};
+
+// Fields read from a single connection
+var CONNECTION_SCHEMA = {
+  duration: true,
+  departure: ENDPOINT_SCHEMA,
+  arrival: ENDPOINT_SCHEMA,
+  vias: { number: true, via: [VIA_SCHEMA] },
+  alerts: { number: true, alert: [{ id: true, header: true }] }
+};
+
+// Top-level response schema
+var RESPONSE_SCHEMA = {
+  connection: [CONNECTION_SCHEMA]
+};
+
+  // Scanner state over a JSON text
+function Scanner(text) {
+    this.text = text;
+    this.pos = 0;
+  }
+
+Scanner.prototype.skipWhitespace = function() {
+    var text = this.text;
+    var pos = this.pos;
+    var c = text.charCodeAt(pos);
+    // space, \t, \n, \r
+    while (c === 32 || c === 9 || c === 10 || c === 13) {
+      c = text.charCodeAt(++pos);
+    }
+    this.pos = pos;
+  };
+
+Scanner.prototype.expect = function(ch) {
+    this.skipWhitespace();
+    if (this.text.charAt(this.pos) !== ch) {
+      throw new Error('Expected \'' + ch + '\' at ' + this.pos);
+    }
+    this.pos++;
+  };
+
+  // Find the end of the string starting at this.pos (on the opening quote)
+Scanner.prototype.stringEnd = function() {
+    var text = this.text;
+    var pos = this.pos + 1;
+    while (true) {
+      var quote = text.indexOf('"', pos);
+      if (quote === -1) {
+        throw new Error('Unterminated string at ' + this.pos);
+      }
+      // Count preceding backslashes to know if this quote is escaped
+      var backslashes = 0;
+      while (text.charCodeAt(quote - 1 - backslashes) === 92) {
+        backslashes++;
+      }
+      if (backslashes % 2 === 0) {
+        return quote + 1;
+      }
+      pos = quote + 1;
+    }
+  };
+
+Scanner.prototype.readString = function() {
+    var start = this.pos;
+    var end = this.stringEnd();
+    this.pos = end;
+    var raw = this.text.substring(start + 1, end - 1);
+    // Only pay for full unescaping when the string actually has escapes
+    return raw.indexOf('\\') === -1 ? raw : JSON.parse(this.text.substring(start, end));
+  };
+
+  // Skip over any JSON value without materializing it
+Scanner.prototype.skipValue = function() {
+    this.skipWhitespace();
+    var text = this.text;
+    var c = text.charAt(this.pos);
+
+    if (c === '"') {
+      this.pos = this.stringEnd();
+      return;
+    }
+
+    if (c === '{' || c === '[') {
+      var depth = 0;
+      var pos = this.pos;
+      var len = text.length;
+      while (pos < len) {
+        var ch = text.charAt(pos);
+        if (ch === '"') {
+          this.pos = pos;
+          pos = this.stringEnd();
+          continue;
+        }
+        if (ch === '{' || ch === '[') {
+          depth++;
+        } else if (ch === '}' || ch === ']') {
+          depth--;
+          if (depth === 0) {
+            this.pos = pos + 1;
+            return;
+          }
+        }
+        pos++;
+      }
+      throw new Error('Unterminated container');
+    }
+
+    // Number, true, false or null: scan to the next delimiter
+    var end = this.pos;
+    while (end < text.length) {
+      var d = text.charAt(end);
+      if (d === ',' || d === '}' || d === ']' || d === ' ' ||
+          d === '\n' || d === '\r' || d === '\t') {
+        break;
+      }
+      end++;
+    }
+    this.pos = end;
+  };
+
+  // Read a scalar, or a whole subtree when the schema asks for it verbatim
+Scanner.prototype.readValue = function() {
+    this.skipWhitespace();
+    var c = this.text.charAt(this.pos);
+
+    if (c === '"') {
+      return this.readString();
+    }
+
+    var start = this.pos;
+    this.skipValue();
+    return JSON.parse(this.text.substring(start, this.pos));
+  };
+
+  // Read a value according to a schema node:
+  //   true     -> materialize the value as-is
+  //   {...}    -> object, keep only listed keys
+  //   [schema] -> array, apply schema to each element (up to limit)
+Scanner.prototype.readSchema = function(schema, limit) {
+    if (schema === true) {
+      return this.readValue();
+    }
+
+    this.skipWhitespace();
+    var c = this.text.charAt(this.pos);
+
+    // Schema mismatch (e.g. null instead of object): keep the raw value
+    if (Array.isArray(schema) ? c !== '[' : c !== '{') {
+      return this.readValue();
+    }
+
+    return Array.isArray(schema) ?
+        this.readArray(schema[0], limit) :
+        this.readObject(schema);
+  };
+
+Scanner.prototype.readObject = function(schema) {
+    var result = {};
+    this.expect('{');
+    this.skipWhitespace();
+    if (this.text.charAt(this.pos) === '}') {
+      this.pos++;
+      return result;
+    }
+
+    while (true) {
+      this.skipWhitespace();
+      var key = this.readString();
+      this.expect(':');
+
+      if (schema.hasOwnProperty(key)) {
+        result[key] = this.readSchema(schema[key]);
+      } else {
+        this.skipValue();
+      }
+
+      this.skipWhitespace();
+      var c = this.text.charAt(this.pos++);
+      if (c === '}') {
+        return result;
+      }
+      if (c !== ',') {
+        throw new Error('Expected \',\' or \'}\' at ' + (this.pos - 1));
+      }
+    }
+  };
+
+  // Arrays stop early once limit elements are read; the rest of the
+  // document is not scanned at all, so callers must not rely on anything
+  // that comes after a limited array.
+Scanner.prototype.readArray = function(schema, limit) {
+    var result = [];
+    this.expect('[');
+    this.skipWhitespace();
+    if (this.text.charAt(this.pos) === ']') {
+      this.pos++;
+      return result;
+    }
+
+    while (true) {
+      result.push(this.readSchema(schema));
+      if (limit && result.length >= limit) {
+        return result;
+      }
+
+      this.skipWhitespace();
+      var c = this.text.charAt(this.pos++);
+      if (c === ']') {
+        return result;
+      }
+      if (c !== ',') {
+        throw new Error('Expected \',\' or \']\' at ' + (this.pos - 1));
+      }
+    }
+  };
+
+  // Parse an iRail /connections/ response, keeping at most maxConnections
+  // connections (0 = all) and only the fields the data processor reads.
+  // Returns an object shaped like the iRail response: { connection: [...] }
+function parseConnections(text, maxConnections) {
+    var scanner = new Scanner(text);
+    var result = {};
+
+    scanner.expect('{');
+    scanner.skipWhitespace();
+    if (scanner.text.charAt(scanner.pos) === '}') {
+      return result;
+    }
+
+    while (true) {
+      scanner.skipWhitespace();
+      var key = scanner.readString();
+      scanner.expect(':');
+
+      if (key === 'connection') {
+        result.connection = scanner.readSchema(RESPONSE_SCHEMA.connection, maxConnections);
+        // Nothing after the connection list is used, stop scanning here
+        return result;
+      }
+      scanner.skipValue();
+
+      scanner.skipWhitespace();
+      var c = scanner.text.charAt(scanner.pos++);
+      if (c === '}') {
+        return result;
+      }
+      if (c !== ',') {
+        throw new Error('Expected \',\' or \'}\' at ' + (scanner.pos - 1));
+      }
+    }
+  }
+
+module.exports = {
+  parseConnections: parseConnections
+};
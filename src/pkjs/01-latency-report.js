@@ -0,0 +1,199 @@
+// End-to-end latency report for train data requests
+//
+// The watch sends a MSG_TRACE_REPORT for each completed request with its stage
+// offsets (ms since it sent REQUEST_DATA, see src/c/trace.h). Those are merged
+// with the phone-side trace events recorded through Log.trace (ms since the
+// request was received here) into a per-request breakdown. Watch and phone
+// clocks are not synchronized, so each side is only compared with itself.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+
+// Order of the uint16 values in TRACE_DATA (must match TraceStage in trace.h)
+var WATCH_STAGES = ['ack', 'count', 'complete', 'error', 'menuReload'];
+var TRACE_NOT_REACHED = 0xFFFF;
+
+// Breakdown segments: [name, from stage, to stage]
+var WATCH_SEGMENTS = [
+  ['watch.ack', 'send', 'ack'],
+  ['watch.fetch', 'ack', 'count'],
+  ['watch.firstDeparture', 'count', 'firstDeparture'],
+  ['watch.stream', 'count', 'lastDeparture'],
+  ['watch.render', 'complete', 'menuReload'],
+  ['watch.total', 'send', 'menuReload']
+];
+
+var PHONE_SEGMENTS = [
+  ['phone.debounce', 'js_receive', 'debounce_fire'],
+  ['phone.queue', 'debounce_fire', 'xhr_start'],
+  ['phone.network', 'xhr_start', 'xhr_end'],
+  ['phone.fanout', 'debounce_fire', 'fanout_done'],
+  ['phone.parse', 'xhr_end', 'parse_done'],
+  ['phone.countSend', 'parse_done', 'count_sent'],
+  ['phone.stream', 'count_sent', 'lastDeparture'],
+  ['phone.total', 'js_receive', 'lastDeparture']
+];
+
+// Recent breakdowns (oldest first)
+var reports = [];
+var reportsSinceSummary = 0;
+
+  // Decode TRACE_DATA (byte array of little-endian uint16) into stage offsets
+function decodeWatchTrace(bytes) {
+    var stages = { send: 0 };
+    var departures = [];
+
+    for (var i = 0; i + 1 < bytes.length; i += 2) {
+      var value = bytes[i] | (bytes[i + 1] << 8);
+      var slot = i / 2;
+      if (value === TRACE_NOT_REACHED) {
+        continue;
+      }
+      if (slot < WATCH_STAGES.length) {
+        stages[WATCH_STAGES[slot]] = value;
+      } else {
+        departures.push(value);
+      }
+    }
+
+    if (departures.length > 0) {
+      stages.firstDeparture = Math.min.apply(null, departures);
+      stages.lastDeparture = Math.max.apply(null, departures);
+    }
+    return stages;
+  }
+
+  // Collect phone-side stage times for a request from the trace ring buffer
+function collectPhoneStages(requestId) {
+    var events = Log.getTrace();
+    var stages = {};
+    var origin = null;
+
+    for (var i = 0; i < events.length; i++) {
+      var event = events[i];
+      if (!event.fields || event.fields.id !== requestId) {
+        continue;
+      }
+      if (event.event === 'js_receive') {
+        // A retried request ID restarts the trace
+        origin = event.t;
+        stages = { js_receive: 0 };
+      } else if (origin !== null) {
+        var offset = event.t - origin;
+        if (event.event === 'departure_sent') {
+          stages.lastDeparture = offset;
+        } else if (!stages.hasOwnProperty(event.event)) {
+          stages[event.event] = offset;
+        }
+      }
+    }
+    return stages;
+  }
+
+function buildSegments(stages, segments, out) {
+    for (var i = 0; i < segments.length; i++) {
+      var from = stages[segments[i][1]];
+      var to = stages[segments[i][2]];
+      if (from !== undefined && to !== undefined) {
+        out[segments[i][0]] = to - from;
+      }
+    }
+  }
+
+function formatBreakdown(report) {
+    var parts = [];
+    for (var name in report.segments) {
+      if (report.segments.hasOwnProperty(name)) {
+        parts.push(name + '=' + report.segments[name] + 'ms');
+      }
+    }
+    return 'Latency [ID ' + report.id + ']' + (report.failed ? ' (failed)' : '') + ': ' +
+           parts.join(' ');
+  }
+
+  // Nearest-rank percentile of a sorted array
+function percentile(sorted, p) {
+    var rank = Math.ceil(p / 100 * sorted.length) - 1;
+    return sorted[Math.max(0, Math.min(sorted.length - 1, rank))];
+  }
+
+  // Percentiles per segment over the kept reports
+function getSummary() {
+    var samples = {};
+    for (var i = 0; i < reports.length; i++) {
+      var segments = reports[i].segments;
+      for (var name in segments) {
+        if (segments.hasOwnProperty(name)) {
+          (samples[name] = samples[name] || []).push(segments[name]);
+        }
+      }
+    }
+
+    var summary = {};
+    for (var key in samples) {
+      if (samples.hasOwnProperty(key)) {
+        var sorted = samples[key].sort(function(a, b) { return a - b; });
+        summary[key] = {
+          n: sorted.length,
+          p50: percentile(sorted, 50),
+          p90: percentile(sorted, 90),
+          max: sorted[sorted.length - 1]
+        };
+      }
+    }
+    return summary;
+  }
+
+function formatSummary() {
+    var summary = getSummary();
+    var lines = ['Latency percentiles over ' + reports.length + ' requests:'];
+    for (var name in summary) {
+      if (summary.hasOwnProperty(name)) {
+        var s = summary[name];
+        lines.push('  ' + name + ': p50=' + s.p50 + 'ms p90=' + s.p90 + 'ms max=' + s.max +
+                   'ms (n=' + s.n + ')');
+      }
+    }
+    return lines.join('\n');
+  }
+
+  // Merge a watch trace report with the phone-side events for the same request
+function addWatchReport(requestId, traceData) {
+    if (!traceData) {
+      return;
+    }
+
+    var watchStages = decodeWatchTrace(traceData);
+    var phoneStages = collectPhoneStages(requestId);
+
+    var report = {
+      id: requestId,
+      failed: watchStages.hasOwnProperty('error'),
+      segments: {}
+    };
+    buildSegments(watchStages, WATCH_SEGMENTS, report.segments);
+    buildSegments(phoneStages, PHONE_SEGMENTS, report.segments);
+
+    reports.push(report);
+    if (reports.length > Constants.CONFIG.LATENCY_REPORT_SIZE) {
+      reports.shift();
+    }
+
+    Log.info(function() { return formatBreakdown(report); });
+
+    reportsSinceSummary++;
+    if (reportsSinceSummary >= Constants.CONFIG.LATENCY_SUMMARY_EVERY) {
+      reportsSinceSummary = 0;
+      Log.info(formatSummary);
+    }
+  }
+
+function getReports() {
+    return reports.slice();
+  }
+
+module.exports = {
+  addWatchReport: addWatchReport,
+  getReports: getReports,
+  getSummary: getSummary,
+  formatSummary: formatSummary
+};
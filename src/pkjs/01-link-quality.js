@@ -0,0 +1,77 @@
+// Bluetooth link quality for NMBS Pebble App
+//
+// Departure lists are sent through send(), which times each AppMessage from
+// send to ack. A moving average of that round trip and of the failure rate
+// is kept for the session (the PebbleKit JS lifetime). A slow or lossy link
+// makes isWeak() true, and departure lists switch to the compact two-part
+// form (see src/c/api_handler.h). batchSize() is how many compact rows go in
+// one message: it grows by one with every ack, since fewer messages is what
+// a slow link needs, and halves on a failure, since a lost big message costs
+// the most. Once acks are quick again the link stops being weak and lists
+// go back to one full message per train.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+
+// Weight of the newest sample in the moving averages
+var SMOOTHING = 0.25;
+
+var rttMs = null;
+var failureRate = 0;
+var batch = Constants.CONFIG.LINK_FIRST_BATCH;
+var weak = false;
+
+function record(ms, ok) {
+    if (ok) {
+      rttMs = rttMs === null ? ms : rttMs + SMOOTHING * (ms - rttMs);
+    }
+    failureRate += SMOOTHING * ((ok ? 0 : 1) - failureRate);
+
+    if (ok) {
+      batch = Math.min(batch + 1, Constants.CONFIG.MAX_DEPARTURES);
+    } else {
+      batch = Math.max(1, Math.floor(batch / 2));
+    }
+
+    var nowWeak = (rttMs !== null && rttMs > Constants.CONFIG.LINK_SLOW_RTT_MS) ||
+                  failureRate > Constants.CONFIG.LINK_MAX_FAILURE_RATE;
+    if (nowWeak !== weak) {
+      weak = nowWeak;
+      Log.info('Link ' + (weak ? 'weak' : 'good again') + ': ' + describe());
+    }
+  }
+
+  // Send an AppMessage, recording how long its ack took
+function send(message, onAck, onNack) {
+    var start = Date.now();
+    Pebble.sendAppMessage(message, function(e) {
+      record(Date.now() - start, true);
+      if (onAck) {
+        onAck(e);
+      }
+    }, function(e) {
+      record(Date.now() - start, false);
+      if (onNack) {
+        onNack(e);
+      }
+    });
+  }
+
+function isWeak() {
+    return weak;
+  }
+
+function batchSize() {
+    return batch;
+  }
+
+function describe() {
+    return 'rtt ' + (rttMs === null ? '-' : Math.round(rttMs) + ' ms') + ', failures ' +
+           Math.round(failureRate * 100) + '%, batch ' + batch;
+  }
+
+module.exports = {
+  send: send,
+  isWeak: isWeak,
+  batchSize: batchSize,
+  describe: describe
+};
@@ -0,0 +1,106 @@
+// Compiled smart-schedule table for NMBS Pebble App
+//
+// Smart schedules are compiled into sorted, non-overlapping minute-of-week
+// intervals (Sunday 00:00 = 0), each mapped to a from/to index into the
+// favorite stations. The table is pushed to the watch (MSG_SCHEDULE_TABLE),
+// which picks the active route itself at startup and at every transition,
+// see src/c/schedule.h for the blob layout. Earlier schedules win where
+// schedules overlap, like the linear scan this replaces.
+var Constants = require('./00-constants.js');
+
+var SCHEDULE_TABLE_VERSION = 1;
+var MINUTES_PER_DAY = 24 * 60;
+
+function parseMinutes(time) {
+    var parts = String(time || '').split(':');
+    return parseInt(parts[0], 10) * 60 + parseInt(parts[1], 10);
+  }
+
+  // Remove the parts of [start, end) already covered by earlier intervals
+function subtractCovered(entries, start, end) {
+    var pieces = [{ start: start, end: end }];
+    entries.forEach(function(entry) {
+      var next = [];
+      pieces.forEach(function(piece) {
+        if (entry.end <= piece.start || entry.start >= piece.end) {
+          next.push(piece);
+          return;
+        }
+        if (piece.start < entry.start) {
+          next.push({ start: piece.start, end: entry.start });
+        }
+        if (entry.end < piece.end) {
+          next.push({ start: entry.end, end: piece.end });
+        }
+      });
+      pieces = next;
+    });
+    return pieces;
+  }
+
+  // Compile schedules into intervals { start, end, from, to } sorted by start
+  // (end exclusive). stationIds are the favorites as sent to the watch;
+  // schedules for routes outside them are dropped.
+function compile(schedules, stationIds) {
+    var entries = [];
+    (schedules || []).forEach(function(schedule) {
+      var from = stationIds.indexOf(schedule.fromId);
+      var to = stationIds.indexOf(schedule.toId);
+      var startMinute = parseMinutes(schedule.startTime);
+      // The end time is inclusive (the old check was time <= endTime)
+      var endMinute = parseMinutes(schedule.endTime) + 1;
+      if (!schedule.enabled || from === -1 || to === -1 || from === to ||
+          isNaN(startMinute) || isNaN(endMinute) || endMinute <= startMinute) {
+        return;
+      }
+
+      (schedule.days || []).forEach(function(day) {
+        var base = day * MINUTES_PER_DAY;
+        subtractCovered(entries, base + startMinute, base + endMinute).forEach(function(piece) {
+          entries.push({ start: piece.start, end: piece.end, from: from, to: to });
+        });
+      });
+    });
+
+    entries.sort(function(a, b) { return a.start - b.start; });
+    return entries.slice(0, Constants.CONFIG.SCHEDULE_TABLE_MAX_ENTRIES);
+  }
+
+  // Interval covering a minute of the week (binary search), or null
+function lookup(entries, minuteOfWeek) {
+    var low = 0;
+    var high = entries.length - 1;
+    while (low <= high) {
+      var mid = (low + high) >> 1;
+      if (entries[mid].end <= minuteOfWeek) {
+        low = mid + 1;
+      } else if (entries[mid].start > minuteOfWeek) {
+        high = mid - 1;
+      } else {
+        return entries[mid];
+      }
+    }
+    return null;
+  }
+
+function minuteOfWeek(date) {
+    return date.getDay() * MINUTES_PER_DAY + date.getHours() * 60 + date.getMinutes();
+  }
+
+  // Blob for the watch: u8 version, u8 count, then per interval
+  // u16 start, u16 end (little-endian), u8 from << 4 | to
+function encode(entries) {
+    var bytes = [SCHEDULE_TABLE_VERSION, entries.length];
+    entries.forEach(function(entry) {
+      bytes.push(entry.start & 0xFF, entry.start >> 8, entry.end & 0xFF, entry.end >> 8,
+                 (entry.from << 4) | entry.to);
+    });
+    return bytes;
+  }
+
+module.exports = {
+  compile: compile,
+  lookup: lookup,
+  minuteOfWeek: minuteOfWeek,
+  encode: encode
+};
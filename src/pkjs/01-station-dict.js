@@ -0,0 +1,154 @@
+// Compressed station dictionary for NMBS Pebble App
+//
+// All cached iRail stations, searched on the watch by name prefix. Names are
+// folded to ASCII (the watch compares upper-cased bytes), sorted and
+// front-coded in blocks of up to STATION_DICT_BLOCK_ENTRIES stations, each
+// block starting with a full name. A small index of each block's first
+// letters lets the watch binary-search to the first block a prefix can be
+// in and request only the blocks it walks through (MSG_REQUEST_STATION_DICT),
+// see src/c/station_dict.h for the blob layouts.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+
+var STATION_DICT_VERSION = 1;
+var HEAD_LENGTH = 4;
+var NAME_MAX_LENGTH = 23;  // STATION_DICT_NAME_MAX - 1 on the watch
+var ENTRY_OVERHEAD = 5;    // shared + suffix length + u24 number
+
+var ACCENTS = {
+  'à': 'a', 'á': 'a', 'â': 'a', 'ä': 'a', 'ã': 'a', 'å': 'a',
+  'ç': 'c',
+  'è': 'e', 'é': 'e', 'ê': 'e', 'ë': 'e',
+  'ì': 'i', 'í': 'i', 'î': 'i', 'ï': 'i',
+  'ñ': 'n',
+  'ò': 'o', 'ó': 'o', 'ô': 'o', 'ö': 'o', 'õ': 'o',
+  'ù': 'u', 'ú': 'u', 'û': 'u', 'ü': 'u',
+  'ý': 'y', 'ÿ': 'y', 'ß': 'ss'
+};
+
+// Dictionary built for the current station cache (rebuilt when it changes)
+var built = null;
+
+  // Fold a name to printable ASCII, keeping case (Liège -> Liege)
+function fold(name) {
+    var result = '';
+    for (var i = 0; i < name.length; i++) {
+      var c = name.charAt(i);
+      var lower = c.toLowerCase();
+      if (ACCENTS[lower]) {
+        var plain = ACCENTS[lower];
+        result += (c === lower) ? plain : plain.toUpperCase();
+      } else if (c >= ' ' && c <= '~') {
+        result += c;
+      }
+    }
+    return result.substring(0, NAME_MAX_LENGTH);
+  }
+
+  // Station number in "BE.NMBS.008813003" (fits 24 bits), or null
+function stationNumber(id) {
+    var match = /^BE\.NMBS\.(\d{9})$/.exec(id || '');
+    if (!match) {
+      return null;
+    }
+    var number = parseInt(match[1], 10);
+    return number < 0x1000000 ? number : null;
+  }
+
+function sharedLength(a, b) {
+    var i = 0;
+    while (i < a.length && i < b.length && a.charAt(i) === b.charAt(i)) {
+      i++;
+    }
+    return i;
+  }
+
+function pushString(bytes, text) {
+    for (var i = 0; i < text.length; i++) {
+      bytes.push(text.charCodeAt(i));
+    }
+  }
+
+  // Build the dictionary from stations ({ id, name }):
+  // { index: bytes, blocks: [bytes], stationCount, size }
+function build(stations) {
+    var entries = [];
+    stations.forEach(function(station) {
+      var number = stationNumber(station.id);
+      var name = fold(station.name || '');
+      if (number !== null && name) {
+        entries.push({ name: name, key: name.toUpperCase(), number: number });
+      }
+    });
+    entries.sort(function(a, b) {
+      return a.key < b.key ? -1 : (a.key > b.key ? 1 : a.number - b.number);
+    });
+
+    var blocks = [];
+    var heads = [];
+    var block = null;
+    var count = 0;
+    var previous = '';
+    for (var i = 0; i < entries.length; i++) {
+      var entry = entries[i];
+      var full = ENTRY_OVERHEAD + entry.name.length;
+      if (!block || count === Constants.CONFIG.STATION_DICT_BLOCK_ENTRIES ||
+          block.length + full > Constants.CONFIG.STATION_DICT_BLOCK_MAX_BYTES) {
+        if (blocks.length === Constants.CONFIG.STATION_DICT_MAX_BLOCKS) {
+          Log.warn('Station dictionary full, dropped ' + (entries.length - i) + ' stations');
+          break;
+        }
+        block = [];
+        blocks.push(block);
+        heads.push(entry.key.substring(0, HEAD_LENGTH));
+        count = 0;
+        previous = '';
+      }
+
+      var shared = sharedLength(previous, entry.name);
+      var suffix = entry.name.substring(shared);
+      block.push(shared, suffix.length);
+      pushString(block, suffix);
+      block.push(entry.number & 0xFF, (entry.number >> 8) & 0xFF, entry.number >> 16);
+      previous = entry.name;
+      count++;
+    }
+
+    // Stations actually encoded (all of them unless the block limit was hit)
+    var stationCount = i;
+    var size = 6 + heads.length * HEAD_LENGTH;
+    blocks.forEach(function(b) { size += b.length; });
+
+    var index = [STATION_DICT_VERSION, blocks.length, stationCount & 0xFF, stationCount >> 8,
+                 size & 0xFF, size >> 8];
+    heads.forEach(function(head) {
+      pushString(index, head);
+      for (var pad = head.length; pad < HEAD_LENGTH; pad++) {
+        index.push(0);
+      }
+    });
+
+    return { index: index, blocks: blocks, stationCount: stationCount, size: size };
+  }
+
+  // Dictionary for the station cache, built on first use
+function get(stations) {
+    if (!built || built.source !== stations) {
+      var start = Date.now();
+      built = build(stations);
+      built.source = stations;
+      var plain = 0;
+      stations.forEach(function(station) { plain += (station.name || '').length + (station.id || '').length; });
+      Log.info('Station dictionary: ' + built.stationCount + ' stations in ' + built.blocks.length +
+               ' blocks, ' + built.size + ' bytes (index ' + built.index.length + ', names and IDs ' +
+               plain + ' bytes), built in ' + (Date.now() - start) + ' ms');
+    }
+    return built;
+  }
+
+module.exports = {
+  INDEX_BLOCK: 255,
+  fold: fold,
+  build: build,
+  get: get
+};
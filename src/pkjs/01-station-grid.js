@@ -0,0 +1,92 @@
+// Spatial index of the cached stations for NMBS Pebble App
+//
+// Stations are bucketed into a uniform grid of roughly CELL_KM square cells
+// (longitude cells are widened by the latitude of the station set). A
+// nearest-station lookup scans the cell of the query point and then rings of
+// cells around it, and stops once the next ring can't hold anything closer
+// than the best station found so far.
+var CELL_KM = 5;
+var KM_PER_DEGREE = 111.32;
+
+function cellKey(row, col) {
+    return row + ':' + col;
+  }
+
+  // Approximate distance in km (equirectangular, fine at commuting range)
+function distanceKm(lat1, lon1, lat2, lon2) {
+    var x = (lon2 - lon1) * Math.cos((lat1 + lat2) / 2 * Math.PI / 180);
+    var y = lat2 - lat1;
+    return Math.sqrt(x * x + y * y) * KM_PER_DEGREE;
+  }
+
+  // Build the grid from stations ({ id, name, lat, lon }); stations without
+  // coordinates are left out
+function build(stations) {
+    var located = stations.filter(function(station) {
+      return typeof station.lat === 'number' && typeof station.lon === 'number' &&
+             !isNaN(station.lat) && !isNaN(station.lon);
+    });
+
+    // Longitude cells are as wide as latitude cells are high at the station
+    // furthest from the equator, so no cell is narrower than CELL_KM
+    var maxLat = 0;
+    located.forEach(function(station) { maxLat = Math.max(maxLat, Math.abs(station.lat)); });
+    var latStep = CELL_KM / KM_PER_DEGREE;
+    var lonStep = latStep / Math.max(0.1, Math.cos(maxLat * Math.PI / 180));
+
+    var cells = {};
+    located.forEach(function(station) {
+      var key = cellKey(Math.floor(station.lat / latStep), Math.floor(station.lon / lonStep));
+      (cells[key] = cells[key] || []).push(station);
+    });
+
+    return { cells: cells, latStep: latStep, lonStep: lonStep, size: located.length };
+  }
+
+  // Nearest station within maxKm of a point: { station, km }, or null
+function nearest(grid, lat, lon, maxKm) {
+    if (grid.size === 0) {
+      return null;
+    }
+    var row = Math.floor(lat / grid.latStep);
+    var col = Math.floor(lon / grid.lonStep);
+    var best = null;
+
+    function scanCell(r, c) {
+      var bucket = grid.cells[cellKey(r, c)];
+      if (!bucket) {
+        return;
+      }
+      for (var i = 0; i < bucket.length; i++) {
+        var km = distanceKm(lat, lon, bucket[i].lat, bucket[i].lon);
+        if (km <= maxKm && (!best || km < best.km)) {
+          best = { station: bucket[i], km: km };
+        }
+      }
+    }
+
+    // Stations in ring r are at least (r - 1) cells away
+    var maxRing = Math.ceil(maxKm / CELL_KM) + 1;
+    for (var ring = 0; ring <= maxRing; ring++) {
+      if (best && (ring - 1) * CELL_KM > best.km) {
+        break;
+      }
+      for (var dr = -ring; dr <= ring; dr++) {
+        if (Math.abs(dr) === ring) {
+          for (var dc = -ring; dc <= ring; dc++) {
+            scanCell(row + dr, col + dc);
+          }
+        } else {
+          scanCell(row + dr, col - ring);
+          scanCell(row + dr, col + ring);
+        }
+      }
+    }
+    return best;
+  }
+
+module.exports = {
+  distanceKm: distanceKm,
+  build: build,
+  nearest: nearest
+};
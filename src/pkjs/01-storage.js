@@ -1,5 +1,6 @@
 // LocalStorage management for NMBS Pebble App
 var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
 
 // Current route and connection identifiers for detail requests
 var currentFromStation = '';
@@ -18,20 +19,20 @@ function loadPersistedData() {
 
     if (storedFrom && Constants.STATION_IDS[storedFrom]) {
       currentFromStation = storedFrom;
-      console.log('Loaded from station: ' + currentFromStation);
+      Log.info('Loaded from station: ' + currentFromStation);
     }
 
     if (storedTo && Constants.STATION_IDS[storedTo]) {
       currentToStation = storedTo;
-      console.log('Loaded to station: ' + currentToStation);
+      Log.info('Loaded to station: ' + currentToStation);
     }
 
     if (storedConnections) {
       connectionIdentifiers = JSON.parse(storedConnections);
-      console.log('Loaded ' + connectionIdentifiers.length + ' connection identifiers');
+      Log.info('Loaded ' + connectionIdentifiers.length + ' connection identifiers');
     }
   } catch (e) {
-    console.log('Error loading persisted data: ' + e.message);
+    Log.error('Error loading persisted data: ' + e.message);
     // Reset to defaults on error
     currentFromStation = '';
     currentToStation = '';
@@ -49,9 +50,9 @@ function savePersistedData() {
       localStorage.setItem(Constants.STORAGE_KEYS.TO_STATION, currentToStation);
     }
     localStorage.setItem(Constants.STORAGE_KEYS.CONNECTIONS, JSON.stringify(connectionIdentifiers));
-    console.log('Persisted data saved');
+    Log.debug('Persisted data saved');
   } catch (e) {
-    console.log('Error saving persisted data: ' + e.message);
+    Log.error('Error saving persisted data: ' + e.message);
   }
 }
 
@@ -61,11 +62,11 @@ function loadCachedStations() {
     var cached = localStorage.getItem(Constants.STORAGE_KEYS.STATION_CACHE);
     if (cached) {
       stationCache = JSON.parse(cached);
-      console.log('Loaded ' + stationCache.length + ' cached stations');
+      Log.info('Loaded ' + stationCache.length + ' cached stations');
       return true;
     }
   } catch (e) {
-    console.log('Error loading cached stations: ' + e.message);
+    Log.error('Error loading cached stations: ' + e.message);
   }
   return false;
 }
@@ -75,14 +76,33 @@ function saveStationCache(stations) {
   try {
     stationCache = stations;
     localStorage.setItem(Constants.STORAGE_KEYS.STATION_CACHE, JSON.stringify(stationCache));
-    console.log('Cached ' + stationCache.length + ' stations');
+    Log.info('Cached ' + stationCache.length + ' stations');
   } catch (e) {
-    console.log('Error saving station cache: ' + e.message);
+    Log.error('Error saving station cache: ' + e.message);
   }
 }
 
-// Get station object by iRail ID
+// Get all cached stations ({ id, name }); replaced, not modified, on refresh
+function getStationCache() {
+  return stationCache;
+}
+
+// Get the station group (see STATION_GROUPS) with this ID, or null
+function getStationGroup(id) {
+  for (var i = 0; i < Constants.STATION_GROUPS.length; i++) {
+    if (Constants.STATION_GROUPS[i].id === id) {
+      return Constants.STATION_GROUPS[i];
+    }
+  }
+  return null;
+}
+
+// Get station object by iRail ID (or station group ID)
 function getStationById(id) {
+  var group = getStationGroup(id);
+  if (group) {
+    return { id: group.id, name: group.name };
+  }
   for (var i = 0; i < stationCache.length; i++) {
     if (stationCache[i].id === id) {
       return stationCache[i];
@@ -105,18 +125,39 @@ function getFavoriteStations() {
       return JSON.parse(favoritesJson);
     }
   } catch (e) {
-    console.log('Error loading favorite stations: ' + e.message);
+    Log.error('Error loading favorite stations: ' + e.message);
   }
   return null;
 }
 
+// Get favorite station iRail IDs with station groups expanded to their
+// members (defaults if none are configured)
+function getFavoriteStationIds() {
+  var favorites = getFavoriteStations() || [];
+  if (favorites.length === 0) {
+    favorites = Object.keys(Constants.STATION_IDS).map(function(name) {
+      return Constants.STATION_IDS[name];
+    });
+  }
+  var ids = [];
+  favorites.forEach(function(id) {
+    var group = getStationGroup(id);
+    (group ? group.members : [id]).forEach(function(member) {
+      if (ids.indexOf(member) === -1) {
+        ids.push(member);
+      }
+    });
+  });
+  return ids;
+}
+
 // Save favorite stations to localStorage
 function saveFavoriteStations(stations) {
   try {
     localStorage.setItem(Constants.STORAGE_KEYS.FAVORITE_STATIONS, JSON.stringify(stations));
-    console.log('Saved ' + stations.length + ' favorite stations');
+    Log.info('Saved ' + stations.length + ' favorite stations');
   } catch (e) {
-    console.log('Error saving favorite stations: ' + e.message);
+    Log.error('Error saving favorite stations: ' + e.message);
   }
 }
 
@@ -128,7 +169,7 @@ function getSmartSchedules() {
       return JSON.parse(schedulesJson);
     }
   } catch (e) {
-    console.log('Error loading smart schedules: ' + e.message);
+    Log.error('Error loading smart schedules: ' + e.message);
   }
   return null;
 }
@@ -137,9 +178,32 @@ function getSmartSchedules() {
 function saveSmartSchedules(schedules) {
   try {
     localStorage.setItem(Constants.STORAGE_KEYS.SMART_SCHEDULES, JSON.stringify(schedules));
-    console.log('Saved ' + schedules.length + ' smart schedules');
+    Log.info('Saved ' + schedules.length + ' smart schedules');
+  } catch (e) {
+    Log.error('Error saving smart schedules: ' + e.message);
+  }
+}
+
+// Get dashboard routes ([{ fromId, toId }]) from localStorage
+function getDashboardRoutes() {
+  try {
+    var routesJson = localStorage.getItem(Constants.STORAGE_KEYS.DASHBOARD_ROUTES);
+    if (routesJson) {
+      return JSON.parse(routesJson);
+    }
+  } catch (e) {
+    Log.error('Error loading dashboard routes: ' + e.message);
+  }
+  return null;
+}
+
+// Save dashboard routes to localStorage
+function saveDashboardRoutes(routes) {
+  try {
+    localStorage.setItem(Constants.STORAGE_KEYS.DASHBOARD_ROUTES, JSON.stringify(routes));
+    Log.info('Saved ' + routes.length + ' dashboard routes');
   } catch (e) {
-    console.log('Error saving smart schedules: ' + e.message);
+    Log.error('Error saving dashboard routes: ' + e.message);
   }
 }
 
@@ -148,11 +212,11 @@ function getLanguage() {
   try {
     var lang = localStorage.getItem(Constants.STORAGE_KEYS.LANGUAGE);
     if (lang) {
-      console.log('Loaded language preference: ' + lang);
+      Log.debug('Loaded language preference: ' + lang);
       return lang;
     }
   } catch (e) {
-    console.log('Error loading language preference: ' + e.message);
+    Log.error('Error loading language preference: ' + e.message);
   }
   return Constants.CONFIG.DEFAULT_LANGUAGE;
 }
@@ -161,9 +225,9 @@ function getLanguage() {
 function saveLanguage(language) {
   try {
     localStorage.setItem(Constants.STORAGE_KEYS.LANGUAGE, language);
-    console.log('Saved language preference: ' + language);
+    Log.info('Saved language preference: ' + language);
   } catch (e) {
-    console.log('Error saving language preference: ' + e.message);
+    Log.error('Error saving language preference: ' + e.message);
   }
 }
 
@@ -202,12 +266,17 @@ module.exports = {
   savePersistedData: savePersistedData,
   loadCachedStations: loadCachedStations,
   saveStationCache: saveStationCache,
+  getStationCache: getStationCache,
   getStationById: getStationById,
   getStationNameById: getStationNameById,
+  getStationGroup: getStationGroup,
   getFavoriteStations: getFavoriteStations,
+  getFavoriteStationIds: getFavoriteStationIds,
   saveFavoriteStations: saveFavoriteStations,
   getSmartSchedules: getSmartSchedules,
   saveSmartSchedules: saveSmartSchedules,
+  getDashboardRoutes: getDashboardRoutes,
+  saveDashboardRoutes: saveDashboardRoutes,
   getLanguage: getLanguage,
   saveLanguage: saveLanguage,
   getCurrentFromStation: getCurrentFromStation,
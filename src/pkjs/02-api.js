@@ -1,22 +1,169 @@
 // iRail API communication for NMBS Pebble App
 var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
 var Storage = require('./01-storage.js');
+var IRailParser = require('./01-irail-parser.js');
+var Energy = require('./01-energy.js');
 
 // Debounce timer for API requests
 var requestDebounceTimer = null;
 
+// Shared iRail rate limiter. Every request below takes a token from one
+// bucket (IRAIL_RATE_PER_S, bursts of IRAIL_BURST); waiting requests go out
+// by priority. A 429 or 5xx answer holds all requests until its Retry-After
+// (or an exponential backoff without one) and the request is retried, up
+// to IRAIL_MAX_RETRIES times and only if the wait is at most
+// IRAIL_MAX_RETRY_WAIT_MS. Otherwise it fails with 'Throttled'.
+var PRIORITY = {
+  FOREGROUND: 0,  // The user is waiting: departures, details, dashboard
+  PREFETCH: 1,    // Caches filled ahead of need: snapshots, station list
+  BACKGROUND: 2   // Worker-driven glance refreshes
+};
+var queues = [[], [], []];
+var tokens = Constants.CONFIG.IRAIL_BURST;
+var tokensAt = Date.now();
+var backoffUntil = 0;
+var backoffMs = 0;  // Last backoff without Retry-After (doubles each time)
+var pumpTimer = null;
+
+function priorityOf(requestInfo) {
+    if (requestInfo && requestInfo.background) {
+      return PRIORITY.BACKGROUND;
+    }
+    return (requestInfo && requestInfo.prefetch) ? PRIORITY.PREFETCH : PRIORITY.FOREGROUND;
+  }
+
+  // Milliseconds to wait from a Retry-After header (seconds or HTTP date),
+  // or null without one
+function retryAfterMs(xhr) {
+    var header = xhr.getResponseHeader ? xhr.getResponseHeader('Retry-After') : null;
+    if (!header) {
+      return null;
+    }
+    if (/^\s*\d+\s*$/.test(header)) {
+      return parseInt(header, 10) * 1000;
+    }
+    var date = Date.parse(header);
+    return isNaN(date) ? null : Math.max(0, date - Date.now());
+  }
+
+  // Tell a waiting foreground request when iRail will be asked again
+function notifyThrottled(entry) {
+    if (entry.requestInfo && entry.requestInfo.onThrottled) {
+      entry.requestInfo.onThrottled(backoffUntil);
+    }
+  }
+
+  // Send queued requests while there are tokens and no backoff
+function pump() {
+    if (pumpTimer) {
+      return;
+    }
+    for (;;) {
+      var queue = null;
+      for (var p = 0; p < queues.length && !queue; p++) {
+        queue = queues[p].length > 0 ? queues[p] : null;
+      }
+      if (!queue) {
+        return;
+      }
+
+      var now = Date.now();
+      var wait = backoffUntil - now;
+      if (wait <= 0) {
+        tokens = Math.min(Constants.CONFIG.IRAIL_BURST,
+                          tokens + Math.max(0, now - tokensAt) * Constants.CONFIG.IRAIL_RATE_PER_S / 1000);
+        tokensAt = Math.max(tokensAt, now);
+        if (tokens < 1) {
+          wait = (1 - tokens) * 1000 / Constants.CONFIG.IRAIL_RATE_PER_S;
+        }
+      }
+      if (wait > 0) {
+        pumpTimer = setTimeout(function() {
+          pumpTimer = null;
+          pump();
+        }, Math.ceil(wait));
+        return;
+      }
+
+      tokens -= 1;
+      start(queue.shift());
+    }
+  }
+
+function start(entry) {
+    var xhr = new XMLHttpRequest();
+    xhr.open('GET', entry.url, true);
+    xhr.setRequestHeader('User-Agent', Constants.CONFIG.USER_AGENT);
+    var headers = (entry.requestInfo && entry.requestInfo.headers) || {};
+    Object.keys(headers).forEach(function(name) {
+      xhr.setRequestHeader(name, headers[name]);
+    });
+    xhr.onload = function() {
+      if (xhr.status === 429 || xhr.status >= 500) {
+        throttled(entry, xhr);
+        return;
+      }
+      backoffMs = 0;
+      entry.onLoad(xhr);
+    };
+    xhr.onerror = function() {
+      entry.onError('Network error');
+    };
+    Energy.countHttpRequest(entry.feature);
+    xhr.send();
+  }
+
+function throttled(entry, xhr) {
+    Energy.countHttpBytes(entry.feature, xhr.responseText.length);
+    var wait = retryAfterMs(xhr);
+    if (wait === null) {
+      backoffMs = Math.min(backoffMs ? backoffMs * 2 : Constants.CONFIG.IRAIL_BACKOFF_MS,
+                           Constants.CONFIG.IRAIL_MAX_BACKOFF_MS);
+      wait = backoffMs;
+    }
+    backoffUntil = Math.max(backoffUntil, Date.now() + wait);
+    // The bucket starts refilling once the backoff is over
+    tokens = 0;
+    tokensAt = backoffUntil;
+
+    if (entry.attempts < Constants.CONFIG.IRAIL_MAX_RETRIES &&
+        backoffUntil - Date.now() <= Constants.CONFIG.IRAIL_MAX_RETRY_WAIT_MS) {
+      entry.attempts++;
+      Log.warn('iRail answered ' + xhr.status + ', retry ' + entry.attempts + ' in ' +
+               (backoffUntil - Date.now()) + ' ms');
+      queues[entry.priority].unshift(entry);
+      notifyThrottled(entry);
+      pump();
+    } else {
+      Log.warn('iRail answered ' + xhr.status + ', giving up');
+      entry.onError('Throttled');
+    }
+  }
+
+  // Queue a GET for the limiter. onLoad gets the finished XMLHttpRequest for
+  // any answer but a throttled one; onError gets 'Network error' or
+  // 'Throttled'. requestInfo.headers are sent as extra request headers.
+function request(url, priority, feature, requestInfo, onLoad, onError) {
+    var entry = { url: url, priority: priority, feature: feature, requestInfo: requestInfo,
+                  onLoad: onLoad, onError: onError, attempts: 0 };
+    if (backoffUntil > Date.now()) {
+      notifyThrottled(entry);
+    }
+    queues[priority].push(entry);
+    pump();
+  }
+
 // Fetch stations from iRail API and cache them
 function fetchStations(callback) {
-    console.log('Fetching stations from iRail API...');
+    Log.info('Fetching stations from iRail API...');
 
     // Get language preference for API request
     var lang = Storage.getLanguage();
     var url = Constants.IRAIL_STATIONS_URL + '&lang=' + lang;
 
-    var xhr = new XMLHttpRequest();
-    xhr.open('GET', url, true);
-    xhr.setRequestHeader('User-Agent', Constants.CONFIG.USER_AGENT);
-    xhr.onload = function() {
+    request(url, PRIORITY.PREFETCH, Energy.FEATURE.CONFIG, null, function(xhr) {
+      Energy.countHttpBytes(Energy.FEATURE.CONFIG, xhr.responseText.length);
       if (xhr.readyState === 4 && xhr.status === 200) {
         try {
           var response = JSON.parse(xhr.responseText);
@@ -25,45 +172,57 @@ function fetchStations(callback) {
             var stations = response.station.map(function(s) {
               return {
                 id: s.id,                          // "BE.NMBS.008813003"
-                name: s.name                       // "Brussels-Central"
+                name: s.name,                      // "Brussels-Central"
+                lat: parseFloat(s.locationY),      // 50.845658 (for 01-station-grid.js)
+                lon: parseFloat(s.locationX)       // 4.356801
               };
             });
 
             // Save to storage
             Storage.saveStationCache(stations);
-            console.log('Fetched and cached ' + stations.length + ' stations');
+            Log.info('Fetched and cached ' + stations.length + ' stations');
 
             if (callback) {
               callback(stations);
             }
           } else {
-            console.log('No stations in API response');
+            Log.warn('No stations in API response');
           }
         } catch (e) {
-          console.log('Error parsing stations API response: ' + e.message);
+          Log.error('Error parsing stations API response: ' + e.message);
         }
       } else {
-        console.log('Failed to fetch stations: ' + xhr.status);
+        Log.warn('Failed to fetch stations: ' + xhr.status);
       }
-    };
-    xhr.onerror = function() {
-      console.log('Network error fetching stations');
-    };
-    xhr.send();
+    }, function(error) {
+      Log.warn('Error fetching stations: ' + error);
+    });
   }
 
   // Fetch train connections from iRail API
-function fetchConnections(fromId, toId, callback, errorCallback) {
-    // Store current route for detail requests
-    Storage.setCurrentFromStation(fromId);
-    Storage.setCurrentToStation(toId);
-    Storage.clearConnectionIdentifiers();
+  // requestInfo is optional: { id: request ID for latency tracing,
+  //                            background: true for worker-driven glance refreshes,
+  //                            keepRoute: true to leave the current route alone
+  //                                       (dashboard routes have no detail view),
+  //                            onThrottled: called with the time (ms) iRail will
+  //                                         be asked again while it throttles }
+function fetchConnections(fromId, toId, callback, errorCallback, requestInfo) {
+    var requestId = requestInfo ? requestInfo.id : undefined;
+    var feature = (requestInfo && requestInfo.background) ?
+        Energy.FEATURE.BACKGROUND : Energy.FEATURE.FOREGROUND;
 
-    // Persist station selection to localStorage
-    Storage.savePersistedData();
+    if (!(requestInfo && requestInfo.keepRoute)) {
+      // Store current route for detail requests
+      Storage.setCurrentFromStation(fromId);
+      Storage.setCurrentToStation(toId);
+      Storage.clearConnectionIdentifiers();
+
+      // Persist station selection to localStorage
+      Storage.savePersistedData();
+    }
 
     if (!fromId || !toId) {
-      console.log('Invalid station IDs: ' + fromId + ' -> ' + toId);
+      Log.warn('Invalid station IDs: ' + fromId + ' -> ' + toId);
       if (errorCallback) {
         errorCallback('Invalid station IDs');
       }
@@ -72,7 +231,7 @@ function fetchConnections(fromId, toId, callback, errorCallback) {
 
     // Can't request same station for from/to
     if (fromId === toId) {
-      console.log('From and To stations are the same, sending empty result');
+      Log.info('From and To stations are the same, sending empty result');
       if (errorCallback) {
         errorCallback('Same from/to station');
       }
@@ -87,62 +246,202 @@ function fetchConnections(fromId, toId, callback, errorCallback) {
         '&format=json' +
         '&lang=' + lang;
 
-    console.log('Fetching: ' + url);
+    Log.debug('Fetching: ' + url);
 
     // Make HTTP request
-    var xhr = new XMLHttpRequest();
-    xhr.open('GET', url, true);
-    xhr.setRequestHeader('User-Agent', Constants.CONFIG.USER_AGENT);
-    xhr.onload = function () {
+    Log.trace('xhr_start', { id: requestId });
+    request(url, priorityOf(requestInfo), feature, requestInfo, function(xhr) {
       if (xhr.readyState === 4) {
+        Log.trace('xhr_end', { id: requestId, status: xhr.status });
+        Energy.countHttpBytes(feature, xhr.responseText.length);
         if (xhr.status === 200) {
-          console.log('Response received');
+          Log.debug('Response received (' + xhr.responseText.length + ' bytes)');
           try {
-            var response = JSON.parse(xhr.responseText);
+            // Only the first MAX_DEPARTURES connections are ever sent to the watch
+            var response = IRailParser.parseConnections(xhr.responseText,
+                                                        Constants.CONFIG.MAX_DEPARTURES);
+            Log.trace('parse_done', { id: requestId });
             if (callback) {
               callback(response);
             }
           } catch (e) {
-            console.log('JSON parse error: ' + e.message);
+            Log.error('JSON parse error: ' + e.message);
             if (errorCallback) {
               errorCallback('Parse error');
             }
           }
         } else {
-          console.log('Request failed: ' + xhr.status + ' - ' + xhr.responseText);
+          Log.warn('Request failed: ' + xhr.status + ' - ' + xhr.responseText);
           if (errorCallback) {
             errorCallback('HTTP ' + xhr.status);
           }
         }
       }
-    };
-    xhr.onerror = function () {
-      console.log('Network error');
+    }, function(error) {
+      Log.warn(error);
+      Log.trace('xhr_end', { id: requestId, status: 0 });
       if (errorCallback) {
-        errorCallback('Network error');
+        errorCallback(error);
       }
-    };
-    xhr.send();
+    });
+  }
+
+  // Fetch connections departing from a given Unix time without touching the
+  // current route or connection identifiers (used for schedule snapshots)
+function fetchConnectionsAt(fromId, toId, timestamp, callback, errorCallback) {
+    var lang = Storage.getLanguage();
+    var url = Constants.IRAIL_API_URL +
+        '?from=' + encodeURIComponent(fromId) +
+        '&to=' + encodeURIComponent(toId) +
+        '&date=' + formatDate(timestamp * 1000) +
+        '&time=' + formatTime(timestamp * 1000) +
+        '&format=json' +
+        '&lang=' + lang;
+
+    Log.debug('Fetching snapshot page: ' + url);
+
+    request(url, PRIORITY.PREFETCH, Energy.FEATURE.BACKGROUND, null, function(xhr) {
+      Energy.countHttpBytes(Energy.FEATURE.BACKGROUND, xhr.responseText.length);
+      if (xhr.readyState === 4 && xhr.status === 200) {
+        try {
+          callback(IRailParser.parseConnections(xhr.responseText, 0));
+        } catch (e) {
+          Log.error('Snapshot page parse error: ' + e.message);
+          errorCallback('Parse error');
+        }
+      } else {
+        errorCallback('HTTP ' + xhr.status);
+      }
+    }, errorCallback);
+  }
+
+  // Fetch the departure board of a station
+  // callback receives the liveboard departures (iRail shape, sorted by time)
+function fetchLiveboard(stationId, callback, errorCallback, requestInfo) {
+    var requestId = requestInfo ? requestInfo.id : undefined;
+    var feature = (requestInfo && requestInfo.background) ?
+        Energy.FEATURE.BACKGROUND : Energy.FEATURE.FOREGROUND;
+
+    var lang = Storage.getLanguage();
+    var url = Constants.IRAIL_LIVEBOARD_URL +
+        '?id=' + encodeURIComponent(stationId) +
+        '&arrdep=departure' +
+        '&format=json' +
+        '&lang=' + lang;
+
+    Log.debug('Fetching liveboard: ' + url);
+
+    Log.trace('xhr_start', { id: requestId });
+    request(url, priorityOf(requestInfo), feature, requestInfo, function(xhr) {
+      Log.trace('xhr_end', { id: requestId, status: xhr.status });
+      Energy.countHttpBytes(feature, xhr.responseText.length);
+      if (xhr.readyState === 4 && xhr.status === 200) {
+        try {
+          var response = JSON.parse(xhr.responseText);
+          Log.trace('parse_done', { id: requestId });
+          callback((response.departures && response.departures.departure) || []);
+        } catch (e) {
+          Log.error('Liveboard parse error: ' + e.message);
+          errorCallback('Parse error');
+        }
+      } else {
+        errorCallback('HTTP ' + xhr.status);
+      }
+    }, function(error) {
+      Log.trace('xhr_end', { id: requestId, status: 0 });
+      errorCallback(error);
+    });
+  }
+
+  // Fetch the stop list of a vehicle on the service day of a Unix time
+function fetchVehicle(vehicleId, timestamp, callback, errorCallback, requestInfo) {
+    var feature = (requestInfo && requestInfo.background) ?
+        Energy.FEATURE.BACKGROUND : Energy.FEATURE.FOREGROUND;
+
+    var lang = Storage.getLanguage();
+    var url = Constants.IRAIL_VEHICLE_URL +
+        '?id=' + encodeURIComponent(vehicleId) +
+        '&date=' + formatDate(timestamp * 1000) +
+        '&format=json' +
+        '&lang=' + lang;
+
+    Log.debug('Fetching vehicle: ' + url);
+
+    request(url, priorityOf(requestInfo), feature, requestInfo, function(xhr) {
+      Energy.countHttpBytes(feature, xhr.responseText.length);
+      if (xhr.readyState === 4 && xhr.status === 200) {
+        try {
+          var response = JSON.parse(xhr.responseText);
+          callback((response.stops && response.stops.stop) || []);
+        } catch (e) {
+          Log.error('Vehicle parse error: ' + e.message);
+          errorCallback('Parse error');
+        }
+      } else {
+        errorCallback('HTTP ' + xhr.status);
+      }
+    }, errorCallback);
+  }
+
+  // Fetch the disturbances feed, conditionally on the validators of the
+  // cached copy ({ etag, lastModified }). callback gets null when the feed
+  // is unchanged (304), else the disturbances and the new validators.
+function fetchDisturbances(validators, callback, errorCallback) {
+    var lang = Storage.getLanguage();
+    var url = Constants.IRAIL_DISTURBANCES_URL +
+        '?format=json' +
+        '&lineBreakCharacter=' +
+        '&lang=' + lang;
+
+    var headers = {};
+    if (validators && validators.etag) {
+      headers['If-None-Match'] = validators.etag;
+    }
+    if (validators && validators.lastModified) {
+      headers['If-Modified-Since'] = validators.lastModified;
+    }
+
+    Log.debug('Fetching disturbances: ' + url);
+
+    request(url, PRIORITY.PREFETCH, Energy.FEATURE.FOREGROUND, { headers: headers }, function(xhr) {
+      Energy.countHttpBytes(Energy.FEATURE.FOREGROUND, xhr.responseText.length);
+      if (xhr.status === 304) {
+        callback(null);
+      } else if (xhr.readyState === 4 && xhr.status === 200) {
+        try {
+          var response = JSON.parse(xhr.responseText);
+          callback(response.disturbance || [], {
+            etag: xhr.getResponseHeader('ETag'),
+            lastModified: xhr.getResponseHeader('Last-Modified')
+          });
+        } catch (e) {
+          Log.error('Disturbances parse error: ' + e.message);
+          errorCallback('Parse error');
+        }
+      } else {
+        errorCallback('HTTP ' + xhr.status);
+      }
+    }, errorCallback);
   }
 
   // Fetch connection details for a specific departure
 function fetchConnectionDetails(departureIndex, callback, errorCallback) {
-    console.log('Fetching details for departure ' + departureIndex);
+    Log.debug('Fetching details for departure ' + departureIndex);
 
     var identifier = Storage.getConnectionIdentifier(departureIndex);
     if (!identifier) {
-      console.log('No connection identifier found for index ' + departureIndex);
+      Log.warn('No connection identifier found for index ' + departureIndex);
       if (errorCallback) {
         errorCallback('No identifier');
       }
       return;
     }
 
-    var fromId = Storage.getCurrentFromStation();
-    var toId = Storage.getCurrentToStation();
+    var fromId = identifier.fromId || Storage.getCurrentFromStation();
+    var toId = identifier.toId || Storage.getCurrentToStation();
 
     if (!fromId || !toId) {
-      console.log('Invalid stations for detail request');
+      Log.warn('Invalid stations for detail request');
       if (errorCallback) {
         errorCallback('Invalid stations');
       }
@@ -162,16 +461,14 @@ function fetchConnectionDetails(departureIndex, callback, errorCallback) {
         '&format=json' +
         '&lang=' + lang;
 
-    console.log('Fetching details from: ' + url);
+    Log.debug('Fetching details from: ' + url);
 
-    var xhr = new XMLHttpRequest();
-    xhr.open('GET', url, true);
-    xhr.setRequestHeader('User-Agent', Constants.CONFIG.USER_AGENT);
-    xhr.onload = function () {
+    request(url, PRIORITY.FOREGROUND, Energy.FEATURE.DETAIL, null, function(xhr) {
+      Energy.countHttpBytes(Energy.FEATURE.DETAIL, xhr.responseText.length);
       if (xhr.readyState === 4 && xhr.status === 200) {
         try {
-          var response = JSON.parse(xhr.responseText);
-          console.log(response);
+          var response = IRailParser.parseConnections(xhr.responseText, 0);
+          Log.debug(function() { return 'Detail response: ' + JSON.stringify(response); });
           if (response.connection && response.connection.length > 0) {
             // Find the matching connection by vehicle and departure time
             var matchedConn = null;
@@ -185,24 +482,29 @@ function fetchConnectionDetails(departureIndex, callback, errorCallback) {
             }
 
             if (matchedConn && callback) {
-              console.log('Found matching connection');
+              Log.debug('Found matching connection');
               callback(matchedConn, departureIndex);
             } else {
-              console.log('Connection not found in fresh data');
+              Log.warn('Connection not found in fresh data');
               if (errorCallback) {
                 errorCallback('Connection not found');
               }
             }
           }
         } catch (e) {
-          console.log('Detail fetch parse error: ' + e.message);
+          Log.error('Detail fetch parse error: ' + e.message);
           if (errorCallback) {
             errorCallback('Parse error');
           }
         }
+      } else if (errorCallback) {
+        errorCallback('HTTP ' + xhr.status);
       }
-    };
-    xhr.send();
+    }, function(error) {
+      if (errorCallback) {
+        errorCallback(error);
+      }
+    });
   }
 
   // Helper function to format date for API (DDMMYY)
@@ -227,19 +529,24 @@ function debounce(func, delay) {
     if (requestDebounceTimer) {
       clearTimeout(requestDebounceTimer);
       requestDebounceTimer = null;
-      console.log('Debouncing request...');
+      Log.debug('Debouncing request...');
     }
 
     requestDebounceTimer = setTimeout(function() {
-      console.log('Executing debounced request');
+      Log.debug('Executing debounced request');
       func();
       requestDebounceTimer = null;
     }, delay);
   }
 
 module.exports = {
+  PRIORITY: PRIORITY,
   fetchStations: fetchStations,
   fetchConnections: fetchConnections,
+  fetchConnectionsAt: fetchConnectionsAt,
+  fetchLiveboard: fetchLiveboard,
+  fetchVehicle: fetchVehicle,
   fetchConnectionDetails: fetchConnectionDetails,
+  fetchDisturbances: fetchDisturbances,
   debounce: debounce
 };
@@ -0,0 +1,142 @@
+// Offline timetable for NMBS Pebble App
+//
+// Keeps a compact timetable (see 01-connection-scan.js) for the trips that
+// serve the user's favorite stations, so departures can be answered without
+// a network round trip. The full-network file is produced from the NMBS GTFS
+// export by scripts/build_timetable.js and downloaded from TIMETABLE_URL; only
+// the filtered part is kept in localStorage. Disabled when TIMETABLE_URL is
+// empty.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+var Storage = require('./01-storage.js');
+var ConnectionScan = require('./01-connection-scan.js');
+var Energy = require('./01-energy.js');
+
+// Parsed timetable and the dated connections for the current service day
+var timetable = null;
+var dayCache = { key: null, day: null };
+var refreshInProgress = false;
+
+function getFavoriteIds() {
+    return Storage.getFavoriteStationIds().sort();
+  }
+
+function loadMeta() {
+    try {
+      var json = localStorage.getItem(Constants.STORAGE_KEYS.TIMETABLE_META);
+      if (json) {
+        return JSON.parse(json);
+      }
+    } catch (e) {
+      Log.error('Error loading timetable metadata: ' + e.message);
+    }
+    return null;
+  }
+
+  // Load the stored timetable on first use
+function getTimetable() {
+    if (timetable) {
+      return timetable;
+    }
+    try {
+      var json = localStorage.getItem(Constants.STORAGE_KEYS.TIMETABLE);
+      if (json) {
+        timetable = JSON.parse(json);
+        Log.info('Loaded offline timetable: ' + timetable.stations.length + ' stations, ' +
+                 (timetable.connections.length / ConnectionScan.STRIDE) + ' connections');
+      }
+    } catch (e) {
+      Log.error('Error loading offline timetable: ' + e.message);
+    }
+    return timetable;
+  }
+
+function saveTimetable(tt, stationIds) {
+    try {
+      localStorage.setItem(Constants.STORAGE_KEYS.TIMETABLE, JSON.stringify(tt));
+      localStorage.setItem(Constants.STORAGE_KEYS.TIMETABLE_META, JSON.stringify({
+        fetched: Date.now(),
+        stations: stationIds
+      }));
+    } catch (e) {
+      Log.error('Error saving offline timetable: ' + e.message);
+    }
+    timetable = tt;
+    dayCache = { key: null, day: null };
+  }
+
+  // Download the timetable if it is older than TIMETABLE_REFRESH_MS or the
+  // favorite stations changed since the last download
+function refresh() {
+    var url = Constants.CONFIG.TIMETABLE_URL;
+    var stationIds = getFavoriteIds();
+    if (!url || stationIds.length === 0 || refreshInProgress) {
+      return;
+    }
+
+    var meta = loadMeta();
+    if (meta && meta.stations.join(',') === stationIds.join(',') &&
+        Date.now() - meta.fetched < Constants.CONFIG.TIMETABLE_REFRESH_MS) {
+      Log.debug('Offline timetable is up to date');
+      return;
+    }
+
+    Log.info('Downloading offline timetable...');
+    refreshInProgress = true;
+
+    var xhr = new XMLHttpRequest();
+    xhr.open('GET', url, true);
+    xhr.setRequestHeader('User-Agent', Constants.CONFIG.USER_AGENT);
+    xhr.onload = function() {
+      refreshInProgress = false;
+      Energy.countHttpBytes(Energy.FEATURE.CONFIG, xhr.responseText.length);
+      if (xhr.readyState === 4 && xhr.status === 200) {
+        try {
+          var full = JSON.parse(xhr.responseText);
+          var filtered = ConnectionScan.filterTimetable(full, stationIds);
+          saveTimetable(filtered, stationIds);
+          Log.info('Offline timetable stored: ' + filtered.trips.length + ' of ' +
+                   full.trips.length + ' trips');
+        } catch (e) {
+          Log.error('Error parsing offline timetable: ' + e.message);
+        }
+      } else {
+        Log.warn('Failed to fetch offline timetable: ' + xhr.status);
+      }
+    };
+    xhr.onerror = function() {
+      refreshInProgress = false;
+      Log.warn('Network error fetching offline timetable');
+    };
+    Energy.countHttpRequest(Energy.FEATURE.CONFIG);
+    xhr.send();
+  }
+
+  // Plan departures from the offline timetable. Returns an iRail-shaped
+  // { connection: [...] } (without realtime delays), or null if the route
+  // is not covered.
+function findConnections(fromId, toId, maxResults) {
+    var tt = getTimetable();
+    if (!tt) {
+      return null;
+    }
+
+    var now = new Date();
+    var key = now.getFullYear() + '-' + now.getMonth() + '-' + now.getDate();
+    if (dayCache.key !== key) {
+      dayCache = { key: key, day: ConnectionScan.buildDay(tt, now) };
+    }
+
+    var result = ConnectionScan.plan(tt, dayCache.day, fromId, toId,
+                                     Math.floor(now.getTime() / 1000), maxResults,
+                                     Constants.CONFIG.TIMETABLE_MIN_CHANGE);
+    if (!result || result.connection.length === 0) {
+      return null;
+    }
+    return result;
+  }
+
+module.exports = {
+  refresh: refresh,
+  findConnections: findConnections
+};
@@ -0,0 +1,172 @@
+// Multi-route dashboard for NMBS Pebble App
+//
+// The dashboard routes picked in the settings are compiled against the
+// favorite stations and pushed to the watch (MSG_DASHBOARD_ROUTES). A
+// dashboard request (MSG_REQUEST_DASHBOARD) carries that route list back;
+// all routes are fetched at once and each answers with one packed
+// MSG_DASHBOARD_DATA as soon as its fetch finishes. The blob layouts are
+// documented in src/c/dashboard.h.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+var Storage = require('./01-storage.js');
+var DataProcessor = require('./03-data-processor.js');
+var StationGroups = require('./03-station-groups.js');
+var Disruptions = require('./03-disruptions.js');
+
+var DASHBOARD_VERSION = 1;
+
+// Dashboard request being answered, and its route answers waiting for the
+// outbox (one message in flight at a time)
+var currentRequestId = -1;
+var sendQueue = [];
+var sending = false;
+
+  // Compile routes ({ fromId, toId }) into station index pairs { from, to }.
+  // stationIds are the favorites as sent to the watch; routes outside them
+  // are dropped.
+function compile(routes, stationIds) {
+    var entries = [];
+    (routes || []).forEach(function(route) {
+      var from = stationIds.indexOf(route.fromId);
+      var to = stationIds.indexOf(route.toId);
+      if (from === -1 || to === -1 || from === to || from > 15 || to > 15) {
+        return;
+      }
+      entries.push({ from: from, to: to });
+    });
+    return entries.slice(0, Constants.CONFIG.DASHBOARD_MAX_ROUTES);
+  }
+
+  // Route list blob: u8 version, u8 count, then u8 from << 4 | to per route
+function encodeRoutes(entries) {
+    var bytes = [DASHBOARD_VERSION, entries.length];
+    entries.forEach(function(entry) {
+      bytes.push((entry.from << 4) | entry.to);
+    });
+    return bytes;
+  }
+
+function decodeRoutes(bytes) {
+    if (!bytes || bytes.length < 2 || bytes[0] !== DASHBOARD_VERSION ||
+        bytes.length !== 2 + bytes[1]) {
+      return null;
+    }
+    var entries = [];
+    for (var i = 0; i < bytes[1]; i++) {
+      entries.push({ from: bytes[2 + i] >> 4, to: bytes[2 + i] & 0x0F });
+    }
+    return entries;
+  }
+
+  // Route data blob for the first DASHBOARD_ROWS_PER_ROUTE connections
+function encodeDepartures(connections) {
+    var count = Math.min(connections.length, Constants.CONFIG.DASHBOARD_ROWS_PER_ROUTE);
+    var bytes = [count];
+    for (var i = 0; i < count; i++) {
+      bytes.push.apply(bytes, DataProcessor.encodeCompactDeparture(connections[i],
+                                                                  Disruptions.affectsConnection(connections[i])));
+    }
+    return bytes;
+  }
+
+  // Send the compiled dashboard routes to the watch
+function sendRoutes(stationIds, callback) {
+    var entries = compile(Storage.getDashboardRoutes(), stationIds);
+    Log.info('Sending ' + entries.length + ' dashboard routes');
+
+    Pebble.sendAppMessage({
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.DASHBOARD_ROUTES,
+      'DASHBOARD_ROUTES': encodeRoutes(entries)
+    }, function() {
+      Log.debug('Dashboard routes sent');
+      if (callback) {
+        callback();
+      }
+    }, function(e) {
+      Log.warn('Failed to send dashboard routes: ' + e.error.message);
+      if (callback) {
+        callback();
+      }
+    });
+  }
+
+  // Send queued route answers one at a time, in the order they finished
+function sendNext() {
+    if (sending || sendQueue.length === 0) {
+      return;
+    }
+    var message = sendQueue.shift();
+    sending = true;
+    Pebble.sendAppMessage(message, function() {
+      Log.debug('Dashboard route ' + message.ROUTE_INDEX + ' sent [ID ' + message.REQUEST_ID + ']');
+      sending = false;
+      sendNext();
+    }, function(e) {
+      Log.warn('Failed to send dashboard route ' + message.ROUTE_INDEX + ': ' + e.error.message);
+      sending = false;
+      sendNext();
+    });
+  }
+
+  // Queue one route's answer (bytes null: the route failed)
+function queueRoute(requestId, index, bytes) {
+    if (requestId !== currentRequestId) {
+      Log.debug('Dropping dashboard route ' + index + ' of old request [ID ' + requestId + ']');
+      return;
+    }
+    var message = {
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.DASHBOARD_DATA,
+      'ROUTE_INDEX': index,
+      'REQUEST_ID': requestId
+    };
+    if (bytes) {
+      message.DASHBOARD_DATA = bytes;
+    }
+    sendQueue.push(message);
+    sendNext();
+  }
+
+  // Answer a dashboard request from the watch: fetch every route at once
+function handleRequest(payload) {
+    var requestId = payload.REQUEST_ID || 0;
+    var routes = decodeRoutes(payload.DASHBOARD_ROUTES);
+    if (!routes) {
+      Log.warn('Invalid dashboard request [ID ' + requestId + ']');
+      return;
+    }
+
+    // A newer request replaces whatever the previous one still had queued
+    currentRequestId = requestId;
+    sendQueue = [];
+
+    var stationIds = Storage.getFavoriteStations() || [];
+    var start = Date.now();
+    Log.info('Dashboard request [ID ' + requestId + ']: ' + routes.length + ' routes');
+
+    routes.forEach(function(route, index) {
+      var fromId = stationIds[route.from];
+      var toId = stationIds[route.to];
+      if (!fromId || !toId) {
+        Log.warn('Dashboard route ' + index + ' is outside the favorites');
+        queueRoute(requestId, index, null);
+        return;
+      }
+
+      StationGroups.fetchConnections(fromId, toId, function(response) {
+        Log.debug('Dashboard route ' + index + ' fetched in ' + (Date.now() - start) + ' ms');
+        queueRoute(requestId, index, encodeDepartures(response.connection || []));
+      }, function(error) {
+        Log.warn('Dashboard route ' + index + ' failed: ' + error);
+        queueRoute(requestId, index, null);
+      }, { id: requestId, keepRoute: true });
+    });
+  }
+
+module.exports = {
+  compile: compile,
+  encodeRoutes: encodeRoutes,
+  decodeRoutes: decodeRoutes,
+  encodeDepartures: encodeDepartures,
+  sendRoutes: sendRoutes,
+  handleRequest: handleRequest
+};
@@ -1,5 +1,6 @@
 // Data processing and formatting for NMBS Pebble App
 var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
 var Storage = require('./01-storage.js');
 
 // Helper function to format Unix timestamp to HH:MM
@@ -23,6 +24,11 @@ function calculateDuration(departTime, arriveTime) {
     }
   }
 
+  // Whether iRail attached alerts (strikes, works, incidents) to a connection
+function hasAlerts(conn) {
+    return !!(conn.alerts && parseInt(conn.alerts.number) > 0);
+  }
+
   // Helper function to check if platform changed
   // iRail API: platforminfo.normal == "0" means changed, "1" means no change
 function checkPlatformChanged(departureOrArrival) {
@@ -56,7 +62,7 @@ function processConnection(conn, index) {
 
     // Check platform change
     var platformChanged = checkPlatformChanged(conn.departure);
-    console.log('Platform changed: ' + platformChanged);
+    Log.debug(function() { return 'Platform changed: ' + platformChanged; });
 
     // Calculate duration from conn.duration (in seconds)
     var durationSeconds = parseInt(conn.duration) || 0;
@@ -72,9 +78,12 @@ function processConnection(conn, index) {
     }
 
     // Store connection identifier for detail requests
+    // (group routes also record the member stations the connection uses)
     Storage.setConnectionIdentifier(index, {
       vehicle: conn.departure.vehicle || '',
-      departTime: departTime
+      departTime: departTime,
+      fromId: conn.fromId,
+      toId: conn.toId
     });
 
     // Persist connection identifiers (will save after each departure)
@@ -93,13 +102,15 @@ function processConnection(conn, index) {
       departDelay: Math.floor(departDelay / 60),
       arriveDelay: Math.floor(arriveDelay / 60),
       isDirect: isDirect,
-      platformChanged: platformChanged
+      platformChanged: platformChanged,
+      hasAlert: hasAlerts(conn),
+      stationLabel: conn.stationLabel || ''  // Group member used, e.g. "North"
     };
   }
 
   // Process connection detail into journey legs
 function processConnectionDetail(conn) {
-    console.log('Processing connection details...');
+    Log.debug('Processing connection details...');
 
     // Build leg array
     var legs = [];
@@ -125,7 +136,11 @@ function processConnectionDetail(conn) {
         direction: (conn.departure.direction && conn.departure.direction.name) || 'Unknown',
         stopCount: (conn.departure.stops && parseInt(conn.departure.stops.number)) || 0,
         departPlatformChanged: checkPlatformChanged(conn.departure),
-        arrivePlatformChanged: checkPlatformChanged(conn.arrival)
+        arrivePlatformChanged: checkPlatformChanged(conn.arrival),
+        // Used to look up intermediate stops (processLegStops)
+        vehicleId: conn.departure.vehicle || '',
+        departTimestamp: parseInt(conn.departure.time),
+        arriveTimestamp: parseInt(conn.arrival.time)
       };
       legs.push(leg);
     } else {
@@ -145,27 +160,32 @@ function processConnectionDetail(conn) {
         direction: (conn.departure.direction && conn.departure.direction.name) || 'Unknown',
         stopCount: (conn.departure.stops && parseInt(conn.departure.stops.number)) || 0,
         departPlatformChanged: checkPlatformChanged(conn.departure),
-        arrivePlatformChanged: checkPlatformChanged(firstVia.arrival)
+        arrivePlatformChanged: checkPlatformChanged(firstVia.arrival),
+        vehicleId: conn.departure.vehicle || '',
+        departTimestamp: parseInt(conn.departure.time),
+        arriveTimestamp: parseInt(firstVia.arrival.time)
       };
       legs.push(firstLeg);
 
       // Middle legs: via departure → next via arrival (or final arrival if last)
       for (var i = 0; i < conn.vias.via.length; i++) {
         var via = conn.vias.via[i];
-        var nextStation, nextTime, nextPlatform, nextDelay, nextPlatformChanged;
+        var nextStation, nextTime, nextPlatform, nextDelay, nextPlatformChanged, nextTimestamp;
 
         if (i < conn.vias.via.length - 1) {
           // Next via exists
           var nextVia = conn.vias.via[i + 1];
           nextStation = nextVia.arrival.stationinfo.name;
-          nextTime = formatUnixTime(parseInt(nextVia.arrival.time));
+          nextTimestamp = parseInt(nextVia.arrival.time);
+          nextTime = formatUnixTime(nextTimestamp);
           nextPlatform = nextVia.arrival.platform || '?';
           nextDelay = Math.floor(parseInt(nextVia.arrival.delay || 0) / 60);
           nextPlatformChanged = checkPlatformChanged(nextVia.arrival);
         } else {
           // Last leg - goes to final arrival
           nextStation = conn.arrival.stationinfo.name;
-          nextTime = formatUnixTime(parseInt(conn.arrival.time));
+          nextTimestamp = parseInt(conn.arrival.time);
+          nextTime = formatUnixTime(nextTimestamp);
           nextPlatform = conn.arrival.platform || '?';
           nextDelay = Math.floor(parseInt(conn.arrival.delay || 0) / 60);
           nextPlatformChanged = checkPlatformChanged(conn.arrival);
@@ -184,20 +204,128 @@ function processConnectionDetail(conn) {
           direction: (via.departure.direction && via.departure.direction.name) || 'Unknown',
           stopCount: (via.departure.stops && parseInt(via.departure.stops.number)) || 0,
           departPlatformChanged: checkPlatformChanged(via.departure),
-          arrivePlatformChanged: nextPlatformChanged
+          arrivePlatformChanged: nextPlatformChanged,
+          vehicleId: via.departure.vehicle || '',
+          departTimestamp: parseInt(via.departure.time),
+          arriveTimestamp: nextTimestamp
         };
         legs.push(leg);
       }
     }
 
-    console.log('Built ' + legs.length + ' legs');
+    Log.debug(function() { return 'Built ' + legs.length + ' legs'; });
     return legs;
   }
 
+  // Station name of a vehicle stop
+function stopName(stop) {
+    return (stop.stationinfo && stop.stationinfo.name) || stop.station || '';
+  }
+
+  // Indices of a leg's departure and arrival in its vehicle's stop list
+  // (API.fetchVehicle); null if the leg isn't found
+function findLegRange(stops, leg) {
+    var start = -1;
+    var end = -1;
+    for (var i = 0; i < stops.length; i++) {
+      var stop = stops[i];
+      if (start === -1) {
+        if (stopName(stop) === leg.departStation ||
+            parseInt(stop.scheduledDepartureTime || stop.time) === leg.departTimestamp) {
+          start = i;
+        }
+      } else if (stopName(stop) === leg.arriveStation ||
+                 parseInt(stop.scheduledArrivalTime || stop.time) === leg.arriveTimestamp) {
+        end = i;
+        break;
+      }
+    }
+    return (start === -1 || end === -1) ? null : { start: start, end: end };
+  }
+
+  // Cut the stops between a leg's departure and arrival out of its
+  // vehicle's stop list; null if the leg isn't found
+function processLegStops(stops, leg) {
+    var range = findLegRange(stops, leg);
+    if (!range) {
+      return null;
+    }
+
+    return stops.slice(range.start + 1, range.end).filter(function(stop) {
+      return stop.arrivalCanceled !== '1' && stop.departureCanceled !== '1';
+    }).map(function(stop) {
+      return {
+        name: stopName(stop),
+        time: formatUnixTime(parseInt(stop.scheduledArrivalTime || stop.time)),
+        delay: Math.floor(parseInt(stop.arrivalDelay || stop.delay || 0) / 60)
+      };
+    });
+  }
+
+  // Current delays and platforms of a leg from its vehicle's stop list, in
+  // the same fields as processConnectionDetail; null if the leg isn't found
+function processLegStatus(stops, leg) {
+    var range = findLegRange(stops, leg);
+    if (!range) {
+      return null;
+    }
+
+    var depart = stops[range.start];
+    var arrive = stops[range.end];
+    return {
+      departDelay: Math.floor(parseInt(depart.departureDelay || depart.delay || 0) / 60),
+      arriveDelay: Math.floor(parseInt(arrive.arrivalDelay || arrive.delay || 0) / 60),
+      departPlatform: depart.platform || '?',
+      arrivePlatform: arrive.platform || '?',
+      departPlatformChanged: checkPlatformChanged(depart),
+      arrivePlatformChanged: checkPlatformChanged(arrive)
+    };
+  }
+
+function clampDelay(seconds) {
+    var minutes = Math.floor((parseInt(seconds) || 0) / 60);
+    return Math.max(-128, Math.min(127, minutes)) & 0xFF;
+  }
+
+function asciiBytes(text) {
+    var bytes = [];
+    for (var i = 0; i < text.length; i++) {
+      var code = text.charCodeAt(i);
+      bytes.push(code < 0x80 ? code : 0x3F);
+    }
+    return bytes;
+  }
+
+  // Compact departure row (layout in src/c/utils.h): times, delays, flags,
+  // platform and train type, without destination or group member label.
+  // alert marks the row for a disruption on top of the connection's own alerts.
+function encodeCompactDeparture(conn, alert) {
+    var depart = parseInt(conn.departure.time);
+    var duration = Math.max(0, Math.min(0xFFFF, Math.round((parseInt(conn.arrival.time) - depart) / 60)));
+    var isDirect = !(conn.vias && parseInt(conn.vias.number));
+    var type = (conn.departure.vehicleinfo && conn.departure.vehicleinfo.type) || 'IC';
+
+    var bytes = [depart & 0xFF, (depart >>> 8) & 0xFF, (depart >>> 16) & 0xFF, (depart >>> 24) & 0xFF,
+                 duration & 0xFF, duration >> 8,
+                 clampDelay(conn.departure.delay),
+                 clampDelay(conn.arrival.delay),
+                 (isDirect ? 0x01 : 0) | (checkPlatformChanged(conn.departure) ? 0x02 : 0) |
+                 (alert || hasAlerts(conn) ? 0x04 : 0)];
+    bytes.push.apply(bytes, asciiBytes((conn.departure.platform || '?').substring(0, 3)));
+    bytes.push(0);
+    bytes.push.apply(bytes, asciiBytes(type.substring(0, 3)));
+    bytes.push(0);
+    return bytes;
+  }
+
 module.exports = {
   formatUnixTime: formatUnixTime,
   calculateDuration: calculateDuration,
   checkPlatformChanged: checkPlatformChanged,
+  hasAlerts: hasAlerts,
+  encodeCompactDeparture: encodeCompactDeparture,
   processConnection: processConnection,
-  processConnectionDetail: processConnectionDetail
+  processConnectionDetail: processConnectionDetail,
+  processLegStops: processLegStops,
+  processLegStatus: processLegStatus
 };
@@ -0,0 +1,248 @@
+// Disruption feed for NMBS Pebble App
+//
+// Follows iRail's /disturbances/ feed (strikes, outages, planned works). It
+// is asked at most every DISRUPTIONS_POLL_MS, with the ETag/Last-Modified of
+// the cached copy, so an unchanged feed costs a 304. The copy is kept in
+// localStorage; disturbances already in it are reused, not reprocessed.
+//
+// Disturbances only carry text, no station IDs or vehicles, so they are
+// matched by name: one is relevant when it names a favorite station or the
+// vehicle of a departure on screen. The relevant ones go to the watch as
+// short summaries (MSG_ALERTS, layout in src/c/alerts.h) with a bit per
+// departure they touch, but only when that set changed since the last push
+// this session. Planned works are summarized but don't mark departures.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+var Storage = require('./01-storage.js');
+var API = require('./02-api.js');
+var DataProcessor = require('./03-data-processor.js');
+
+// Cached feed: { etag, lastModified, fetched, items: [{ id, title, text, planned }] }
+var cache = null;
+var polling = false;
+// Departure list the alerts are for: { connections, requestId }
+var current = null;
+// Relevant disturbance IDs last pushed to the watch ('id,id'); the watch
+// app starts without alerts
+var pushedKey = '';
+
+function getCache() {
+    if (!cache) {
+      try {
+        cache = JSON.parse(localStorage.getItem(Constants.STORAGE_KEYS.DISRUPTIONS) || 'null');
+      } catch (e) {
+        Log.error('Error loading disruptions: ' + e.message);
+      }
+    }
+    if (!cache || !cache.items) {
+      cache = { etag: null, lastModified: null, fetched: 0, items: [] };
+    }
+    return cache;
+  }
+
+function saveCache() {
+    try {
+      localStorage.setItem(Constants.STORAGE_KEYS.DISRUPTIONS, JSON.stringify(cache));
+    } catch (e) {
+      Log.error('Error saving disruptions: ' + e.message);
+    }
+  }
+
+  // Replace the cached disturbances with a fresh feed, keeping the
+  // processed copy of the ones already seen
+function storeFeed(disturbances, validators) {
+    var seen = {};
+    cache.items.forEach(function(item) {
+      seen[item.id] = item;
+    });
+
+    var fresh = 0;
+    cache.items = disturbances.slice(0, Constants.CONFIG.DISRUPTIONS_CACHE_MAX).map(function(d) {
+      var id = String(d.id || d.link || d.title);
+      if (seen[id]) {
+        return seen[id];
+      }
+      fresh++;
+      return {
+        id: id,
+        title: String(d.title || ''),
+        text: (String(d.title || '') + ' ' + String(d.description || '')).toLowerCase().substring(0, 600),
+        planned: d.type === 'planned'
+      };
+    });
+    cache.etag = validators.etag || null;
+    cache.lastModified = validators.lastModified || null;
+    Log.info('Disturbances: ' + cache.items.length + ', ' + fresh + ' new');
+  }
+
+  // Whether text names a station or vehicle ("IC 1234" also matches
+  // "IC1234"), as a whole word
+function mentions(text, name) {
+    var pattern = name.toLowerCase().replace(/[.*+?^${}()|[\]\\]/g, '\\$&').replace(/\s+/g, '\\s*');
+    return new RegExp('(^|[^a-z0-9])' + pattern + '($|[^a-z0-9])').test(text);
+  }
+
+  // Parts of bilingual station names ("Brussel-Zuid/Bruxelles-Midi")
+function nameParts(name) {
+    return (name || '').split('/').map(function(part) {
+      return part.trim();
+    }).filter(function(part) {
+      return part.length >= 3;
+    });
+  }
+
+function favoriteNames() {
+    var names = [];
+    Storage.getFavoriteStationIds().forEach(function(id) {
+      names.push.apply(names, nameParts(Storage.getStationNameById(id)));
+    });
+    return names;
+  }
+
+  // Vehicles of a connection: the first train and every transfer
+function vehicleNames(conn) {
+    var names = [conn.departure.vehicleinfo && conn.departure.vehicleinfo.shortname];
+    if (conn.vias && conn.vias.via) {
+      conn.vias.via.forEach(function(via) {
+        names.push(via.departure && via.departure.vehicleinfo && via.departure.vehicleinfo.shortname);
+      });
+    }
+    return names.filter(function(name) {
+      return !!name;
+    });
+  }
+
+function touches(item, conn) {
+    var names = vehicleNames(conn)
+        .concat(nameParts(conn.departure.stationinfo && conn.departure.stationinfo.name))
+        .concat(nameParts(conn.arrival.stationinfo && conn.arrival.stationinfo.name));
+    return names.some(function(name) {
+      return mentions(item.text, name);
+    });
+  }
+
+  // Whether a cached disturbance (not planned works) touches a connection's
+  // trains or its stations
+function affectsConnection(conn) {
+    return getCache().items.some(function(item) {
+      return !item.planned && touches(item, conn);
+    });
+  }
+
+  // Disturbances naming a favorite station or a train on screen,
+  // disruptions before planned works
+function relevantItems(connections) {
+    var favorites = favoriteNames();
+    var items = getCache().items.filter(function(item) {
+      return favorites.some(function(name) {
+        return mentions(item.text, name);
+      }) || connections.some(function(conn) {
+        return vehicleNames(conn).some(function(name) {
+          return mentions(item.text, name);
+        });
+      });
+    });
+    return items.filter(function(item) {
+      return !item.planned;
+    }).concat(items.filter(function(item) {
+      return item.planned;
+    }));
+  }
+
+  // UTF-8 bytes of a title, cut to fit ALERT_TITLE_LEN with its NUL and
+  // without splitting a character
+function titleBytes(title) {
+    var utf8 = unescape(encodeURIComponent(title));
+    var length = Math.min(utf8.length, Constants.CONFIG.ALERT_TITLE_LEN - 1);
+    while (length < utf8.length && (utf8.charCodeAt(length) & 0xC0) === 0x80) {
+      length--;
+    }
+    var bytes = [];
+    for (var i = 0; i < length; i++) {
+      bytes.push(utf8.charCodeAt(i));
+    }
+    return bytes;
+  }
+
+  // Alert blob: u8 count, per alert u8 flags (bit 0 planned works) and the
+  // NUL-terminated UTF-8 title
+function encodeAlerts(items) {
+    var bytes = [items.length];
+    items.forEach(function(item) {
+      bytes.push(item.planned ? 0x01 : 0);
+      bytes.push.apply(bytes, titleBytes(item.title));
+      bytes.push(0);
+    });
+    return bytes;
+  }
+
+  // Push the summaries for the current list if its relevant set changed
+function push() {
+    if (!current) {
+      return;
+    }
+    var items = relevantItems(current.connections).slice(0, Constants.CONFIG.ALERTS_MAX);
+    var key = items.map(function(item) {
+      return item.id;
+    }).join(',');
+    if (key === pushedKey) {
+      return;
+    }
+
+    var rows = 0;
+    current.connections.forEach(function(conn, index) {
+      if (index < 32 && (DataProcessor.hasAlerts(conn) || affectsConnection(conn))) {
+        rows |= 1 << index;
+      }
+    });
+
+    pushedKey = key;
+    var requestId = current.requestId;
+    Pebble.sendAppMessage({
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.ALERTS,
+      'ALERT_DATA': encodeAlerts(items),
+      'ALERT_ROWS': rows >>> 0,
+      'REQUEST_ID': requestId
+    }, function() {
+      Log.debug('Alerts sent: ' + items.length + ' [ID ' + requestId + ']');
+    }, function(e) {
+      Log.warn('Failed to send alerts: ' + e.error.message);
+      // Try again with the next list
+      pushedKey = null;
+    });
+  }
+
+  // A departure list (iRail connections) is on the watch: poll the feed if
+  // due, then push what changed for it
+function update(connections, requestId) {
+    current = { connections: connections, requestId: requestId };
+    var data = getCache();
+    if (polling || Date.now() - data.fetched < Constants.CONFIG.DISRUPTIONS_POLL_MS) {
+      push();
+      return;
+    }
+
+    polling = true;
+    API.fetchDisturbances(data, function(disturbances, validators) {
+      polling = false;
+      if (disturbances) {
+        storeFeed(disturbances, validators);
+      } else {
+        Log.debug('Disturbances unchanged');
+      }
+      cache.fetched = Date.now();
+      saveCache();
+      push();
+    }, function(error) {
+      polling = false;
+      Log.warn('Failed to fetch disturbances: ' + error);
+      // Wait a full interval before asking again
+      cache.fetched = Date.now();
+      push();
+    });
+  }
+
+module.exports = {
+  affectsConnection: affectsConnection,
+  update: update
+};
@@ -0,0 +1,147 @@
+// Live tracking of the journey open in the watch's detail window
+//
+// While the detail window is shown, each leg's vehicle is polled for new
+// delays and platforms. Polls are spaced at a quarter of the time until the
+// journey's next departure or arrival (between TRACKING_MIN_INTERVAL_MS and
+// TRACKING_MAX_INTERVAL_MS), so they get closer together around boarding and
+// transfers. Only fields that changed since the last poll are passed on.
+// Tracking ends when the watch closes the window, another journey is opened
+// or the final arrival has passed.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+var API = require('./02-api.js');
+var DataProcessor = require('./03-data-processor.js');
+
+// Fields compared between polls (see processLegStatus)
+var TRACKED_FIELDS = ['departDelay', 'arriveDelay', 'departPlatform', 'arrivePlatform',
+                      'departPlatformChanged', 'arrivePlatformChanged'];
+
+// Tracked journey: { legs, status (per leg, last values sent), onChange }
+var tracked = null;
+var pollTimer = null;
+// Bumped on stop() so answers to an earlier journey's polls are dropped
+var generation = 0;
+
+function nowSeconds() {
+    return Math.floor(Date.now() / 1000);
+  }
+
+  // Next (delayed) departure or arrival still ahead, in Unix seconds
+function nextEventTime() {
+    var now = nowSeconds();
+    var next = null;
+    tracked.legs.forEach(function(leg, i) {
+      var status = tracked.status[i];
+      [leg.departTimestamp + status.departDelay * 60,
+       leg.arriveTimestamp + status.arriveDelay * 60].forEach(function(time) {
+        if (time > now && (next === null || time < next)) {
+          next = time;
+        }
+      });
+    });
+    return next;
+  }
+
+function scheduleNextPoll() {
+    var next = nextEventTime();
+    if (next === null) {
+      Log.info('Journey completed, tracking stopped');
+      stop();
+      return;
+    }
+
+    var interval = Math.max(Constants.CONFIG.TRACKING_MIN_INTERVAL_MS,
+                            Math.min(Constants.CONFIG.TRACKING_MAX_INTERVAL_MS,
+                                     (next - nowSeconds()) * 1000 / 4));
+    Log.debug('Next journey poll in ' + Math.round(interval / 1000) + ' s');
+    pollTimer = setTimeout(poll, interval);
+  }
+
+  // Fetch every leg that hasn't arrived yet and report changed fields
+function poll() {
+    pollTimer = null;
+    var current = generation;
+    var now = nowSeconds();
+    var pending = tracked.legs.filter(function(leg, i) {
+      return leg.arriveTimestamp + tracked.status[i].arriveDelay * 60 > now;
+    }).length;
+
+    if (pending === 0) {
+      scheduleNextPoll();
+      return;
+    }
+
+    function finished() {
+      pending--;
+      if (pending === 0 && current === generation) {
+        scheduleNextPoll();
+      }
+    }
+
+    tracked.legs.forEach(function(leg, i) {
+      if (leg.arriveTimestamp + tracked.status[i].arriveDelay * 60 <= now) {
+        return;
+      }
+
+      API.fetchVehicle(leg.vehicleId, leg.departTimestamp, function(stops) {
+        if (current !== generation) {
+          return;
+        }
+        var status = DataProcessor.processLegStatus(stops, leg);
+        if (!status) {
+          Log.warn('Leg ' + i + ' not found in stops of ' + leg.vehicleId);
+          finished();
+          return;
+        }
+
+        var changes = {};
+        var changed = false;
+        TRACKED_FIELDS.forEach(function(field) {
+          if (status[field] !== tracked.status[i][field]) {
+            changes[field] = status[field];
+            tracked.status[i][field] = status[field];
+            changed = true;
+          }
+        });
+        if (changed) {
+          Log.info('Leg ' + i + ' changed: ' + JSON.stringify(changes));
+          tracked.onChange(i, changes);
+        }
+        finished();
+      }, function(error) {
+        Log.warn('Tracking ' + leg.vehicleId + ' failed: ' + error);
+        finished();
+      });
+    });
+  }
+
+  // Start tracking legs (from processConnectionDetail, as sent to the
+  // watch); onChange(legIndex, changes) receives changed fields only
+function start(legs, onChange) {
+    stop();
+    tracked = {
+      legs: legs,
+      status: legs.map(function(leg) {
+        var status = {};
+        TRACKED_FIELDS.forEach(function(field) { status[field] = leg[field]; });
+        return status;
+      }),
+      onChange: onChange
+    };
+    Log.info('Tracking journey with ' + legs.length + ' legs');
+    scheduleNextPoll();
+  }
+
+function stop() {
+    generation++;
+    if (pollTimer) {
+      clearTimeout(pollTimer);
+      pollTimer = null;
+    }
+    tracked = null;
+  }
+
+module.exports = {
+  start: start,
+  stop: stop
+};
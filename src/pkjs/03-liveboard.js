@@ -0,0 +1,280 @@
+// Liveboard fan-out for NMBS Pebble App
+//
+// Instead of one /connections/ request per From/To pair, fetches the
+// liveboard of the origin once and matches its departures against the
+// destination through each vehicle's stop list. Stop lists only change with
+// the timetable, so they are cached per vehicle and service day (keeping just
+// the stops at favorite stations). One liveboard then answers every
+// destination the watch cycles through for LIVEBOARD_TTL_MS.
+//
+// Only direct trains can be found this way, so faster connections with a
+// transfer are missed once LIVEBOARD_MIN_RESULTS direct ones match, and a
+// cold route costs a liveboard plus up to LIVEBOARD_VEHICLE_FETCHES vehicle
+// requests: it is off unless LIVEBOARD_FANOUT is set. Pairs with fewer
+// matches fall back to /connections/ (and are remembered, so they don't pay
+// for the liveboard again). Stop lists only keep favorite stations, so
+// other destinations (e.g. searched ones) go to /connections/ directly.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+var Storage = require('./01-storage.js');
+var API = require('./02-api.js');
+
+// Liveboards per origin: { time, departures }
+var liveboards = {};
+// Callbacks waiting for a liveboard already being fetched, per origin
+var pendingLiveboards = {};
+// Cached stop lists: { favorites: 'id,id', vehicles: { 'vehicle@YYYYMMDD': [[id, arrival, platform, normal]] } }
+var vehicleCache = null;
+// Vehicles whose stop list couldn't be fetched this session
+var failedVehicles = {};
+// Pairs that need transfers or don't run often enough ('from>to')
+var fallbackPairs = {};
+
+// Request counts for comparing with one /connections/ call per route request
+var stats = { answered: 0, fallbacks: 0, liveboards: 0, vehicles: 0 };
+
+function serviceDay(timestamp) {
+    var date = new Date(timestamp * 1000);
+    return date.getFullYear() * 10000 + (date.getMonth() + 1) * 100 + date.getDate();
+  }
+
+function getFavoriteKey() {
+    return Storage.getFavoriteStationIds().sort().join(',');
+  }
+
+  // Load the stop list cache; it is dropped when the favorites change
+function getVehicleCache() {
+    var favorites = getFavoriteKey();
+    if (!vehicleCache) {
+      try {
+        vehicleCache = JSON.parse(localStorage.getItem(Constants.STORAGE_KEYS.VEHICLE_STOPS) || 'null');
+      } catch (e) {
+        Log.error('Error loading vehicle stops: ' + e.message);
+      }
+    }
+    if (!vehicleCache || vehicleCache.favorites !== favorites) {
+      vehicleCache = { favorites: favorites, vehicles: {} };
+    }
+    return vehicleCache;
+  }
+
+  // Persist the cache, keeping only today's and later service days
+function saveVehicleCache() {
+    var today = serviceDay(Date.now() / 1000);
+    var vehicles = vehicleCache.vehicles;
+    Object.keys(vehicles).forEach(function(key) {
+      if (parseInt(key.split('@')[1], 10) < today) {
+        delete vehicles[key];
+      }
+    });
+    try {
+      localStorage.setItem(Constants.STORAGE_KEYS.VEHICLE_STOPS, JSON.stringify(vehicleCache));
+    } catch (e) {
+      Log.error('Error saving vehicle stops: ' + e.message);
+    }
+  }
+
+function vehicleKey(departure) {
+    return departure.vehicle + '@' + serviceDay(parseInt(departure.time));
+  }
+
+  // Liveboard of an origin, fetched at most once per LIVEBOARD_TTL_MS
+function getLiveboard(stationId, callback, requestInfo) {
+    var cached = liveboards[stationId];
+    if (cached && Date.now() - cached.time < Constants.CONFIG.LIVEBOARD_TTL_MS) {
+      Log.debug('Using cached liveboard for ' + stationId);
+      callback(cached.departures);
+      return;
+    }
+
+    if (pendingLiveboards[stationId]) {
+      pendingLiveboards[stationId].push(callback);
+      return;
+    }
+    pendingLiveboards[stationId] = [callback];
+
+    function done(departures) {
+      var callbacks = pendingLiveboards[stationId];
+      delete pendingLiveboards[stationId];
+      callbacks.forEach(function(cb) { cb(departures); });
+    }
+
+    stats.liveboards++;
+    API.fetchLiveboard(stationId, function(departures) {
+      liveboards[stationId] = { time: Date.now(), departures: departures };
+      done(departures);
+    }, function(error) {
+      Log.warn('Liveboard failed: ' + error);
+      done(null);
+    }, requestInfo);
+  }
+
+  // Fetch missing stop lists for the first departures (up to
+  // LIVEBOARD_VEHICLE_FETCHES at once), then call done(complete) where
+  // complete is false if some departures are still unknown
+function fetchMissingVehicles(departures, requestInfo, done) {
+    var cache = getVehicleCache();
+    var favorites = {};
+    cache.favorites.split(',').forEach(function(id) { favorites[id] = true; });
+
+    var missing = [];
+    var seen = {};
+    var complete = true;
+    for (var i = 0; i < departures.length; i++) {
+      var key = vehicleKey(departures[i]);
+      if (cache.vehicles[key] || failedVehicles[key] || seen[key]) {
+        continue;
+      }
+      if (missing.length === Constants.CONFIG.LIVEBOARD_VEHICLE_FETCHES) {
+        complete = false;
+        break;
+      }
+      seen[key] = true;
+      missing.push(departures[i]);
+    }
+    if (missing.length === 0) {
+      done(complete);
+      return;
+    }
+
+    var remaining = missing.length;
+    function finished() {
+      remaining--;
+      if (remaining === 0) {
+        saveVehicleCache();
+        done(complete);
+      }
+    }
+
+    missing.forEach(function(departure) {
+      var key = vehicleKey(departure);
+      stats.vehicles++;
+      API.fetchVehicle(departure.vehicle, parseInt(departure.time), function(stops) {
+        cache.vehicles[key] = stops.filter(function(stop) {
+          return stop.stationinfo && favorites[stop.stationinfo.id];
+        }).map(function(stop) {
+          return [stop.stationinfo.id, parseInt(stop.scheduledArrivalTime || stop.time),
+                  stop.platform || '?', (stop.platforminfo && stop.platforminfo.normal) || '1'];
+        });
+        finished();
+      }, function(error) {
+        Log.warn('Vehicle ' + departure.vehicle + ' failed: ' + error);
+        failedVehicles[key] = true;
+        finished();
+      }, requestInfo);
+    });
+  }
+
+  // Build iRail-shaped connections from liveboard departures calling at toId
+function matchDepartures(fromId, toId, departures) {
+    var vehicles = getVehicleCache().vehicles;
+    var fromName = Storage.getStationNameById(fromId) || fromId;
+    var toName = Storage.getStationNameById(toId) || toId;
+    var connections = [];
+
+    for (var i = 0; i < departures.length && connections.length < Constants.CONFIG.MAX_DEPARTURES; i++) {
+      var dep = departures[i];
+      var stops = vehicles[vehicleKey(dep)];
+      if (!stops || dep.canceled === '1' || dep.left === '1') {
+        continue;
+      }
+
+      var departTime = parseInt(dep.time);
+      for (var s = 0; s < stops.length; s++) {
+        var stop = stops[s];
+        if (stop[0] !== toId || stop[1] <= departTime) {
+          continue;
+        }
+        var vehicleinfo = dep.vehicleinfo || {};
+        connections.push({
+          duration: String(stop[1] - departTime),
+          departure: {
+            time: dep.time,
+            delay: dep.delay,
+            platform: dep.platform,
+            platforminfo: dep.platforminfo,
+            vehicle: dep.vehicle,
+            vehicleinfo: {
+              type: vehicleinfo.type || (vehicleinfo.shortname || '').split(' ')[0],
+              shortname: vehicleinfo.shortname
+            },
+            direction: { name: dep.station },
+            stationinfo: { name: fromName }
+          },
+          // The stop list is cached, so carry the current delay forward
+          arrival: {
+            time: String(stop[1]),
+            delay: dep.delay,
+            platform: stop[2],
+            platforminfo: { normal: stop[3] },
+            vehicle: dep.vehicle,
+            stationinfo: { name: toName }
+          },
+          vias: { number: '0' }
+        });
+        break;
+      }
+    }
+    return connections;
+  }
+
+function logStats() {
+    var requests = stats.liveboards + stats.vehicles;
+    Log.info('Liveboard fan-out: ' + stats.answered + ' routes answered with ' + requests +
+             ' requests (' + stats.liveboards + ' liveboards, ' + stats.vehicles +
+             ' vehicles), per-pair would use ' + stats.answered + '; ' + stats.fallbacks +
+             ' fallbacks to /connections/');
+  }
+
+  // Drop-in replacement for API.fetchConnections that answers from the
+  // origin's liveboard where possible
+function fetchConnections(fromId, toId, callback, errorCallback, requestInfo) {
+    var pair = fromId + '>' + toId;
+    if (!Constants.CONFIG.LIVEBOARD_FANOUT || !fromId || !toId || fromId === toId ||
+        fallbackPairs[pair] || Storage.getFavoriteStationIds().indexOf(toId) === -1) {
+      API.fetchConnections(fromId, toId, callback, errorCallback, requestInfo);
+      return;
+    }
+
+    function fallback(reason) {
+      Log.info('Liveboard fan-out for ' + pair + ' not usable (' + reason + ')');
+      stats.fallbacks++;
+      API.fetchConnections(fromId, toId, callback, errorCallback, requestInfo);
+    }
+
+    getLiveboard(fromId, function(departures) {
+      if (!departures) {
+        fallback('liveboard failed');
+        return;
+      }
+
+      fetchMissingVehicles(departures, requestInfo, function(complete) {
+        var connections = matchDepartures(fromId, toId, departures);
+        if (connections.length < Constants.CONFIG.LIVEBOARD_MIN_RESULTS) {
+          // Only give up on the pair once every departure has been checked
+          if (complete) {
+            fallbackPairs[pair] = true;
+          }
+          fallback(connections.length + ' direct trains');
+          return;
+        }
+
+        // Same bookkeeping as API.fetchConnections for detail requests
+        if (!(requestInfo && requestInfo.keepRoute)) {
+          Storage.setCurrentFromStation(fromId);
+          Storage.setCurrentToStation(toId);
+          Storage.clearConnectionIdentifiers();
+          Storage.savePersistedData();
+        }
+
+        stats.answered++;
+        Log.trace('fanout_done', { id: requestInfo ? requestInfo.id : undefined });
+        logStats();
+        callback({ connection: connections });
+      });
+    }, requestInfo);
+  }
+
+module.exports = {
+  fetchConnections: fetchConnections
+};
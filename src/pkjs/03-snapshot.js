@@ -0,0 +1,253 @@
+// Schedule snapshots for phone-less operation
+//
+// Pushes the next few hours of departures for the active route and the
+// smart-schedule routes to the watch (MSG_SNAPSHOT, one route per slot) in a
+// compact binary form, so the watch can still show departures when the phone
+// is out of reach. The blob layout is documented in src/c/snapshot.h.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+var Storage = require('./01-storage.js');
+var API = require('./02-api.js');
+var DataProcessor = require('./03-data-processor.js');
+
+var SNAPSHOT_VERSION = 1;
+var HEADER_SIZE = 15;
+var MAX_STRINGS = 48;
+
+// Enum-coded train types (must match TRAIN_TYPES in src/c/snapshot.c)
+var TRAIN_TYPES = ['IC', 'L', 'S', 'P', 'EXT', 'ICE', 'TGV', 'EUR', 'THA', 'EC', 'INT', 'BUS'];
+var TYPE_STRING_FLAG = 0x80;
+
+var refreshInProgress = false;
+
+  // Numeric station code as used on the watch (BE.NMBS.008813003 -> 8813003)
+function stationCode(irailId) {
+    return parseInt(String(irailId).replace(/\D/g, ''), 10) || 0;
+  }
+
+function utf8Bytes(text) {
+    var encoded = unescape(encodeURIComponent(text));
+    var bytes = [];
+    for (var i = 0; i < encoded.length; i++) {
+      bytes.push(encoded.charCodeAt(i));
+    }
+    return bytes;
+  }
+
+function pushU32(bytes, value) {
+    bytes.push(value & 0xFF, (value >>> 8) & 0xFF, (value >>> 16) & 0xFF, (value >>> 24) & 0xFF);
+  }
+
+function pushVarint(bytes, value) {
+    while (value >= 0x80) {
+      bytes.push((value & 0x7F) | 0x80);
+      value = Math.floor(value / 128);
+    }
+    bytes.push(value);
+  }
+
+function clampDelay(seconds) {
+    var minutes = Math.floor((parseInt(seconds) || 0) / 60);
+    return Math.max(-128, Math.min(127, minutes)) & 0xFF;
+  }
+
+  // Encode connections (iRail shape, sorted by departure) for one route
+function encode(fromId, toId, connections) {
+    var strings = [];
+    var stringIndex = {};
+    function intern(text) {
+      if (!stringIndex.hasOwnProperty(text)) {
+        stringIndex[text] = strings.length;
+        strings.push(text);
+      }
+      return stringIndex[text];
+    }
+
+    var body = [];
+    var base = connections.length > 0 ? parseInt(connections[0].departure.time) : 0;
+    var previous = base;
+
+    for (var i = 0; i < connections.length; i++) {
+      var conn = connections[i];
+      var depart = parseInt(conn.departure.time);
+      var delta = Math.max(0, Math.round((depart - previous) / 60));
+      previous += delta * 60;
+
+      var type = (conn.departure.vehicleinfo && conn.departure.vehicleinfo.type) || 'IC';
+      var typeCode = TRAIN_TYPES.indexOf(type);
+      if (typeCode === -1) {
+        typeCode = TYPE_STRING_FLAG | intern(type.substring(0, 7));
+      }
+
+      var direction = (conn.departure.direction && conn.departure.direction.name) ||
+                      (conn.arrival.stationinfo && conn.arrival.stationinfo.name) || 'Unknown';
+      var isDirect = !(conn.vias && parseInt(conn.vias.number));
+
+      pushVarint(body, delta);
+      pushVarint(body, Math.max(0, Math.round((parseInt(conn.arrival.time) - depart) / 60)));
+      body.push(typeCode,
+                intern(direction.substring(0, 31)),
+                intern((conn.departure.platform || '?').substring(0, 3)),
+                (isDirect ? 0x01 : 0) | (DataProcessor.checkPlatformChanged(conn.departure) ? 0x02 : 0),
+                clampDelay(conn.departure.delay),
+                clampDelay(conn.arrival.delay));
+
+      if (strings.length > MAX_STRINGS) {
+        return null;
+      }
+    }
+
+    var bytes = [SNAPSHOT_VERSION];
+    pushU32(bytes, stationCode(fromId));
+    pushU32(bytes, stationCode(toId));
+    pushU32(bytes, base);
+    bytes.push(connections.length, strings.length);
+    for (var s = 0; s < strings.length; s++) {
+      bytes.push.apply(bytes, utf8Bytes(strings[s]));
+      bytes.push(0);
+    }
+    return bytes.concat(body);
+  }
+
+  // Encode as many departures as fit in SNAPSHOT_MAX_BYTES
+function encodeFitting(fromId, toId, connections) {
+    var count = Math.min(connections.length, 255);
+    while (count > 0) {
+      var bytes = encode(fromId, toId, connections.slice(0, count));
+      if (bytes && bytes.length <= Constants.CONFIG.SNAPSHOT_MAX_BYTES) {
+        return { bytes: bytes, count: count };
+      }
+      count--;
+    }
+    return null;
+  }
+
+  // Collect departures for the next SNAPSHOT_HOURS, paging through iRail
+function collectConnections(fromId, toId, callback) {
+    var now = Math.floor(Date.now() / 1000);
+    var horizon = now + Constants.CONFIG.SNAPSHOT_HOURS * 3600;
+    var connections = [];
+    var pages = 0;
+
+    function fetchPage(from) {
+      API.fetchConnectionsAt(fromId, toId, from, function(response) {
+        pages++;
+        var list = response.connection || [];
+        var last = from;
+        for (var i = 0; i < list.length; i++) {
+          var depart = parseInt(list[i].departure.time);
+          if (depart >= from && depart <= horizon) {
+            connections.push(list[i]);
+          }
+          last = Math.max(last, depart);
+        }
+
+        if (last < horizon && list.length > 0 && pages < Constants.CONFIG.SNAPSHOT_MAX_PAGES) {
+          fetchPage(last + 60);
+        } else {
+          callback(connections);
+        }
+      }, function(error) {
+        Log.warn('Snapshot page failed: ' + error);
+        callback(connections);
+      });
+    }
+
+    fetchPage(now);
+  }
+
+  // Active route first, then distinct enabled smart-schedule routes
+function getRoutes(fromId, toId) {
+    var routes = [];
+    function add(from, to) {
+      // Group routes span several station pairs and don't fit one slot
+      if (!from || !to || from === to || routes.length >= Constants.CONFIG.SNAPSHOT_MAX_ROUTES ||
+          Storage.getStationGroup(from) || Storage.getStationGroup(to)) {
+        return;
+      }
+      for (var i = 0; i < routes.length; i++) {
+        if (routes[i].fromId === from && routes[i].toId === to) {
+          return;
+        }
+      }
+      routes.push({ fromId: from, toId: to });
+    }
+
+    add(fromId, toId);
+    var schedules = Storage.getSmartSchedules() || [];
+    for (var i = 0; i < schedules.length; i++) {
+      if (schedules[i].enabled) {
+        add(schedules[i].fromId, schedules[i].toId);
+      }
+    }
+    return routes;
+  }
+
+function sendSnapshot(slot, route, connections) {
+    var encoded = encodeFitting(route.fromId, route.toId, connections);
+    if (!encoded) {
+      Log.warn('Snapshot for slot ' + slot + ' does not fit');
+      return;
+    }
+
+    var hours = Constants.CONFIG.SNAPSHOT_HOURS;
+    Log.info('Snapshot slot ' + slot + ': ' + encoded.count + ' departures, ' +
+             encoded.bytes.length + ' B (' + Math.round(encoded.bytes.length / hours) +
+             ' B/route-hour)');
+    Log.trace('snapshot', { slot: slot, departures: encoded.count, bytes: encoded.bytes.length });
+
+    Pebble.sendAppMessage({
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SNAPSHOT,
+      'SNAPSHOT_SLOT': slot,
+      'SNAPSHOT_DATA': encoded.bytes
+    }, function() {
+      Log.debug('Snapshot slot ' + slot + ' sent');
+    }, function(e) {
+      Log.warn('Failed to send snapshot slot ' + slot + ': ' + e.error.message);
+    });
+  }
+
+  // Push fresh snapshots if the routes changed or the last push is older
+  // than SNAPSHOT_REFRESH_MS
+function maybeRefresh(fromId, toId) {
+    var routes = getRoutes(fromId, toId);
+    if (routes.length === 0 || refreshInProgress) {
+      return;
+    }
+
+    var key = routes.map(function(r) { return r.fromId + '>' + r.toId; }).join(',');
+    try {
+      var last = JSON.parse(localStorage.getItem(Constants.STORAGE_KEYS.SNAPSHOT_SENT) || 'null');
+      if (last && last.routes === key &&
+          Date.now() - last.time < Constants.CONFIG.SNAPSHOT_REFRESH_MS) {
+        return;
+      }
+    } catch (e) {
+      Log.error('Error reading snapshot state: ' + e.message);
+    }
+
+    refreshInProgress = true;
+    var slot = 0;
+    function next() {
+      if (slot >= routes.length) {
+        refreshInProgress = false;
+        localStorage.setItem(Constants.STORAGE_KEYS.SNAPSHOT_SENT,
+                             JSON.stringify({ routes: key, time: Date.now() }));
+        return;
+      }
+      var route = routes[slot];
+      collectConnections(route.fromId, route.toId, function(connections) {
+        if (connections.length > 0) {
+          sendSnapshot(slot, route, connections);
+        }
+        slot++;
+        next();
+      });
+    }
+    next();
+  }
+
+module.exports = {
+  encode: encode,
+  maybeRefresh: maybeRefresh
+};
@@ -0,0 +1,157 @@
+// Station groups for NMBS Pebble App
+//
+// A favorite can be a station group (STATION_GROUPS, e.g. Brussels
+// Central/North/South). Routes from or to a group are fetched for every
+// member pair, in parallel unless CONFIG.GROUP_FETCH_SEQUENTIAL, and merged
+// into one time-ordered, deduplicated list
+// of at most MAX_DEPARTURES connections. Each connection is tagged with the
+// member stations it uses: stationLabel is shown on the watch row, fromId and
+// toId are kept for detail requests.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+var Storage = require('./01-storage.js');
+var Liveboard = require('./03-liveboard.js');
+
+  // Member name without the city ("Brussels-North" -> "North")
+function shortName(stationId) {
+    var name = Storage.getStationNameById(stationId);
+    var dash = name.indexOf('-');
+    return dash > 0 ? name.substring(dash + 1) : name;
+  }
+
+function compareConnections(a, b) {
+    return (parseInt(a.departure.time) - parseInt(b.departure.time)) ||
+           (parseInt(a.arrival.time) - parseInt(b.arrival.time));
+  }
+
+  // Merge time-ordered connection lists, dropping the same train listed for
+  // several destination members (the earliest arrival wins)
+function merge(lists, max) {
+    var heads = lists.map(function() { return 0; });
+    var seen = {};
+    var merged = [];
+
+    while (merged.length < max) {
+      var best = -1;
+      for (var k = 0; k < lists.length; k++) {
+        if (heads[k] < lists[k].length &&
+            (best === -1 || compareConnections(lists[k][heads[k]], lists[best][heads[best]]) < 0)) {
+          best = k;
+        }
+      }
+      if (best === -1) {
+        break;
+      }
+
+      var conn = lists[best][heads[best]++];
+      var key = conn.departure.vehicle + '@' + conn.departure.time;
+      if (!seen[key]) {
+        seen[key] = true;
+        merged.push(conn);
+      }
+    }
+    return merged;
+  }
+
+  // Drop-in replacement for API.fetchConnections that also accepts groups
+function fetchConnections(fromId, toId, callback, errorCallback, requestInfo) {
+    var fromGroup = Storage.getStationGroup(fromId);
+    var toGroup = Storage.getStationGroup(toId);
+    if (!fromGroup && !toGroup) {
+      Liveboard.fetchConnections(fromId, toId, callback, errorCallback, requestInfo);
+      return;
+    }
+
+    var pairs = [];
+    (fromGroup ? fromGroup.members : [fromId]).forEach(function(from) {
+      (toGroup ? toGroup.members : [toId]).forEach(function(to) {
+        if (from !== to) {
+          pairs.push({ from: from, to: to });
+        }
+      });
+    });
+
+    var sequential = Constants.CONFIG.GROUP_FETCH_SEQUENTIAL;
+    var start = Date.now();
+    // Latency of every member fetch added up; in parallel the fetches
+    // overlap, so this is not what a sequential run would take
+    var summedMs = 0;
+    var results = [];
+    var remaining = pairs.length;
+    var lastError = 'No member pairs';
+
+    function finished() {
+      remaining--;
+      if (remaining > 0) {
+        if (sequential) {
+          fetchPair(pairs.length - remaining);
+        }
+        return;
+      }
+
+      // Member fetches overwrote the current route; detail requests use
+      // the member IDs stored with each connection instead
+      if (!(requestInfo && requestInfo.keepRoute)) {
+        Storage.setCurrentFromStation(fromId);
+        Storage.setCurrentToStation(toId);
+        Storage.clearConnectionIdentifiers();
+      }
+
+      var lists = results.filter(function(list) { return list; });
+      if (lists.length === 0) {
+        errorCallback(lastError);
+        return;
+      }
+
+      var merged = merge(lists, Constants.CONFIG.MAX_DEPARTURES);
+      var elapsed = Date.now() - start;
+      Log.info('Group route: ' + pairs.length + ' member pairs, ' + merged.length +
+               ' departures in ' + elapsed + ' ms ' + (sequential ? 'sequential' : 'parallel') +
+               ' (per-pair latencies summed: ' + summedMs + ' ms)');
+      Log.trace('group_done', { id: requestInfo ? requestInfo.id : undefined, pairs: pairs.length,
+                                sequential: sequential, ms: elapsed, summedMs: summedMs });
+      callback({ connection: merged });
+    }
+
+    if (pairs.length === 0) {
+      remaining = 1;
+      finished();
+      return;
+    }
+
+    function fetchPair(i) {
+      var pair = pairs[i];
+      var label = fromGroup && toGroup ? shortName(pair.from) + '>' + shortName(pair.to) :
+                  shortName(fromGroup ? pair.from : pair.to);
+      var pairStart = Date.now();
+
+      Liveboard.fetchConnections(pair.from, pair.to, function(response) {
+        summedMs += Date.now() - pairStart;
+        results[i] = (response.connection || []).map(function(conn) {
+          conn.fromId = pair.from;
+          conn.toId = pair.to;
+          conn.stationLabel = label.substring(0, 15);
+          return conn;
+        });
+        finished();
+      }, function(error) {
+        summedMs += Date.now() - pairStart;
+        Log.warn('Group member ' + pair.from + ' -> ' + pair.to + ' failed: ' + error);
+        lastError = error;
+        finished();
+      }, requestInfo);
+    }
+
+    if (sequential) {
+      fetchPair(0);
+    } else {
+      pairs.forEach(function(pair, i) {
+        fetchPair(i);
+      });
+    }
+  }
+
+module.exports = {
+  merge: merge,
+  fetchConnections: fetchConnections
+};
@@ -0,0 +1,107 @@
+// Origin station from the phone's location for NMBS Pebble App
+//
+// At launch the phone's position picks the route's origin before the
+// favorites go to the watch, so the first REQUEST_DATA is already for the
+// station the user is at. The nearest favorite (any member of a station
+// group counts) wins when it is within LOCATION_FAVORITE_KM; otherwise the
+// nearest of all cached stations within LOCATION_STATION_KM, found through
+// the grid index in 01-station-grid.js. Without a fix in time the watch
+// keeps its usual origin.
+var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
+var Storage = require('./01-storage.js');
+var StationGrid = require('./01-station-grid.js');
+
+// Grid built for the current station cache (rebuilt when it changes)
+var grid = null;
+var gridSource = null;
+
+function getGrid() {
+    var stations = Storage.getStationCache();
+    if (gridSource !== stations) {
+      grid = StationGrid.build(stations);
+      gridSource = stations;
+      Log.debug('Station grid: ' + grid.size + ' located stations');
+    }
+    return grid;
+  }
+
+  // Nearest favorite within LOCATION_FAVORITE_KM: { index, km }, or null
+function nearestFavorite(favoriteIds, lat, lon) {
+    var best = null;
+    favoriteIds.forEach(function(id, index) {
+      var group = Storage.getStationGroup(id);
+      (group ? group.members : [id]).forEach(function(memberId) {
+        var station = Storage.getStationById(memberId);
+        if (!station || typeof station.lat !== 'number' || isNaN(station.lat)) {
+          return;
+        }
+        var km = StationGrid.distanceKm(lat, lon, station.lat, station.lon);
+        if (km <= Constants.CONFIG.LOCATION_FAVORITE_KM && (!best || km < best.km)) {
+          best = { index: index, km: km };
+        }
+      });
+    });
+    return best;
+  }
+
+  // Origin for a position: { index } of a favorite, { station } of another
+  // nearby station, or null
+function originAt(favoriteIds, lat, lon) {
+    var favorite = nearestFavorite(favoriteIds, lat, lon);
+    if (favorite) {
+      Log.info('Nearest favorite: ' + favoriteIds[favorite.index] + ' (' +
+               favorite.km.toFixed(2) + ' km)');
+      return { index: favorite.index };
+    }
+
+    var start = Date.now();
+    var nearby = StationGrid.nearest(getGrid(), lat, lon, Constants.CONFIG.LOCATION_STATION_KM);
+    Log.debug('Nearest station lookup took ' + (Date.now() - start) + ' ms');
+    if (nearby) {
+      Log.info('Nearest station: ' + nearby.station.name + ' (' + nearby.km.toFixed(2) + ' km)');
+      return { station: nearby.station };
+    }
+    return null;
+  }
+
+  // Find the origin for the phone's current position; callback(origin) runs
+  // once, with null if location is off, unavailable or too slow
+function findOrigin(favoriteIds, callback) {
+    if (!Constants.CONFIG.LOCATION_ORIGIN || typeof navigator === 'undefined' ||
+        !navigator.geolocation) {
+      callback(null);
+      return;
+    }
+
+    var done = false;
+    function finish(origin) {
+      if (!done) {
+        done = true;
+        clearTimeout(timer);
+        callback(origin);
+      }
+    }
+
+    // getCurrentPosition's own timeout doesn't cover a pending permission prompt
+    var timer = setTimeout(function() {
+      Log.info('No location fix in time, keeping the usual origin');
+      finish(null);
+    }, Constants.CONFIG.LOCATION_TIMEOUT_MS);
+
+    navigator.geolocation.getCurrentPosition(function(position) {
+      finish(originAt(favoriteIds, position.coords.latitude, position.coords.longitude));
+    }, function(error) {
+      Log.info('Location unavailable: ' + error.message);
+      finish(null);
+    }, {
+      enableHighAccuracy: false,
+      timeout: Constants.CONFIG.LOCATION_TIMEOUT_MS,
+      maximumAge: Constants.CONFIG.LOCATION_MAX_AGE_MS
+    });
+  }
+
+module.exports = {
+  findOrigin: findOrigin,
+  originAt: originAt
+};
@@ -1,60 +1,126 @@
 // AppMessage protocol handler for NMBS Pebble App
 var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
 var DataProcessor = require('./03-data-processor.js');
 var Storage = require('./01-storage.js');
 var API = require('./02-api.js');
+var LatencyReport = require('./01-latency-report.js');
+var Energy = require('./01-energy.js');
+var Timetable = require('./02-timetable.js');
+var Snapshot = require('./03-snapshot.js');
+var StationGroups = require('./03-station-groups.js');
+var JourneyTracker = require('./03-journey-tracker.js');
+var ScheduleTable = require('./01-schedule-table.js');
+var StationDict = require('./01-station-dict.js');
+var Dashboard = require('./03-dashboard.js');
+var LinkQuality = require('./01-link-quality.js');
+var Disruptions = require('./03-disruptions.js');
 
 // Request ID tracking (for race condition prevention)
 var currentRequestId = 0;  // Last received request ID
 var currentDetailRequestId = 0;  // Last received detail request ID
+var currentBackground = false;  // Whether the last train data request came from the worker
+
+// Legs of the journey shown in the watch's detail window, and their
+// intermediate stops once fetched (per leg index)
+var detailLegs = [];
+var detailLegStops = [];
+// Detail request whose window the watch already closed (don't track it)
+var closedDetailRequestId = -1;
+
+// Leg fields sent in LEG_UPDATE messages
+var LEG_UPDATE_KEYS = {
+  departDelay: 'LEG_DEPART_DELAY',
+  arriveDelay: 'LEG_ARRIVE_DELAY',
+  departPlatform: 'LEG_DEPART_PLATFORM',
+  arrivePlatform: 'LEG_ARRIVE_PLATFORM',
+  departPlatformChanged: 'LEG_DEPART_PLATFORM_CHANGED',
+  arrivePlatformChanged: 'LEG_ARRIVE_PLATFORM_CHANGED'
+};
 
-  // Process train data from API response and send to watch
-function processTrainData(response) {
-    console.log('Processing response: ' + JSON.stringify(response).substring(0, 200));
+// Bumped for every departure list sent, empty ones included, so a newer
+// list (e.g. live data replacing an offline answer) stops the previous one
+// mid-stream
+var sendGeneration = 0;
+
+  // Send an empty departure list
+function sendEmptyList() {
+    ++sendGeneration;
+    Pebble.sendAppMessage({
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SEND_COUNT,
+      'DATA_COUNT': 0,
+      'REQUEST_ID': currentRequestId
+    });
+  }
+
+  // Process train data from API response and send to watch; offline answers
+  // (from the timetable) are flagged so the watch labels them as scheduled
+function processTrainData(response, offline) {
+    Log.debug('Processing response: ' +
+                (response.connection ? response.connection.length : 0) + ' connections');
 
     if (!response.connection || response.connection.length === 0) {
-      console.log('No connections found');
-      // Send count of 0
-      Pebble.sendAppMessage({
-        'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SEND_COUNT,
-        'DATA_COUNT': 0,
-        'REQUEST_ID': currentRequestId
-      });
+      Log.info('No connections found');
+      sendEmptyList();
       return;
     }
 
     var connections = response.connection;
     var count = Math.min(connections.length, Constants.CONFIG.MAX_DEPARTURES);
+    var generation = ++sendGeneration;
 
-    console.log('Found ' + count + ' connections');
-    console.log('First connection: ' + JSON.stringify(connections[0]));
+    Log.debug('Found ' + count + ' connections');
+    Log.debug(function() { return 'First connection: ' + JSON.stringify(connections[0]); });
 
     // Send count first (with request ID)
-    Pebble.sendAppMessage({
+    LinkQuality.send({
       'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SEND_COUNT,
       'DATA_COUNT': count,
-      'REQUEST_ID': currentRequestId
+      'REQUEST_ID': currentRequestId,
+      'IS_OFFLINE': offline ? 1 : 0
     }, function () {
-      console.log('Count sent: ' + count + ' [ID ' + currentRequestId + ']');
-      // Start sending departures
-      sendDepartures(connections, 0);
+      Log.debug('Count sent: ' + count + ' [ID ' + currentRequestId + ']');
+      Log.trace('count_sent', { id: currentRequestId });
+      // Background refreshes always get full rows: the glance needs the
+      // destinations and the worker exits as soon as the list is complete
+      if (LinkQuality.isWeak() && !currentBackground) {
+        Log.info('Weak link (' + LinkQuality.describe() + '), sending compact departures');
+        sendCompactRows(connections.slice(0, count), 0, 0, generation);
+      } else {
+        sendDepartures(connections, 0, generation);
+      }
     }, function (e) {
-      console.log('Failed to send count: ' + e.error.message);
+      Log.warn('Failed to send count: ' + e.error.message);
     });
   }
 
-  // Send departures one at a time (recursive with callbacks)
-function sendDepartures(connections, index) {
-    if (index >= connections.length || index >= Constants.CONFIG.MAX_DEPARTURES) {
-      console.log('All departures sent');
-      return;
+  // A departure list is complete on the watch: bring its disruption alerts
+  // up to date (not for background refreshes, the worker exits right away)
+function listSent(connections) {
+    if (!currentBackground) {
+      Disruptions.update(connections, currentRequestId);
     }
+  }
 
-    var conn = connections[index];
-    var departure = DataProcessor.processConnection(conn, index);
+  // Tell the watch iRail is throttling its request: retryAt is when the
+  // phone asks again (ms), or 0 when it gave up
+function sendThrottled(requestId, retryAt) {
+    var seconds = retryAt ? Math.max(1, Math.ceil((retryAt - Date.now()) / 1000)) : 0;
+    Pebble.sendAppMessage({
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.THROTTLED,
+      'RETRY_AFTER': seconds,
+      'REQUEST_ID': requestId
+    }, function() {
+      Log.debug('Throttle notice sent (' + seconds + ' s) [ID ' + requestId + ']');
+    }, function(e) {
+      Log.warn('Failed to send throttle notice: ' + e.error.message);
+    });
+  }
 
-    // Build message
-    var message = {
+  // Full SEND_DEPARTURE message for one connection
+function departureMessage(conn, index) {
+    var departure = DataProcessor.processConnection(conn, index);
+    return {
       'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SEND_DEPARTURE,
       'DEPARTURE_INDEX': departure.index,
       'DESTINATION': departure.destination,
@@ -68,26 +134,142 @@ function sendDepartures(connections, index) {
       'ARRIVE_DELAY': departure.arriveDelay,
       'IS_DIRECT': departure.isDirect,
       'PLATFORM_CHANGED': departure.platformChanged,
+      'HAS_ALERT': departure.hasAlert || Disruptions.affectsConnection(conn),
+      'STATION_LABEL': departure.stationLabel,
       'REQUEST_ID': currentRequestId
     };
+  }
+
+  // Send departures one at a time (recursive with callbacks)
+function sendDepartures(connections, index, generation) {
+    if (index >= connections.length || index >= Constants.CONFIG.MAX_DEPARTURES) {
+      Log.debug('All departures sent');
+      if (generation === sendGeneration) {
+        listSent(connections.slice(0, Constants.CONFIG.MAX_DEPARTURES));
+      }
+      return;
+    }
+    if (generation !== sendGeneration) {
+      Log.debug('Departure list superseded, stopping at ' + index);
+      return;
+    }
+
+    var message = departureMessage(connections[index], index);
 
-    console.log('Sending departure ' + index + ': ' + departure.destination + ' [ID ' + currentRequestId + ']');
+    Log.debug(function() {
+      return 'Sending departure ' + index + ': ' + message.DESTINATION + ' [ID ' + currentRequestId + ']';
+    });
 
     // Send message with callbacks
-    Pebble.sendAppMessage(message, function () {
+    LinkQuality.send(message, function () {
       // Success - send next departure
-      console.log('Departure ' + index + ' sent successfully');
-      sendDepartures(connections, index + 1);
+      Log.debug(function() { return 'Departure ' + index + ' sent successfully'; });
+      Log.trace('departure_sent', { id: currentRequestId, index: index });
+      sendDepartures(connections, index + 1, generation);
     }, function (e) {
-      console.log('Failed to send departure ' + index + ': ' + e.error.message);
+      Log.warn('Failed to send departure ' + index + ': ' + e.error.message);
       // Try next one anyway
-      sendDepartures(connections, index + 1);
+      sendDepartures(connections, index + 1, generation);
+    });
+  }
+
+  // Weak link: send the compact rows (no destination or group member label)
+  // of all departures first, several per message, so the list shows up
+  // quickly. The first message is kept small; later ones follow
+  // LinkQuality.batchSize(). A failed batch is resent up to
+  // LINK_MAX_RETRIES times, then skipped.
+function sendCompactRows(connections, index, attempt, generation) {
+    if (index >= connections.length) {
+      sendDepartureDetails(connections, 0, 0, generation);
+      return;
+    }
+    if (generation !== sendGeneration) {
+      Log.debug('Departure list superseded, stopping at compact row ' + index);
+      return;
+    }
+
+    var size = LinkQuality.batchSize();
+    if (index === 0) {
+      size = Math.min(size, Constants.CONFIG.LINK_FIRST_BATCH);
+    }
+    var end = Math.min(index + size, connections.length);
+    var bytes = [];
+    for (var i = index; i < end; i++) {
+      bytes.push.apply(bytes, DataProcessor.encodeCompactDeparture(connections[i],
+                                                                  Disruptions.affectsConnection(connections[i])));
+    }
+
+    LinkQuality.send({
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SEND_DEPARTURE,
+      'DEPARTURE_INDEX': index,
+      'DEPARTURE_ROWS': bytes,
+      'REQUEST_ID': currentRequestId
+    }, function () {
+      Log.debug(function() {
+        return 'Compact rows ' + index + '-' + (end - 1) + ' sent (' + bytes.length + ' B)';
+      });
+      Log.trace('departure_sent', { id: currentRequestId, index: end - 1 });
+      sendCompactRows(connections, end, 0, generation);
+    }, function (e) {
+      if (attempt < Constants.CONFIG.LINK_MAX_RETRIES) {
+        Log.warn('Failed to send compact rows ' + index + '-' + (end - 1) + ', retrying: ' + e.error.message);
+        sendCompactRows(connections, index, attempt + 1, generation);
+      } else {
+        Log.warn('Giving up on compact rows ' + index + '-' + (end - 1) + ': ' + e.error.message);
+        sendCompactRows(connections, end, 0, generation);
+      }
+    });
+  }
+
+  // Weak link, second part: destination and group member label per row. A
+  // failed row is resent up to LINK_MAX_RETRIES times, then once in full
+  // (SEND_DEPARTURE), so it doesn't stay a skeleton until the next refresh.
+function sendDepartureDetails(connections, index, attempt, generation) {
+    if (index >= connections.length) {
+      Log.debug('All departure details sent');
+      if (generation === sendGeneration) {
+        listSent(connections);
+      }
+      return;
+    }
+    if (generation !== sendGeneration) {
+      Log.debug('Departure list superseded, stopping at details ' + index);
+      return;
+    }
+
+    var departure = DataProcessor.processConnection(connections[index], index);
+    LinkQuality.send({
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.DEPARTURE_DETAILS,
+      'DEPARTURE_INDEX': index,
+      'DESTINATION': departure.destination,
+      'STATION_LABEL': departure.stationLabel,
+      'REQUEST_ID': currentRequestId
+    }, function () {
+      Log.debug(function() { return 'Departure details ' + index + ' sent'; });
+      sendDepartureDetails(connections, index + 1, 0, generation);
+    }, function (e) {
+      // A superseded list stops at the next call (the row would carry the
+      // new request ID)
+      if (attempt < Constants.CONFIG.LINK_MAX_RETRIES || generation !== sendGeneration) {
+        Log.warn('Failed to send departure details ' + index + ', retrying: ' + e.error.message);
+        sendDepartureDetails(connections, index, attempt + 1, generation);
+        return;
+      }
+      Log.warn('Giving up on departure details ' + index + ', resending the row: ' + e.error.message);
+      LinkQuality.send(departureMessage(connections[index], index), function () {
+        sendDepartureDetails(connections, index + 1, 0, generation);
+      }, function (e) {
+        Log.warn('Failed to resend departure ' + index + ': ' + e.error.message);
+        sendDepartureDetails(connections, index + 1, 0, generation);
+      });
     });
   }
 
   // Send full connection details to watch (leg-by-leg)
 function sendConnectionDetail(conn, departureIndex) {
     var legs = DataProcessor.processConnectionDetail(conn);
+    detailLegs = legs;
+    detailLegStops = [];
 
     // Send leg count first (with request ID)
     Pebble.sendAppMessage({
@@ -96,18 +278,21 @@ function sendConnectionDetail(conn, departureIndex) {
       'LEG_COUNT': legs.length,
       'REQUEST_ID': currentDetailRequestId
     }, function () {
-      console.log('Leg count sent: ' + legs.length + ' [ID ' + currentDetailRequestId + ']');
+      Log.debug('Leg count sent: ' + legs.length + ' [ID ' + currentDetailRequestId + ']');
       // Start sending individual legs
       sendLegs(legs, 0);
     }, function (e) {
-      console.log('Failed to send leg count: ' + e.error.message);
+      Log.warn('Failed to send leg count: ' + e.error.message);
     });
   }
 
   // Send legs one at a time (recursive with callbacks)
 function sendLegs(legs, index) {
     if (index >= legs.length) {
-      console.log('All legs sent');
+      Log.debug('All legs sent');
+      if (closedDetailRequestId !== currentDetailRequestId) {
+        JourneyTracker.start(legs, sendLegUpdate.bind(null, currentDetailRequestId));
+      }
       return;
     }
 
@@ -132,39 +317,178 @@ function sendLegs(legs, index) {
       'REQUEST_ID': currentDetailRequestId
     };
 
-    console.log('Sending leg ' + index + ': ' + leg.departStation + ' → ' + leg.arriveStation + ' [ID ' + currentDetailRequestId + ']');
+    Log.debug(function() {
+      return 'Sending leg ' + index + ': ' + leg.departStation + ' → ' + leg.arriveStation +
+             ' [ID ' + currentDetailRequestId + ']';
+    });
 
     Pebble.sendAppMessage(message, function () {
       // Success - send next leg
       sendLegs(legs, index + 1);
     }, function (e) {
-      console.log('Failed to send leg ' + index + ': ' + e.error.message);
+      Log.warn('Failed to send leg ' + index + ': ' + e.error.message);
       // Try next one anyway
       sendLegs(legs, index + 1);
     });
   }
 
-  // Send favorite stations to watch
-function sendStationsToWatch(stationIds) {
-    console.log('Sending ' + stationIds.length + ' stations to watch');
+  // Send the fields of a tracked leg that changed since it was sent
+function sendLegUpdate(requestId, legIndex, changes) {
+    var message = {
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.LEG_UPDATE,
+      'LEG_INDEX': legIndex,
+      'REQUEST_ID': requestId
+    };
+    Object.keys(changes).forEach(function(field) {
+      var value = changes[field];
+      message[LEG_UPDATE_KEYS[field]] = typeof value === 'string' ? value.substring(0, 3) : value;
+    });
+
+    Pebble.sendAppMessage(message, function () {
+      Log.debug(function() { return 'Leg ' + legIndex + ' update sent [ID ' + requestId + ']'; });
+    }, function (e) {
+      Log.warn('Failed to send leg ' + legIndex + ' update: ' + e.error.message);
+    });
+  }
+
+  // Send one page of a leg's intermediate stops, fetching the leg's vehicle
+  // on the first request
+function sendLegStops(legIndex, firstStop, requestId) {
+    var leg = detailLegs[legIndex];
+    if (!leg) {
+      sendStopsUnavailable(legIndex, requestId);
+      return;
+    }
+    if (detailLegStops[legIndex]) {
+      var end = Math.min(firstStop + Constants.CONFIG.STOPS_PAGE_SIZE, detailLegStops[legIndex].length);
+      sendStops(legIndex, detailLegStops[legIndex], firstStop, end, requestId);
+      return;
+    }
+
+    API.fetchVehicle(leg.vehicleId, leg.departTimestamp, function(stops) {
+      var legStops = DataProcessor.processLegStops(stops, leg);
+      if (!legStops) {
+        Log.warn('Leg ' + legIndex + ' not found in stops of ' + leg.vehicleId);
+        sendStopsUnavailable(legIndex, requestId);
+        return;
+      }
+      if (requestId === currentDetailRequestId) {
+        detailLegStops[legIndex] = legStops;
+      }
+      sendLegStops(legIndex, firstStop, requestId);
+    }, function(error) {
+      Log.warn('Failed to fetch stops of ' + leg.vehicleId + ': ' + error);
+      sendStopsUnavailable(legIndex, requestId);
+    });
+  }
+
+  // Send stops [index, end) one at a time; a page past the end only
+  // updates the watch's stop count
+function sendStops(legIndex, stops, index, end, requestId) {
+    if (requestId !== currentDetailRequestId) {
+      Log.debug('Detail request ' + requestId + ' superseded, stopping stops');
+      return;
+    }
+    var message = {
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SEND_STOP,
+      'LEG_INDEX': legIndex,
+      'STOP_INDEX': index,
+      'LEG_STOP_COUNT': stops.length,
+      'REQUEST_ID': requestId
+    };
+    if (index < stops.length) {
+      message.STOP_NAME = stops[index].name.substring(0, 23);
+      message.STOP_TIME = stops[index].time.substring(0, 5);
+      message.STOP_DELAY = stops[index].delay;
+    }
+
+    Pebble.sendAppMessage(message, function () {
+      if (index + 1 < end) {
+        sendStops(legIndex, stops, index + 1, end, requestId);
+      }
+    }, function (e) {
+      Log.warn('Failed to send stop ' + index + ' of leg ' + legIndex + ': ' + e.error.message);
+    });
+  }
 
-    // Send count first
+function sendStopsUnavailable(legIndex, requestId) {
     Pebble.sendAppMessage({
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SEND_STOP,
+      'LEG_INDEX': legIndex,
+      'REQUEST_ID': requestId
+    });
+  }
+
+  // Send one block of the station dictionary (or its index) to the watch;
+  // without a station cache it is fetched first, the watch times out if
+  // that fails too
+function sendStationDictBlock(block) {
+    var stations = Storage.getStationCache();
+    if (stations.length === 0) {
+      Log.info('No cached stations for the station dictionary, fetching');
+      API.fetchStations(function() {
+        sendStationDictBlock(block);
+      });
+      return;
+    }
+
+    var dict = StationDict.get(stations);
+    var data = (block === StationDict.INDEX_BLOCK) ? dict.index : dict.blocks[block];
+    var message = {
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.STATION_DICT,
+      'STATION_DICT_BLOCK': block
+    };
+    if (data) {
+      message.STATION_DICT_DATA = data;
+    }
+
+    Pebble.sendAppMessage(message, function() {
+      Log.debug(function() { return 'Station dictionary block ' + block + ' sent'; });
+    }, function(e) {
+      Log.warn('Failed to send station dictionary block ' + block + ': ' + e.error.message);
+    });
+  }
+
+  // Send favorite stations to watch; origin (optional, see
+  // 03-station-locator.js) replaces the watch's origin before it requests data
+function sendStationsToWatch(stationIds, origin) {
+    Log.info('Sending ' + stationIds.length + ' stations to watch');
+
+    // The schedule table and dashboard routes go first, so the watch picks
+    // the active route (or shows the dashboard) as soon as the last station
+    // arrives
+    sendScheduleTable(stationIds, function() {
+      Dashboard.sendRoutes(stationIds, function() {
+        sendStationCount(stationIds, origin);
+      });
+    });
+  }
+
+function sendStationCount(stationIds, origin) {
+    var message = {
       'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SEND_STATION_COUNT,
       'CONFIG_STATION_COUNT': stationIds.length
-    }, function() {
-      console.log('Station count sent');
+    };
+    if (origin && origin.station) {
+      message.ORIGIN_STATION_NAME = origin.station.name.substring(0, 63);
+      message.ORIGIN_STATION_ID = origin.station.id;
+    } else if (origin) {
+      message.ORIGIN_STATION_INDEX = origin.index;
+    }
+
+    Pebble.sendAppMessage(message, function() {
+      Log.info('Station count sent');
       // Start sending individual stations
       sendStationSequential(stationIds, 0);
     }, function(e) {
-      console.log('Failed to send station count: ' + e.error.message);
+      Log.warn('Failed to send station count: ' + e.error.message);
     });
   }
 
   // Send stations one at a time (sequential with callbacks)
 function sendStationSequential(stationIds, index) {
     if (index >= stationIds.length) {
-      console.log('All stations sent to watch');
+      Log.info('All stations sent to watch');
       return;
     }
 
@@ -172,7 +496,7 @@ function sendStationSequential(stationIds, index) {
     var station = Storage.getStationById(stationId);
 
     if (!station) {
-      console.log('Station not found in cache: ' + stationId);
+      Log.warn('Station not found in cache: ' + stationId);
       // Skip and continue
       sendStationSequential(stationIds, index + 1);
       return;
@@ -185,66 +509,67 @@ function sendStationSequential(stationIds, index) {
       'CONFIG_STATION_IRAIL_ID': station.id.substring(0, 31)
     };
 
-    console.log('Sending station ' + index + ': ' + station.name);
+    Log.debug(function() { return 'Sending station ' + index + ': ' + station.name; });
 
     Pebble.sendAppMessage(message, function() {
       // Success - send next station
       sendStationSequential(stationIds, index + 1);
     }, function(e) {
-      console.log('Failed to send station ' + index + ': ' + e.error.message);
+      Log.warn('Failed to send station ' + index + ': ' + e.error.message);
       // Try next one anyway
       sendStationSequential(stationIds, index + 1);
     });
   }
 
-  // Set active route based on schedule
-function setActiveRoute(stationIds, fromId, toId) {
-    // Find indices in favorite stations array
-    var fromIndex = stationIds.indexOf(fromId);
-    var toIndex = stationIds.indexOf(toId);
-
-    if (fromIndex === -1 || toIndex === -1) {
-      console.log('Active route stations not in favorites');
-      return;
-    }
-
-    console.log('Setting active route: index ' + fromIndex + ' -> ' + toIndex);
+  // Compile the smart schedules against stationIds and send them to the
+  // watch, which picks the active route itself (see src/c/schedule.h)
+function sendScheduleTable(stationIds, callback) {
+    var entries = ScheduleTable.compile(Storage.getSmartSchedules(), stationIds);
+    Log.info('Sending schedule table with ' + entries.length + ' intervals');
 
     Pebble.sendAppMessage({
-      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SET_ACTIVE_ROUTE,
-      'CONFIG_FROM_INDEX': fromIndex,
-      'CONFIG_TO_INDEX': toIndex
+      'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SCHEDULE_TABLE,
+      'SCHEDULE_DATA': ScheduleTable.encode(entries)
     }, function() {
-      console.log('Active route set successfully');
+      Log.debug('Schedule table sent');
+      if (callback) {
+        callback();
+      }
     }, function(e) {
-      console.log('Failed to set active route: ' + e.error.message);
+      Log.warn('Failed to send schedule table: ' + e.error.message);
+      if (callback) {
+        callback();
+      }
     });
   }
 
   // Handle incoming message from watch
 function handleAppMessage(e) {
-    console.log('Message from watch: ' + JSON.stringify(e.payload));
+    Log.debug(function() { return 'Message from watch: ' + JSON.stringify(e.payload); });
 
     var messageType = e.payload.MESSAGE_TYPE;
 
     if (messageType === Constants.MESSAGE_TYPES.REQUEST_DATA) {
       // Extract request ID (for race condition prevention)
       currentRequestId = e.payload.REQUEST_ID || 0;
-      console.log('Train data request [ID ' + currentRequestId + ']');
+      var isBackground = !!e.payload.IS_BACKGROUND;
+      currentBackground = isBackground;
+      Log.debug('Train data request [ID ' + currentRequestId + ']');
+      Log.trace('js_receive', { id: currentRequestId });
 
       // Check if using new iRail ID format or old name format
       var fromId = e.payload.FROM_STATION_ID;
       var toId = e.payload.TO_STATION_ID;
 
       if (fromId && toId) {
-        console.log('Data requested (by ID): ' + fromId + ' -> ' + toId);
+        Log.debug('Data requested (by ID): ' + fromId + ' -> ' + toId);
         Storage.setCurrentFromStation(fromId);
         Storage.setCurrentToStation(toId);
       } else {
         // Fallback to old format (station names) - convert to IDs
         var fromStation = e.payload.FROM_STATION;
         var toStation = e.payload.TO_STATION;
-        console.log('Data requested (by name): ' + fromStation + ' -> ' + toStation);
+        Log.debug('Data requested (by name): ' + fromStation + ' -> ' + toStation);
         fromId = Constants.STATION_IDS[fromStation];
         toId = Constants.STATION_IDS[toStation];
         // Always store IDs, not names
@@ -252,43 +577,114 @@ function handleAppMessage(e) {
         Storage.setCurrentToStation(toId);
       }
 
-      // Send acknowledgment immediately (before debounce)
-      Pebble.sendAppMessage({
+      // Send acknowledgment immediately (before debounce); its round trip is
+      // the first link sample for this list
+      LinkQuality.send({
         'MESSAGE_TYPE': Constants.MESSAGE_TYPES.REQUEST_ACK,
         'REQUEST_ID': currentRequestId
       }, function() {
-        console.log('Request acknowledged [ID ' + currentRequestId + ']');
+        Log.debug('Request acknowledged [ID ' + currentRequestId + ']');
       }, function(e) {
-        console.log('Failed to send acknowledgment: ' + e.error.message);
+        Log.warn('Failed to send acknowledgment: ' + e.error.message);
       });
 
       // Debounce the API request
       API.debounce(function() {
-        console.log('Executing debounced request [ID ' + currentRequestId + ']');
-        API.fetchConnections(fromId, toId, processTrainData, function(error) {
+        Log.debug('Executing debounced request [ID ' + currentRequestId + ']');
+        Log.trace('debounce_fire', { id: currentRequestId });
+
+        // Answer foreground requests from the offline timetable right away;
+        // the live iRail response (with realtime delays) replaces it when it
+        // arrives. Background refreshes only use it as a fallback.
+        var offline = Timetable.findConnections(fromId, toId, Constants.CONFIG.MAX_DEPARTURES);
+        if (offline && !isBackground) {
+          Log.debug('Sending ' + offline.connection.length + ' offline departures');
+          Log.trace('offline_answer', { id: currentRequestId });
+          processTrainData(offline, true);
+        }
+
+        // Member and fan-out fetches can each be held back; tell the watch
+        // once per new wait, unless it already has the offline answer
+        var requestId = currentRequestId;
+        var notifiedRetryAt = 0;
+        function onThrottled(retryAt) {
+          if (retryAt > notifiedRetryAt && !(offline && !isBackground) && requestId === currentRequestId) {
+            notifiedRetryAt = retryAt;
+            sendThrottled(requestId, retryAt);
+          }
+        }
+
+        StationGroups.fetchConnections(fromId, toId, function(response) {
+          processTrainData(response);
+          // Keep the watch's offline snapshots fresh while the phone is online
+          Snapshot.maybeRefresh(fromId, toId);
+        }, function(error) {
+          if (offline) {
+            Log.info('Live data unavailable (' + error + '), using offline timetable');
+            if (isBackground) {
+              processTrainData(offline, true);
+            }
+            return;
+          }
+
+          if (error === 'Throttled') {
+            sendThrottled(requestId, 0);
+            return;
+          }
+
           // Send empty result on error
-          Pebble.sendAppMessage({
-            'MESSAGE_TYPE': Constants.MESSAGE_TYPES.SEND_COUNT,
-            'DATA_COUNT': 0,
-            'REQUEST_ID': currentRequestId
-          });
-        });
+          sendEmptyList();
+        }, { id: currentRequestId, background: isBackground, onThrottled: onThrottled });
       }, Constants.CONFIG.DEBOUNCE_DELAY);
 
     } else if (messageType === Constants.MESSAGE_TYPES.REQUEST_DETAILS) {
       // Extract request ID for detail request
       currentDetailRequestId = e.payload.REQUEST_ID || 0;
+      JourneyTracker.stop();
       var departureIndex = e.payload.DEPARTURE_INDEX;
-      console.log('Details requested [ID ' + currentDetailRequestId + '] for departure ' + departureIndex);
+      Log.debug('Details requested [ID ' + currentDetailRequestId + '] for departure ' + departureIndex);
 
       API.fetchConnectionDetails(departureIndex, sendConnectionDetail, function(error) {
-        console.log('Failed to fetch connection details: ' + error);
+        Log.warn('Failed to fetch connection details: ' + error);
       });
+
+    } else if (messageType === Constants.MESSAGE_TYPES.REQUEST_STOPS) {
+      // Detail window scrolled to stops it doesn't have yet
+      var stopsRequestId = e.payload.REQUEST_ID || 0;
+      if (stopsRequestId !== currentDetailRequestId) {
+        Log.debug('Ignoring stops request for old detail [ID ' + stopsRequestId + ']');
+        return;
+      }
+      sendLegStops(e.payload.LEG_INDEX || 0, e.payload.STOP_INDEX || 0, stopsRequestId);
+
+    } else if (messageType === Constants.MESSAGE_TYPES.STOP_TRACKING) {
+      // Detail window closed on the watch
+      closedDetailRequestId = e.payload.REQUEST_ID || 0;
+      if (closedDetailRequestId === currentDetailRequestId) {
+        Log.debug('Detail window closed, tracking stopped');
+        JourneyTracker.stop();
+      }
+
+    } else if (messageType === Constants.MESSAGE_TYPES.REQUEST_DASHBOARD) {
+      // All dashboard routes, answered one message per route
+      Dashboard.handleRequest(e.payload);
+
+    } else if (messageType === Constants.MESSAGE_TYPES.REQUEST_STATION_DICT) {
+      // Station search on the watch walked into a block it doesn't have
+      sendStationDictBlock(e.payload.STATION_DICT_BLOCK || 0);
+
+    } else if (messageType === Constants.MESSAGE_TYPES.TRACE_REPORT) {
+      // Watch-side stage timings for a completed data request
+      LatencyReport.addWatchReport(e.payload.REQUEST_ID || 0, e.payload.TRACE_DATA);
+
+    } else if (messageType === Constants.MESSAGE_TYPES.ENERGY_REPORT) {
+      // Closed hour of watch-side energy counters
+      Energy.addWatchReport(e.payload.ENERGY_HOUR, e.payload.ENERGY_DATA);
     }
   }
 
 module.exports = {
   handleAppMessage: handleAppMessage,
   sendStationsToWatch: sendStationsToWatch,
-  setActiveRoute: setActiveRoute
+  sendScheduleTable: sendScheduleTable
 };
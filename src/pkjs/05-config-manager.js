@@ -1,81 +1,76 @@
 // Configuration management for NMBS Pebble App
 var Constants = require('./00-constants.js');
+var Log = require('./00-log.js');
 var Storage = require('./01-storage.js');
 var MessageHandler = require('./04-message-handler.js');
+var StationLocator = require('./03-station-locator.js');
 var API = require('./02-api.js');
+var Timetable = require('./02-timetable.js');
+var ScheduleTable = require('./01-schedule-table.js');
+var Dashboard = require('./03-dashboard.js');
 
-// Evaluate smart schedules and return active route (if any)
+// Evaluate smart schedules and return active route (if any). The watch picks
+// the route itself from the same compiled table; this is for logging.
 function evaluateSchedules() {
     try {
-      var schedules = Storage.getSmartSchedules();
-      if (!schedules) {
-        console.log('No smart schedules configured');
+      var stationIds = Storage.getFavoriteStations() || [];
+      var entries = ScheduleTable.compile(Storage.getSmartSchedules(), stationIds);
+      var entry = ScheduleTable.lookup(entries, ScheduleTable.minuteOfWeek(new Date()));
+      if (!entry) {
+        Log.info('No matching schedule found');
         return null;
       }
-
-      var now = new Date();
-      var currentDay = now.getDay();  // 0=Sunday, 1=Monday, ..., 6=Saturday
-      var currentTime = ('0' + now.getHours()).slice(-2) + ':' + ('0' + now.getMinutes()).slice(-2);
-
-      console.log('Evaluating schedules for day=' + currentDay + ', time=' + currentTime);
-
-      for (var i = 0; i < schedules.length; i++) {
-        var schedule = schedules[i];
-
-        // Skip disabled schedules
-        if (!schedule.enabled) {
-          continue;
-        }
-
-        // Check if current day matches
-        var dayMatches = schedule.days.indexOf(currentDay) !== -1;
-
-        if (!dayMatches) {
-          continue;
-        }
-
-        // Check if current time is within range
-        if (currentTime >= schedule.startTime && currentTime <= schedule.endTime) {
-          console.log('Matched schedule: ' + schedule.id);
-          return {
-            fromId: schedule.fromId,
-            toId: schedule.toId
-          };
-        }
-      }
-
-      console.log('No matching schedule found');
-      return null;
+      return {
+        fromId: stationIds[entry.from],
+        toId: stationIds[entry.to]
+      };
     } catch (e) {
-      console.log('Error evaluating schedules: ' + e.message);
+      Log.error('Error evaluating schedules: ' + e.message);
       return null;
     }
   }
 
   // Handle configuration page open
 function handleShowConfiguration() {
-    console.log('Opening configuration page');
+    Log.info('Opening configuration page');
     Pebble.openURL(Constants.CONFIG.CONFIG_URL);
   }
 
   // Handle configuration page close
 function handleWebviewClosed(e) {
-    console.log('Configuration closed');
+    Log.info('Configuration closed');
 
     if (e && e.response) {
       try {
         var config = JSON.parse(decodeURIComponent(e.response));
-        console.log('Received config: ' + JSON.stringify(config));
+        Log.debug(function() { return 'Received config: ' + JSON.stringify(config); });
+
+        // Save smart schedules first: they are compiled for the watch
+        // together with the stations (see sendStationsToWatch)
+        if (config.smartSchedules) {
+          Storage.saveSmartSchedules(config.smartSchedules);
+          if (!config.favoriteStations || config.favoriteStations.length === 0) {
+            MessageHandler.sendScheduleTable(Storage.getFavoriteStations() || []);
+          }
+        }
+
+        // Dashboard routes are compiled the same way
+        if (config.dashboardRoutes) {
+          Storage.saveDashboardRoutes(config.dashboardRoutes);
+          if (!config.favoriteStations || config.favoriteStations.length === 0) {
+            Dashboard.sendRoutes(Storage.getFavoriteStations() || []);
+          }
+        }
 
         // Save language preference
         if (config.language) {
           Storage.saveLanguage(config.language);
-          console.log('Saved language preference: ' + config.language);
+          Log.info('Saved language preference: ' + config.language);
 
           // Config page and PebbleKit JS have separate localStorage!
           // Need to fetch fresh stations with new language
           API.fetchStations(function() {
-            console.log('Fetched stations with new language');
+            Log.info('Fetched stations with new language');
             // After stations are fetched, send them to watch if we have favorites
             if (config.favoriteStations && config.favoriteStations.length > 0) {
               MessageHandler.sendStationsToWatch(config.favoriteStations);
@@ -87,6 +82,9 @@ function handleWebviewClosed(e) {
         if (config.favoriteStations && config.favoriteStations.length > 0) {
           Storage.saveFavoriteStations(config.favoriteStations);
 
+          // Favorites decide which part of the offline timetable is kept
+          Timetable.refresh();
+
           // Send stations to watch (but only if language wasn't changed above)
           // If language was changed, we'll send after fetching new stations
           if (!config.language) {
@@ -94,28 +92,17 @@ function handleWebviewClosed(e) {
           }
         }
 
-        // Save smart schedules
-        if (config.smartSchedules) {
-          Storage.saveSmartSchedules(config.smartSchedules);
-
-          // Evaluate and set active route
-          var activeRoute = evaluateSchedules();
-          if (activeRoute) {
-            MessageHandler.setActiveRoute(config.favoriteStations, activeRoute.fromId, activeRoute.toId);
-          }
-        }
-
       } catch (e) {
-        console.log('Error parsing configuration: ' + e.message);
+        Log.error('Error parsing configuration: ' + e.message);
       }
     } else {
-      console.log('Configuration cancelled or no data received');
+      Log.info('Configuration cancelled or no data received');
     }
   }
 
   // Handle PebbleKit JS ready event
 function handleReady() {
-    console.log('PebbleKit JS ready!');
+    Log.info('PebbleKit JS ready!');
 
     // Load cached stations immediately (for offline use)
     Storage.loadCachedStations();
@@ -123,29 +110,32 @@ function handleReady() {
     // Fetch fresh station list in background
     API.fetchStations();
 
+    // Refresh the offline timetable if it is stale
+    Timetable.refresh();
+
     // Load persisted station selection and connection data
     Storage.loadPersistedData();
 
     // Load user configuration and send to watch
     var favoriteStations = Storage.getFavoriteStations();
     if (favoriteStations) {
-      console.log('Loading saved configuration with ' + favoriteStations.length + ' stations');
-      MessageHandler.sendStationsToWatch(favoriteStations);
+      Log.info('Loading saved configuration with ' + favoriteStations.length + ' stations');
+      // Start from the station the phone is at
+      StationLocator.findOrigin(favoriteStations, function(origin) {
+        MessageHandler.sendStationsToWatch(favoriteStations, origin);
+      });
 
-      // Evaluate schedules and set active route
+      // The watch picks the active route from the schedule table sent with them
       var activeRoute = evaluateSchedules();
       if (activeRoute) {
-        console.log('Found active schedule');
-        MessageHandler.setActiveRoute(favoriteStations, activeRoute.fromId, activeRoute.toId);
-      } else {
-        console.log('No active schedule, will use default route');
+        Log.info('Active schedule: ' + activeRoute.fromId + ' -> ' + activeRoute.toId);
       }
     } else {
-      console.log('No saved configuration, watch will use defaults');
+      Log.info('No saved configuration, watch will use defaults');
     }
 
     if (Storage.getCurrentFromStation() && Storage.getCurrentToStation()) {
-      console.log('Restored session: ' + Storage.getCurrentFromStation() + ' -> ' + Storage.getCurrentToStation());
+      Log.info('Restored session: ' + Storage.getCurrentFromStation() + ' -> ' + Storage.getCurrentToStation());
     }
   }
 
@@ -156,26 +146,43 @@ module.exports = {
 // Register event listeners at module level (where Pebble is available)
 Pebble.addEventListener('appmessage', MessageHandler.handleAppMessage);
 Pebble.addEventListener('showConfiguration', function() {
-  console.log('Opening configuration page');
+  Log.info('Opening configuration page');
   Pebble.openURL(Constants.CONFIG.CONFIG_URL);
 });
 Pebble.addEventListener('webviewclosed', function(e) {
-  console.log('Configuration closed');
+  Log.info('Configuration closed');
 
   if (e && e.response) {
     try {
       var config = JSON.parse(decodeURIComponent(e.response));
-      console.log('Received config: ' + JSON.stringify(config));
+      Log.debug(function() { return 'Received config: ' + JSON.stringify(config); });
+
+      // Save smart schedules first: they are compiled for the watch
+      // together with the stations (see sendStationsToWatch)
+      if (config.smartSchedules) {
+        Storage.saveSmartSchedules(config.smartSchedules);
+        if (!config.favoriteStations || config.favoriteStations.length === 0) {
+          MessageHandler.sendScheduleTable(Storage.getFavoriteStations() || []);
+        }
+      }
+
+      // Dashboard routes are compiled the same way
+      if (config.dashboardRoutes) {
+        Storage.saveDashboardRoutes(config.dashboardRoutes);
+        if (!config.favoriteStations || config.favoriteStations.length === 0) {
+          Dashboard.sendRoutes(Storage.getFavoriteStations() || []);
+        }
+      }
 
       // Save language preference
       if (config.language) {
         Storage.saveLanguage(config.language);
-        console.log('Saved language preference: ' + config.language);
+        Log.info('Saved language preference: ' + config.language);
 
         // Config page and PebbleKit JS have separate localStorage!
         // Need to fetch fresh stations with new language
         API.fetchStations(function() {
-          console.log('Fetched stations with new language');
+          Log.info('Fetched stations with new language');
           // After stations are fetched, send them to watch if we have favorites
           if (config.favoriteStations && config.favoriteStations.length > 0) {
             MessageHandler.sendStationsToWatch(config.favoriteStations);
@@ -187,6 +194,9 @@ Pebble.addEventListener('webviewclosed', function(e) {
       if (config.favoriteStations && config.favoriteStations.length > 0) {
         Storage.saveFavoriteStations(config.favoriteStations);
 
+        // Favorites decide which part of the offline timetable is kept
+        Timetable.refresh();
+
         // Send stations to watch (but only if language wasn't changed above)
         // If language was changed, we'll send after fetching new stations
         if (!config.language) {
@@ -194,26 +204,15 @@ Pebble.addEventListener('webviewclosed', function(e) {
         }
       }
 
-      // Save smart schedules
-      if (config.smartSchedules) {
-        Storage.saveSmartSchedules(config.smartSchedules);
-
-        // Evaluate and set active route
-        var activeRoute = evaluateSchedules();
-        if (activeRoute) {
-          MessageHandler.setActiveRoute(config.favoriteStations, activeRoute.fromId, activeRoute.toId);
-        }
-      }
-
     } catch (e) {
-      console.log('Error parsing configuration: ' + e.message);
+      Log.error('Error parsing configuration: ' + e.message);
     }
   } else {
-    console.log('Configuration cancelled or no data received');
+    Log.info('Configuration cancelled or no data received');
   }
 });
 Pebble.addEventListener('ready', function() {
-  console.log('PebbleKit JS ready!');
+  Log.info('PebbleKit JS ready!');
 
   // Load cached stations immediately (for offline use)
   Storage.loadCachedStations();
@@ -221,28 +220,31 @@ Pebble.addEventListener('ready', function() {
   // Fetch fresh station list in background
   API.fetchStations();
 
+  // Refresh the offline timetable if it is stale
+  Timetable.refresh();
+
   // Load persisted station selection and connection data
   Storage.loadPersistedData();
 
   // Load user configuration and send to watch
   var favoriteStations = Storage.getFavoriteStations();
   if (favoriteStations) {
-    console.log('Loading saved configuration with ' + favoriteStations.length + ' stations');
-    MessageHandler.sendStationsToWatch(favoriteStations);
+    Log.info('Loading saved configuration with ' + favoriteStations.length + ' stations');
+    // Start from the station the phone is at
+    StationLocator.findOrigin(favoriteStations, function(origin) {
+      MessageHandler.sendStationsToWatch(favoriteStations, origin);
+    });
 
-    // Evaluate schedules and set active route
+    // The watch picks the active route from the schedule table sent with them
     var activeRoute = evaluateSchedules();
     if (activeRoute) {
-      console.log('Found active schedule');
-      MessageHandler.setActiveRoute(favoriteStations, activeRoute.fromId, activeRoute.toId);
-    } else {
-      console.log('No active schedule, will use default route');
+      Log.info('Active schedule: ' + activeRoute.fromId + ' -> ' + activeRoute.toId);
     }
   } else {
-    console.log('No saved configuration, watch will use defaults');
+    Log.info('No saved configuration, watch will use defaults');
   }
 
   if (Storage.getCurrentFromStation() && Storage.getCurrentToStation()) {
-    console.log('Restored session: ' + Storage.getCurrentFromStation() + ' -> ' + Storage.getCurrentToStation());
+    Log.info('Restored session: ' + Storage.getCurrentFromStation() + ' -> ' + Storage.getCurrentToStation());
   }
 });
@@ -4,17 +4,89 @@
 // This must match the value in package.json messageKeys
 #define WORKER_REQUEST_GLANCE 100
 
+// Persistent storage key for wake accounting (shared with the app, must match
+// types.h). Only the worker writes it: a total that only grows. The app keeps
+// the last total it counted under its own key.
+#define PERSIST_KEY_WORKER_WAKES 1
+
+// Smart-schedule table written by the app (layout in src/c/schedule.h)
+#define PERSIST_KEY_SCHEDULE_TABLE 4
+#define SCHEDULE_TABLE_VERSION 1
+#define SCHEDULE_TABLE_MAX_ENTRIES 48
+#define SCHEDULE_ENTRY_SIZE 5
+
 // Tick counter for periodic updates
 static uint32_t s_tick_count = 0;
 
+// Wakes since the worker was first installed, and whether some of them
+// aren't in PERSIST_KEY_WORKER_WAKES yet
+static uint32_t s_wake_total = 0;
+static bool s_wakes_unsaved = false;
+
 // Update interval in minutes (how often to refresh glances)
 #define UPDATE_INTERVAL_MINUTES 10
 
+// Interval boundaries as minute-of-week, sorted (starts and ends)
+static uint16_t s_boundaries[SCHEDULE_TABLE_MAX_ENTRIES * 2];
+static uint8_t s_boundary_count = 0;
+
+// Read the schedule table again (the app may have replaced it)
+static void load_boundaries(void) {
+  uint8_t table[2 + SCHEDULE_TABLE_MAX_ENTRIES * SCHEDULE_ENTRY_SIZE];
+  int length = persist_exists(PERSIST_KEY_SCHEDULE_TABLE) ?
+               persist_read_data(PERSIST_KEY_SCHEDULE_TABLE, table, sizeof(table)) : 0;
+  s_boundary_count = 0;
+  if (length < 2 || table[0] != SCHEDULE_TABLE_VERSION || table[1] > SCHEDULE_TABLE_MAX_ENTRIES ||
+      length != 2 + table[1] * SCHEDULE_ENTRY_SIZE) {
+    return;
+  }
+
+  // Intervals are sorted and don't overlap, so their starts and ends are too
+  for (uint8_t i = 0; i < table[1]; i++) {
+    const uint8_t *entry = &table[2 + i * SCHEDULE_ENTRY_SIZE];
+    s_boundaries[s_boundary_count++] = entry[0] | (entry[1] << 8);
+    s_boundaries[s_boundary_count++] = entry[2] | (entry[3] << 8);
+  }
+}
+
+// Whether the active route changes at this minute of the week (binary search)
+static bool is_boundary(uint16_t minute) {
+  int low = 0;
+  int high = s_boundary_count - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    if (s_boundaries[mid] == minute) return true;
+    if (s_boundaries[mid] < minute) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return false;
+}
+
+// Persist the wake total
+static void save_wakes(void) {
+  if (!s_wakes_unsaved) return;
+
+  persist_write_int(PERSIST_KEY_WORKER_WAKES, (int32_t)s_wake_total);
+  s_wakes_unsaved = false;
+}
+
 static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
   s_tick_count++;
+  s_wake_total++;
+  s_wakes_unsaved = true;
+
+  // Every UPDATE_INTERVAL_MINUTES, and as soon as a smart schedule starts
+  // or ends, request a glance update
+  uint16_t minute = tick_time->tm_wday * 24 * 60 + tick_time->tm_hour * 60 + tick_time->tm_min;
+  if (s_tick_count % UPDATE_INTERVAL_MINUTES == 0 || is_boundary(minute)) {
+    load_boundaries();
+
+    // Batched to keep flash writes to one per update interval
+    save_wakes();
 
-  // Every UPDATE_INTERVAL_MINUTES, request a glance update
-  if (s_tick_count % UPDATE_INTERVAL_MINUTES == 0) {
     APP_LOG(APP_LOG_LEVEL_INFO, "Worker requesting glance update (every %d minutes)", UPDATE_INTERVAL_MINUTES);
 
     // Construct a message packet
@@ -30,6 +102,10 @@ static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
 static void worker_init(void) {
   APP_LOG(APP_LOG_LEVEL_INFO, "NMBS Background Worker initialized");
 
+  load_boundaries();
+  s_wake_total = persist_exists(PERSIST_KEY_WORKER_WAKES) ?
+                 (uint32_t)persist_read_int(PERSIST_KEY_WORKER_WAKES) : 0;
+
   // Subscribe to minute tick timer
   tick_timer_service_subscribe(MINUTE_UNIT, tick_handler);
 }
@@ -39,6 +115,8 @@ static void worker_deinit(void) {
 
   // Unsubscribe from tick timer
   tick_timer_service_unsubscribe();
+
+  save_wakes();
 }
 
 int main(void) {